@@ -0,0 +1,188 @@
+#ifndef _PPMD_BENCH
+#define _PPMD_BENCH
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Result of timing one benchmark for one set of parameters.
+ */
+struct BenchResult {
+    std::string name;
+    std::string params;
+    long npart;
+    int nrepeat;
+    double time_min;
+    double time_mean;
+
+    inline double particles_per_second() const {
+        return (this->time_min > 0.0) ? this->npart / this->time_min : 0.0;
+    }
+    inline std::string key() const { return this->name + "," + this->params; }
+};
+
+/*
+ * Times benchmarks, where each benchmark processes a known number of
+ * particles, and reads and writes the results as CSV.
+ */
+class BenchRunner {
+  private:
+    std::map<std::string, double> baseline;
+
+  public:
+    std::vector<BenchResult> results;
+    int nrepeat;
+    // Run reduced parameter sweeps.
+    bool quick;
+    // Peak floating point operations per second of the device, 0 if unknown.
+    double peak_flops;
+
+    BenchRunner(const int nrepeat = 5, const bool quick = false)
+        : nrepeat(nrepeat), quick(quick), peak_flops(0.0){};
+
+    /*
+     * Report the floating point operations per second achieved by the last
+     * benchmark, which performed flops_per_particle operations per particle,
+     * and the fraction of peak_flops if known.
+     */
+    inline void report_flops(const double flops_per_particle) {
+        const double flops =
+            this->results.back().particles_per_second() * flops_per_particle;
+        std::cout << std::left << std::setw(36) << "" << std::setw(32)
+                  << "  achieved" << std::right << std::setw(14)
+                  << std::scientific << std::setprecision(4) << flops
+                  << " FLOP/s";
+        if (this->peak_flops > 0.0) {
+            std::cout << std::fixed << std::setprecision(2) << "  "
+                      << 100.0 * flops / this->peak_flops << "% of peak";
+        }
+        std::cout << std::endl;
+    }
+
+    /*
+     * Time the function run, which processes npart particles. The function
+     * setup is called before each call to run and is not timed. One untimed
+     * warm up call of run is made.
+     */
+    inline void run(const std::string name, const std::string params,
+                    const long npart, std::function<void()> setup,
+                    std::function<void()> run) {
+        std::vector<double> times;
+        for (int rx = -1; rx < this->nrepeat; rx++) {
+            setup();
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            run();
+            const auto t1 = std::chrono::high_resolution_clock::now();
+            if (rx >= 0) {
+                times.push_back(std::chrono::duration<double>(t1 - t0).count());
+            }
+        }
+
+        BenchResult result;
+        result.name = name;
+        result.params = params;
+        result.npart = npart;
+        result.nrepeat = this->nrepeat;
+        result.time_min = *std::min_element(times.begin(), times.end());
+        double time_sum = 0.0;
+        for (auto &t : times) {
+            time_sum += t;
+        }
+        result.time_mean = time_sum / times.size();
+        this->results.push_back(result);
+
+        std::cout << std::left << std::setw(36) << name << std::setw(32)
+                  << params << std::right << std::setw(14) << std::scientific
+                  << std::setprecision(4) << result.particles_per_second()
+                  << " particles/s" << this->compare(result) << std::endl;
+    }
+
+    /*
+     * Write the results as CSV with one row per benchmark and parameter set.
+     */
+    inline void write(const std::string filename) {
+        std::ofstream out(filename);
+        out << "name,params,npart,nrepeat,time_min,time_mean,particles_per_"
+               "second\n";
+        out << std::scientific << std::setprecision(8);
+        for (auto &result : this->results) {
+            out << result.name << ",\"" << result.params << "\","
+                << result.npart << "," << result.nrepeat << ","
+                << result.time_min << "," << result.time_mean << ","
+                << result.particles_per_second() << "\n";
+        }
+    }
+
+    /*
+     * Read particles per second values from a CSV file written by write.
+     * Returns false if the file cannot be read.
+     */
+    inline bool read_baseline(const std::string filename) {
+        std::ifstream in(filename);
+        if (!in.good()) {
+            return false;
+        }
+        std::string line;
+        std::getline(in, line);
+        while (std::getline(in, line)) {
+            // name,"params",npart,nrepeat,time_min,time_mean,rate
+            const auto q0 = line.find('"');
+            const auto q1 = line.find('"', q0 + 1);
+            const auto last = line.rfind(',');
+            if ((q0 == std::string::npos) || (q1 == std::string::npos) ||
+                (last == std::string::npos)) {
+                continue;
+            }
+            const std::string name = line.substr(0, q0 - 1);
+            const std::string params = line.substr(q0 + 1, q1 - q0 - 1);
+            this->baseline[name + "," + params] =
+                std::stod(line.substr(last + 1));
+        }
+        return true;
+    }
+
+    /*
+     * Describe the change relative to the baseline, if one exists.
+     */
+    inline std::string compare(const BenchResult &result) {
+        auto it = this->baseline.find(result.key());
+        if ((it == this->baseline.end()) || (it->second <= 0.0)) {
+            return "";
+        }
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(3) << "  x"
+            << result.particles_per_second() / it->second << " vs baseline";
+        return out.str();
+    }
+};
+
+/*
+ * Format a parameter set as "key=value;key=value".
+ */
+inline std::string
+bench_params(std::vector<std::pair<std::string, long>> params) {
+    std::ostringstream out;
+    for (std::size_t px = 0; px < params.size(); px++) {
+        out << ((px > 0) ? ";" : "") << params[px].first << "="
+            << params[px].second;
+    }
+    return out.str();
+}
+
+void bench_particle_dat(BenchRunner &runner);
+void bench_cell_dat(BenchRunner &runner);
+void bench_particle_group(BenchRunner &runner);
+void bench_particle_loop(BenchRunner &runner);
+void bench_particle_loop_layout(BenchRunner &runner);
+void bench_particle_loop_simd(BenchRunner &runner);
+void bench_particle_sort(BenchRunner &runner);
+
+#endif
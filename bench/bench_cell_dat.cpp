@@ -0,0 +1,51 @@
+#include <CL/sycl.hpp>
+#include <ppmd.hpp>
+
+#include "bench.hpp"
+using namespace PPMD;
+
+/*
+ * Time CellDat::get_cell and CellDat::set_cell over every cell.
+ */
+void bench_cell_dat(BenchRunner &runner) {
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    std::vector<int> cell_counts = {64, 1024, 16384};
+    std::vector<int> ppcs = {16, 128};
+    std::vector<int> ncomps = {1, 3, 6};
+    if (runner.quick) {
+        cell_counts = {64, 1024};
+        ppcs = {16};
+    }
+
+    for (auto cell_count : cell_counts) {
+        for (auto ppc : ppcs) {
+            for (auto ncomp : ncomps) {
+                CellDat<PPMD::REAL> cell_dat(sycl_target, cell_count, ncomp);
+                for (int cellx = 0; cellx < cell_count; cellx++) {
+                    cell_dat.set_nrow(cellx, ppc);
+                }
+                std::vector<CellData<PPMD::REAL>> cells(cell_count);
+                const auto params = bench_params(
+                    {{"ncell", cell_count}, {"ppc", ppc}, {"ncomp", ncomp}});
+
+                runner.run(
+                    "CellDat::get_cell", params, (long)cell_count * ppc,
+                    []() {},
+                    [&]() {
+                        for (int cellx = 0; cellx < cell_count; cellx++) {
+                            cells[cellx] = cell_dat.get_cell(cellx);
+                        }
+                    });
+                runner.run(
+                    "CellDat::set_cell", params, (long)cell_count * ppc,
+                    []() {},
+                    [&]() {
+                        for (int cellx = 0; cellx < cell_count; cellx++) {
+                            cell_dat.set_cell(cellx, cells[cellx]);
+                        }
+                    });
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#include <cstdlib>
+#include <cstring>
+#include <mpi.h>
+#include <string>
+
+#include "bench.hpp"
+
+/*
+ * Runs the benchmarks. Arguments:
+ *  --output <file>     write the results as CSV to this file.
+ *  --baseline <file>   compare the results against a CSV file from an earlier
+ *                      run.
+ *  --repeat <n>        number of timed repeats of each benchmark.
+ *  --quick             run reduced parameter sweeps.
+ *  --peak-gflops <x>   peak GFLOP/s of the device, used to report the
+ *                      fraction of peak achieved by compute bound benchmarks.
+ */
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+
+    std::string output = "bench_results.csv";
+    std::string baseline = "";
+    int nrepeat = 5;
+    bool quick = false;
+    double peak_gflops = 0.0;
+    for (int argx = 1; argx < argc; argx++) {
+        if ((std::strcmp(argv[argx], "--output") == 0) && (argx + 1 < argc)) {
+            output = argv[++argx];
+        } else if ((std::strcmp(argv[argx], "--baseline") == 0) &&
+                   (argx + 1 < argc)) {
+            baseline = argv[++argx];
+        } else if ((std::strcmp(argv[argx], "--repeat") == 0) &&
+                   (argx + 1 < argc)) {
+            nrepeat = std::atoi(argv[++argx]);
+        } else if (std::strcmp(argv[argx], "--quick") == 0) {
+            quick = true;
+        } else if ((std::strcmp(argv[argx], "--peak-gflops") == 0) &&
+                   (argx + 1 < argc)) {
+            peak_gflops = std::atof(argv[++argx]);
+        }
+    }
+
+    BenchRunner runner(nrepeat, quick);
+    runner.peak_flops = peak_gflops * 1.0e9;
+    if ((baseline.size() > 0) && (!runner.read_baseline(baseline))) {
+        std::cout << "No baseline found at " << baseline << std::endl;
+    }
+
+    bench_particle_dat(runner);
+    bench_cell_dat(runner);
+    bench_particle_group(runner);
+    bench_particle_loop(runner);
+    bench_particle_loop_layout(runner);
+    bench_particle_loop_simd(runner);
+    bench_particle_sort(runner);
+
+    runner.write(output);
+    std::cout << "Results written to " << output << std::endl;
+
+    MPI_Finalize();
+    return 0;
+}
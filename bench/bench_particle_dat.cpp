@@ -0,0 +1,46 @@
+#include <CL/sycl.hpp>
+#include <ppmd.hpp>
+#include <random>
+
+#include "bench.hpp"
+using namespace PPMD;
+
+/*
+ * Time ParticleDatT::realloc growing every cell from ppc to 2 * ppc rows.
+ */
+void bench_particle_dat(BenchRunner &runner) {
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    std::vector<int> cell_counts = {64, 1024, 16384};
+    std::vector<int> ppcs = {16, 128};
+    std::vector<int> ncomps = {1, 3, 6};
+    if (runner.quick) {
+        cell_counts = {64, 1024};
+        ppcs = {16};
+    }
+
+    for (auto cell_count : cell_counts) {
+        for (auto ppc : ppcs) {
+            for (auto ncomp : ncomps) {
+                std::vector<PPMD::INT> counts_0(cell_count, ppc);
+                std::vector<PPMD::INT> counts_1(cell_count, 2 * ppc);
+                ParticleDatShPtr<PPMD::REAL> A;
+
+                runner.run(
+                    "ParticleDatT::realloc",
+                    bench_params({{"ncell", cell_count},
+                                  {"ppc", ppc},
+                                  {"ncomp", ncomp}}),
+                    (long)cell_count * ppc,
+                    [&]() {
+                        A = ParticleDat(sycl_target,
+                                        ParticleProp(Sym<PPMD::REAL>("A"),
+                                                     ncomp),
+                                        cell_count);
+                        A->realloc(counts_0);
+                    },
+                    [&]() { A->realloc(counts_1); });
+            }
+        }
+    }
+}
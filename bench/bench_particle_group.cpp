@@ -0,0 +1,96 @@
+#include <CL/sycl.hpp>
+#include <memory>
+#include <ppmd.hpp>
+#include <random>
+
+#include "bench.hpp"
+using namespace PPMD;
+
+/*
+ * Time the ParticleGroup operations that move particle data: appending
+ * particles, removing particles and sorting particles within cells.
+ */
+void bench_particle_group(BenchRunner &runner) {
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    std::vector<int> cell_counts_1d = {4, 16, 64};
+    std::vector<int> ppcs = {16, 128};
+    std::vector<int> ncomps = {1, 3, 6};
+    if (runner.quick) {
+        cell_counts_1d = {4, 16};
+        ppcs = {16};
+    }
+
+    for (auto cell_count_1d : cell_counts_1d) {
+        std::vector<int> dims = {cell_count_1d, cell_count_1d};
+        MeshHierarchy mesh_hierarchy(sycl_target, 2, dims, 1.0, 3);
+        const int cell_count = mesh_hierarchy.ncells_coarse;
+        Mesh mesh(cell_count);
+        Domain domain(mesh);
+
+        for (auto ppc : ppcs) {
+            for (auto ncomp : ncomps) {
+                const int N = cell_count * ppc;
+                ParticleSpec particle_spec{
+                    ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                    ParticleProp(Sym<PPMD::REAL>("V"), ncomp),
+                    ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                    ParticleProp(Sym<PPMD::INT>("MASK"), 1)};
+
+                std::mt19937 rng(52234);
+                std::uniform_real_distribution<double> pos_rng(0.0, 1.0);
+                ParticleSet initial_distribution(N, particle_spec);
+                for (int px = 0; px < N; px++) {
+                    const int cell = px % cell_count;
+                    const int cell_index[2] = {cell % cell_count_1d,
+                                               cell / cell_count_1d};
+                    initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] =
+                        cell;
+                    initial_distribution[Sym<PPMD::INT>("MASK")][px][0] =
+                        (px % 10 == 0) ? 1 : 0;
+                    for (int dimx = 0; dimx < 2; dimx++) {
+                        initial_distribution[Sym<PPMD::REAL>("P")][px][dimx] =
+                            cell_index[dimx] + pos_rng(rng);
+                    }
+                    for (int cx = 0; cx < ncomp; cx++) {
+                        initial_distribution[Sym<PPMD::REAL>("V")][px][cx] =
+                            pos_rng(rng);
+                    }
+                }
+
+                const auto params = bench_params(
+                    {{"ncell", cell_count}, {"ppc", ppc}, {"ncomp", ncomp}});
+                std::shared_ptr<ParticleGroup> A;
+                auto lambda_make_group = [&]() {
+                    A = std::make_shared<ParticleGroup>(domain, particle_spec,
+                                                        sycl_target);
+                };
+                auto lambda_make_populated_group = [&]() {
+                    lambda_make_group();
+                    A->add_particles_local(initial_distribution);
+                };
+
+                runner.run("ParticleGroup::add_particles_local", params, N,
+                           lambda_make_group, [&]() {
+                               A->add_particles_local(initial_distribution);
+                           });
+
+                runner.run("ParticleGroup::remove_particles", params, N,
+                           lambda_make_populated_group, [&]() {
+                               A->remove_particles(
+                                   (*A)[Sym<PPMD::INT>("MASK")]);
+                           });
+
+                std::shared_ptr<ParticleSort> particle_sort;
+                runner.run(
+                    "ParticleSort::sort", params, N,
+                    [&]() {
+                        lambda_make_populated_group();
+                        particle_sort = std::make_shared<ParticleSort>(
+                            *A, mesh_hierarchy);
+                    },
+                    [&]() { particle_sort->sort(); });
+            }
+        }
+    }
+}
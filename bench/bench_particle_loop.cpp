@@ -0,0 +1,254 @@
+#include <CL/sycl.hpp>
+#include <memory>
+#include <ppmd.hpp>
+#include <random>
+
+#include "bench.hpp"
+using namespace PPMD;
+
+/*
+ * Time a streaming ParticleLoop under each schedule, and a sequence of three
+ * loops with and without fusion, for uniform and skewed cell occupancies. In
+ * the skewed distribution half of the particles are placed in a single cell.
+ */
+void bench_particle_loop(BenchRunner &runner) {
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    std::vector<int> cell_counts = {64, 1024};
+    std::vector<int> ppcs = {16, 128};
+    if (runner.quick) {
+        cell_counts = {64};
+        ppcs = {16};
+    }
+    const std::vector<std::pair<std::string, ParticleLoopSchedule>> schedules =
+        {{"automatic", ParticleLoopSchedule::automatic},
+         {"cell_blocked", ParticleLoopSchedule::cell_blocked},
+         {"flat", ParticleLoopSchedule::flat}};
+
+    for (auto cell_count : cell_counts) {
+        Mesh mesh(cell_count);
+        Domain domain(mesh);
+        for (auto ppc : ppcs) {
+            for (int skewed = 0; skewed < 2; skewed++) {
+                const int N = cell_count * ppc;
+                ParticleSpec particle_spec{
+                    ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                    ParticleProp(Sym<PPMD::REAL>("V"), 3),
+                    ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true)};
+
+                std::mt19937 rng(9182);
+                std::uniform_real_distribution<double> uniform_rng(0.0, 1.0);
+                ParticleSet initial_distribution(N, particle_spec);
+                for (int px = 0; px < N; px++) {
+                    initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] =
+                        (skewed && (px % 2 == 0)) ? 0 : px % cell_count;
+                    for (int cx = 0; cx < 3; cx++) {
+                        initial_distribution[Sym<PPMD::REAL>("V")][px][cx] =
+                            uniform_rng(rng);
+                    }
+                }
+                ParticleGroup A(domain, particle_spec, sycl_target);
+                A.add_particles_local(initial_distribution);
+
+                auto k_P = A[Sym<PPMD::REAL>("P")]->cell_dat.device_ptr();
+                auto k_V = A[Sym<PPMD::REAL>("V")]->cell_dat.device_ptr();
+                auto loop = ParticleLoop(
+                    "bench_particle_loop", A,
+                    [=](const int cellx, const int layerx) {
+                        k_P[cellx][0][layerx] += 0.01 * k_V[cellx][0][layerx];
+                        k_P[cellx][1][layerx] += 0.01 * k_V[cellx][1][layerx];
+                    });
+
+                for (auto &schedule : schedules) {
+                    loop->schedule = schedule.second;
+                    const auto params =
+                        bench_params({{"ncell", cell_count},
+                                      {"ppc", ppc},
+                                      {"skewed", skewed}}) +
+                        ";schedule=" + schedule.first;
+                    runner.run(
+                        "ParticleLoop::execute", params, N, []() {},
+                        [&]() { loop->execute(); });
+                }
+
+                // A push, boundary and velocity update sequence with and
+                // without fusion.
+                auto P = A[Sym<PPMD::REAL>("P")];
+                auto V = A[Sym<PPMD::REAL>("V")];
+                auto loop_push = ParticleLoop(
+                    "push", A,
+                    [=](const int cellx, const int layerx) {
+                        k_P[cellx][0][layerx] += 0.01 * k_V[cellx][0][layerx];
+                        k_P[cellx][1][layerx] += 0.01 * k_V[cellx][1][layerx];
+                    },
+                    {dat_access<READ>(V), dat_access<WRITE>(P)});
+                auto loop_boundary = ParticleLoop(
+                    "boundary", A,
+                    [=](const int cellx, const int layerx) {
+                        for (int dimx = 0; dimx < 2; dimx++) {
+                            const double p = k_P[cellx][dimx][layerx];
+                            k_P[cellx][dimx][layerx] = p - sycl::floor(p);
+                        }
+                    },
+                    {dat_access<WRITE>(P)});
+                auto loop_velocity = ParticleLoop(
+                    "velocity", A,
+                    [=](const int cellx, const int layerx) {
+                        k_V[cellx][2][layerx] +=
+                            0.01 * k_P[cellx][0][layerx] *
+                            k_P[cellx][1][layerx];
+                    },
+                    {dat_access<READ>(P), dat_access<WRITE>(V)});
+                auto sequence = ParticleLoopSequence(
+                    "bench_sequence", loop_push, loop_boundary, loop_velocity);
+                for (int fused = 0; fused < 2; fused++) {
+                    sequence->fusion_enabled = fused;
+                    const auto params = bench_params({{"ncell", cell_count},
+                                                      {"ppc", ppc},
+                                                      {"skewed", skewed},
+                                                      {"fused", fused}});
+                    runner.run(
+                        "ParticleLoopSequence::execute", params, N, []() {},
+                        [&]() { sequence->execute(); });
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Time a ParticleLoop which reads and writes every component of a position
+ * and a velocity dat with the soa and aosoa layouts.
+ */
+void bench_particle_loop_layout(BenchRunner &runner) {
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    std::vector<int> cell_counts = {64, 1024};
+    const int ppc = 64;
+    if (runner.quick) {
+        cell_counts = {64};
+    }
+    const std::vector<std::pair<std::string, CellDatLayout>> layouts = {
+        {"soa", CellDatLayout::soa}, {"aosoa", CellDatLayout::aosoa}};
+
+    for (auto cell_count : cell_counts) {
+        Mesh mesh(cell_count);
+        Domain domain(mesh);
+        const int N = cell_count * ppc;
+        for (auto &layout : layouts) {
+            ParticleSpec particle_spec{
+                ParticleProp(Sym<PPMD::REAL>("P"), 3, true, layout.second),
+                ParticleProp(Sym<PPMD::REAL>("V"), 3, false, layout.second),
+                ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true)};
+
+            std::mt19937 rng(9182);
+            std::uniform_real_distribution<double> uniform_rng(0.0, 1.0);
+            ParticleSet initial_distribution(N, particle_spec);
+            for (int px = 0; px < N; px++) {
+                initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] =
+                    px % cell_count;
+                for (int cx = 0; cx < 3; cx++) {
+                    initial_distribution[Sym<PPMD::REAL>("V")][px][cx] =
+                        uniform_rng(rng);
+                }
+            }
+            ParticleGroup A(domain, particle_spec, sycl_target);
+            A.add_particles_local(initial_distribution);
+
+            auto k_P = A[Sym<PPMD::REAL>("P")]->cell_dat.device_accessor();
+            auto k_V = A[Sym<PPMD::REAL>("V")]->cell_dat.device_accessor();
+            auto loop = ParticleLoop(
+                "bench_particle_loop_layout", A,
+                [=](const int cellx, const int layerx) {
+                    for (int dimx = 0; dimx < 3; dimx++) {
+                        k_V[cellx][dimx][layerx] -=
+                            0.01 * k_P[cellx][dimx][layerx];
+                        k_P[cellx][dimx][layerx] +=
+                            0.01 * k_V[cellx][dimx][layerx];
+                    }
+                });
+            const auto params =
+                bench_params({{"ncell", cell_count}, {"ppc", ppc}}) +
+                ";layout=" + layout.first;
+            runner.run(
+                "ParticleLoop::execute", params, N, []() {},
+                [&]() { loop->execute(); });
+        }
+    }
+}
+
+/*
+ * Time a compute bound ParticleLoop, which evaluates a polynomial of each
+ * position component, under the cell blocked and simd schedules and report
+ * the achieved FLOP/s. Pass --peak-gflops to compare against the peak of the
+ * device.
+ */
+void bench_particle_loop_simd(BenchRunner &runner) {
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    std::vector<int> cell_counts = {64, 1024};
+    const int ppc = 100;
+    if (runner.quick) {
+        cell_counts = {64};
+    }
+    // One multiply and one add per degree for each of three components.
+    const int degree = 32;
+    const double flops_per_particle = 3 * 2 * degree;
+    const std::vector<std::pair<std::string, ParticleLoopSchedule>> schedules =
+        {{"cell_blocked", ParticleLoopSchedule::cell_blocked},
+         {"simd", ParticleLoopSchedule::simd}};
+    const std::vector<std::pair<std::string, CellDatLayout>> layouts = {
+        {"soa", CellDatLayout::soa}, {"aosoa", CellDatLayout::aosoa}};
+
+    for (auto cell_count : cell_counts) {
+        Mesh mesh(cell_count);
+        Domain domain(mesh);
+        const int N = cell_count * ppc;
+        for (auto &layout : layouts) {
+            ParticleSpec particle_spec{
+                ParticleProp(Sym<PPMD::REAL>("P"), 3, true, layout.second),
+                ParticleProp(Sym<PPMD::REAL>("F"), 3, false, layout.second),
+                ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true)};
+
+            std::mt19937 rng(5219);
+            std::uniform_real_distribution<double> uniform_rng(0.0, 1.0);
+            ParticleSet initial_distribution(N, particle_spec);
+            for (int px = 0; px < N; px++) {
+                initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] =
+                    px % cell_count;
+                for (int cx = 0; cx < 3; cx++) {
+                    initial_distribution[Sym<PPMD::REAL>("P")][px][cx] =
+                        uniform_rng(rng);
+                }
+            }
+            ParticleGroup A(domain, particle_spec, sycl_target);
+            A.add_particles_local(initial_distribution);
+
+            auto k_P = A[Sym<PPMD::REAL>("P")]->cell_dat.device_accessor();
+            auto k_F = A[Sym<PPMD::REAL>("F")]->cell_dat.device_accessor();
+            auto loop = ParticleLoop(
+                "bench_particle_loop_simd", A,
+                [=](const int cellx, const int layerx) {
+                    for (int dimx = 0; dimx < 3; dimx++) {
+                        const double p = k_P[cellx][dimx][layerx];
+                        double f = 1.0;
+                        for (int termx = 0; termx < degree; termx++) {
+                            f = f * p + 0.5;
+                        }
+                        k_F[cellx][dimx][layerx] = f;
+                    }
+                });
+
+            for (auto &schedule : schedules) {
+                loop->schedule = schedule.second;
+                const auto params =
+                    bench_params({{"ncell", cell_count}, {"ppc", ppc}}) +
+                    ";layout=" + layout.first + ";schedule=" + schedule.first;
+                runner.run(
+                    "ParticleLoop::execute:flops", params, N, []() {},
+                    [&]() { loop->execute(); });
+                runner.report_flops(flops_per_particle);
+            }
+        }
+    }
+}
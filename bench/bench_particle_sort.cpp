@@ -0,0 +1,128 @@
+#include <CL/sycl.hpp>
+#include <ppmd.hpp>
+#include <random>
+
+#include "bench.hpp"
+using namespace PPMD;
+
+/*
+ * Time a field gather loop and a charge deposition loop on the fine cells of
+ * a MeshHierarchy before and after the particles are sorted with
+ * ParticleSort, and time the sort itself. Particles are placed uniformly at
+ * random, hence before the sort consecutive particles of a cell access
+ * unrelated fine cells. The sort is also timed with a skewed occupancy where
+ * most particles lie in one cell.
+ */
+void bench_particle_sort(BenchRunner &runner) {
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    constexpr int ndim = 3;
+    std::vector<int> dims = {16, 16, 16};
+    int ppc = 64;
+    if (runner.quick) {
+        dims = {8, 8, 8};
+        ppc = 16;
+    }
+    const int subdivision_order = 3;
+    const double extent = 1.0;
+    MeshHierarchy mh(sycl_target, ndim, dims, extent, subdivision_order);
+    const int cell_count = mh.ncells_coarse;
+    const int ncells_fine = mh.ncells_fine;
+    const int N = cell_count * ppc;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), ndim, true),
+                               ParticleProp(Sym<PPMD::REAL>("E"), 1),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true)};
+
+    std::mt19937 rng(7391);
+    std::uniform_real_distribution<double> uniform_rng(0.0, 1.0);
+    // Place particle px in cell lambda_cell(px) at a random position.
+    auto lambda_add = [&](ParticleGroup &group, auto lambda_cell) {
+        ParticleSet initial_distribution(N, particle_spec);
+        for (int px = 0; px < N; px++) {
+            const int cell = lambda_cell(px);
+            initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cell;
+            int cell_remainder = cell;
+            for (int dimx = 0; dimx < ndim; dimx++) {
+                const int cell_index = cell_remainder % dims[dimx];
+                cell_remainder /= dims[dimx];
+                initial_distribution[Sym<PPMD::REAL>("P")][px][dimx] =
+                    (cell_index + uniform_rng(rng)) * extent;
+            }
+        }
+        group.add_particles_local(initial_distribution);
+    };
+    ParticleGroup A(domain, particle_spec, sycl_target);
+    lambda_add(A, [=](const int px) { return px % cell_count; });
+
+    // One value per fine cell.
+    BufferDevice<PPMD::REAL> d_grid(sycl_target, cell_count * ncells_fine);
+    sycl_target.queue
+        .fill(d_grid.ptr, (PPMD::REAL)1.0, cell_count * ncells_fine)
+        .wait();
+    PPMD::REAL *k_grid = d_grid.ptr;
+    const auto k_mh = mh.get_device_view<ndim>();
+    auto P = A[Sym<PPMD::REAL>("P")];
+    auto E = A[Sym<PPMD::REAL>("E")];
+    auto k_P = P->cell_dat.device_accessor();
+    auto k_E = E->cell_dat.device_accessor();
+
+    auto lambda_fine_index = [=](const int cellx, const int layerx) {
+        double position[ndim];
+        for (int dimx = 0; dimx < ndim; dimx++) {
+            position[dimx] = k_P[cellx][dimx][layerx];
+        }
+        int index_coarse[ndim];
+        int index_fine[ndim];
+        k_mh.position_to_tuple(position, index_coarse, index_fine);
+        return cellx * ncells_fine + k_mh.tuple_to_linear_fine(index_fine);
+    };
+    auto loop_gather = ParticleLoop(
+        "bench_particle_sort_gather", A,
+        [=](const int cellx, const int layerx) {
+            k_E[cellx][0][layerx] = k_grid[lambda_fine_index(cellx, layerx)];
+        },
+        {dat_access<READ>(P), dat_access<WRITE>(E)});
+    auto loop_deposit = ParticleLoop(
+        "bench_particle_sort_deposit", A,
+        [=](const int cellx, const int layerx) {
+            atomic_fetch_add(&k_grid[lambda_fine_index(cellx, layerx)],
+                             (PPMD::REAL)0.001);
+        },
+        {dat_access<READ>(P)});
+
+    auto lambda_run_loops = [&](const int sorted) {
+        const auto params = bench_params(
+            {{"ncell", cell_count}, {"ppc", ppc}, {"sorted", sorted}});
+        runner.run(
+            "ParticleLoop::execute:gather", params, N, []() {},
+            [&]() { loop_gather->execute(); });
+        runner.run(
+            "ParticleLoop::execute:deposit", params, N, []() {},
+            [&]() { loop_deposit->execute(); });
+    };
+
+    // The sort also sets the cell traversal order, hence the unsorted loops
+    // are timed before the ParticleSort is created.
+    lambda_run_loops(0);
+    ParticleSort particle_sort(A, mh, 0);
+    runner.run(
+        "ParticleSort::sort",
+        bench_params({{"ncell", cell_count}, {"ppc", ppc}}), N, []() {},
+        [&]() { particle_sort.sort(); });
+    lambda_run_loops(1);
+
+    // Seven in eight particles lie in cell 0, the sort of this cell is split
+    // over many work items.
+    ParticleGroup B(domain, particle_spec, sycl_target);
+    lambda_add(B, [=](const int px) {
+        return (px % 8 == 0) ? px % cell_count : 0;
+    });
+    ParticleSort particle_sort_skewed(B, mh, 0);
+    runner.run(
+        "ParticleSort::sort",
+        bench_params({{"ncell", cell_count}, {"ppc", ppc}, {"skewed", 1}}), N,
+        []() {}, [&]() { particle_sort_skewed.sort(); });
+}
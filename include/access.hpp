@@ -67,11 +67,104 @@ template <typename T> class RawPointerColumnMajorRowAccessor {
     };
 };
 
+/*
+ * Layouts of the rows (particles) of a CellDat on the device.
+ *
+ *  soa:    Each column of a cell is a separate contiguous array.
+ *  aosoa:  Rows are grouped into tiles of PPMD_TILE_WIDTH rows. The tiles of
+ *          a cell are contiguous and within a tile the columns are stored
+ *          one after another, i.e. the order from slowest to fastest is
+ *          tile, column, row within the tile.
+ */
+enum class CellDatLayout { soa, aosoa };
+
+/*
+ * Number of rows in a tile of the aosoa layout. Should match the SIMD width
+ * or sub-group size of the target and must be a power of two.
+ */
+#ifndef PPMD_TILE_WIDTH
+#define PPMD_TILE_WIDTH 8
+#endif
+static_assert((PPMD_TILE_WIDTH > 0) &&
+                  ((PPMD_TILE_WIDTH & (PPMD_TILE_WIDTH - 1)) == 0),
+              "PPMD_TILE_WIDTH must be a power of two.");
+
+/*
+ * Map a row of a column to the index of the element relative to the start of
+ * the column. For the aosoa layout the column pointer is the start of the
+ * column in the first tile and each following tile is (ncol - 1) * tile_width
+ * elements further on, i.e. tile_skip. For the soa layout tile_skip is zero.
+ */
+inline int tiled_row_index(const int rowx, const int tile_shift,
+                           const int tile_skip) {
+    return rowx + (rowx >> tile_shift) * tile_skip;
+}
+
+template <typename T> class TiledColumnAccessor {
+  private:
+    T *col_ptr;
+    const int tile_shift;
+    const int tile_skip;
+
+  public:
+    TiledColumnAccessor(T *col_ptr, const int tile_shift, const int tile_skip)
+        : col_ptr(col_ptr), tile_shift(tile_shift), tile_skip(tile_skip){};
+
+    inline T &operator[](const int rowx) const {
+        return this->col_ptr[tiled_row_index(rowx, this->tile_shift,
+                                             this->tile_skip)];
+    };
+};
+
+template <typename T> class TiledCellAccessor {
+  private:
+    T **cell_ptr;
+    const int tile_shift;
+    const int tile_skip;
+
+  public:
+    TiledCellAccessor(T **cell_ptr, const int tile_shift, const int tile_skip)
+        : cell_ptr(cell_ptr), tile_shift(tile_shift), tile_skip(tile_skip){};
+
+    inline TiledColumnAccessor<T> operator[](const int colx) const {
+        return TiledColumnAccessor<T>(this->cell_ptr[colx], this->tile_shift,
+                                      this->tile_skip);
+    };
+};
+
+/*
+ * Device accessor for a CellDat which hides the layout of the CellDat. Data
+ * is accessed in SYCL kernels as d[cell_index][column_index][row_index] for
+ * both the soa and aosoa layouts. Obtained with CellDat::device_accessor and
+ * copied by value into kernels.
+ */
+template <typename T> class CellDatDeviceAccessor {
+  private:
+    T ***d_ptr;
+    int tile_shift;
+    int tile_skip;
+
+  public:
+    CellDatDeviceAccessor(T ***d_ptr, const int tile_shift, const int tile_skip)
+        : d_ptr(d_ptr), tile_shift(tile_shift), tile_skip(tile_skip){};
+
+    inline TiledCellAccessor<T> operator[](const int cellx) const {
+        return TiledCellAccessor<T>(this->d_ptr[cellx], this->tile_shift,
+                                    this->tile_skip);
+    };
+};
+
 class AccessMode {};
 
-class READ : public AccessMode {};
+class READ : public AccessMode {
+  public:
+    static constexpr bool write = false;
+};
 
-class WRITE : public AccessMode {};
+class WRITE : public AccessMode {
+  public:
+    static constexpr bool write = true;
+};
 
 template <typename T> class Accessor {
   private:
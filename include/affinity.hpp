@@ -0,0 +1,202 @@
+#ifndef _PPMD_AFFINITY
+#define _PPMD_AFFINITY
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mpi.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "communication.hpp"
+#include "typedefs.hpp"
+
+namespace PPMD {
+
+/*
+ * Parse a Linux CPU list, e.g. "0-3,8,10-11", into a list of CPU indices.
+ */
+inline std::vector<int> parse_cpu_list(const std::string &cpu_list) {
+    std::vector<int> cpus;
+    std::stringstream stream(cpu_list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.find_first_of("0123456789") == std::string::npos) {
+            continue;
+        }
+        const std::size_t dash = range.find('-');
+        const int start = std::stoi(range.substr(0, dash));
+        const int end = (dash == std::string::npos)
+                            ? start
+                            : std::stoi(range.substr(dash + 1));
+        for (int cpux = start; cpux <= end; cpux++) {
+            cpus.push_back(cpux);
+        }
+    }
+    return cpus;
+}
+
+/*
+ * Get the CPUs of each NUMA node from sysfs. Returns a single domain holding
+ * no CPUs if the NUMA topology is not available.
+ */
+inline std::vector<std::vector<int>> get_numa_node_cpus() {
+    std::vector<std::vector<int>> numa_cpus;
+    for (int nodex = 0;; nodex++) {
+        std::ifstream file("/sys/devices/system/node/node" +
+                           std::to_string(nodex) + "/cpulist");
+        if (!file.is_open()) {
+            break;
+        }
+        std::string cpu_list;
+        std::getline(file, cpu_list);
+        numa_cpus.push_back(parse_cpu_list(cpu_list));
+    }
+    if (numa_cpus.size() == 0) {
+        numa_cpus.push_back(std::vector<int>());
+    }
+    return numa_cpus;
+}
+
+/*
+ * Partition the CPUs of a node, given per NUMA node, between nranks ranks
+ * and return the CPUs of a rank. If there are at least as many ranks as NUMA
+ * nodes the ranks are divided between the NUMA nodes and the CPUs of each
+ * NUMA node are divided between its ranks, such that no rank spans NUMA
+ * nodes. Otherwise each rank is given a contiguous set of whole NUMA nodes.
+ * Empty NUMA nodes, e.g. memory only nodes, are ignored. Ranks share CPUs if
+ * a NUMA node has fewer CPUs than ranks.
+ */
+inline std::vector<int>
+partition_node_cpus(const std::vector<std::vector<int>> &numa_cpus,
+                    const int nranks, const int rank) {
+    PPMDASSERT((rank >= 0) && (rank < nranks), "Bad rank");
+    std::vector<std::vector<int>> domains;
+    for (auto &cpus : numa_cpus) {
+        if (cpus.size() > 0) {
+            domains.push_back(cpus);
+        }
+    }
+    const int ndomain = domains.size();
+    std::vector<int> rank_cpus;
+    if (ndomain == 0) {
+        return rank_cpus;
+    }
+
+    if (nranks < ndomain) {
+        const int start = (rank * ndomain) / nranks;
+        const int end = ((rank + 1) * ndomain) / nranks;
+        for (int dx = start; dx < end; dx++) {
+            rank_cpus.insert(rank_cpus.end(), domains[dx].begin(),
+                             domains[dx].end());
+        }
+        return rank_cpus;
+    }
+
+    // The domain of the rank and the ranks that share the domain.
+    int domain = 0;
+    while (((domain + 1) * nranks) / ndomain <= rank) {
+        domain++;
+    }
+    const int rank_start = (domain * nranks) / ndomain;
+    const int nranks_domain = ((domain + 1) * nranks) / ndomain - rank_start;
+    const int rank_domain = rank - rank_start;
+    auto &cpus = domains[domain];
+    const int ncpus = cpus.size();
+    if (ncpus < nranks_domain) {
+        rank_cpus.push_back(cpus[rank_domain % ncpus]);
+        return rank_cpus;
+    }
+    const int start = (rank_domain * ncpus) / nranks_domain;
+    const int end = ((rank_domain + 1) * ncpus) / nranks_domain;
+    rank_cpus.assign(cpus.begin() + start, cpus.begin() + end);
+    return rank_cpus;
+}
+
+/*
+ * Collective on the intra-node communicator of comm_pair. Partition the CPUs
+ * of the node between the ranks on the node with partition_node_cpus and
+ * restrict this process to its CPUs. The CPUs of the node are the union of
+ * the CPUs the ranks on the node may run on. Only the CPUs of the partition
+ * that this process may already run on are used, if there are none the
+ * affinity is left unchanged with a warning. Threads created after this
+ * call, e.g. the worker threads of the SYCL runtime, inherit the
+ * restriction, hence memory they first touch is allocated on the NUMA node
+ * of the rank. OMP_NUM_THREADS is set to the number of CPUs of the rank if
+ * it is not already set. Returns the CPUs of this rank, empty if affinity
+ * is not supported on this platform or is left unchanged.
+ */
+inline std::vector<int> set_node_affinity(CommPair &comm_pair) {
+    std::vector<int> rank_cpus;
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    PPMDASSERT(sched_getaffinity(0, sizeof(cpu_set_t), &cpu_set) == 0,
+               "sched_getaffinity failed");
+    std::vector<unsigned char> mask(CPU_SETSIZE);
+    for (int cpux = 0; cpux < CPU_SETSIZE; cpux++) {
+        mask[cpux] = CPU_ISSET(cpux, &cpu_set) ? 1 : 0;
+    }
+    const std::vector<unsigned char> mask_rank = mask;
+    MPICHK(MPI_Allreduce(MPI_IN_PLACE, mask.data(), CPU_SETSIZE,
+                         MPI_UNSIGNED_CHAR, MPI_BOR, comm_pair.comm_intra))
+
+    // Group the CPUs of the node by NUMA node, CPUs not listed in a NUMA
+    // node form an extra domain.
+    std::vector<std::vector<int>> numa_cpus = get_numa_node_cpus();
+    std::vector<char> listed(CPU_SETSIZE, 0);
+    for (auto &cpus : numa_cpus) {
+        auto end = std::remove_if(cpus.begin(), cpus.end(), [&](int cpux) {
+            return (cpux >= CPU_SETSIZE) || (mask[cpux] == 0);
+        });
+        cpus.erase(end, cpus.end());
+        for (auto &cpux : cpus) {
+            listed[cpux] = 1;
+        }
+    }
+    std::vector<int> unlisted;
+    for (int cpux = 0; cpux < CPU_SETSIZE; cpux++) {
+        if (mask[cpux] && !listed[cpux]) {
+            unlisted.push_back(cpux);
+        }
+    }
+    if (unlisted.size() > 0) {
+        numa_cpus.push_back(unlisted);
+    }
+
+    rank_cpus = partition_node_cpus(numa_cpus, comm_pair.size_intra,
+                                    comm_pair.rank_intra);
+    if (rank_cpus.size() == 0) {
+        return rank_cpus;
+    }
+    // The launcher may have restricted the ranks to sets that do not match
+    // the partition.
+    auto end = std::remove_if(rank_cpus.begin(), rank_cpus.end(),
+                              [&](int cpux) { return mask_rank[cpux] == 0; });
+    rank_cpus.erase(end, rank_cpus.end());
+    if (rank_cpus.size() == 0) {
+        std::cerr << "PPMD Warning:\tnone of the CPUs assigned to rank "
+                  << comm_pair.rank_parent
+                  << " are in its affinity mask, the affinity is unchanged\n";
+        return rank_cpus;
+    }
+    CPU_ZERO(&cpu_set);
+    for (auto &cpux : rank_cpus) {
+        CPU_SET(cpux, &cpu_set);
+    }
+    PPMDASSERT(sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set) == 0,
+               "sched_setaffinity failed");
+    setenv("OMP_NUM_THREADS", std::to_string(rank_cpus.size()).c_str(), 0);
+#endif
+    return rank_cpus;
+}
+
+} // namespace PPMD
+
+#endif
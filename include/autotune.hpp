@@ -0,0 +1,268 @@
+#ifndef _PPMD_AUTOTUNE
+#define _PPMD_AUTOTUNE
+
+#include <CL/sycl.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * Launch parameters of a kernel. The variant selects between alternative
+ * implementations of a kernel, e.g. a ParticleLoopSchedule, and is
+ * interpreted by the kernel. A local_size of 0 launches the kernel with a
+ * plain range and leaves the work-group size to the SYCL runtime.
+ */
+struct KernelConfig {
+    int variant;
+    int local_size;
+};
+
+/*
+ * Selects launch parameters for named kernels. Tuning is online: while a
+ * kernel is being tuned each launch uses the next untried candidate and the
+ * time of the launch is passed back with record. Hence kernels that modify
+ * their inputs can be tuned as each launch is a launch the caller would make
+ * anyway. Once every candidate has been timed nrepeat times the fastest is
+ * stored and, if a cache file is set, written to the cache file. Configurations
+ * stored in the cache file are used without further tuning.
+ *
+ * Kernels are identified by a key which should combine the kernel name with
+ * a bucket of the problem size, see size_bucket.
+ */
+class Autotuner {
+  private:
+    struct Tuning {
+        std::vector<KernelConfig> candidates;
+        std::vector<double> times;
+        int index;
+        int count;
+    };
+
+    std::map<std::string, KernelConfig> configs;
+    std::map<std::string, double> config_times;
+    std::map<std::string, Tuning> tunings;
+
+  public:
+    // Tune kernels that have no stored configuration.
+    bool enabled;
+    // Number of timed launches of each candidate.
+    int nrepeat;
+    // File the configurations are read from and written to, may be empty.
+    std::string filename;
+    // Write the cache file when tuning of a kernel completes.
+    bool write_cache;
+
+    Autotuner() : enabled(false), nrepeat(3), write_cache(false){};
+
+    /*
+     * The default cache file for a device. The file is placed in the
+     * directory given by the environment variable PPMD_TUNE_DIR or the
+     * working directory if PPMD_TUNE_DIR is not set.
+     */
+    static inline std::string default_filename(const std::string device_name) {
+        const char *env_dir = std::getenv("PPMD_TUNE_DIR");
+        std::string filename = (env_dir != nullptr) ? env_dir : ".";
+        filename += "/ppmd_tuning_";
+        for (auto &c : device_name) {
+            filename += std::isalnum(c) ? c : '_';
+        }
+        return filename + ".txt";
+    }
+
+    /*
+     * Bucket for a problem size, the number of bits required to represent
+     * the size, such that sizes within a factor of two share a bucket.
+     */
+    static inline int size_bucket(std::int64_t size) {
+        int bucket = 0;
+        while (size > 0) {
+            size >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    /*
+     * Candidate local sizes for a device, 0 (runtime default) followed by
+     * powers of two up to the maximum work-group size.
+     */
+    static inline std::vector<int> candidate_local_sizes(sycl::device &device) {
+        const int max_size =
+            device.get_info<sycl::info::device::max_work_group_size>();
+        std::vector<int> local_sizes = {0};
+        for (int size = 32; (size <= 512) && (size <= max_size); size *= 2) {
+            local_sizes.push_back(size);
+        }
+        return local_sizes;
+    }
+
+    inline bool load();
+    inline void save();
+
+    /*
+     * Get the configuration to use for the next launch of the kernel
+     * identified by key. The first candidate is the default and is used if
+     * no configuration is stored and tuning is disabled. Returns true if the
+     * launch is a trial, in which case the time of the launch must be passed
+     * to record.
+     */
+    inline bool get_config(const std::string key,
+                           const std::vector<KernelConfig> &candidates,
+                           KernelConfig &config) {
+        PPMDASSERT(candidates.size() > 0, "No candidate configurations");
+        auto it = this->configs.find(key);
+        if (it != this->configs.end()) {
+            config = it->second;
+            return false;
+        }
+        if (!this->enabled) {
+            config = candidates[0];
+            return false;
+        }
+        if (this->tunings.count(key) == 0) {
+            Tuning tuning;
+            tuning.candidates = candidates;
+            tuning.times = std::vector<double>(candidates.size(), -1.0);
+            tuning.index = 0;
+            tuning.count = 0;
+            this->tunings[key] = tuning;
+        }
+        auto &tuning = this->tunings.at(key);
+        config = tuning.candidates[tuning.index];
+        return true;
+    }
+
+    /*
+     * Record the time in seconds of a trial launch returned by get_config.
+     */
+    inline void record(const std::string key, const double time) {
+        auto it = this->tunings.find(key);
+        if (it == this->tunings.end()) {
+            return;
+        }
+        auto &tuning = it->second;
+        double &time_min = tuning.times[tuning.index];
+        time_min = (time_min < 0.0) ? time : std::min(time_min, time);
+        if (++tuning.count < this->nrepeat) {
+            return;
+        }
+        tuning.count = 0;
+        if (++tuning.index < tuning.candidates.size()) {
+            return;
+        }
+
+        int best = 0;
+        for (int cx = 1; cx < tuning.candidates.size(); cx++) {
+            if (tuning.times[cx] < tuning.times[best]) {
+                best = cx;
+            }
+        }
+        this->configs[key] = tuning.candidates[best];
+        this->config_times[key] = tuning.times[best];
+        this->tunings.erase(it);
+        if (this->write_cache) {
+            this->save();
+        }
+    }
+
+    /*
+     * Returns true if a configuration is stored for the key.
+     */
+    inline bool has_config(const std::string key) {
+        return this->configs.count(key) > 0;
+    }
+
+    /*
+     * Discard stored configurations and any tuning in progress.
+     */
+    inline void reset() {
+        this->configs.clear();
+        this->config_times.clear();
+        this->tunings.clear();
+    }
+};
+
+/*
+ * Read configurations from the cache file. Each line holds a key, variant,
+ * local size and time separated by tabs. Malformed lines are skipped. Returns
+ * false if the file cannot be read.
+ */
+inline bool Autotuner::load() {
+    if (this->filename.size() == 0) {
+        return false;
+    }
+    std::ifstream in(this->filename);
+    if (!in.good()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        const auto t2 = line.rfind('\t');
+        const auto t1 = (t2 == std::string::npos || t2 == 0)
+                            ? std::string::npos
+                            : line.rfind('\t', t2 - 1);
+        const auto t0 = (t1 == std::string::npos || t1 == 0)
+                            ? std::string::npos
+                            : line.rfind('\t', t1 - 1);
+        if (t0 == std::string::npos) {
+            continue;
+        }
+        const std::string key = line.substr(0, t0);
+        KernelConfig config;
+        double time;
+        try {
+            config.variant = std::stoi(line.substr(t0 + 1, t1 - t0 - 1));
+            config.local_size = std::stoi(line.substr(t1 + 1, t2 - t1 - 1));
+            time = std::stod(line.substr(t2 + 1));
+        } catch (const std::logic_error &) {
+            // std::invalid_argument or std::out_of_range, e.g. from a
+            // truncated or hand edited file. The kernel keeps its default.
+            continue;
+        }
+        this->configs[key] = config;
+        this->config_times[key] = time;
+    }
+    return true;
+}
+
+/*
+ * Write all stored configurations to the cache file. The file is written to
+ * a temporary file which is then renamed over the cache file.
+ */
+inline void Autotuner::save() {
+    if (this->filename.size() == 0) {
+        return;
+    }
+    const std::string filename_tmp = this->filename + ".tmp";
+    {
+        std::ofstream out(filename_tmp);
+        if (!out.good()) {
+            return;
+        }
+        out << std::scientific << std::setprecision(6);
+        for (auto &config : this->configs) {
+            out << config.first << "\t" << config.second.variant << "\t"
+                << config.second.local_size << "\t"
+                << this->config_times[config.first] << "\n";
+        }
+    }
+    std::rename(filename_tmp.c_str(), this->filename.c_str());
+}
+
+} // namespace PPMD
+
+#endif
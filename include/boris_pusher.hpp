@@ -0,0 +1,136 @@
+#ifndef _PPMD_BORIS_PUSHER
+#define _PPMD_BORIS_PUSHER
+
+#include <CL/sycl.hpp>
+#include <string>
+
+#include "cell_dat.hpp"
+#include "particle_dat.hpp"
+#include "particle_group.hpp"
+#include "particle_loop.hpp"
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * Kernel of a BorisPusher for a single particle, trivially copyable such that
+ * it may be captured in SYCL kernels. The velocity is advanced by dt with the
+ * Boris rotation and the position is then advanced with the new velocity.
+ */
+template <typename T> struct BorisKernel {
+    CellDatDeviceAccessor<T> P;
+    CellDatDeviceAccessor<T> V;
+    CellDatDeviceAccessor<T> E;
+    CellDatDeviceAccessor<T> B;
+    int ndim;
+    T dt;
+    // Half the charge to mass ratio times dt.
+    T half_qm_dt;
+
+    inline void operator()(const int cellx, const int layerx) const {
+        T v[3];
+        T t[3];
+        T v_minus[3];
+        T v_prime[3];
+        T t_squared = 0;
+        for (int dimx = 0; dimx < 3; dimx++) {
+            t[dimx] = this->half_qm_dt * this->B[cellx][dimx][layerx];
+            t_squared += t[dimx] * t[dimx];
+            // first half of the electric field acceleration
+            v_minus[dimx] = this->V[cellx][dimx][layerx] +
+                            this->half_qm_dt * this->E[cellx][dimx][layerx];
+        }
+        const T s_factor = ((T)2) / (((T)1) + t_squared);
+
+        // v' = v- + v- x t
+        v_prime[0] = v_minus[0] + v_minus[1] * t[2] - v_minus[2] * t[1];
+        v_prime[1] = v_minus[1] + v_minus[2] * t[0] - v_minus[0] * t[2];
+        v_prime[2] = v_minus[2] + v_minus[0] * t[1] - v_minus[1] * t[0];
+        // v+ = v- + v' x s, with s = 2t / (1 + |t|^2)
+        v[0] = v_minus[0] + s_factor * (v_prime[1] * t[2] - v_prime[2] * t[1]);
+        v[1] = v_minus[1] + s_factor * (v_prime[2] * t[0] - v_prime[0] * t[2]);
+        v[2] = v_minus[2] + s_factor * (v_prime[0] * t[1] - v_prime[1] * t[0]);
+
+        for (int dimx = 0; dimx < 3; dimx++) {
+            // second half of the electric field acceleration
+            v[dimx] += this->half_qm_dt * this->E[cellx][dimx][layerx];
+            this->V[cellx][dimx][layerx] = v[dimx];
+        }
+        for (int dimx = 0; dimx < this->ndim; dimx++) {
+            this->P[cellx][dimx][layerx] += this->dt * v[dimx];
+        }
+    }
+};
+
+/*
+ * Advances the particles of a ParticleGroup in electric and magnetic fields
+ * with the Boris scheme. The velocity update, both halves of the electric
+ * field acceleration and the magnetic rotation, and the position update are
+ * made in a single ParticleLoop, hence each particle reads and writes its
+ * data once per step. The fields must already be interpolated to the
+ * particles in the dats E and B. V, E and B must have three components and
+ * the position dat P between one and three components, the first components
+ * of the velocity advance the position. All the dats must have the same
+ * element type T, e.g. PPMD::REAL or float.
+ *
+ * The loop is named "BorisPusher" and is tuned by the autotuner as any other
+ * ParticleLoop.
+ */
+template <typename T> class BorisPusher {
+  private:
+    ParticleLoopShPtr<BorisKernel<T>> loop;
+
+  public:
+    ParticleGroup &particle_group;
+    ParticleDatShPtr<T> P;
+    ParticleDatShPtr<T> V;
+    ParticleDatShPtr<T> E;
+    ParticleDatShPtr<T> B;
+    // Time step.
+    const T dt;
+    // Charge to mass ratio of the particles.
+    const T q_over_m;
+
+    BorisPusher(ParticleGroup &particle_group, Sym<T> position_sym,
+                Sym<T> velocity_sym, Sym<T> e_field_sym, Sym<T> b_field_sym,
+                const T dt, const T q_over_m)
+        : particle_group(particle_group), P(particle_group[position_sym]),
+          V(particle_group[velocity_sym]), E(particle_group[e_field_sym]),
+          B(particle_group[b_field_sym]), dt(dt), q_over_m(q_over_m) {
+        PPMDASSERT((this->P->ncomp >= 1) && (this->P->ncomp <= 3),
+                   "Position dat must have 1 to 3 components");
+        PPMDASSERT(this->V->ncomp == 3, "Velocity dat must have 3 components");
+        PPMDASSERT(this->E->ncomp == 3, "E field dat must have 3 components");
+        PPMDASSERT(this->B->ncomp == 3, "B field dat must have 3 components");
+
+        const BorisKernel<T> kernel{this->P->cell_dat.device_accessor(),
+                                    this->V->cell_dat.device_accessor(),
+                                    this->E->cell_dat.device_accessor(),
+                                    this->B->cell_dat.device_accessor(),
+                                    this->P->ncomp,
+                                    dt,
+                                    ((T)0.5) * q_over_m * dt};
+        this->loop = ParticleLoop("BorisPusher", particle_group, kernel,
+                                  {dat_access<READ>(this->E),
+                                   dat_access<READ>(this->B),
+                                   dat_access<WRITE>(this->V),
+                                   dat_access<WRITE>(this->P)});
+    };
+
+    /*
+     * Submit one step to the compute queue and return the event of the
+     * kernel.
+     */
+    inline sycl::event submit() { return this->loop->submit(); }
+
+    /*
+     * Advance the particles by one step and block until complete.
+     */
+    inline void execute() { this->submit().wait(); }
+};
+
+} // namespace PPMD
+
+#endif
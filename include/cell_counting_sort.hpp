@@ -0,0 +1,328 @@
+#ifndef _PPMD_CELL_COUNTING_SORT
+#define _PPMD_CELL_COUNTING_SORT
+
+#include <CL/sycl.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "compute_target.hpp"
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * Stable counting sort of items, e.g. particles being appended, by cell on
+ * the device without atomics. The layer of item i is the first free layer of
+ * its cell plus the number of items before i in the same cell, hence the
+ * result depends only on the input and is reproducible.
+ *
+ * The items are ordered by cell with a stable least significant digit radix
+ * sort, each pass sorts radix_bits bits of the cell index. The items are split
+ * into blocks of consecutive items and each block is processed sequentially
+ * by one work item. In each pass the blocks count their items in each bucket,
+ * the counts are scanned over the blocks of each bucket then over the
+ * buckets, then each block places its items. The number of blocks and the
+ * size of the counts depend only on the number of items, not on the number of
+ * cells. The first item of each cell in the sorted order then gives the layer
+ * of each item and the number of items in each cell.
+ *
+ * The cells are validated before they are sorted. Items with a cell outside
+ * [0, ncell) are sorted after all other items and are not assigned a layer,
+ * the number of such items and the index of the first are reported with the
+ * number of items in each cell in a single copy to the host.
+ */
+class CellCountingSort {
+  private:
+    SYCLTarget &sycl_target;
+    const int ncell;
+    // Orders of the items before and after a pass of the radix sort, the
+    // bucket counts of each block, indexed by bucket then block, and the
+    // first position of each bucket.
+    BufferDevice<int> d_order;
+    BufferDevice<int> d_block_counts;
+    BufferDevice<int> d_bucket_offsets;
+    // Number of invalid cells and index of the first in each block.
+    BufferDevice<int> d_block_errors;
+    // Position of the first item of each cell in the sorted order.
+    BufferDevice<int> d_cell_first;
+    BufferDevice<int> d_layer_start;
+    // The number of items in each cell followed by the number of invalid
+    // cells and the index of the first.
+    BufferDevice<int> d_summary;
+    std::vector<int> h_summary;
+    // Number of bits of the cell index sorted by each pass of the radix sort.
+    static constexpr int radix_bits = 8;
+
+  public:
+    // Number of items processed by each work item.
+    int block_size;
+    // The layer of each item after a call to compute.
+    BufferDevice<int> d_layers;
+    // The number of items in each cell after a call to compute.
+    std::vector<int> cell_counts;
+    // The number of items with an invalid cell and the index of the first,
+    // or -1, after a call to compute.
+    int nerrors;
+    int first_error;
+
+    CellCountingSort(SYCLTarget &sycl_target, const int ncell,
+                     const int block_size = 256)
+        : sycl_target(sycl_target), ncell(ncell), d_order(sycl_target, 0),
+          d_block_counts(sycl_target, 0), d_bucket_offsets(sycl_target, 0),
+          d_block_errors(sycl_target, 0), d_cell_first(sycl_target, ncell),
+          d_layer_start(sycl_target, 0), d_summary(sycl_target, ncell + 2),
+          h_summary(ncell + 2), block_size(block_size),
+          d_layers(sycl_target, 0), cell_counts(ncell), nerrors(0),
+          first_error(-1) {
+        PPMDASSERT(block_size > 0, "Bad block size");
+    }
+
+    /*
+     * Compute the layer of each of the npart items in the device array
+     * d_cells and the number of items in each cell. layer_start holds the
+     * first free layer of each cell. Blocks until the layers are available
+     * in d_layers. Returns the number of items with an invalid cell.
+     */
+    inline int compute(const int npart, const PPMD::INT *d_cells,
+                       const std::vector<int> &layer_start) {
+        PPMDASSERT(layer_start.size() >= this->ncell,
+                   "Insufficient layer starts");
+        this->d_layers.realloc_no_copy(npart);
+        std::fill(this->cell_counts.begin(), this->cell_counts.end(), 0);
+        this->nerrors = 0;
+        this->first_error = -1;
+        if (npart == 0) {
+            return 0;
+        }
+        // Invalid cells have key ncell such that they are sorted last.
+        int key_bits = 1;
+        while ((key_bits < 31) && ((1 << key_bits) <= this->ncell)) {
+            key_bits++;
+        }
+        const int digit_bits = std::min(key_bits, CellCountingSort::radix_bits);
+        const int nbucket = 1 << digit_bits;
+        const int npass = (key_bits + digit_bits - 1) / digit_bits;
+        const int block_size = this->block_size;
+        const int nblock = (npart + block_size - 1) / block_size;
+        this->d_order.realloc_no_copy(2 * ((size_t)npart));
+        this->d_block_counts.realloc_no_copy(((size_t)nbucket) * nblock);
+        this->d_bucket_offsets.realloc_no_copy(nbucket);
+        this->d_block_errors.realloc_no_copy(2 * nblock);
+        this->d_layer_start.set(layer_start);
+
+        const int k_ncell = this->ncell;
+        int *k_counts = this->d_block_counts.ptr;
+        int *k_bucket_offsets = this->d_bucket_offsets.ptr;
+        int *k_errors = this->d_block_errors.ptr;
+        int *k_cell_first = this->d_cell_first.ptr;
+        const int *k_layer_start = this->d_layer_start.ptr;
+        int *k_summary = this->d_summary.ptr;
+        int *k_layers = this->d_layers.ptr;
+        auto &queue = this->sycl_target.queue;
+        // The items of a block.
+        auto lambda_items = [=](const int blockx, int &start, int &end) {
+            start = blockx * block_size;
+            end = (npart - start < block_size) ? npart : start + block_size;
+        };
+        // The cell of an item, or ncell if the cell is invalid.
+        auto lambda_key = [=](const int px) {
+            const PPMD::INT cellx = d_cells[px];
+            return ((cellx < 0) || (cellx >= k_ncell)) ? k_ncell : (int)cellx;
+        };
+
+        queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(
+                    sycl::range<1>(nblock), [=](sycl::id<1> idx) {
+                        const int blockx = idx[0];
+                        int start, end;
+                        lambda_items(blockx, start, end);
+                        int nerrors = 0;
+                        int first_error = -1;
+                        for (int px = start; px < end; px++) {
+                            if (lambda_key(px) == k_ncell) {
+                                first_error = (nerrors == 0) ? px : first_error;
+                                nerrors++;
+                            }
+                        }
+                        k_errors[2 * blockx] = nerrors;
+                        k_errors[2 * blockx + 1] = first_error;
+                    });
+            })
+            .wait();
+        queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.single_task<>([=]() {
+                    int nerrors = 0;
+                    int first_error = -1;
+                    for (int blockx = 0; blockx < nblock; blockx++) {
+                        const int nerrors_block = k_errors[2 * blockx];
+                        if ((nerrors == 0) && (nerrors_block > 0)) {
+                            first_error = k_errors[2 * blockx + 1];
+                        }
+                        nerrors += nerrors_block;
+                    }
+                    k_summary[k_ncell] = nerrors;
+                    k_summary[k_ncell + 1] = first_error;
+                });
+            })
+            .wait();
+
+        // Each pass reads the order of the previous pass, the first pass
+        // starts from the order of the items, and writes the order stably
+        // sorted by one digit.
+        for (int passx = 0; passx < npass; passx++) {
+            const int *k_order_in =
+                this->d_order.ptr + (passx % 2) * ((size_t)npart);
+            int *k_order_out =
+                this->d_order.ptr + ((passx + 1) % 2) * ((size_t)npart);
+            const int shift = passx * digit_bits;
+            const int mask = nbucket - 1;
+            const bool first_pass = (passx == 0);
+            // The item at position rowx and its bucket in this pass.
+            auto lambda_item = [=](const int rowx) {
+                return first_pass ? rowx : k_order_in[rowx];
+            };
+            auto lambda_bucket = [=](const int px) {
+                return (lambda_key(px) >> shift) & mask;
+            };
+
+            queue
+                .submit([&](sycl::handler &cgh) {
+                    cgh.parallel_for<>(
+                        sycl::range<1>(nblock), [=](sycl::id<1> idx) {
+                            const int blockx = idx[0];
+                            int *counts = k_counts + blockx;
+                            for (int bx = 0; bx < nbucket; bx++) {
+                                counts[((size_t)bx) * nblock] = 0;
+                            }
+                            int start, end;
+                            lambda_items(blockx, start, end);
+                            for (int rowx = start; rowx < end; rowx++) {
+                                const int bx = lambda_bucket(lambda_item(rowx));
+                                counts[((size_t)bx) * nblock]++;
+                            }
+                        });
+                })
+                .wait();
+            queue
+                .submit([&](sycl::handler &cgh) {
+                    cgh.parallel_for<>(
+                        sycl::range<1>(nbucket), [=](sycl::id<1> idx) {
+                            const int bx = idx[0];
+                            int *counts = k_counts + ((size_t)bx) * nblock;
+                            int count = 0;
+                            for (int blockx = 0; blockx < nblock; blockx++) {
+                                const int count_block = counts[blockx];
+                                counts[blockx] = count;
+                                count += count_block;
+                            }
+                            k_bucket_offsets[bx] = count;
+                        });
+                })
+                .wait();
+            queue
+                .submit([&](sycl::handler &cgh) {
+                    cgh.single_task<>([=]() {
+                        int count = 0;
+                        for (int bx = 0; bx < nbucket; bx++) {
+                            const int count_bucket = k_bucket_offsets[bx];
+                            k_bucket_offsets[bx] = count;
+                            count += count_bucket;
+                        }
+                    });
+                })
+                .wait();
+            queue
+                .submit([&](sycl::handler &cgh) {
+                    cgh.parallel_for<>(
+                        sycl::range<1>(nblock), [=](sycl::id<1> idx) {
+                            const int blockx = idx[0];
+                            int *counts = k_counts + blockx;
+                            int start, end;
+                            lambda_items(blockx, start, end);
+                            for (int rowx = start; rowx < end; rowx++) {
+                                const int px = lambda_item(rowx);
+                                const int bx = lambda_bucket(px);
+                                const int position =
+                                    k_bucket_offsets[bx] +
+                                    counts[((size_t)bx) * nblock]++;
+                                k_order_out[position] = px;
+                            }
+                        });
+                })
+                .wait();
+        }
+
+        // The layer of an item is its position in the sorted order relative
+        // to the first item of its cell. The last item of each cell gives the
+        // number of items in the cell.
+        const int *k_order = this->d_order.ptr + (npass % 2) * ((size_t)npart);
+        queue.fill(k_summary, 0, k_ncell).wait();
+        queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(
+                    sycl::range<1>(npart), [=](sycl::id<1> idx) {
+                        const int rowx = idx[0];
+                        const int cellx = lambda_key(k_order[rowx]);
+                        if ((cellx < k_ncell) &&
+                            ((rowx == 0) ||
+                             (lambda_key(k_order[rowx - 1]) != cellx))) {
+                            k_cell_first[cellx] = rowx;
+                        }
+                    });
+            })
+            .wait();
+        queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(
+                    sycl::range<1>(npart), [=](sycl::id<1> idx) {
+                        const int rowx = idx[0];
+                        const int px = k_order[rowx];
+                        const int cellx = lambda_key(px);
+                        if (cellx == k_ncell) {
+                            k_layers[px] = -1;
+                            return;
+                        }
+                        const int first = k_cell_first[cellx];
+                        k_layers[px] = k_layer_start[cellx] + rowx - first;
+                        if ((rowx == npart - 1) ||
+                            (lambda_key(k_order[rowx + 1]) != cellx)) {
+                            k_summary[cellx] = rowx + 1 - first;
+                        }
+                    });
+            })
+            .wait();
+        queue
+            .memcpy(this->h_summary.data(), k_summary,
+                    (k_ncell + 2) * sizeof(int))
+            .wait();
+        std::copy(this->h_summary.begin(), this->h_summary.begin() + k_ncell,
+                  this->cell_counts.begin());
+        this->nerrors = this->h_summary[k_ncell];
+        this->first_error = this->h_summary[k_ncell + 1];
+        return this->nerrors;
+    }
+
+    /*
+     * Abort with the number of invalid cells and the index of the first if
+     * the last call to compute found invalid cells.
+     */
+    inline void assert_valid() {
+        if (this->nerrors > 0) {
+            const std::string msg =
+                std::to_string(this->nerrors) +
+                " particles have a cell index out of range, the first is "
+                "particle " +
+                std::to_string(this->first_error) + ".";
+            PPMDASSERT(this->nerrors == 0, msg.c_str());
+        }
+    }
+};
+
+} // namespace PPMD
+
+#endif
@@ -2,6 +2,7 @@
 #define _PPMD_CELL_DAT
 
 #include <CL/sycl.hpp>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -23,6 +24,8 @@ template <typename T> class CellDataT {
     const int nrow;
     const int ncol;
     std::vector<std::vector<T>> data;
+    // Host staging space for copies to and from cells with the aosoa layout.
+    std::vector<T> tiles;
     inline CellDataT(SYCLTarget &sycl_target, const int nrow, const int ncol)
         : sycl_target(sycl_target), nrow(nrow), ncol(ncol) {
         this->data = std::vector<std::vector<T>>(ncol);
@@ -79,50 +82,147 @@ template <typename T> class CellDatConst {
      */
     T *device_ptr() { return this->d_ptr; };
 
+    /*
+     * Start copying the data stored in a provided cell into a CellData
+     * instance on the host using the device to host copy queue. The copy
+     * events are pushed onto the EventStack and cell_data must not be
+     * accessed until the events are complete. The copies depend on the
+     * kernels in flight on the compute queue, see
+     * SYCLTarget::add_compute_event.
+     */
+    inline void get_cell_async(const int cell, CellDataT<T> &cell_data,
+                               EventStack &es) {
+        PPMDASSERT(cell_data.nrow >= this->nrow,
+                   "CellData as insuffient row count.");
+        PPMDASSERT(cell_data.ncol >= this->ncol,
+                   "CellData as insuffient column count.");
+        const std::vector<sycl::event> deps =
+            this->sycl_target.get_compute_events();
+        for (int colx = 0; colx < this->ncol; colx++) {
+            es.push(this->sycl_target.queue_d2h.memcpy(
+                        cell_data.data[colx].data(),
+                        &this->d_ptr[cell * this->stride + colx * this->nrow],
+                        this->nrow * sizeof(T), deps),
+                    this->sycl_target.profiler, "CellDatConst::get_cell");
+        }
+        this->sycl_target.profiler.add_bytes("device_to_host",
+                                             this->stride * sizeof(T));
+    }
+
+    /*
+     * Start copying the data in a CellData instance into a cell using the
+     * host to device copy queue. The copy events are pushed onto the
+     * EventStack and cell_data must not be modified until the events are
+     * complete. The copies depend on the kernels in flight on the compute
+     * queue.
+     */
+    inline void set_cell_async(const int cell, CellDataT<T> &cell_data,
+                               EventStack &es) {
+        PPMDASSERT(cell_data.nrow >= this->nrow,
+                   "CellData as insuffient row count.");
+        PPMDASSERT(cell_data.ncol >= this->ncol,
+                   "CellData as insuffient column count.");
+        const std::vector<sycl::event> deps =
+            this->sycl_target.get_compute_events();
+        for (int colx = 0; colx < this->ncol; colx++) {
+            es.push(this->sycl_target.queue_h2d.memcpy(
+                        &this->d_ptr[cell * this->stride + colx * this->nrow],
+                        cell_data.data[colx].data(), this->nrow * sizeof(T),
+                        deps),
+                    this->sycl_target.profiler, "CellDatConst::set_cell");
+        }
+        this->sycl_target.profiler.add_bytes("host_to_device",
+                                             this->stride * sizeof(T));
+    }
+
     /*
      * Get the data stored in a provided cell on the host as a CellData
      * instance.
      */
     inline CellData<T> get_cell(const int cell) {
+        this->sycl_target.profiler.start_region("CellDatConst::get_cell");
         auto cell_data = std::make_shared<CellDataT<T>>(this->sycl_target,
                                                         this->nrow, this->ncol);
-        for (int colx = 0; colx < this->ncol; colx++) {
-            this->sycl_target.queue.memcpy(
-                cell_data->data[colx].data(),
-                &this->d_ptr[cell * this->stride + colx * this->nrow],
-                this->nrow * sizeof(T));
-        }
-        this->sycl_target.queue.wait();
+        EventStack es;
+        this->get_cell_async(cell, *cell_data, es);
+        es.wait();
+        this->sycl_target.profiler.end_region();
         return cell_data;
     }
     /*
      *  Set the data in a cell using a CellData instance.
      */
     inline void set_cell(const int cell, CellData<T> cell_data) {
-        PPMDASSERT(cell_data->nrow >= this->nrow,
-                   "CellData as insuffient row count.");
-        PPMDASSERT(cell_data->ncol >= this->ncol,
-                   "CellData as insuffient column count.");
-
-        for (int colx = 0; colx < this->ncol; colx++) {
-            this->sycl_target.queue.memcpy(
-                &this->d_ptr[cell * this->stride + colx * this->nrow],
-                cell_data->data[colx].data(), this->nrow * sizeof(T));
-        }
-        this->sycl_target.queue.wait();
+        this->sycl_target.profiler.start_region("CellDatConst::set_cell");
+        EventStack es;
+        this->set_cell_async(cell, *cell_data, es);
+        es.wait();
+        this->sycl_target.profiler.end_region();
     }
 };
 
 /*
  * Store data on each cell where the number of columns required per cell is
- * constant but the number of rows is variable. Data is stored in a column
- * major manner with a new device pointer per column.
+ * constant but the number of rows is variable. With the soa layout data is
+ * stored in a column major manner with a new device pointer per column. With
+ * the aosoa layout each cell is a single allocation of tiles, see
+ * CellDatLayout, and the column pointers of a cell point to the columns of
+ * the first tile.
  */
 template <typename T> class CellDat {
   private:
     T ***d_ptr;
     std::vector<T **> h_ptr_cells;
     std::vector<T *> h_ptr_cols;
+    int tile_shift;
+    int tile_skip;
+
+    // Host mirror, see enable_host_mirror. A cell is stale if the device copy
+    // may have changed since the host copy was made and dirty if the host
+    // copy was modified and has not been pushed to the device.
+    bool host_mirror;
+    std::vector<CellData<T>> host_cells;
+    std::vector<char> host_stale;
+    std::vector<char> host_dirty;
+    // Incremented whenever the data on the device is marked as modified.
+    std::int64_t version;
+
+    // Out of core storage, see page_out_cells. The data of a cell that is
+    // not resident on the device is held in a host allocation, by column for
+    // the soa layout and as tiles for the aosoa layout. For a resident cell
+    // paged_valid is set while the host allocation matches the device copy.
+    std::vector<char> resident;
+    std::vector<char> paged_valid;
+    std::vector<T *> paged_ptr;
+    std::vector<size_t> paged_alloc;
+    int nnonresident;
+    // Bytes of device memory allocated for the data of the cells.
+    size_t device_bytes;
+
+    // Number of elements allocated for a cell with nrow rows in the aosoa
+    // layout.
+    inline size_t tiled_size(const PPMD::INT nrow) {
+        const size_t ntiles =
+            (nrow + this->tile_width - 1) / this->tile_width;
+        return ntiles * this->tile_width * this->ncol;
+    }
+
+    // Number of elements of the cell data, including the tile padding.
+    inline size_t cell_size(const int cell) {
+        return (this->layout == CellDatLayout::aosoa)
+                   ? this->tiled_size(this->nrow[cell])
+                   : this->nrow[cell] * this->ncol;
+    }
+
+    // Pointer to a column of a cell, on the device if the cell is resident
+    // and on the host otherwise. For the aosoa layout only column 0 may be
+    // used, it points to the first tile.
+    inline T *col_ptr(const int cell, const int col) {
+        if (this->resident[cell]) {
+            return this->h_ptr_cols[cell * this->ncol + col];
+        }
+        return this->paged_ptr[cell] + col * this->nrow[cell];
+    }
 
   public:
     SYCLTarget &sycl_target;
@@ -130,23 +230,47 @@ template <typename T> class CellDat {
     std::vector<PPMD::INT> nrow;
     const int ncol;
     std::vector<PPMD::INT> nrow_alloc;
+    const CellDatLayout layout;
+    // Rows per tile, 1 for the soa layout.
+    const int tile_width;
     ~CellDat() {
         // issues on cuda backend w/o this NULL check.
         for (int cellx = 0; cellx < ncells; cellx++) {
-            if ((this->nrow_alloc[cellx] != 0) &&
-                (this->h_ptr_cells[cellx] != NULL)) {
+            if (this->h_ptr_cells[cellx] != NULL) {
                 sycl::free(this->h_ptr_cells[cellx], sycl_target.queue);
             }
         }
-        for (int colx = 0; colx < ncells * this->ncol; colx++) {
+        // With the aosoa layout only the first column pointer of a cell is an
+        // allocation.
+        const int col_step =
+            (this->layout == CellDatLayout::aosoa) ? this->ncol : 1;
+        for (int colx = 0; colx < ncells * this->ncol; colx += col_step) {
             if (this->h_ptr_cols[colx] != NULL) {
                 sycl::free(this->h_ptr_cols[colx], sycl_target.queue);
             }
         }
+        for (int cellx = 0; cellx < ncells; cellx++) {
+            if (this->paged_ptr[cellx] != NULL) {
+                sycl::free(this->paged_ptr[cellx], sycl_target.queue);
+            }
+        }
         sycl::free(this->d_ptr, sycl_target.queue);
     };
-    inline CellDat(SYCLTarget &sycl_target, const int ncells, const int ncol)
-        : sycl_target(sycl_target), ncells(ncells), ncol(ncol) {
+    inline CellDat(SYCLTarget &sycl_target, const int ncells, const int ncol,
+                   const CellDatLayout layout = CellDatLayout::soa)
+        : sycl_target(sycl_target), ncells(ncells), ncol(ncol), layout(layout),
+          tile_width((layout == CellDatLayout::aosoa) ? PPMD_TILE_WIDTH : 1),
+          host_mirror(false), version(0), resident(ncells, 1),
+          paged_valid(ncells, 0), paged_ptr(ncells, NULL),
+          paged_alloc(ncells, 0), nnonresident(0), device_bytes(0) {
+
+        this->tile_shift = 0;
+        while ((1 << this->tile_shift) < this->tile_width) {
+            this->tile_shift++;
+        }
+        this->tile_skip = (layout == CellDatLayout::aosoa)
+                              ? (ncol - 1) * this->tile_width
+                              : 0;
 
         this->nrow = std::vector<PPMD::INT>(ncells);
         this->d_ptr = sycl::malloc_device<T **>(ncells, sycl_target.queue);
@@ -183,7 +307,37 @@ template <typename T> class CellDat {
         const PPMD::INT nrow_existing = this->nrow[cell];
 
         if (nrow_required != nrow_existing) {
-            if (nrow_required > nrow_alloced) {
+            PPMDASSERT(this->resident[cell],
+                       "Cells must be resident on the device to be resized");
+            this->paged_valid[cell] = 0;
+            if ((nrow_required > nrow_alloced) &&
+                (this->layout == CellDatLayout::aosoa)) {
+                T *ptr_old = this->h_ptr_cols[cell * this->ncol];
+                T *ptr_new = sycl::malloc_device<T>(
+                    this->tiled_size(nrow_required), this->sycl_target.queue);
+                this->device_bytes += (this->tiled_size(nrow_required) -
+                                       this->tiled_size(nrow_alloced)) *
+                                      sizeof(T);
+                if (nrow_alloced > 0) {
+                    this->sycl_target.queue
+                        .memcpy(ptr_new, ptr_old,
+                                this->tiled_size(nrow_existing) * sizeof(T))
+                        .wait();
+                }
+                if (ptr_old != NULL) {
+                    sycl::free(ptr_old, this->sycl_target.queue);
+                }
+                for (int colx = 0; colx < this->ncol; colx++) {
+                    this->h_ptr_cols[cell * this->ncol + colx] =
+                        ptr_new + colx * this->tile_width;
+                }
+                this->nrow_alloc[cell] = nrow_required;
+                sycl_target.queue.memcpy(this->h_ptr_cells[cell],
+                                         &this->h_ptr_cols[cell * this->ncol],
+                                         this->ncol * sizeof(T *));
+
+                sycl_target.queue.wait();
+            } else if (nrow_required > nrow_alloced) {
                 for (int colx = 0; colx < this->ncol; colx++) {
                     T *col_ptr_old = this->h_ptr_cols[cell * this->ncol + colx];
                     T *col_ptr_new = sycl::malloc_device<T>(
@@ -201,6 +355,8 @@ template <typename T> class CellDat {
 
                     this->h_ptr_cols[cell * this->ncol + colx] = col_ptr_new;
                 }
+                this->device_bytes +=
+                    (nrow_required - nrow_alloced) * this->ncol * sizeof(T);
                 this->nrow_alloc[cell] = nrow_required;
                 sycl_target.queue.memcpy(this->h_ptr_cells[cell],
                                          &this->h_ptr_cols[cell * this->ncol],
@@ -209,23 +365,120 @@ template <typename T> class CellDat {
                 sycl_target.queue.wait();
             }
             this->nrow[cell] = nrow_required;
+            if (this->host_mirror) {
+                PPMDASSERT(!this->host_dirty[cell],
+                           "Host mirror modifications must be pushed before "
+                           "the cell is resized");
+                this->host_stale[cell] = 1;
+            }
         }
     }
 
+    /*
+     * Start copying the contents of a provided cell into a CellData instance
+     * on the host using the device to host copy queue. The copy events are
+     * pushed onto the EventStack and cell_data must not be accessed until the
+     * events are complete. The copies depend on the kernels in flight on the
+     * compute queue, see SYCLTarget::add_compute_event. For the aosoa layout
+     * the tiles are
+     * copied into the staging space of cell_data and unpacked on the host,
+     * hence the copy is complete on return.
+     */
+    inline void get_cell_async(const int cell, CellDataT<T> &cell_data,
+                               EventStack &es) {
+        PPMDASSERT(cell_data.nrow >= this->nrow[cell],
+                   "CellData as insuffient row count.");
+        PPMDASSERT(cell_data.ncol >= this->ncol,
+                   "CellData as insuffient column count.");
+        const std::vector<sycl::event> deps =
+            this->sycl_target.get_compute_events();
+        if ((this->nrow[cell] > 0) && (this->layout == CellDatLayout::aosoa)) {
+            const size_t size = this->tiled_size(this->nrow[cell]);
+            cell_data.tiles.resize(size);
+            EventStack es_tiles;
+            es_tiles.push(this->sycl_target.queue_d2h.memcpy(
+                              cell_data.tiles.data(), this->col_ptr(cell, 0),
+                              size * sizeof(T), deps),
+                          this->sycl_target.profiler, "CellDat::get_cell");
+            es_tiles.wait();
+            for (int colx = 0; colx < this->ncol; colx++) {
+                for (int rowx = 0; rowx < this->nrow[cell]; rowx++) {
+                    cell_data.data[colx][rowx] =
+                        cell_data.tiles[colx * this->tile_width +
+                                        tiled_row_index(rowx, this->tile_shift,
+                                                        this->tile_skip)];
+                }
+            }
+        } else if (this->nrow[cell] > 0) {
+            for (int colx = 0; colx < this->ncol; colx++) {
+                es.push(this->sycl_target.queue_d2h.memcpy(
+                            cell_data.data[colx].data(),
+                            this->col_ptr(cell, colx),
+                            this->nrow[cell] * sizeof(T), deps),
+                        this->sycl_target.profiler, "CellDat::get_cell");
+            }
+        }
+        this->sycl_target.profiler.add_bytes(
+            "device_to_host", this->nrow[cell] * this->ncol * sizeof(T));
+    }
+
+    /*
+     * Start copying the contents of a CellData instance into a cell using the
+     * host to device copy queue. The copy events are pushed onto the
+     * EventStack and cell_data must not be modified until the events are
+     * complete. The copies depend on the kernels in flight on the compute
+     * queue. For the aosoa layout the data is packed into the staging space
+     * of cell_data which is then copied as one block.
+     */
+    inline void set_cell_async(const int cell, CellDataT<T> &cell_data,
+                               EventStack &es) {
+        PPMDASSERT(cell_data.nrow >= this->nrow[cell],
+                   "CellData as insuffient row count.");
+        PPMDASSERT(cell_data.ncol >= this->ncol,
+                   "CellData as insuffient column count.");
+        this->version++;
+        this->paged_valid[cell] = 0;
+        const std::vector<sycl::event> deps =
+            this->sycl_target.get_compute_events();
+        if ((this->nrow[cell] > 0) && (this->layout == CellDatLayout::aosoa)) {
+            const size_t size = this->tiled_size(this->nrow[cell]);
+            cell_data.tiles.assign(size, ((T)0));
+            for (int colx = 0; colx < this->ncol; colx++) {
+                for (int rowx = 0; rowx < this->nrow[cell]; rowx++) {
+                    cell_data.tiles[colx * this->tile_width +
+                                    tiled_row_index(rowx, this->tile_shift,
+                                                    this->tile_skip)] =
+                        cell_data.data[colx][rowx];
+                }
+            }
+            es.push(this->sycl_target.queue_h2d.memcpy(
+                        this->col_ptr(cell, 0), cell_data.tiles.data(),
+                        size * sizeof(T), deps),
+                    this->sycl_target.profiler, "CellDat::set_cell");
+        } else if (this->nrow[cell] > 0) {
+            for (int colx = 0; colx < this->ncol; colx++) {
+                es.push(this->sycl_target.queue_h2d.memcpy(
+                            this->col_ptr(cell, colx),
+                            cell_data.data[colx].data(),
+                            this->nrow[cell] * sizeof(T), deps),
+                        this->sycl_target.profiler, "CellDat::set_cell");
+            }
+        }
+        this->sycl_target.profiler.add_bytes(
+            "host_to_device", this->nrow[cell] * this->ncol * sizeof(T));
+    }
+
     /*
      * Get the contents of a provided cell on the host as a CellData instance.
      */
     inline CellData<T> get_cell(const int cell) {
-
+        this->sycl_target.profiler.start_region("CellDat::get_cell");
         auto cell_data = std::make_shared<CellDataT<T>>(
             this->sycl_target, this->nrow[cell], this->ncol);
-        for (int colx = 0; colx < this->ncol; colx++) {
-            this->sycl_target.queue.memcpy(
-                cell_data->data[colx].data(),
-                this->h_ptr_cols[cell * this->ncol + colx],
-                this->nrow[cell] * sizeof(T));
-        }
-        this->sycl_target.queue.wait();
+        EventStack es;
+        this->get_cell_async(cell, *cell_data, es);
+        es.wait();
+        this->sycl_target.profiler.end_region();
         return cell_data;
     }
 
@@ -233,28 +486,300 @@ template <typename T> class CellDat {
      * Set the contents of a cell on the device using a CellData instance.
      */
     inline void set_cell(const int cell, CellData<T> cell_data) {
-        PPMDASSERT(cell_data->nrow >= this->nrow[cell],
-                   "CellData as insuffient row count.");
-        PPMDASSERT(cell_data->ncol >= this->ncol,
-                   "CellData as insuffient column count.");
+        this->sycl_target.profiler.start_region("CellDat::set_cell");
+        EventStack es;
+        this->set_cell_async(cell, *cell_data, es);
+        es.wait();
+        if (this->host_mirror) {
+            // the device copy replaces any host modifications
+            this->host_dirty[cell] = 0;
+            this->host_stale[cell] = 1;
+        }
+        this->sycl_target.profiler.end_region();
+    }
 
-        if (this->nrow[cell] > 0) {
-            for (int colx = 0; colx < this->ncol; colx++) {
+    /*
+     * Keep a copy of the cells on the host which is only updated when it is
+     * read and the device copy may have changed. Modifications made to the
+     * host copy are only pushed to the device for the cells marked as
+     * modified. Operations that modify the data on the device must call
+     * mark_device_modified and operations that use the data on the device
+     * must call push_host_cells first. ParticleGroup, ParticleLoop and the
+     * halo and load balance exchanges do so for the dats they use.
+     */
+    inline void enable_host_mirror() {
+        if (this->host_mirror) {
+            return;
+        }
+        this->host_mirror = true;
+        this->host_cells = std::vector<CellData<T>>(this->ncells);
+        this->host_stale = std::vector<char>(this->ncells, 1);
+        this->host_dirty = std::vector<char>(this->ncells, 0);
+    }
+    inline bool host_mirror_enabled() { return this->host_mirror; }
+
+    /*
+     * A counter which is incremented when the data on the device is marked as
+     * modified, by mark_device_modified, or written from the host. Changes
+     * in the number of rows are not counted.
+     */
+    inline std::int64_t get_version() { return this->version; }
 
-                this->sycl_target.queue.memcpy(
-                    this->h_ptr_cols[cell * this->ncol + colx],
-                    cell_data->data[colx].data(), this->nrow[cell] * sizeof(T));
+    /*
+     * Get the host copy of a cell. The cell is copied from the device only
+     * if the device copy may have changed since the last copy. If write is
+     * true the cell is marked as modified on the host and is copied to the
+     * device by the next call to push_host_cells. The returned reference is
+     * valid until the cell is resized.
+     */
+    inline CellDataT<T> &get_host_cell(const int cell,
+                                       const bool write = false) {
+        PPMDASSERT(this->host_mirror, "The host mirror is not enabled");
+        PPMDASSERT((cell >= 0) && (cell < this->ncells), "Bad cell index");
+        auto &cell_data = this->host_cells[cell];
+        if (this->host_stale[cell]) {
+            if ((cell_data == nullptr) ||
+                (cell_data->nrow != this->nrow[cell])) {
+                cell_data = std::make_shared<CellDataT<T>>(
+                    this->sycl_target, this->nrow[cell], this->ncol);
             }
-            this->sycl_target.queue.wait();
+            EventStack es;
+            this->get_cell_async(cell, *cell_data, es);
+            es.wait();
+            this->host_stale[cell] = 0;
         }
+        if (write) {
+            this->host_dirty[cell] = 1;
+        }
+        return *cell_data;
     }
 
     /*
-     * Get the root device pointer for the data storage. Data can be accessed
-     * on the device in SYCL kernels with access like:
+     * Copy the host copies of the cells modified on the host to the device.
+     * Does nothing if the host mirror is not enabled.
+     */
+    inline void push_host_cells() {
+        if (!this->host_mirror) {
+            return;
+        }
+        EventStack es;
+        for (int cellx = 0; cellx < this->ncells; cellx++) {
+            if (this->host_dirty[cellx]) {
+                this->set_cell_async(cellx, *this->host_cells[cellx], es);
+                this->host_dirty[cellx] = 0;
+            }
+        }
+        es.wait();
+    }
+
+    /*
+     * Mark the host copies of all cells, or of one cell, as out of date as
+     * the data on the device may have been modified. Host modifications must
+     * have been pushed first.
+     */
+    inline void mark_device_modified() {
+        this->version++;
+        std::fill(this->paged_valid.begin(), this->paged_valid.end(), 0);
+        if (!this->host_mirror) {
+            return;
+        }
+        for (int cellx = 0; cellx < this->ncells; cellx++) {
+            this->mark_device_modified(cellx);
+        }
+    }
+    inline void mark_device_modified(const int cell) {
+        this->version++;
+        this->paged_valid[cell] = 0;
+        if (!this->host_mirror) {
+            return;
+        }
+        PPMDASSERT(!this->host_dirty[cell],
+                   "Host mirror modifications must be pushed before the "
+                   "device modifies the cell");
+        this->host_stale[cell] = 1;
+    }
+
+    /*
+     * Get the root device pointer for the data storage. For the soa layout
+     * data can be accessed on the device in SYCL kernels with access like:
      *      d[cell_index][column_index][row_index]
+     * For the aosoa layout the row index must be mapped with
+     * tiled_row_index, or device_accessor used instead.
      */
     T ***device_ptr() { return this->d_ptr; };
+
+    /*
+     * Get a device accessor for the data which may be indexed as
+     *      d[cell_index][column_index][row_index]
+     * in SYCL kernels for any layout.
+     */
+    inline CellDatDeviceAccessor<T> device_accessor() {
+        return CellDatDeviceAccessor<T>(this->d_ptr, this->tile_shift,
+                                        this->tile_skip);
+    }
+
+    /*
+     * Get the parameters which map a row to an element index relative to a
+     * column pointer, see tiled_row_index.
+     */
+    inline int get_tile_shift() { return this->tile_shift; }
+    inline int get_tile_skip() { return this->tile_skip; }
+
+    inline bool is_resident(const int cell) { return this->resident[cell]; }
+    inline bool all_resident() { return this->nnonresident == 0; }
+
+    /*
+     * Bytes of device memory allocated for the data of the cells, including
+     * spare rows but not the tables of cell and column pointers.
+     */
+    inline size_t get_device_bytes() { return this->device_bytes; }
+
+    /*
+     * Number of bytes of the data of a cell, which is the device memory the
+     * cell uses once paged in.
+     */
+    inline size_t get_data_bytes(const int cell) {
+        return this->cell_size(cell) * sizeof(T);
+    }
+
+    /*
+     * Number of bytes of device memory used by a cell if it is resident,
+     * including any spare rows, or that it will use once paged in otherwise.
+     */
+    inline size_t get_cell_bytes(const int cell) {
+        if (!this->resident[cell]) {
+            return this->get_data_bytes(cell);
+        }
+        return (this->layout == CellDatLayout::aosoa)
+                   ? this->tiled_size(this->nrow_alloc[cell]) * sizeof(T)
+                   : this->nrow_alloc[cell] * this->ncol * sizeof(T);
+    }
+
+    /*
+     * Move the data of cells from the device to host memory and free the
+     * device allocations of the cells. The data is only copied if the host
+     * copy made when the cell was last paged out may be out of date. Cells
+     * that are not resident may be read and written with get_cell and
+     * set_cell, and through the host mirror, but must not be accessed on the
+     * device or resized. The copies depend on the kernels in flight on the
+     * compute queue. Blocks until the copies are complete.
+     */
+    inline void page_out_cells(const std::vector<int> &cells) {
+        EventStack es;
+        const std::vector<sycl::event> deps =
+            this->sycl_target.get_compute_events();
+        for (auto &cellx : cells) {
+            const size_t size = this->cell_size(cellx);
+            if ((!this->resident[cellx]) || this->paged_valid[cellx] ||
+                (size == 0)) {
+                continue;
+            }
+            if (this->paged_alloc[cellx] < size) {
+                T *&ptr = this->paged_ptr[cellx];
+                if (ptr != NULL) {
+                    sycl::free(ptr, this->sycl_target.queue);
+                }
+                ptr = sycl::malloc_host<T>(size, this->sycl_target.queue);
+                this->paged_alloc[cellx] = size;
+            }
+            const int nrow = this->nrow[cellx];
+            if (this->layout == CellDatLayout::aosoa) {
+                es.push(this->sycl_target.queue_d2h.memcpy(
+                            this->paged_ptr[cellx],
+                            this->h_ptr_cols[cellx * this->ncol],
+                            size * sizeof(T), deps),
+                        this->sycl_target.profiler, "CellDat::page_out");
+            } else {
+                for (int colx = 0; colx < this->ncol; colx++) {
+                    es.push(this->sycl_target.queue_d2h.memcpy(
+                                this->paged_ptr[cellx] + colx * nrow,
+                                this->h_ptr_cols[cellx * this->ncol + colx],
+                                nrow * sizeof(T), deps),
+                            this->sycl_target.profiler, "CellDat::page_out");
+                }
+            }
+            this->sycl_target.profiler.add_bytes("page_out", size * sizeof(T));
+        }
+        es.wait();
+
+        for (auto &cellx : cells) {
+            if (!this->resident[cellx]) {
+                continue;
+            }
+            this->device_bytes -= this->get_cell_bytes(cellx);
+            const int col_step =
+                (this->layout == CellDatLayout::aosoa) ? this->ncol : 1;
+            for (int colx = 0; colx < this->ncol; colx++) {
+                T *&ptr = this->h_ptr_cols[cellx * this->ncol + colx];
+                if ((colx % col_step == 0) && (ptr != NULL)) {
+                    sycl::free(ptr, this->sycl_target.queue);
+                }
+                ptr = NULL;
+            }
+            this->nrow_alloc[cellx] = 0;
+            es.push(this->sycl_target.queue_h2d.memcpy(
+                        this->h_ptr_cells[cellx],
+                        &this->h_ptr_cols[cellx * this->ncol],
+                        this->ncol * sizeof(T *)),
+                    this->sycl_target.profiler, "CellDat::page_out");
+            this->resident[cellx] = 0;
+            this->nnonresident++;
+        }
+        es.wait();
+    }
+
+    /*
+     * Start moving the data of cells paged out with page_out_cells back to
+     * the device using the host to device copy queue. The copy events are
+     * pushed onto the EventStack and the cells must not be accessed on the
+     * device until the events are complete. The host copy is kept such that
+     * a cell that is not modified need not be copied when paged out again.
+     */
+    inline void page_in_cells_async(const std::vector<int> &cells,
+                                    EventStack &es) {
+        for (auto &cellx : cells) {
+            if (this->resident[cellx]) {
+                continue;
+            }
+            const int nrow = this->nrow[cellx];
+            const size_t size = this->cell_size(cellx);
+            if (nrow > 0) {
+                if (this->layout == CellDatLayout::aosoa) {
+                    T *ptr =
+                        sycl::malloc_device<T>(size, this->sycl_target.queue);
+                    for (int colx = 0; colx < this->ncol; colx++) {
+                        this->h_ptr_cols[cellx * this->ncol + colx] =
+                            ptr + colx * this->tile_width;
+                    }
+                    es.push(this->sycl_target.queue_h2d.memcpy(
+                                ptr, this->paged_ptr[cellx], size * sizeof(T)),
+                            this->sycl_target.profiler, "CellDat::page_in");
+                } else {
+                    for (int colx = 0; colx < this->ncol; colx++) {
+                        T *ptr = sycl::malloc_device<T>(
+                            nrow, this->sycl_target.queue);
+                        this->h_ptr_cols[cellx * this->ncol + colx] = ptr;
+                        es.push(this->sycl_target.queue_h2d.memcpy(
+                                    ptr, this->paged_ptr[cellx] + colx * nrow,
+                                    nrow * sizeof(T)),
+                                this->sycl_target.profiler, "CellDat::page_in");
+                    }
+                }
+                this->device_bytes += size * sizeof(T);
+                this->sycl_target.profiler.add_bytes("page_in",
+                                                     size * sizeof(T));
+            }
+            this->nrow_alloc[cellx] = nrow;
+            es.push(this->sycl_target.queue_h2d.memcpy(
+                        this->h_ptr_cells[cellx],
+                        &this->h_ptr_cols[cellx * this->ncol],
+                        this->ncol * sizeof(T *)),
+                    this->sycl_target.profiler, "CellDat::page_in");
+            this->resident[cellx] = 1;
+            this->paged_valid[cellx] = 1;
+            this->nnonresident--;
+        }
+    }
 };
 
 } // namespace PPMD
@@ -0,0 +1,238 @@
+#ifndef _PPMD_CELL_DAT_HALO
+#define _PPMD_CELL_DAT_HALO
+
+#include <CL/sycl.hpp>
+#include <mpi.h>
+#include <set>
+#include <vector>
+
+#include "cell_dat.hpp"
+#include "communication.hpp"
+#include "compute_target.hpp"
+#include "load_balance.hpp"
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * Halo exchange for a CellDatConst which holds all the coarse cells of a
+ * MeshHierarchy in linear index order. The ghost layer of a rank is the set
+ * of cells, owned by other ranks, in the stencil of the cells it owns, see
+ * LoadBalance::get_halo_cells. exchange copies the owned cells in the ghost
+ * layers of other ranks into the corresponding cells on those ranks.
+ *
+ * The halo does not allocate ghost layers. The exchange writes into the
+ * CellDatConst, which is replicated, i.e. every rank stores every coarse
+ * cell, and cells that are neither owned nor in the ghost layer are
+ * allocated but not updated. The memory per rank therefore grows with the
+ * global number of cells rather than with the owned and ghost cells.
+ *
+ * The cells sent to and received from each neighbouring rank are packed
+ * into contiguous buffers on the device. The MPI requests are persistent,
+ * created once with MPI_Send_init and MPI_Recv_init and started on each
+ * exchange, and are only recreated when the cell ownership changes.
+ */
+template <typename T> class CellDatConstHalo {
+  private:
+    static constexpr int tag = 4203;
+
+    LoadBalance &load_balance;
+    CellDatConst<T> &cell_dat;
+    const int stride;
+
+    // The owners the plan and requests were created for.
+    std::vector<int> plan_cell_owners;
+    HaloCells halo;
+    std::vector<int> halo_cells;
+    int nsend_cells;
+    int nrecv_cells;
+    BufferDevice<int> d_send_cells;
+    BufferDevice<int> d_recv_cells;
+    BufferDevice<T> d_send_buffer;
+    BufferDevice<T> d_recv_buffer;
+    std::vector<T> h_send_buffer;
+    std::vector<T> h_recv_buffer;
+    // Receive requests followed by send requests, one of each per
+    // neighbouring rank.
+    std::vector<MPI_Request> requests;
+
+    inline void free_requests() {
+        int flag;
+        MPICHK(MPI_Finalized(&flag))
+        if (!flag) {
+            for (auto &request : this->requests) {
+                MPICHK(MPI_Request_free(&request))
+            }
+        }
+        this->requests.clear();
+    }
+
+    inline void setup();
+
+  public:
+    SYCLTarget &sycl_target;
+    MPI_Comm comm;
+
+    CellDatConstHalo(const CellDatConstHalo &) = delete;
+    CellDatConstHalo &operator=(const CellDatConstHalo &) = delete;
+
+    CellDatConstHalo(LoadBalance &load_balance, CellDatConst<T> &cell_dat)
+        : load_balance(load_balance), cell_dat(cell_dat),
+          stride(cell_dat.nrow * cell_dat.ncol), nsend_cells(0),
+          nrecv_cells(0), d_send_cells(cell_dat.sycl_target, 0),
+          d_recv_cells(cell_dat.sycl_target, 0),
+          d_send_buffer(cell_dat.sycl_target, 0),
+          d_recv_buffer(cell_dat.sycl_target, 0),
+          sycl_target(cell_dat.sycl_target), comm(load_balance.comm) {
+        PPMDASSERT(cell_dat.ncells == load_balance.ncells,
+                   "CellDatConst cells are not the coarse mesh cells");
+        this->setup();
+    }
+
+    ~CellDatConstHalo() { this->free_requests(); }
+
+    /*
+     * Cells in the ghost layer of this rank in increasing order.
+     */
+    inline std::vector<int> &get_halo_cells() { return this->halo_cells; }
+
+    inline void exchange();
+};
+
+/*
+ * Compute the cells exchanged with each neighbouring rank, size the buffers
+ * and create the persistent requests.
+ */
+template <typename T> inline void CellDatConstHalo<T>::setup() {
+    this->free_requests();
+    this->halo = this->load_balance.get_halo_cells();
+    this->plan_cell_owners = this->load_balance.cell_owners;
+    const int nneighbours = this->halo.ranks.size();
+
+    std::vector<int> send_cells_flat;
+    std::vector<int> recv_cells_flat;
+    std::set<int> halo_set;
+    for (int nx = 0; nx < nneighbours; nx++) {
+        send_cells_flat.insert(send_cells_flat.end(),
+                               this->halo.send_cells[nx].begin(),
+                               this->halo.send_cells[nx].end());
+        recv_cells_flat.insert(recv_cells_flat.end(),
+                               this->halo.recv_cells[nx].begin(),
+                               this->halo.recv_cells[nx].end());
+        halo_set.insert(this->halo.recv_cells[nx].begin(),
+                        this->halo.recv_cells[nx].end());
+    }
+    this->halo_cells.assign(halo_set.begin(), halo_set.end());
+    this->nsend_cells = send_cells_flat.size();
+    this->nrecv_cells = recv_cells_flat.size();
+    this->d_send_cells.set(send_cells_flat);
+    this->d_recv_cells.set(recv_cells_flat);
+    this->d_send_buffer.realloc_no_copy(this->nsend_cells * this->stride);
+    this->d_recv_buffer.realloc_no_copy(this->nrecv_cells * this->stride);
+    this->h_send_buffer.resize(this->nsend_cells * this->stride);
+    this->h_recv_buffer.resize(this->nrecv_cells * this->stride);
+
+    // The host buffers must not be reallocated while the requests exist.
+    this->requests.resize(2 * nneighbours);
+    int recv_offset = 0;
+    int send_offset = 0;
+    for (int nx = 0; nx < nneighbours; nx++) {
+        const int nrecv = this->halo.recv_cells[nx].size() * this->stride;
+        MPICHK(MPI_Recv_init(this->h_recv_buffer.data() + recv_offset,
+                             nrecv * sizeof(T), MPI_BYTE, this->halo.ranks[nx],
+                             tag, this->comm, &this->requests[nx]))
+        recv_offset += nrecv;
+        const int nsend = this->halo.send_cells[nx].size() * this->stride;
+        MPICHK(MPI_Send_init(this->h_send_buffer.data() + send_offset,
+                             nsend * sizeof(T), MPI_BYTE, this->halo.ranks[nx],
+                             tag, this->comm,
+                             &this->requests[nneighbours + nx]))
+        send_offset += nsend;
+    }
+}
+
+/*
+ * Collective. Copy the owned cells in the ghost layers of other ranks to
+ * those ranks and receive the ghost layer of this rank. If the ownership has
+ * changed since the last exchange the exchange plan and the requests are
+ * recreated first.
+ */
+template <typename T> inline void CellDatConstHalo<T>::exchange() {
+    auto &profiler = this->sycl_target.profiler;
+    profiler.start_region("CellDatConstHalo::exchange");
+    if (this->plan_cell_owners != this->load_balance.cell_owners) {
+        this->setup();
+    }
+    const int nneighbours = this->halo.ranks.size();
+    if (nneighbours == 0) {
+        profiler.end_region();
+        return;
+    }
+
+    MPICHK(MPI_Startall(nneighbours, this->requests.data()))
+
+    // The buffers are packed and unpacked on the compute queue and copied
+    // on the copy queues, ordered by events.
+    const int k_stride = this->stride;
+    T *k_ptr = this->cell_dat.device_ptr();
+    EventStack es;
+    const size_t nsend = this->nsend_cells * this->stride;
+    if (nsend > 0) {
+        const int *k_cells = this->d_send_cells.ptr;
+        T *k_buffer = this->d_send_buffer.ptr;
+        const std::vector<sycl::event> deps =
+            this->sycl_target.get_compute_events();
+        sycl::event event_pack =
+            this->sycl_target.queue.submit([&](sycl::handler &cgh) {
+                cgh.depends_on(deps);
+                cgh.parallel_for<>(
+                    sycl::range<1>(nsend), [=](sycl::id<1> idx) {
+                        const int cellx = k_cells[idx[0] / k_stride];
+                        const int ix = idx[0] % k_stride;
+                        k_buffer[idx] = k_ptr[cellx * k_stride + ix];
+                    });
+            });
+        profiler.add_device_event("CellDatConstHalo::exchange", event_pack);
+        es.push(this->sycl_target.queue_d2h.memcpy(this->h_send_buffer.data(),
+                                                   k_buffer, nsend * sizeof(T),
+                                                   event_pack),
+                profiler, "CellDatConstHalo::exchange");
+        es.wait();
+    }
+
+    MPICHK(MPI_Startall(nneighbours, this->requests.data() + nneighbours))
+    MPICHK(MPI_Waitall(2 * nneighbours, this->requests.data(),
+                       MPI_STATUSES_IGNORE))
+
+    const size_t nrecv = this->nrecv_cells * this->stride;
+    if (nrecv > 0) {
+        const int *k_cells = this->d_recv_cells.ptr;
+        T *k_buffer = this->d_recv_buffer.ptr;
+        es.push(this->sycl_target.queue_h2d.memcpy(
+                    k_buffer, this->h_recv_buffer.data(), nrecv * sizeof(T)),
+                profiler, "CellDatConstHalo::exchange");
+        std::vector<sycl::event> deps = this->sycl_target.get_compute_events();
+        deps.insert(deps.end(), es.events.begin(), es.events.end());
+        sycl::event event_unpack =
+            this->sycl_target.queue.submit([&](sycl::handler &cgh) {
+                cgh.depends_on(deps);
+                cgh.parallel_for<>(
+                    sycl::range<1>(nrecv), [=](sycl::id<1> idx) {
+                        const int cellx = k_cells[idx[0] / k_stride];
+                        const int ix = idx[0] % k_stride;
+                        k_ptr[cellx * k_stride + ix] = k_buffer[idx];
+                    });
+            });
+        profiler.add_device_event("CellDatConstHalo::exchange", event_unpack);
+        event_unpack.wait();
+        es.wait();
+    }
+    profiler.add_bytes("mpi_send", nsend * sizeof(T));
+    profiler.end_region();
+}
+
+} // namespace PPMD
+
+#endif
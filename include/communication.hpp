@@ -55,9 +55,10 @@ class CommPair {
     };
 
     void free() {
-        int flag;
+        int flag, finalized;
         MPICHK(MPI_Initialized(&flag))
-        if (allocated && flag) {
+        MPICHK(MPI_Finalized(&finalized))
+        if (allocated && flag && !finalized) {
 
             if ((this->comm_intra != MPI_COMM_NULL) &&
                 (this->comm_intra != MPI_COMM_WORLD)) {
@@ -68,7 +69,7 @@ class CommPair {
             if ((this->comm_inter != MPI_COMM_NULL) &&
                 (this->comm_inter != MPI_COMM_WORLD)) {
                 MPICHK(MPI_Comm_free(&this->comm_inter))
-                this->comm_intra = MPI_COMM_NULL;
+                this->comm_inter = MPI_COMM_NULL;
             }
         }
         this->allocated = false;
@@ -2,25 +2,77 @@
 #define _PPMD_COMPUTE_TARGET
 
 #include <CL/sycl.hpp>
+#include <cstdint>
+#include <cstdlib>
 #include <mpi.h>
+#include <vector>
 
+#include "affinity.hpp"
+#include "autotune.hpp"
 #include "communication.hpp"
+#include "profiling.hpp"
 #include "typedefs.hpp"
 
 using namespace cl;
 
 namespace PPMD {
 
+/*
+ * Holds the SYCL device, the queues and the MPI communicator used by the
+ * library. Kernels are submitted to the out-of-order compute queue. Host to
+ * device and device to host copies are submitted to the dedicated copy
+ * queues, queue_h2d and queue_d2h, such that transfers may overlap kernel
+ * execution. All queues share a context, hence device allocations made with
+ * any queue may be used on all queues. Ordering between work on different
+ * queues is expressed with events, e.g. with handler::depends_on.
+ *
+ * If profiling is true, or the environment variable PPMD_PROFILE is set to a
+ * positive integer, the queues are created with profiling enabled and the
+ * profiler is enabled, otherwise the profiler can be enabled at runtime
+ * without device timings.
+ *
+ * Kernel launch parameters stored in the tuning cache of the device are read
+ * on construction. If the environment variable PPMD_AUTOTUNE is set to a
+ * positive integer kernels without stored parameters are tuned and rank 0 of
+ * the communicator writes the results to the cache.
+ *
+ * If the environment variable PPMD_AFFINITY is set to a positive integer the
+ * CPUs of each node are partitioned between the ranks on the node, using the
+ * intra-node communicator of comm_pair, and each rank is restricted to its
+ * CPUs before the SYCL runtime creates its worker threads, see
+ * set_node_affinity.
+ */
 class SYCLTarget {
   private:
+    // Kernels on the compute queue which may be in flight, see
+    // add_compute_event.
+    std::vector<sycl::event> compute_events;
+
   public:
     sycl::device device;
+    sycl::context context;
+    // Compute queue.
     sycl::queue queue;
+    // Queue for host to device copies.
+    sycl::queue queue_h2d;
+    // Queue for device to host copies.
+    sycl::queue queue_d2h;
     MPI_Comm comm;
     CommPair comm_pair;
+    Profiler profiler;
+    Autotuner autotuner;
+    // The CPUs this rank is restricted to, empty if the affinity is not set.
+    std::vector<int> cpu_affinity;
 
     SYCLTarget(){};
-    SYCLTarget(const int gpu_device, MPI_Comm comm) : comm_pair(comm_pair) {
+    SYCLTarget(const int gpu_device, MPI_Comm comm,
+               const bool profiling = false)
+        : comm_pair(comm) {
+        const char *env_affinity = std::getenv("PPMD_AFFINITY");
+        if ((env_affinity != nullptr) && (std::atoi(env_affinity) > 0)) {
+            this->cpu_affinity = set_node_affinity(this->comm_pair);
+        }
+
         if (gpu_device > 0) {
             try {
                 this->device = sycl::device(sycl::gpu_selector());
@@ -37,14 +89,295 @@ class SYCLTarget {
                   << this->device.get_info<sycl::info::device::name>()
                   << std::endl;
 
-        this->queue = sycl::queue(this->device);
+        sycl::property_list queue_properties{};
+        const char *env_profile = std::getenv("PPMD_PROFILE");
+        if (profiling ||
+            ((env_profile != nullptr) && (std::atoi(env_profile) > 0))) {
+            queue_properties =
+                sycl::property_list{sycl::property::queue::enable_profiling()};
+            this->profiler.device_profiling = true;
+            this->profiler.enable();
+        }
+        this->context = sycl::context(this->device);
+        this->queue =
+            sycl::queue(this->context, this->device, queue_properties);
+        this->queue_h2d =
+            sycl::queue(this->context, this->device, queue_properties);
+        this->queue_d2h =
+            sycl::queue(this->context, this->device, queue_properties);
         this->comm = comm;
+
+        int rank;
+        MPICHK(MPI_Comm_rank(comm, &rank))
+        const char *env_autotune = std::getenv("PPMD_AUTOTUNE");
+        this->autotuner.enabled =
+            (env_autotune != nullptr) && (std::atoi(env_autotune) > 0);
+        this->autotuner.filename = Autotuner::default_filename(
+            this->device.get_info<sycl::info::device::name>());
+        this->autotuner.write_cache = (rank == 0);
+        this->autotuner.load();
+    }
+    ~SYCLTarget() { this->free(); }
+
+    /*
+     * Record a kernel submitted to the compute queue which is returned to the
+     * caller without waiting, e.g. by ParticleLoop::submit. Copies between
+     * the host and device data of CellDats are submitted to the copy queues
+     * with the recorded kernels as dependencies, see get_compute_events.
+     */
+    inline void add_compute_event(sycl::event event) {
+        this->compute_events.push_back(event);
+    }
+
+    /*
+     * The recorded kernels that may not be complete. Complete kernels are
+     * discarded.
+     */
+    inline std::vector<sycl::event> get_compute_events() {
+        std::vector<sycl::event> events;
+        for (auto &event : this->compute_events) {
+            if (event.get_info<sycl::info::event::command_execution_status>() !=
+                sycl::info::event_command_status::complete) {
+                events.push_back(event);
+            }
+        }
+        this->compute_events = events;
+        return events;
+    }
+
+    /*
+     * Block until all work submitted to the compute and copy queues is
+     * complete.
+     */
+    inline void wait_all() {
+        this->queue_h2d.wait();
+        this->queue_d2h.wait();
+        this->queue.wait();
+        this->compute_events.clear();
     }
-    ~SYCLTarget() {}
 
+    /*
+     * Free the communicators of comm_pair. Called by the destructor, further
+     * calls have no effect.
+     */
     void free() { comm_pair.free(); }
 };
 
+/*
+ * Collection of events for work which is in flight. Used to wait on a set of
+ * copies or kernels that may have been submitted to different queues, or to
+ * pass the set as dependencies to further work.
+ */
+class EventStack {
+  private:
+  public:
+    std::vector<sycl::event> events;
+
+    EventStack(){};
+
+    inline void push(sycl::event event) { this->events.push_back(event); }
+    /*
+     * Push an event, e.g. of a copy, and record it with the profiler under
+     * the given name, see Profiler::add_device_event.
+     */
+    inline void push(sycl::event event, Profiler &profiler,
+                     const char *name) {
+        profiler.add_device_event(name, event);
+        this->events.push_back(event);
+    }
+
+    /*
+     * Block until all events are complete then clear the collection.
+     */
+    inline void wait() {
+        for (auto &event : this->events) {
+            event.wait();
+        }
+        this->events.clear();
+    }
+};
+
+/*
+ * Copy an element of size bytes between device locations aligned to the
+ * element size. Used by kernels which move data of any element type.
+ */
+inline void copy_element(char *dst, const char *src, const int size) {
+    switch (size) {
+    case 8:
+        *reinterpret_cast<uint64_t *>(dst) =
+            *reinterpret_cast<const uint64_t *>(src);
+        break;
+    case 4:
+        *reinterpret_cast<uint32_t *>(dst) =
+            *reinterpret_cast<const uint32_t *>(src);
+        break;
+    case 2:
+        *reinterpret_cast<uint16_t *>(dst) =
+            *reinterpret_cast<const uint16_t *>(src);
+        break;
+    default:
+        for (int bx = 0; bx < size; bx++) {
+            dst[bx] = src[bx];
+        }
+    }
+}
+
+/*
+ * Atomically add a value to an element in device memory and return the value
+ * held prior to the addition.
+ */
+template <typename T> inline T atomic_fetch_add(T *element, const T value) {
+#if defined(__INTEL_LLVM_COMPILER)
+    auto element_atomic = sycl::ext::oneapi::atomic_ref<
+        T, sycl::ext::oneapi::memory_order_acq_rel,
+        sycl::ext::oneapi::memory_scope_device,
+        sycl::access::address_space::global_space>(*element);
+    return element_atomic.fetch_add(value);
+#else
+    sycl::atomic_ref<T, sycl::memory_order::relaxed, sycl::memory_scope::device>
+        element_atomic(*element);
+    return element_atomic.fetch_add(value);
+#endif
+}
+
+/*
+ * Atomically add a value to an element in work-group local memory, e.g. a
+ * local_accessor, and return the value held prior to the addition.
+ */
+template <typename T>
+inline T atomic_fetch_add_local(T *element, const T value) {
+#if defined(__INTEL_LLVM_COMPILER)
+    auto element_atomic = sycl::ext::oneapi::atomic_ref<
+        T, sycl::ext::oneapi::memory_order_relaxed,
+        sycl::ext::oneapi::memory_scope_work_group,
+        sycl::access::address_space::local_space>(*element);
+    return element_atomic.fetch_add(value);
+#else
+    sycl::atomic_ref<T, sycl::memory_order::relaxed,
+                     sycl::memory_scope::work_group,
+                     sycl::access::address_space::local_space>
+        element_atomic(*element);
+    return element_atomic.fetch_add(value);
+#endif
+}
+
+/*
+ * Atomically replace an element in device memory with desired if the element
+ * equals expected. Returns true if the element was replaced, otherwise
+ * expected is set to the value held by the element.
+ */
+template <typename T>
+inline bool atomic_compare_exchange(T *element, T &expected, const T desired) {
+#if defined(__INTEL_LLVM_COMPILER)
+    auto element_atomic = sycl::ext::oneapi::atomic_ref<
+        T, sycl::ext::oneapi::memory_order_acq_rel,
+        sycl::ext::oneapi::memory_scope_device,
+        sycl::access::address_space::global_space>(*element);
+    return element_atomic.compare_exchange_strong(expected, desired);
+#else
+    sycl::atomic_ref<T, sycl::memory_order::relaxed, sycl::memory_scope::device>
+        element_atomic(*element);
+    return element_atomic.compare_exchange_strong(expected, desired);
+#endif
+}
+
+/*
+ * Container for a device allocation of a given number of elements of type T.
+ * The allocation is grown, never shrunk, by realloc_no_copy.
+ */
+template <typename T> class BufferDevice {
+  private:
+  public:
+    SYCLTarget &sycl_target;
+    T *ptr;
+    size_t size;
+
+    BufferDevice(SYCLTarget &sycl_target, size_t size)
+        : sycl_target(sycl_target), size(size) {
+        this->ptr = (size > 0)
+                        ? sycl::malloc_device<T>(size, sycl_target.queue)
+                        : NULL;
+    }
+    BufferDevice(const BufferDevice &) = delete;
+    BufferDevice &operator=(const BufferDevice &) = delete;
+
+    ~BufferDevice() {
+        if (this->ptr != NULL) {
+            sycl::free(this->ptr, this->sycl_target.queue);
+        }
+    }
+
+    /*
+     * Ensure the allocation holds at least size elements. Existing contents
+     * are not preserved if a new allocation is required.
+     */
+    inline void realloc_no_copy(const size_t size) {
+        if (size > this->size) {
+            if (this->ptr != NULL) {
+                sycl::free(this->ptr, this->sycl_target.queue);
+            }
+            this->ptr = sycl::malloc_device<T>(size, this->sycl_target.queue);
+            this->size = size;
+        }
+    }
+
+    /*
+     * Copy the contents of a host vector into the buffer, growing the
+     * allocation if required. Blocks until the copy is complete.
+     */
+    inline void set(const std::vector<T> &data) {
+        this->realloc_no_copy(data.size());
+        if (data.size() > 0) {
+            this->sycl_target.queue
+                .memcpy(this->ptr, data.data(), data.size() * sizeof(T))
+                .wait();
+        }
+    }
+};
+
+/*
+ * Container for a shared (host and device accessible) allocation of a given
+ * number of elements of type T.
+ */
+template <typename T> class BufferShared {
+  private:
+  public:
+    SYCLTarget &sycl_target;
+    T *ptr;
+    size_t size;
+
+    BufferShared(SYCLTarget &sycl_target, size_t size)
+        : sycl_target(sycl_target), size(size) {
+        this->ptr = (size > 0)
+                        ? sycl::malloc_shared<T>(size, sycl_target.queue)
+                        : NULL;
+    }
+    BufferShared(const BufferShared &) = delete;
+    BufferShared &operator=(const BufferShared &) = delete;
+
+    ~BufferShared() {
+        if (this->ptr != NULL) {
+            sycl::free(this->ptr, this->sycl_target.queue);
+        }
+    }
+
+    /*
+     * Ensure the allocation holds at least size elements. Existing contents
+     * are not preserved if a new allocation is required.
+     */
+    inline void realloc_no_copy(const size_t size) {
+        if (size > this->size) {
+            if (this->ptr != NULL) {
+                sycl::free(this->ptr, this->sycl_target.queue);
+            }
+            this->ptr = sycl::malloc_shared<T>(size, this->sycl_target.queue);
+            this->size = size;
+        }
+    }
+
+    inline T &operator[](const size_t index) { return this->ptr[index]; }
+};
+
 } // namespace PPMD
 
 #endif
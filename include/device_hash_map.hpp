@@ -0,0 +1,196 @@
+#ifndef _PPMD_DEVICE_HASH_MAP
+#define _PPMD_DEVICE_HASH_MAP
+
+#include <CL/sycl.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "compute_target.hpp"
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * Device view of a DeviceHashMap, copied by value into kernels. Keys must be
+ * non-negative. Slots are found by linear probing from the hash of the key.
+ * Erased keys leave a tombstone such that the probe sequences of other keys
+ * are not broken.
+ */
+struct DeviceHashMapView {
+    static constexpr PPMD::INT empty = -1;
+    static constexpr PPMD::INT tombstone = -2;
+
+    PPMD::INT *keys;
+    PPMD::INT *values;
+    std::uint64_t mask;
+
+    /*
+     * First slot of the probe sequence of a key, the splitmix64 finaliser of
+     * the key.
+     */
+    inline std::uint64_t slot(const PPMD::INT key) const {
+        std::uint64_t z = static_cast<std::uint64_t>(key);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return (z ^ (z >> 31)) & this->mask;
+    }
+
+    /*
+     * Insert a key which is not held by the map. Erased slots are reused.
+     */
+    inline void insert(const PPMD::INT key, const PPMD::INT value) const {
+        std::uint64_t slotx = this->slot(key);
+        while (true) {
+            PPMD::INT expected = this->keys[slotx];
+            if (((expected == empty) || (expected == tombstone)) &&
+                atomic_compare_exchange(&this->keys[slotx], expected, key)) {
+                this->values[slotx] = value;
+                return;
+            }
+            slotx = (slotx + 1) & this->mask;
+        }
+    }
+
+    /*
+     * Find the slot of a key, returns -1 if the key is not held.
+     */
+    inline std::int64_t find_slot(const PPMD::INT key) const {
+        std::uint64_t slotx = this->slot(key);
+        for (std::uint64_t probex = 0; probex <= this->mask; probex++) {
+            const PPMD::INT slot_key = this->keys[slotx];
+            if (slot_key == key) {
+                return slotx;
+            } else if (slot_key == empty) {
+                return -1;
+            }
+            slotx = (slotx + 1) & this->mask;
+        }
+        return -1;
+    }
+
+    /*
+     * Get the value of a key. Returns false if the key is not held.
+     */
+    inline bool find(const PPMD::INT key, PPMD::INT &value) const {
+        const std::int64_t slotx = this->find_slot(key);
+        if (slotx < 0) {
+            return false;
+        }
+        value = this->values[slotx];
+        return true;
+    }
+
+    /*
+     * Set the value of a key which is held by the map.
+     */
+    inline void assign(const PPMD::INT key, const PPMD::INT value) const {
+        const std::int64_t slotx = this->find_slot(key);
+        if (slotx >= 0) {
+            this->values[slotx] = value;
+        }
+    }
+
+    /*
+     * Remove a key from the map if it is held.
+     */
+    inline void erase(const PPMD::INT key) const {
+        const std::int64_t slotx = this->find_slot(key);
+        if (slotx >= 0) {
+            this->keys[slotx] = tombstone;
+        }
+    }
+};
+
+/*
+ * Open addressing hash map from non-negative INT keys to INT values stored on
+ * the device. Insertions, lookups and removals are made in kernels through
+ * the view returned by get_device_view. The map does not grow on the device,
+ * the owner must track the number of slots in use, including erased slots,
+ * and call reset before the load would exceed one half.
+ */
+class DeviceHashMap {
+  private:
+    SYCLTarget &sycl_target;
+    BufferDevice<PPMD::INT> d_keys;
+    BufferDevice<PPMD::INT> d_values;
+    BufferDevice<PPMD::INT> d_lookup;
+    std::uint64_t capacity;
+
+  public:
+    // Upper bound on the number of slots holding a key or a tombstone.
+    std::int64_t nused;
+
+    DeviceHashMap(SYCLTarget &sycl_target, const std::int64_t nentries = 0)
+        : sycl_target(sycl_target), d_keys(sycl_target, 0),
+          d_values(sycl_target, 0), d_lookup(sycl_target, 0), capacity(0),
+          nused(0) {
+        this->reset(nentries);
+    }
+
+    /*
+     * Remove all keys and size the map to hold at least nentries keys at a
+     * load of at most one quarter.
+     */
+    inline void reset(const std::int64_t nentries) {
+        std::uint64_t capacity = 64;
+        while (capacity < static_cast<std::uint64_t>(4 * nentries)) {
+            capacity *= 2;
+        }
+        this->capacity = capacity;
+        this->d_keys.realloc_no_copy(capacity);
+        this->d_values.realloc_no_copy(capacity);
+        this->sycl_target.queue
+            .fill(this->d_keys.ptr, DeviceHashMapView::empty, capacity)
+            .wait();
+        this->nused = 0;
+    }
+
+    /*
+     * Returns true if nentries more keys may be inserted without the load
+     * exceeding one half.
+     */
+    inline bool has_capacity(const std::int64_t nentries) {
+        return static_cast<std::uint64_t>(2 * (this->nused + nentries)) <=
+               this->capacity;
+    }
+
+    inline std::uint64_t get_capacity() { return this->capacity; }
+
+    inline DeviceHashMapView get_device_view() {
+        return {this->d_keys.ptr, this->d_values.ptr, this->capacity - 1};
+    }
+
+    /*
+     * Look up keys from the host. The value of each key is written to values,
+     * or -1 if the key is not held.
+     */
+    inline void find(const std::vector<PPMD::INT> &keys,
+                     std::vector<PPMD::INT> &values) {
+        const std::size_t nkeys = keys.size();
+        values.resize(nkeys);
+        if (nkeys == 0) {
+            return;
+        }
+        this->d_lookup.set(keys);
+        PPMD::INT *d_lookup = this->d_lookup.ptr;
+        const DeviceHashMapView map = this->get_device_view();
+        this->sycl_target.queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(sycl::range<1>(nkeys), [=](sycl::id<1> idx) {
+                    PPMD::INT value = -1;
+                    map.find(d_lookup[idx], value);
+                    d_lookup[idx] = value;
+                });
+            })
+            .wait();
+        this->sycl_target.queue
+            .memcpy(values.data(), d_lookup, nkeys * sizeof(PPMD::INT))
+            .wait();
+    }
+};
+
+} // namespace PPMD
+
+#endif
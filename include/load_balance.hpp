@@ -0,0 +1,706 @@
+#ifndef _PPMD_LOAD_BALANCE
+#define _PPMD_LOAD_BALANCE
+
+#include <CL/sycl.hpp>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mpi.h>
+#include <set>
+#include <vector>
+
+#include "cell_dat.hpp"
+#include "communication.hpp"
+#include "compute_target.hpp"
+#include "mesh_hierarchy.hpp"
+#include "particle_group.hpp"
+#include "particle_set.hpp"
+#include "particle_spec.hpp"
+#include "particle_species.hpp"
+#include "space_filling_curve.hpp"
+#include "typedefs.hpp"
+
+namespace PPMD {
+
+/*
+ * Split a sequence of cells into nparts contiguous parts of approximately
+ * equal total cost. Returns the part index of each cell, indexed by cell.
+ */
+inline std::vector<int> partition_cells(const std::vector<int> &cell_order,
+                                        const std::vector<double> &cell_costs,
+                                        const int nparts) {
+    PPMDASSERT(cell_order.size() == cell_costs.size(),
+               "cell order and costs have different sizes");
+    PPMDASSERT(nparts > 0, "Bad number of parts");
+    const int ncells = cell_order.size();
+    double cost_total = 0.0;
+    for (auto &cost : cell_costs) {
+        PPMDASSERT(cost >= 0.0, "Negative cell cost");
+        cost_total += cost;
+    }
+
+    std::vector<int> parts(ncells);
+    double cost_before = 0.0;
+    for (int ix = 0; ix < ncells; ix++) {
+        const int cellx = cell_order[ix];
+        const double cost = cell_costs[cellx];
+        // Place each cell by the midpoint of its cost interval.
+        const int part =
+            (cost_total > 0.0)
+                ? (int)((cost_before + 0.5 * cost) * nparts / cost_total)
+                : (int)(((long)ix * nparts) / ncells);
+        parts[cellx] = std::min(std::max(part, 0), nparts - 1);
+        cost_before += cost;
+    }
+    return parts;
+}
+
+/*
+ * Convert the number of bytes exchanged with each rank, computed in size_t,
+ * to the int counts and displacements of MPI_Alltoallv. Aborts if the total
+ * does not fit in an int, hence every count, displacement and offset into
+ * the exchanged bytes fits in an int. Returns the total.
+ */
+inline int mpi_byte_layout(const std::vector<size_t> &bytes,
+                           std::vector<int> &counts,
+                           std::vector<int> &displs) {
+    const int nranks = bytes.size();
+    size_t total = 0;
+    for (auto &nbytes : bytes) {
+        total += nbytes;
+    }
+    PPMDASSERT(total <= (size_t)INT_MAX,
+               "More than INT_MAX bytes exchanged in one migration");
+    counts.resize(nranks);
+    displs.resize(nranks);
+    int offset = 0;
+    for (int rankx = 0; rankx < nranks; rankx++) {
+        counts[rankx] = bytes[rankx];
+        displs[rankx] = offset;
+        offset += counts[rankx];
+    }
+    return offset;
+}
+
+/*
+ * The cells exchanged with each neighbouring rank to form the halo of the
+ * cells owned by a rank, see LoadBalance::get_halo_cells. The lists are
+ * indexed by position in ranks.
+ */
+struct HaloCells {
+    // Neighbouring ranks in increasing order.
+    std::vector<int> ranks;
+    // Owned cells sent to each neighbouring rank in increasing order.
+    std::vector<std::vector<int>> send_cells;
+    // Cells of each neighbouring rank received in increasing order.
+    std::vector<std::vector<int>> recv_cells;
+};
+
+/*
+ * Assigns the coarse cells of a MeshHierarchy to the ranks of the
+ * communicator of the SYCLTarget. Each rank owns a contiguous range of the
+ * coarse cells ordered along a Morton curve. The cost of each cell is
+ * accumulated from particle counts and loop timings and the cells can be
+ * repartitioned to equalise the cost on each rank. Particles and CellDatConst
+ * data in cells that change owner are migrated to the new owner.
+ *
+ * ParticleGroups and CellDatConsts passed to this class must hold all the
+ * coarse cells of the MeshHierarchy in linear index order.
+ */
+class LoadBalance {
+  private:
+    std::vector<int> cell_order;
+    std::vector<double> cell_costs;
+
+    // Device space used to pack migrated particles and cells, see
+    // migrate_particles and migrate.
+    BufferDevice<int> d_pack_particles;
+    BufferDevice<char> d_pack_buffer;
+
+    inline void
+    migrate_particles(const std::vector<ParticleGroup *> &groups);
+
+  public:
+    MeshHierarchy &mesh_hierarchy;
+    MPI_Comm comm;
+    int comm_rank;
+    int comm_size;
+    const int ncells;
+
+    // The rank that owns each coarse cell.
+    std::vector<int> cell_owners;
+    // The owners before the last call to repartition.
+    std::vector<int> cell_owners_previous;
+
+    // Cost added per particle by add_particle_counts.
+    double particle_weight;
+    // Cost added per cell by add_particle_counts.
+    double cell_weight;
+    // repartition only changes the owners if the ratio of the maximum to the
+    // mean rank cost exceeds this value.
+    double imbalance_tolerance;
+
+    LoadBalance(MeshHierarchy &mesh_hierarchy,
+                const double imbalance_tolerance = 1.1)
+        : d_pack_particles(mesh_hierarchy.sycl_target, 0),
+          d_pack_buffer(mesh_hierarchy.sycl_target, 0),
+          mesh_hierarchy(mesh_hierarchy),
+          comm(mesh_hierarchy.sycl_target.comm),
+          ncells(mesh_hierarchy.ncells_coarse), particle_weight(1.0),
+          cell_weight(1.0), imbalance_tolerance(imbalance_tolerance) {
+        MPICHK(MPI_Comm_rank(this->comm, &this->comm_rank))
+        MPICHK(MPI_Comm_size(this->comm, &this->comm_size))
+
+        this->cell_order =
+            morton_cell_order(mesh_hierarchy.ndim, mesh_hierarchy.dims);
+        this->cell_costs = std::vector<double>(this->ncells);
+        std::fill(this->cell_costs.begin(), this->cell_costs.end(), 1.0);
+        this->cell_owners = partition_cells(this->cell_order, this->cell_costs,
+                                            this->comm_size);
+        this->cell_owners_previous = this->cell_owners;
+        this->reset_costs();
+    };
+
+    /*
+     * Get the cells owned by this rank.
+     */
+    inline std::vector<int> get_owned_cells() {
+        std::vector<int> owned_cells;
+        for (int cellx = 0; cellx < this->ncells; cellx++) {
+            if (this->cell_owners[cellx] == this->comm_rank) {
+                owned_cells.push_back(cellx);
+            }
+        }
+        return owned_cells;
+    }
+
+    /*
+     * Zero the accumulated costs of the cells.
+     */
+    inline void reset_costs() {
+        std::fill(this->cell_costs.begin(), this->cell_costs.end(), 0.0);
+    }
+
+    /*
+     * Add a cost to a cell on this rank.
+     */
+    inline void add_cost(const int cell, const double cost) {
+        PPMDASSERT((cell >= 0) && (cell < this->ncells), "Bad cell index");
+        this->cell_costs[cell] += cost;
+    }
+
+    /*
+     * Add the particle_weight times the occupancy plus the cell_weight to the
+     * cost of each cell owned by this rank.
+     */
+    inline void add_particle_counts(ParticleGroup &particle_group) {
+        auto &npart_cell = particle_group.get_npart_cell();
+        PPMDASSERT(npart_cell.size() == this->ncells,
+                   "ParticleGroup cells are not the coarse mesh cells");
+        for (int cellx = 0; cellx < this->ncells; cellx++) {
+            if (this->cell_owners[cellx] == this->comm_rank) {
+                this->cell_costs[cellx] +=
+                    this->particle_weight * npart_cell[cellx] +
+                    this->cell_weight;
+            }
+        }
+    }
+
+    /*
+     * As add_particle_counts for a ParticleGroup with the occupancy summed
+     * over all the species, the cell_weight is added once per cell.
+     */
+    inline void add_particle_counts(ParticleSpeciesGroup &species_group) {
+        auto &npart_cell = species_group.get_npart_cell();
+        PPMDASSERT(npart_cell.size() == this->ncells,
+                   "ParticleGroup cells are not the coarse mesh cells");
+        for (int cellx = 0; cellx < this->ncells; cellx++) {
+            if (this->cell_owners[cellx] == this->comm_rank) {
+                this->cell_costs[cellx] +=
+                    this->particle_weight * npart_cell[cellx] +
+                    this->cell_weight;
+            }
+        }
+    }
+
+    /*
+     * Distribute a measured loop time over the cells of this rank in
+     * proportion to their occupancy. Particles in cells this rank does not
+     * own are not counted.
+     */
+    inline void add_loop_time(ParticleGroup &particle_group,
+                              const double time) {
+        auto &npart_cell = particle_group.get_npart_cell();
+        PPMDASSERT(npart_cell.size() == this->ncells,
+                   "ParticleGroup cells are not the coarse mesh cells");
+        PPMD::INT npart_owned = 0;
+        for (int cellx = 0; cellx < this->ncells; cellx++) {
+            if (this->cell_owners[cellx] == this->comm_rank) {
+                npart_owned += npart_cell[cellx];
+            }
+        }
+        if (npart_owned == 0) {
+            return;
+        }
+        const double time_per_particle = time / ((double)npart_owned);
+        for (int cellx = 0; cellx < this->ncells; cellx++) {
+            if (this->cell_owners[cellx] == this->comm_rank) {
+                this->cell_costs[cellx] +=
+                    time_per_particle * npart_cell[cellx];
+            }
+        }
+    }
+
+    /*
+     * Collective. Return the ratio of the maximum to the mean rank cost under
+     * the current ownership.
+     */
+    inline double get_imbalance() {
+        double cost_local = 0.0;
+        for (int cellx = 0; cellx < this->ncells; cellx++) {
+            cost_local += this->cell_costs[cellx];
+        }
+        double cost_max, cost_sum;
+        MPICHK(MPI_Allreduce(&cost_local, &cost_max, 1, MPI_DOUBLE, MPI_MAX,
+                             this->comm))
+        MPICHK(MPI_Allreduce(&cost_local, &cost_sum, 1, MPI_DOUBLE, MPI_SUM,
+                             this->comm))
+        const double cost_mean = cost_sum / this->comm_size;
+        return (cost_mean > 0.0) ? cost_max / cost_mean : 1.0;
+    }
+
+    inline HaloCells get_halo_cells();
+    inline bool repartition(const bool force = false);
+    inline void migrate(ParticleGroup &particle_group);
+    inline void migrate(ParticleSpeciesGroup &species_group);
+    template <typename T> inline void migrate(CellDatConst<T> &cell_dat);
+};
+
+/*
+ * Get the cells sent to and received from each neighbouring rank under the
+ * current ownership. A cell owned by this rank is sent to every other rank
+ * that owns a cell in its stencil, see
+ * MeshHierarchy::get_neighbours_coarse. As the ownership is known on every
+ * rank the receiving rank computes the same lists of cells without
+ * communication.
+ */
+inline HaloCells LoadBalance::get_halo_cells() {
+    std::map<int, std::set<int>> send_sets;
+    std::map<int, std::set<int>> recv_sets;
+    auto &mesh_hierarchy = this->mesh_hierarchy;
+    for (int cellx = 0; cellx < this->ncells; cellx++) {
+        if (this->cell_owners[cellx] != this->comm_rank) {
+            continue;
+        }
+        for (auto &neighbour : mesh_hierarchy.get_neighbours_coarse(cellx)) {
+            const int owner = this->cell_owners[neighbour];
+            if (owner != this->comm_rank) {
+                send_sets[owner].insert(cellx);
+                recv_sets[owner].insert(neighbour);
+            }
+        }
+    }
+
+    HaloCells halo;
+    for (auto &send_set : send_sets) {
+        auto &recv_set = recv_sets.at(send_set.first);
+        halo.ranks.push_back(send_set.first);
+        halo.send_cells.emplace_back(send_set.second.begin(),
+                                     send_set.second.end());
+        halo.recv_cells.emplace_back(recv_set.begin(), recv_set.end());
+    }
+    return halo;
+}
+
+/*
+ * Collective. If the imbalance exceeds the tolerance, or force is true,
+ * repartition the cells along the Morton curve using the accumulated costs.
+ * Returns true if any cell changed owner. The accumulated costs are reset.
+ */
+inline bool LoadBalance::repartition(const bool force) {
+    const double imbalance = this->get_imbalance();
+    this->cell_owners_previous = this->cell_owners;
+    if ((!force) && (imbalance <= this->imbalance_tolerance)) {
+        this->reset_costs();
+        return false;
+    }
+
+    std::vector<double> cell_costs_global(this->ncells);
+    MPICHK(MPI_Allreduce(this->cell_costs.data(), cell_costs_global.data(),
+                         this->ncells, MPI_DOUBLE, MPI_SUM, this->comm))
+    this->cell_owners = partition_cells(this->cell_order, cell_costs_global,
+                                        this->comm_size);
+    this->reset_costs();
+    return this->cell_owners != this->cell_owners_previous;
+}
+
+/*
+ * Collective. Send the particles in cells this rank owned before the last
+ * repartition, and no longer owns, to the new owners of those cells.
+ */
+inline void LoadBalance::migrate(ParticleGroup &particle_group) {
+    this->migrate_particles({&particle_group});
+}
+
+/*
+ * Collective. As migrate for a single ParticleGroup, but the particles of all
+ * the species are exchanged in one communication round.
+ */
+inline void LoadBalance::migrate(ParticleSpeciesGroup &species_group) {
+    this->migrate_particles(species_group.get_particle_groups());
+}
+
+/*
+ * Migrate the particles of several ParticleGroups with one exchange of counts
+ * and one exchange of data.
+ */
+inline void
+LoadBalance::migrate_particles(const std::vector<ParticleGroup *> &groups) {
+    auto &profiler = this->mesh_hierarchy.sycl_target.profiler;
+    profiler.start_region("LoadBalance::migrate");
+    const int comm_size = this->comm_size;
+    const int ngroup = groups.size();
+
+    // The cells sent to each rank are the same for all the groups.
+    std::vector<std::vector<int>> send_cells(comm_size);
+    for (int cellx = 0; cellx < this->ncells; cellx++) {
+        const int owner = this->cell_owners[cellx];
+        if ((this->cell_owners_previous[cellx] == this->comm_rank) &&
+            (owner != this->comm_rank)) {
+            send_cells[owner].push_back(cellx);
+        }
+    }
+
+    // Number of particles of each group sent to each rank, indexed by rank
+    // then group, and the number of bytes of all the dats of a single
+    // particle of each group.
+    std::vector<int> send_counts(comm_size * ngroup);
+    std::vector<int> particle_bytes(ngroup);
+    for (int gx = 0; gx < ngroup; gx++) {
+        auto &particle_group = *groups[gx];
+        auto &npart_cell = particle_group.get_npart_cell();
+        PPMDASSERT(npart_cell.size() == this->ncells,
+                   "ParticleGroup cells are not the coarse mesh cells");
+        // The particles are packed from the device copies of the dats.
+        PPMDASSERT(particle_group.all_resident(),
+                   "All cells must be resident on the device, see "
+                   "ParticleResidency::page_in_all");
+        particle_group.for_each_particle_dat(
+            [&](auto &dat) { dat->cell_dat.push_host_cells(); });
+        particle_group.for_each_particle_dat([&](auto &dat) {
+            particle_bytes[gx] += dat->ncomp * dat->elem_size;
+        });
+        for (int rankx = 0; rankx < comm_size; rankx++) {
+            for (auto &cellx : send_cells[rankx]) {
+                send_counts[rankx * ngroup + gx] += npart_cell[cellx];
+            }
+        }
+    }
+    std::vector<size_t> send_bytes(comm_size);
+    for (int rankx = 0; rankx < comm_size; rankx++) {
+        for (int gx = 0; gx < ngroup; gx++) {
+            send_bytes[rankx] += ((size_t)send_counts[rankx * ngroup + gx]) *
+                                 particle_bytes[gx];
+        }
+    }
+    std::vector<int> send_counts_bytes;
+    std::vector<int> send_displs_bytes;
+    const int send_total =
+        mpi_byte_layout(send_bytes, send_counts_bytes, send_displs_bytes);
+
+    // Pack the particles for each destination on the device. For each
+    // destination the groups are packed in order and the data of each group
+    // is stored by dat, component then particle. Dats are packed as bytes in
+    // the order of ParticleGroup::for_each_particle_dat.
+    auto &sycl_target = this->mesh_hierarchy.sycl_target;
+    this->d_pack_buffer.realloc_no_copy(send_total);
+    char *k_buffer = this->d_pack_buffer.ptr;
+    std::vector<int> group_offsets(comm_size, 0);
+    // The dats may be written by loops submitted without waiting.
+    const std::vector<sycl::event> deps = sycl_target.get_compute_events();
+    for (int gx = 0; gx < ngroup; gx++) {
+        // The cell, layer, offset of the region of the destination, particle
+        // count of the destination and index within the destination of each
+        // sent particle, as consecutive arrays.
+        auto &npart_cell = groups[gx]->get_npart_cell();
+        std::vector<int> cells;
+        std::vector<int> layers;
+        std::vector<int> regions;
+        std::vector<int> counts;
+        std::vector<int> indices;
+        for (int rankx = 0; rankx < comm_size; rankx++) {
+            const int npart_rank = send_counts[rankx * ngroup + gx];
+            const int region = send_displs_bytes[rankx] + group_offsets[rankx];
+            group_offsets[rankx] += npart_rank * particle_bytes[gx];
+            int px = 0;
+            for (auto &cellx : send_cells[rankx]) {
+                for (int layerx = 0; layerx < npart_cell[cellx]; layerx++) {
+                    cells.push_back(cellx);
+                    layers.push_back(layerx);
+                    regions.push_back(region);
+                    counts.push_back(npart_rank);
+                    indices.push_back(px++);
+                }
+            }
+        }
+        const int nsend = cells.size();
+        if (nsend == 0) {
+            continue;
+        }
+        std::vector<int> pack;
+        for (auto values : {&cells, &layers, &regions, &counts, &indices}) {
+            pack.insert(pack.end(), values->begin(), values->end());
+        }
+        this->d_pack_particles.set(pack);
+        const int *k_cells = this->d_pack_particles.ptr;
+        const int *k_layers = k_cells + nsend;
+        const int *k_regions = k_cells + 2 * nsend;
+        const int *k_counts = k_cells + 3 * nsend;
+        const int *k_indices = k_cells + 4 * nsend;
+        // The kernels of a group share the index arrays, hence they complete
+        // before the arrays of the next group are copied.
+        EventStack es;
+        int prefix = 0;
+        groups[gx]->for_each_particle_dat([&](auto &dat) {
+            const auto k_dat = dat->cell_dat.device_accessor();
+            const int k_ncomp = dat->ncomp;
+            const int k_elem_size = dat->elem_size;
+            const int k_prefix = prefix;
+            es.push(sycl_target.queue.submit([&](sycl::handler &cgh) {
+                cgh.depends_on(deps);
+                cgh.parallel_for<>(
+                    sycl::range<1>(nsend), [=](sycl::id<1> idx) {
+                        const int cellx = k_cells[idx];
+                        const int layerx = k_layers[idx];
+                        const int npart_rank = k_counts[idx];
+                        char *dst = k_buffer + k_regions[idx] +
+                                    k_prefix * npart_rank +
+                                    k_indices[idx] * k_elem_size;
+                        for (int cx = 0; cx < k_ncomp; cx++) {
+                            const auto value = k_dat[cellx][cx][layerx];
+                            // The packed elements need not be aligned.
+                            const char *src =
+                                reinterpret_cast<const char *>(&value);
+                            char *dst_comp =
+                                dst + cx * npart_rank * k_elem_size;
+                            for (int bx = 0; bx < k_elem_size; bx++) {
+                                dst_comp[bx] = src[bx];
+                            }
+                        }
+                    });
+            }));
+            prefix += dat->ncomp * dat->elem_size;
+        });
+        es.wait();
+    }
+    std::vector<char> send_buffer(send_total);
+    if (send_total > 0) {
+        EventStack es;
+        es.push(sycl_target.queue_d2h.memcpy(send_buffer.data(), k_buffer,
+                                             send_total),
+                profiler, "LoadBalance::migrate");
+        es.wait();
+    }
+
+    for (int gx = 0; gx < ngroup; gx++) {
+        auto &npart_cell = groups[gx]->get_npart_cell();
+        std::vector<PPMD::INT> remove_cells;
+        std::vector<PPMD::INT> remove_layers;
+        for (int rankx = 0; rankx < comm_size; rankx++) {
+            for (auto &cellx : send_cells[rankx]) {
+                for (int layerx = 0; layerx < npart_cell[cellx]; layerx++) {
+                    remove_cells.push_back(cellx);
+                    remove_layers.push_back(layerx);
+                }
+            }
+        }
+        groups[gx]->remove_particles(remove_cells.size(), remove_cells,
+                                     remove_layers);
+    }
+
+    std::vector<int> recv_counts(comm_size * ngroup);
+    MPICHK(MPI_Alltoall(send_counts.data(), ngroup, MPI_INT,
+                        recv_counts.data(), ngroup, MPI_INT, this->comm))
+
+    // Offset of the particles from each rank in the received particles of
+    // each group, indexed by rank then group.
+    std::vector<int> recv_displs(comm_size * ngroup);
+    std::vector<int> npart_recv(ngroup);
+    std::vector<size_t> recv_bytes(comm_size);
+    for (int rankx = 0; rankx < comm_size; rankx++) {
+        for (int gx = 0; gx < ngroup; gx++) {
+            const int npart_rank = recv_counts[rankx * ngroup + gx];
+            recv_displs[rankx * ngroup + gx] = npart_recv[gx];
+            npart_recv[gx] += npart_rank;
+            recv_bytes[rankx] += ((size_t)npart_rank) * particle_bytes[gx];
+        }
+    }
+    std::vector<int> recv_counts_bytes;
+    std::vector<int> recv_displs_bytes;
+    const int recv_total =
+        mpi_byte_layout(recv_bytes, recv_counts_bytes, recv_displs_bytes);
+
+    std::vector<char> recv_buffer(recv_total);
+    MPICHK(MPI_Alltoallv(send_buffer.data(), send_counts_bytes.data(),
+                         send_displs_bytes.data(), MPI_BYTE,
+                         recv_buffer.data(), recv_counts_bytes.data(),
+                         recv_displs_bytes.data(), MPI_BYTE, this->comm))
+
+    // Unpack into a ParticleSet for each group.
+    for (int gx = 0; gx < ngroup; gx++) {
+        if (npart_recv[gx] == 0) {
+            continue;
+        }
+        auto &particle_group = *groups[gx];
+        ParticleSpec particle_spec;
+        particle_group.for_each_particle_dat([&](auto &dat) {
+            particle_spec.add_property(
+                ParticleProp(dat->sym, dat->ncomp, dat->positions,
+                             dat->cell_dat.layout));
+        });
+        ParticleSet particle_set(npart_recv[gx], particle_spec);
+
+        for (int rankx = 0; rankx < comm_size; rankx++) {
+            const char *rank_buffer =
+                recv_buffer.data() + recv_displs_bytes[rankx];
+            for (int gy = 0; gy < gx; gy++) {
+                rank_buffer +=
+                    recv_counts[rankx * ngroup + gy] * particle_bytes[gy];
+            }
+            const int npart_rank = recv_counts[rankx * ngroup + gx];
+            const int offset = recv_displs[rankx * ngroup + gx];
+            particle_group.for_each_particle_dat([&](auto &dat) {
+                const int elem_size = dat->elem_size;
+                auto &values = particle_set.get(dat->sym);
+                for (int cx = 0; cx < dat->ncomp; cx++) {
+                    std::memcpy(values.data() + cx * npart_recv[gx] + offset,
+                                rank_buffer + cx * npart_rank * elem_size,
+                                npart_rank * elem_size);
+                }
+                rank_buffer += npart_rank * dat->ncomp * elem_size;
+            });
+        }
+        particle_group.add_particles_local(particle_set);
+    }
+    profiler.add_bytes("mpi_send", send_buffer.size());
+    profiler.end_region();
+}
+
+/*
+ * Collective. Send the data of cells this rank owned before the last
+ * repartition, and no longer owns, to the new owners of those cells. The
+ * cells are packed and unpacked on the compute queue and copied on the copy
+ * queues, ordered by events.
+ */
+template <typename T>
+inline void LoadBalance::migrate(CellDatConst<T> &cell_dat) {
+    PPMDASSERT(cell_dat.ncells == this->ncells,
+               "CellDatConst cells are not the coarse mesh cells");
+    const int comm_size = this->comm_size;
+    const int comm_rank = this->comm_rank;
+    const int stride = cell_dat.nrow * cell_dat.ncol;
+    auto &sycl_target = cell_dat.sycl_target;
+    auto &profiler = this->mesh_hierarchy.sycl_target.profiler;
+    profiler.start_region("LoadBalance::migrate");
+
+    // Cells are sent and received in increasing cell index order.
+    std::vector<std::vector<int>> send_cells(comm_size);
+    std::vector<std::vector<int>> recv_cells(comm_size);
+    for (int cellx = 0; cellx < this->ncells; cellx++) {
+        const int owner = this->cell_owners[cellx];
+        const int owner_previous = this->cell_owners_previous[cellx];
+        if (owner != owner_previous) {
+            if (owner_previous == comm_rank) {
+                send_cells[owner].push_back(cellx);
+            } else if (owner == comm_rank) {
+                recv_cells[owner_previous].push_back(cellx);
+            }
+        }
+    }
+    std::vector<size_t> send_bytes(comm_size);
+    std::vector<size_t> recv_bytes(comm_size);
+    std::vector<int> send_cells_flat;
+    std::vector<int> recv_cells_flat;
+    for (int rankx = 0; rankx < comm_size; rankx++) {
+        send_bytes[rankx] = send_cells[rankx].size() * stride * sizeof(T);
+        recv_bytes[rankx] = recv_cells[rankx].size() * stride * sizeof(T);
+        send_cells_flat.insert(send_cells_flat.end(), send_cells[rankx].begin(),
+                               send_cells[rankx].end());
+        recv_cells_flat.insert(recv_cells_flat.end(), recv_cells[rankx].begin(),
+                               recv_cells[rankx].end());
+    }
+    std::vector<int> send_counts;
+    std::vector<int> send_displs;
+    std::vector<int> recv_counts;
+    std::vector<int> recv_displs;
+    const int send_total =
+        mpi_byte_layout(send_bytes, send_counts, send_displs);
+    const int recv_total =
+        mpi_byte_layout(recv_bytes, recv_counts, recv_displs);
+
+    const int k_stride = stride;
+    T *k_ptr = cell_dat.device_ptr();
+    std::vector<char> send_buffer(send_total);
+    std::vector<char> recv_buffer(recv_total);
+    this->d_pack_buffer.realloc_no_copy(std::max(send_total, recv_total));
+    T *k_buffer = reinterpret_cast<T *>(this->d_pack_buffer.ptr);
+    EventStack es;
+    const size_t nsend = send_cells_flat.size() * stride;
+    if (nsend > 0) {
+        this->d_pack_particles.set(send_cells_flat);
+        const int *k_cells = this->d_pack_particles.ptr;
+        const std::vector<sycl::event> deps = sycl_target.get_compute_events();
+        sycl::event event_pack =
+            sycl_target.queue.submit([&](sycl::handler &cgh) {
+                cgh.depends_on(deps);
+                cgh.parallel_for<>(
+                    sycl::range<1>(nsend), [=](sycl::id<1> idx) {
+                        const int cellx = k_cells[idx[0] / k_stride];
+                        const int ix = idx[0] % k_stride;
+                        k_buffer[idx] = k_ptr[cellx * k_stride + ix];
+                    });
+            });
+        profiler.add_device_event("LoadBalance::migrate", event_pack);
+        es.push(sycl_target.queue_d2h.memcpy(send_buffer.data(), k_buffer,
+                                             send_total, event_pack),
+                profiler, "LoadBalance::migrate");
+        es.wait();
+    }
+
+    MPICHK(MPI_Alltoallv(send_buffer.data(), send_counts.data(),
+                         send_displs.data(), MPI_BYTE, recv_buffer.data(),
+                         recv_counts.data(), recv_displs.data(), MPI_BYTE,
+                         this->comm))
+
+    const size_t nrecv = recv_cells_flat.size() * stride;
+    if (nrecv > 0) {
+        this->d_pack_particles.set(recv_cells_flat);
+        const int *k_cells = this->d_pack_particles.ptr;
+        es.push(sycl_target.queue_h2d.memcpy(k_buffer, recv_buffer.data(),
+                                             recv_total),
+                profiler, "LoadBalance::migrate");
+        std::vector<sycl::event> deps = sycl_target.get_compute_events();
+        deps.insert(deps.end(), es.events.begin(), es.events.end());
+        sycl::event event_unpack =
+            sycl_target.queue.submit([&](sycl::handler &cgh) {
+                cgh.depends_on(deps);
+                cgh.parallel_for<>(
+                    sycl::range<1>(nrecv), [=](sycl::id<1> idx) {
+                        const int cellx = k_cells[idx[0] / k_stride];
+                        const int ix = idx[0] % k_stride;
+                        k_ptr[cellx * k_stride + ix] = k_buffer[idx];
+                    });
+            });
+        profiler.add_device_event("LoadBalance::migrate", event_unpack);
+        event_unpack.wait();
+        es.wait();
+    }
+    profiler.add_bytes("mpi_send", send_total);
+    profiler.end_region();
+}
+
+} // namespace PPMD
+
+#endif
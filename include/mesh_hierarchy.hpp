@@ -1,6 +1,9 @@
 #ifndef _PPMD_MESH_HIERARCHY
 #define _PPMD_MESH_HIERARCHY
+#include <algorithm>
 #include <cmath>
+#include <numeric>
+#include <type_traits>
 #include <vector>
 
 #include "compute_target.hpp"
@@ -10,6 +13,138 @@ using namespace PPMD;
 
 namespace PPMD {
 
+/*
+ * Trivially copyable description of a MeshHierarchy that can be captured by
+ * value in SYCL kernels. Linear indices are computed with the first dimension
+ * as the fastest running index for both the coarse cells and the fine cells
+ * within each coarse cell. Positions are measured from the origin of the
+ * coarse mesh. The index helpers are constexpr such that they can also be
+ * evaluated at compile time.
+ */
+template <int NDIM> class MeshHierarchyDevice {
+  public:
+    int dims[NDIM];
+    int subdivision_order;
+    // Number of fine cells along each dimension of a coarse cell.
+    int ncells_dim_fine;
+    int ncells_coarse;
+    int ncells_fine;
+    double cell_width_coarse;
+    double cell_width_fine;
+    double inverse_cell_width_coarse;
+    double inverse_cell_width_fine;
+
+    // Number of cells in the stencil of a cell and its direct neighbours.
+    static constexpr int stencil_size() {
+        int size = 1;
+        for (int dimx = 0; dimx < NDIM; dimx++) {
+            size *= 3;
+        }
+        return size;
+    }
+
+    /*
+     * Compute the coarse cell tuple and the tuple of the fine cell within the
+     * coarse cell that contains a position. The coarse tuple is not wrapped
+     * into the mesh, see periodic_wrap_coarse.
+     */
+    inline void position_to_tuple(const double *position, int *index_coarse,
+                                  int *index_fine) const {
+        for (int dimx = 0; dimx < NDIM; dimx++) {
+            const double pos = position[dimx];
+            const int cx =
+                (int)sycl::floor(pos * this->inverse_cell_width_coarse);
+            int fx = ((int)sycl::floor(pos * this->inverse_cell_width_fine)) -
+                     cx * this->ncells_dim_fine;
+            // guard against rounding at the coarse cell boundaries
+            fx = (fx < 0) ? 0 : fx;
+            fx = (fx >= this->ncells_dim_fine) ? this->ncells_dim_fine - 1 : fx;
+            index_coarse[dimx] = cx;
+            index_fine[dimx] = fx;
+        }
+    }
+
+    /*
+     * Linear index of a coarse cell from its tuple.
+     */
+    constexpr int tuple_to_linear_coarse(const int *index) const {
+        int linear = index[NDIM - 1];
+        for (int dimx = NDIM - 2; dimx >= 0; dimx--) {
+            linear = linear * this->dims[dimx] + index[dimx];
+        }
+        return linear;
+    }
+
+    /*
+     * Tuple of a coarse cell from its linear index.
+     */
+    constexpr void linear_to_tuple_coarse(int linear, int *index) const {
+        for (int dimx = 0; dimx < NDIM; dimx++) {
+            index[dimx] = linear % this->dims[dimx];
+            linear /= this->dims[dimx];
+        }
+    }
+
+    /*
+     * Linear index of a fine cell within a coarse cell from its tuple.
+     */
+    constexpr int tuple_to_linear_fine(const int *index) const {
+        int linear = index[NDIM - 1];
+        for (int dimx = NDIM - 2; dimx >= 0; dimx--) {
+            linear = linear * this->ncells_dim_fine + index[dimx];
+        }
+        return linear;
+    }
+
+    /*
+     * Tuple of a fine cell within a coarse cell from its linear index.
+     */
+    constexpr void linear_to_tuple_fine(int linear, int *index) const {
+        for (int dimx = 0; dimx < NDIM; dimx++) {
+            index[dimx] = linear % this->ncells_dim_fine;
+            linear /= this->ncells_dim_fine;
+        }
+    }
+
+    /*
+     * Map a coarse tuple into the mesh assuming periodic boundaries.
+     */
+    constexpr void periodic_wrap_coarse(int *index) const {
+        for (int dimx = 0; dimx < NDIM; dimx++) {
+            const int n = this->dims[dimx];
+            index[dimx] = ((index[dimx] % n) + n) % n;
+        }
+    }
+
+    /*
+     * Offset, in each dimension in {-1, 0, 1}, of stencil entry s where
+     * 0 <= s < stencil_size(). Entry (stencil_size() - 1) / 2 is the centre.
+     */
+    constexpr void stencil_offset(int s, int *offset) const {
+        for (int dimx = 0; dimx < NDIM; dimx++) {
+            offset[dimx] = (s % 3) - 1;
+            s /= 3;
+        }
+    }
+
+    /*
+     * Linear index of the neighbour, given by stencil entry s, of a coarse
+     * cell assuming periodic boundaries.
+     */
+    constexpr int stencil_neighbour_coarse(const int linear,
+                                           const int s) const {
+        int index[NDIM] = {};
+        int offset[NDIM] = {};
+        this->linear_to_tuple_coarse(linear, index);
+        this->stencil_offset(s, offset);
+        for (int dimx = 0; dimx < NDIM; dimx++) {
+            index[dimx] += offset[dimx];
+        }
+        this->periodic_wrap_coarse(index);
+        return this->tuple_to_linear_coarse(index);
+    }
+};
+
 class MeshHierarchy {
 
   public:
@@ -46,6 +181,71 @@ class MeshHierarchy {
         PPMDASSERT(subdivision_order >= 0,
                    "Negative subdivision order passed.");
     };
+
+    /*
+     * Linear indices of the coarse cells in the stencil of a coarse cell,
+     * excluding the cell itself, assuming periodic boundaries. Cells are
+     * listed once in increasing order even if the mesh is narrow enough that
+     * several stencil entries wrap onto the same cell.
+     */
+    inline std::vector<int> get_neighbours_coarse(const int cell) {
+        PPMDASSERT((cell >= 0) && (cell < this->ncells_coarse),
+                   "Bad coarse cell index");
+        std::vector<int> index(this->ndim);
+        int linear = cell;
+        for (int dimx = 0; dimx < this->ndim; dimx++) {
+            index[dimx] = linear % this->dims[dimx];
+            linear /= this->dims[dimx];
+        }
+        int stencil_size = 1;
+        for (int dimx = 0; dimx < this->ndim; dimx++) {
+            stencil_size *= 3;
+        }
+        std::vector<int> neighbours;
+        for (int sx = 0; sx < stencil_size; sx++) {
+            int s = sx;
+            int neighbour = 0;
+            int stride = 1;
+            for (int dimx = 0; dimx < this->ndim; dimx++) {
+                const int n = this->dims[dimx];
+                const int ix = (index[dimx] + (s % 3) - 1 + n) % n;
+                neighbour += ix * stride;
+                stride *= n;
+                s /= 3;
+            }
+            if (neighbour != cell) {
+                neighbours.push_back(neighbour);
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+                         neighbours.end());
+        return neighbours;
+    }
+
+    /*
+     * Get a copy of the hierarchy that can be captured in SYCL kernels. NDIM
+     * must match the number of dimensions of the hierarchy.
+     */
+    template <int NDIM> inline MeshHierarchyDevice<NDIM> get_device_view() {
+        static_assert(
+            std::is_trivially_copyable<MeshHierarchyDevice<NDIM>>::value,
+            "MeshHierarchyDevice must be trivially copyable");
+        PPMDASSERT(NDIM == this->ndim, "NDIM does not match ndim");
+        MeshHierarchyDevice<NDIM> view;
+        for (int dimx = 0; dimx < NDIM; dimx++) {
+            view.dims[dimx] = this->dims[dimx];
+        }
+        view.subdivision_order = this->subdivision_order;
+        view.ncells_dim_fine = 1 << this->subdivision_order;
+        view.ncells_coarse = this->ncells_coarse;
+        view.ncells_fine = this->ncells_fine;
+        view.cell_width_coarse = this->cell_width_coarse;
+        view.cell_width_fine = this->cell_width_fine;
+        view.inverse_cell_width_coarse = this->inverse_cell_width_coarse;
+        view.inverse_cell_width_fine = this->inverse_cell_width_fine;
+        return view;
+    }
 };
 
 } // namespace PPMD
@@ -2,9 +2,13 @@
 #define _PPMD_PARTICLE_DAT
 
 #include <CL/sycl.hpp>
+#include <chrono>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "access.hpp"
+#include "cell_counting_sort.hpp"
 #include "compute_target.hpp"
 #include "particle_set.hpp"
 #include "particle_spec.hpp"
@@ -25,14 +29,26 @@ template <typename T> class ParticleDatT {
     const int ncell;
     const bool positions;
     const std::string name;
+    // Size in bytes of an element of the dat.
+    static constexpr int elem_size = sizeof(T);
 
     SYCLTarget &sycl_target;
+    // Device staging space for the cells and data of appended particles.
+    BufferDevice<PPMD::INT> d_append_cells;
+    BufferDevice<T> d_append_data;
+    // The last append kernel, which reads the staging space.
+    sycl::event append_event;
+    // Layers of appended particles when the dat is appended to directly.
+    CellCountingSort append_sort;
 
     ParticleDatT(SYCLTarget &sycl_target, const Sym<T> sym, int ncomp,
-                 int ncell, bool positions = false)
+                 int ncell, bool positions = false,
+                 CellDatLayout layout = CellDatLayout::soa)
         : sycl_target(sycl_target), sym(sym), name(sym.name), ncomp(ncomp),
           ncell(ncell), positions(positions),
-          cell_dat(CellDat<T>(sycl_target, ncell, ncomp)) {
+          cell_dat(CellDat<T>(sycl_target, ncell, ncomp, layout)),
+          d_append_cells(sycl_target, 0), d_append_data(sycl_target, 0),
+          append_sort(sycl_target, ncell) {
 
         this->npart_local = 0;
         this->npart_alloc = 0;
@@ -55,7 +71,13 @@ template <typename T> class ParticleDatT {
                                      const bool new_data_exists,
                                      std::vector<PPMD::INT> &cells,
                                      std::vector<T> &data);
+    inline void append_particle_data(const int npart_new,
+                                     const bool new_data_exists,
+                                     const PPMD::INT *d_cells,
+                                     const int *d_layers,
+                                     std::vector<T> &data);
     inline void realloc(std::vector<PPMD::INT> &npart_cell_new);
+    inline void set_npart_cells(std::vector<PPMD::INT> &npart_cell_new);
     inline int get_npart_local() { return this->npart_local; }
 };
 
@@ -64,15 +86,18 @@ template <typename T> using ParticleDatShPtr = std::shared_ptr<ParticleDatT<T>>;
 template <typename T>
 inline ParticleDatShPtr<T> ParticleDat(SYCLTarget &sycl_target,
                                        const PPMD::Sym<T> sym, int ncomp,
-                                       int ncell, bool positions = false) {
+                                       int ncell, bool positions = false,
+                                       CellDatLayout layout =
+                                           CellDatLayout::soa) {
     return std::make_shared<ParticleDatT<T>>(sycl_target, sym, ncomp, ncell,
-                                             positions);
+                                             positions, layout);
 }
 template <typename T>
 inline ParticleDatShPtr<T> ParticleDat(SYCLTarget &sycl_target,
                                        ParticleProp<T> prop, int ncell) {
     return std::make_shared<ParticleDatT<T>>(sycl_target, prop.sym, prop.ncomp,
-                                             ncell, prop.positions);
+                                             ncell, prop.positions,
+                                             prop.layout);
 }
 template <typename T>
 inline void ParticleDatT<T>::realloc(std::vector<PPMD::INT> &npart_cell_new) {
@@ -84,8 +109,33 @@ inline void ParticleDatT<T>::realloc(std::vector<PPMD::INT> &npart_cell_new) {
 }
 
 /*
- *  Append particle data to the ParticleDat. wait() must be called on the queue
- *  before use of the data.
+ *  Set the number of particles in each cell. The allocated space in each cell
+ *  is grown if required but existing data is not modified.
+ */
+template <typename T>
+inline void
+ParticleDatT<T>::set_npart_cells(std::vector<PPMD::INT> &npart_cell_new) {
+    PPMDASSERT(npart_cell_new.size() >= this->ncell,
+               "Insufficent new cell counts");
+    int npart_local = 0;
+    for (int cellx = 0; cellx < this->ncell; cellx++) {
+        this->cell_dat.set_nrow(cellx, npart_cell_new[cellx]);
+        this->s_npart_cell[cellx] = npart_cell_new[cellx];
+        npart_local += npart_cell_new[cellx];
+    }
+    this->npart_local = npart_local;
+}
+
+/*
+ *  Append particle data to the ParticleDat. The cells are uploaded and the
+ *  layers of the new particles are computed with a stable counting sort,
+ *  hence the new particles of each cell follow the existing particles in the
+ *  order they are given. The space in each cell must have been grown with
+ *  realloc. The data is uploaded on the host to device copy queue and the
+ *  append kernel on the compute queue depends on the upload. wait() must be
+ *  called on the compute queue before use of the data and before the data is
+ *  modified. The upload reads the host vector data after the call returns,
+ *  hence data must not be modified or destroyed until the wait.
  *
  */
 template <typename T>
@@ -95,82 +145,136 @@ inline void ParticleDatT<T>::append_particle_data(const int npart_new,
                                                   std::vector<T> &data) {
 
     PPMDASSERT(npart_new <= cells.size(), "incorrect number of cells");
+    if (npart_new == 0) {
+        return;
+    }
+    // The previous append may still read the staging space.
+    this->append_event.wait();
+    this->d_append_cells.realloc_no_copy(npart_new);
+    EventStack es;
+    es.push(this->sycl_target.queue_h2d.memcpy(this->d_append_cells.ptr,
+                                               cells.data(),
+                                               npart_new * sizeof(PPMD::INT)),
+            this->sycl_target.profiler, "ParticleDatT::append_particle_data");
+    es.wait();
+    this->sycl_target.profiler.add_bytes("host_to_device",
+                                         npart_new * sizeof(PPMD::INT));
+
+    std::vector<int> layer_start(this->s_npart_cell,
+                                 this->s_npart_cell + this->ncell);
+    this->append_sort.compute(npart_new, this->d_append_cells.ptr,
+                              layer_start);
+    this->append_sort.assert_valid();
+    this->append_particle_data(npart_new, new_data_exists,
+                               this->d_append_cells.ptr,
+                               this->append_sort.d_layers.ptr, data);
+    for (int cellx = 0; cellx < this->ncell; cellx++) {
+        this->s_npart_cell[cellx] += this->append_sort.cell_counts[cellx];
+    }
+}
+
+/*
+ *  Append particle data to the ParticleDat at given locations. d_cells and
+ *  d_layers are device arrays holding the cell and layer of each new
+ *  particle, e.g. as computed by a CellCountingSort, and must not be modified
+ *  until the append is complete. The occupancies in s_npart_cell are not
+ *  modified, see set_npart_cells. The data is uploaded on the host to device
+ *  copy queue and the append kernel on the compute queue depends on the
+ *  upload. wait() must be called on the compute queue before use of the data
+ *  and before the data is modified. The upload reads the host vector data
+ *  after the call returns, hence data must not be modified or destroyed until
+ *  the wait.
+ */
+template <typename T>
+inline void ParticleDatT<T>::append_particle_data(const int npart_new,
+                                                  const bool new_data_exists,
+                                                  const PPMD::INT *d_cells,
+                                                  const int *d_layers,
+                                                  std::vector<T> &data) {
+    if (npart_new == 0) {
+        return;
+    }
 
     // using "this" in the kernel causes segfaults on the device so we make a
     // copy here.
     const size_t size_npart_new = static_cast<size_t>(npart_new);
-    int *s_npart_cell = this->s_npart_cell;
     const int ncomp = this->ncomp;
-    T ***d_cell_dat_ptr = this->cell_dat.device_ptr();
-
-    sycl::buffer<PPMD::INT, 1> b_cells(cells.data(),
-                                       sycl::range<1>{size_npart_new});
+    auto d_cell_dat = this->cell_dat.device_accessor();
 
     // If data is supplied copy the data otherwise zero the components.
+    std::vector<sycl::event> events_copy;
+    const T *d_data = nullptr;
     if (new_data_exists) {
-        sycl::buffer<T, 1> b_data(data.data(),
-                                  sycl::range<1>{size_npart_new * this->ncomp});
-        this->sycl_target.queue.submit([&](sycl::handler &cgh) {
-            // The cell counts on this dat
-            auto a_cells = b_cells.get_access<sycl::access::mode::read>(cgh);
-            // The new data
-            auto a_data =
-                b_data.template get_access<sycl::access::mode::read>(cgh);
-
-            cgh.parallel_for<>(sycl::range<1>(npart_new), [=](sycl::id<1> idx) {
-                PPMD::INT cellx = a_cells[idx];
-                // atomically get the new layer and increment the count in
-                // the cell
-#if defined(__INTEL_LLVM_COMPILER)
-                auto element_atomic = sycl::ext::oneapi::atomic_ref<
-                    int, sycl::ext::oneapi::memory_order_acq_rel,
-                    sycl::ext::oneapi::memory_scope_device,
-                    sycl::access::address_space::global_space>(
-                    s_npart_cell[cellx]);
-                const int layerx = element_atomic.fetch_add(1);
-#else
-                    sycl::atomic_ref<int, sycl::memory_order::relaxed,
-                                     sycl::memory_scope::device>
-                        element_atomic(s_npart_cell[cellx]);
-                    const int layerx = element_atomic.fetch_add(1);
-#endif
-                // copy the data into the dat.
-                for (int cx = 0; cx < ncomp; cx++) {
-                    d_cell_dat_ptr[cellx][cx][layerx] =
-                        a_data[cx * npart_new + idx];
-                }
-            });
-        });
-    } else {
-        this->sycl_target.queue.submit([&](sycl::handler &cgh) {
-            // The cell counts on this dat
-            auto a_cells = b_cells.get_access<sycl::access::mode::read>(cgh);
-
-            cgh.parallel_for<>(sycl::range<1>(npart_new), [=](sycl::id<1> idx) {
-                PPMD::INT cellx = a_cells[idx];
-                // atomically get the layer
-
-#if defined(__INTEL_LLVM_COMPILER)
-                auto element_atomic = sycl::ext::oneapi::atomic_ref<
-                    int, sycl::ext::oneapi::memory_order_acq_rel,
-                    sycl::ext::oneapi::memory_scope_device,
-                    sycl::access::address_space::global_space>(
-                    s_npart_cell[cellx]);
-                const int layerx = element_atomic.fetch_add(1);
-#else
-                    sycl::atomic_ref<int, sycl::memory_order::relaxed,
-                                     sycl::memory_scope::device>
-                        element_atomic(s_npart_cell[cellx]);
-                    const int layerx = element_atomic.fetch_add(1);
-#endif
+        // The previous append may still read the staging space.
+        this->append_event.wait();
+        this->d_append_data.realloc_no_copy(size_npart_new * this->ncomp);
+        d_data = this->d_append_data.ptr;
+        events_copy.push_back(this->sycl_target.queue_h2d.memcpy(
+            this->d_append_data.ptr, data.data(),
+            size_npart_new * this->ncomp * sizeof(T)));
+        this->sycl_target.profiler.add_device_event(
+            "ParticleDatT::append_particle_data", events_copy.back());
+        this->sycl_target.profiler.add_bytes(
+            "host_to_device", size_npart_new * this->ncomp * sizeof(T));
+    }
 
-                // zero the new components in the dat
-                for (int cx = 0; cx < ncomp; cx++) {
-                    d_cell_dat_ptr[cellx][cx][layerx] = ((T)0);
-                }
-            });
-        });
+    auto lambda_append = [=](const int index) {
+        const PPMD::INT cellx = d_cells[index];
+        const int layerx = d_layers[index];
+        for (int cx = 0; cx < ncomp; cx++) {
+            d_cell_dat[cellx][cx][layerx] =
+                (d_data != nullptr) ? d_data[cx * npart_new + index] : ((T)0);
+        }
+    };
+    // The work-group size is selected by the autotuner.
+    std::vector<KernelConfig> candidates;
+    for (auto local_size :
+         Autotuner::candidate_local_sizes(this->sycl_target.device)) {
+        candidates.push_back({0, local_size});
+    }
+    const std::string key = "ParticleDatT::append_particle_data:" +
+                            std::to_string(Autotuner::size_bucket(npart_new));
+    KernelConfig config;
+    const bool trial =
+        this->sycl_target.autotuner.get_config(key, candidates, config);
+    const int local_size = config.local_size;
+    if (trial) {
+        // Exclude the uploads from the time of the trial.
+        for (auto &event : events_copy) {
+            event.wait();
+        }
+    }
+
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    auto event = this->sycl_target.queue.submit([&](sycl::handler &cgh) {
+        cgh.depends_on(events_copy);
+        if (local_size == 0) {
+            cgh.parallel_for<>(
+                sycl::range<1>(npart_new),
+                [=](sycl::id<1> idx) { lambda_append(idx[0]); });
+        } else {
+            const size_t global_size =
+                ((size_npart_new + local_size - 1) / local_size) * local_size;
+            cgh.parallel_for<>(sycl::nd_range<1>(sycl::range<1>(global_size),
+                                                 sycl::range<1>(local_size)),
+                               [=](sycl::nd_item<1> idx) {
+                                   const int index = idx.get_global_id(0);
+                                   if (index < npart_new) {
+                                       lambda_append(index);
+                                   }
+                               });
+        }
+    });
+    if (trial) {
+        event.wait();
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        this->sycl_target.autotuner.record(
+            key, std::chrono::duration<double>(t1 - t0).count());
     }
+    this->sycl_target.profiler.add_device_event(
+        "ParticleDatT::append_particle_data", event);
+    this->sycl_target.add_compute_event(event);
+    this->append_event = event;
 }
 
 } // namespace PPMD
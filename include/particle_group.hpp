@@ -1,22 +1,45 @@
 #ifndef _PPMD_PARTICLE_GROUP
 #define _PPMD_PARTICLE_GROUP
 
+#include <algorithm>
 #include <cstdint>
 #include <map>
 #include <memory>
 #include <mpi.h>
+#include <numeric>
 #include <string>
+#include <type_traits>
 
 #include "access.hpp"
+#include "cell_counting_sort.hpp"
 #include "compute_target.hpp"
+#include "device_hash_map.hpp"
 #include "domain.hpp"
 #include "particle_dat.hpp"
 #include "particle_set.hpp"
 #include "particle_spec.hpp"
+#include "type_map.hpp"
 #include "typedefs.hpp"
 
 namespace PPMD {
 
+template <typename T>
+using ParticleDatMap = std::map<PPMD::Sym<T>, ParticleDatShPtr<T>>;
+
+/*
+ * The location of a particle, a cell and a layer, packed into one INT as
+ * stored in the global id index of a ParticleGroup.
+ */
+inline PPMD::INT particle_location(const int cell, const int layer) {
+    return (((PPMD::INT)cell) << 32) + layer;
+}
+inline int particle_location_cell(const PPMD::INT location) {
+    return location >> 32;
+}
+inline int particle_location_layer(const PPMD::INT location) {
+    return location & 0xffffffff;
+}
+
 class ParticleGroup {
   private:
     int ncell;
@@ -24,13 +47,89 @@ class ParticleGroup {
     std::vector<PPMD::INT> npart_cell;
     std::vector<PPMD::INT> npart_cell_tmp;
 
+    // Exclusive prefix sum of the cell occupancies and the maximum occupancy.
+    BufferDevice<int> d_cell_offsets;
+    int nrow_max;
+
+    // The order in which cells should be traversed and the exclusive prefix
+    // sum of the cell occupancies taken in that order.
+    std::vector<int> cell_order;
+    BufferDevice<int> d_cell_order;
+    BufferDevice<int> d_order_offsets;
+
+    // Device copies of the root pointers, component counts, element sizes
+    // and layouts of every dat such that a single kernel can operate on all
+    // the dats in the group. The data is moved as bytes such that these
+    // kernels are independent of the element types.
+    int ndat;
+    BufferDevice<char ***> d_dat_ptrs;
+    BufferDevice<int> d_dat_ncomp;
+    BufferDevice<int> d_dat_elem_size;
+    BufferDevice<int> d_dat_tile_shift;
+    BufferDevice<int> d_dat_tile_skip;
+
+    // Temporary space used when removing particles.
+    BufferDevice<PPMD::INT> d_remove_cells;
+    BufferDevice<PPMD::INT> d_remove_layers;
+    BufferDevice<int> d_remove_ranks;
+    BufferDevice<int> d_remove_flags;
+    BufferDevice<int> d_remove_holes;
+    BufferDevice<int> d_remove_sources;
+    BufferDevice<int> d_remove_block_counts;
+    BufferDevice<int> d_remove_offsets;
+    BufferDevice<int> d_npart_cell_new;
+    BufferShared<int> s_remove_counts;
+    // The number of invalid removals and the index of the first, see
+    // count_invalid_removals.
+    BufferDevice<int> d_remove_errors;
+
+    // The cells of appended particles and the counting sort which places
+    // them in layers, computed once per append for all the dats.
+    BufferDevice<PPMD::INT> d_append_cells;
+    CellCountingSort append_sort;
+
+    // Temporary space used when permuting particles within cells.
+    BufferDevice<char> d_permute;
+    BufferDevice<std::size_t> d_permute_offsets;
+
+    // Incremented whenever particles are added, removed or reordered.
+    std::int64_t version;
+
+    // The next global id to be issued, the same on all ranks.
+    PPMD::INT global_id_next;
+    // Device index from global id to particle location, only created by
+    // enable_global_id_index.
+    std::unique_ptr<DeviceHashMap> global_id_map;
+    BufferDevice<int> d_index_layer_start;
+
+    // For each dat, in the order of for_each_particle_dat, the cells paged in
+    // by page_in_cells_temporary.
+    std::vector<std::vector<int>> paged_in_cells;
+
+    inline void push_dat_pointers();
+    inline void push_host_cells(const bool require_resident = true);
+    inline void page_in_cells_temporary(const std::vector<int> &cells);
+    inline void restore_paged_out_cells();
+    inline void update_cell_offsets();
+    inline void upload_removals(const int npart,
+                                std::vector<PPMD::INT> &cells,
+                                std::vector<PPMD::INT> &layers);
+    inline int count_invalid_removals(const int npart, int &first_invalid);
+    inline void remove_particles_device(const int npart);
+    inline PPMD::INT issue_global_ids(const PPMD::INT npart);
+    inline void index_particles(std::vector<int> &layer_start,
+                                const bool assign);
+
   public:
     Domain domain;
     SYCLTarget &sycl_target;
 
-    std::map<PPMD::Sym<REAL>, ParticleDatShPtr<PPMD::REAL>>
-        particle_dats_real{};
-    std::map<PPMD::Sym<INT>, ParticleDatShPtr<PPMD::INT>> particle_dats_int{};
+    // The dats of the group for each element type in ParticleTypes.
+    TypeMap<ParticleDatMap, ParticleTypes> particle_dats;
+    // The dat holding the global id of each particle, only set once global
+    // ids are enabled, see enable_global_ids.
+    ParticleDatShPtr<PPMD::INT> global_id_dat;
+    std::shared_ptr<PPMD::Sym<PPMD::INT>> global_id_sym;
 
     std::shared_ptr<Sym<PPMD::REAL>> position_sym;
     ParticleDatShPtr<PPMD::REAL> position_dat;
@@ -40,14 +139,33 @@ class ParticleGroup {
     ParticleGroup(Domain domain, ParticleSpec &particle_spec,
                   SYCLTarget &sycl_target)
         : domain(domain), sycl_target(sycl_target),
-          ncell(domain.mesh.get_cell_count()) {
+          ncell(domain.mesh.get_cell_count()),
+          d_cell_offsets(sycl_target, domain.mesh.get_cell_count()),
+          d_cell_order(sycl_target, domain.mesh.get_cell_count()),
+          d_order_offsets(sycl_target, domain.mesh.get_cell_count() + 1),
+          ndat(0), d_dat_ptrs(sycl_target, 0), d_dat_ncomp(sycl_target, 0),
+          d_dat_elem_size(sycl_target, 0), d_dat_tile_shift(sycl_target, 0),
+          d_dat_tile_skip(sycl_target, 0), d_remove_cells(sycl_target, 0),
+          d_remove_layers(sycl_target, 0), d_remove_ranks(sycl_target, 0),
+          d_remove_flags(sycl_target, 0), d_remove_holes(sycl_target, 0),
+          d_remove_sources(sycl_target, 0),
+          d_remove_block_counts(sycl_target, 0),
+          d_remove_offsets(sycl_target, domain.mesh.get_cell_count()),
+          d_npart_cell_new(sycl_target, domain.mesh.get_cell_count()),
+          s_remove_counts(sycl_target, domain.mesh.get_cell_count()),
+          d_remove_errors(sycl_target, 2),
+          d_append_cells(sycl_target, 0),
+          append_sort(sycl_target, domain.mesh.get_cell_count()),
+          d_permute(sycl_target, 0), d_permute_offsets(sycl_target, 0),
+          version(0), global_id_next(0),
+          d_index_layer_start(sycl_target, 0) {
 
-        for (auto &property : particle_spec.properties_real) {
-            add_particle_dat(ParticleDat(sycl_target, property, this->ncell));
-        }
-        for (auto &property : particle_spec.properties_int) {
-            add_particle_dat(ParticleDat(sycl_target, property, this->ncell));
-        }
+        particle_spec.properties.for_each([&](auto &properties) {
+            for (auto &property : properties) {
+                this->add_particle_dat(
+                    ParticleDat(sycl_target, property, this->ncell));
+            }
+        });
         this->npart_local = 0;
         this->npart_cell = std::vector<PPMD::INT>(this->ncell);
         this->npart_cell_tmp = std::vector<PPMD::INT>(this->ncell);
@@ -55,89 +173,1008 @@ class ParticleGroup {
             this->npart_cell[cellx] = 0;
             this->npart_cell_tmp[cellx] = 0;
         }
+
+        this->cell_order = std::vector<int>(this->ncell);
+        std::iota(this->cell_order.begin(), this->cell_order.end(), 0);
+        this->d_cell_order.set(this->cell_order);
+        this->update_cell_offsets();
     }
     ~ParticleGroup() {}
 
-    inline void add_particle_dat(ParticleDatShPtr<PPMD::REAL> particle_dat);
-    inline void add_particle_dat(ParticleDatShPtr<PPMD::INT> particle_dat);
+    template <typename T>
+    inline void add_particle_dat(ParticleDatShPtr<T> particle_dat);
 
     inline void add_particles();
-    template <typename U> inline void add_particles(U particle_data);
+    inline void add_particles(ParticleSet &particle_data);
     inline void add_particles_local(ParticleSet &particle_data);
+    inline void remove_particles(const int npart,
+                                 std::vector<PPMD::INT> &cells,
+                                 std::vector<PPMD::INT> &layers);
+    inline void remove_particles(ParticleDatShPtr<PPMD::INT> mask_dat);
+    inline int check_remove_particles(const int npart,
+                                      std::vector<PPMD::INT> &cells,
+                                      std::vector<PPMD::INT> &layers,
+                                      int &first_invalid);
+    inline void permute_layers(const int *d_layer_map);
+
+    inline void set_cell_order(std::vector<int> &cell_order);
+    inline std::vector<int> &get_cell_order() { return this->cell_order; }
+    inline bool all_resident();
+    /*
+     * Device pointer to the order in which cells should be traversed.
+     */
+    inline const int *get_device_cell_order() {
+        return this->d_cell_order.ptr;
+    }
+    /*
+     * Device pointer to the exclusive prefix sum of the cell occupancies
+     * (ncell + 1 entries).
+     */
+    inline const int *get_device_cell_offsets() {
+        return this->d_cell_offsets.ptr;
+    }
+    /*
+     * Device pointer to the exclusive prefix sum of the cell occupancies taken
+     * in the cell traversal order (ncell + 1 entries). Entry i is the number
+     * of particles in the cells that precede position i of the cell order.
+     */
+    inline const int *get_device_order_offsets() {
+        return this->d_order_offsets.ptr;
+    }
+    inline std::vector<PPMD::INT> &get_npart_cell() { return this->npart_cell; }
+    inline int get_nrow_max() { return this->nrow_max; }
 
     inline int get_npart_local() { return this->npart_local; }
+    inline int get_ncell() { return this->ncell; }
+    /*
+     * A counter which is incremented whenever particles are added, removed
+     * or reordered, i.e. whenever the layer of a particle may change.
+     */
+    inline std::int64_t get_version() { return this->version; }
 
-    inline ParticleDatShPtr<PPMD::REAL> &operator[](PPMD::Sym<PPMD::REAL> sym) {
-        return this->particle_dats_real.at(sym);
-    };
-    inline ParticleDatShPtr<PPMD::INT> &operator[](PPMD::Sym<PPMD::INT> sym) {
-        return this->particle_dats_int.at(sym);
+    inline void
+    enable_global_ids(const Sym<PPMD::INT> sym = Sym<PPMD::INT>("GLOBAL_ID"));
+    inline void enable_global_id_index();
+    inline void get_particle_locations(const std::vector<PPMD::INT> &ids,
+                                       std::vector<int> &cells,
+                                       std::vector<int> &layers);
+
+    /*
+     * Device view of the global id index which maps the global id of each
+     * particle on this rank to its location, see particle_location. Valid
+     * until particles are added, removed or reordered.
+     */
+    inline DeviceHashMapView get_global_id_map() {
+        PPMDASSERT(this->global_id_map != nullptr,
+                   "The global id index is not enabled");
+        return this->global_id_map->get_device_view();
+    }
+
+    template <typename T>
+    inline ParticleDatShPtr<T> &operator[](PPMD::Sym<T> sym) {
+        return this->particle_dats.get<T>().at(sym);
     };
+
+    /*
+     * Get the dats of the group with element type T.
+     */
+    template <typename T> inline ParticleDatMap<T> &get_particle_dats() {
+        return this->particle_dats.get<T>();
+    }
+
+    /*
+     * Call f(dat) for every dat in the group. Dats are visited by element
+     * type, in the order of ParticleTypes, then by name, hence the order is
+     * the same on all ranks for groups created from the same ParticleSpec.
+     */
+    template <typename F> inline void for_each_particle_dat(F f) {
+        this->particle_dats.for_each([&](auto &dats) {
+            for (auto &dat : dats) {
+                f(dat.second);
+            }
+        });
+    }
 };
 
-inline void
-ParticleGroup::add_particle_dat(ParticleDatShPtr<PPMD::REAL> particle_dat) {
-    this->particle_dats_real[particle_dat->sym] = particle_dat;
-    // Does this dat hold particle positions?
-    if (particle_dat->positions) {
-        this->position_dat = particle_dat;
-        this->position_sym =
-            std::make_shared<PPMD::Sym<PPMD::REAL>>(particle_dat->sym.name);
+template <typename T>
+inline void ParticleGroup::add_particle_dat(ParticleDatShPtr<T> particle_dat) {
+    this->particle_dats.get<T>()[particle_dat->sym] = particle_dat;
+    // Does this dat hold particle positions or particle cell ids?
+    if constexpr (std::is_same<T, PPMD::REAL>::value) {
+        if (particle_dat->positions) {
+            this->position_dat = particle_dat;
+            this->position_sym =
+                std::make_shared<PPMD::Sym<PPMD::REAL>>(particle_dat->sym.name);
+        }
+    } else if constexpr (std::is_same<T, PPMD::INT>::value) {
+        if (particle_dat->positions) {
+            this->cell_id_dat = particle_dat;
+            this->cell_id_sym =
+                std::make_shared<PPMD::Sym<PPMD::INT>>(particle_dat->sym.name);
+        }
     }
+    this->push_dat_pointers();
 }
-inline void
-ParticleGroup::add_particle_dat(ParticleDatShPtr<PPMD::INT> particle_dat) {
-    this->particle_dats_int[particle_dat->sym] = particle_dat;
-    // Does this dat hold particle cell ids?
-    if (particle_dat->positions) {
-        this->cell_id_dat = particle_dat;
-        this->cell_id_sym =
-            std::make_shared<PPMD::Sym<PPMD::INT>>(particle_dat->sym.name);
+
+/*
+ * Compute the exclusive prefix sum and maximum of the cell occupancies and
+ * copy the prefix sum to the device. The prefix sum has ncell + 1 entries such
+ * that the occupancy of cell c is offsets[c + 1] - offsets[c]. The prefix sum
+ * in the cell traversal order is also computed.
+ */
+inline void ParticleGroup::update_cell_offsets() {
+    this->version++;
+    std::vector<int> cell_offsets(this->ncell + 1);
+    int offset = 0;
+    int nrow_max = 0;
+    for (int cellx = 0; cellx < this->ncell; cellx++) {
+        cell_offsets[cellx] = offset;
+        offset += this->npart_cell[cellx];
+        nrow_max = std::max(nrow_max, (int)this->npart_cell[cellx]);
     }
+    cell_offsets[this->ncell] = offset;
+    this->nrow_max = nrow_max;
+    this->d_cell_offsets.set(cell_offsets);
+
+    offset = 0;
+    for (int ix = 0; ix < this->ncell; ix++) {
+        cell_offsets[ix] = offset;
+        offset += this->npart_cell[this->cell_order[ix]];
+    }
+    cell_offsets[this->ncell] = offset;
+    this->d_order_offsets.set(cell_offsets);
+}
+
+/*
+ * Set the order in which cells should be traversed. The passed order must be
+ * a permutation of the cell indices.
+ */
+inline void ParticleGroup::set_cell_order(std::vector<int> &cell_order) {
+    PPMDASSERT(cell_order.size() == this->ncell, "incorrect number of cells");
+    std::vector<int> cell_count(this->ncell);
+    for (auto &cellx : cell_order) {
+        PPMDASSERT((cellx >= 0) && (cellx < this->ncell), "Bad cell index");
+        PPMDASSERT(cell_count[cellx]++ == 0, "Cell index repeated");
+    }
+    this->cell_order = cell_order;
+    this->d_cell_order.set(this->cell_order);
+    this->update_cell_offsets();
+}
+
+/*
+ * Copy the device root pointers, component counts and element sizes of all
+ * dats in the group to the device.
+ */
+inline void ParticleGroup::push_dat_pointers() {
+    std::vector<char ***> ptrs;
+    std::vector<int> ncomp;
+    std::vector<int> elem_size;
+    std::vector<int> tile_shift;
+    std::vector<int> tile_skip;
+    this->for_each_particle_dat([&](auto &dat) {
+        ptrs.push_back(reinterpret_cast<char ***>(dat->cell_dat.device_ptr()));
+        ncomp.push_back(dat->ncomp);
+        elem_size.push_back(dat->elem_size);
+        tile_shift.push_back(dat->cell_dat.get_tile_shift());
+        tile_skip.push_back(dat->cell_dat.get_tile_skip());
+    });
+    this->ndat = ptrs.size();
+    this->d_dat_ptrs.set(ptrs);
+    this->d_dat_ncomp.set(ncomp);
+    this->d_dat_elem_size.set(elem_size);
+    this->d_dat_tile_shift.set(tile_shift);
+    this->d_dat_tile_skip.set(tile_skip);
+}
+
+/*
+ * Push host mirror modifications of all dats to the device before the dats
+ * are modified on the device, see CellDat::enable_host_mirror. Unless
+ * require_resident is false every cell must be resident on the device.
+ */
+inline void ParticleGroup::push_host_cells(const bool require_resident) {
+    this->for_each_particle_dat([&](auto &dat) {
+        PPMDASSERT((!require_resident) || dat->cell_dat.all_resident(),
+                   "All cells must be resident on the device, see "
+                   "ParticleResidency::page_in_all");
+        dat->cell_dat.push_host_cells();
+    });
+}
+
+/*
+ * True if every cell of every dat is resident on the device, see
+ * CellDat::page_out_cells.
+ */
+inline bool ParticleGroup::all_resident() {
+    bool resident = true;
+    this->for_each_particle_dat([&](auto &dat) {
+        resident = resident && dat->cell_dat.all_resident();
+    });
+    return resident;
+}
+
+/*
+ * Page in the given cells of each dat that are not resident on the device
+ * such that particles can be added to or removed from the cells. The cells
+ * are paged out again by restore_paged_out_cells. Blocks until the copies
+ * are complete.
+ */
+inline void
+ParticleGroup::page_in_cells_temporary(const std::vector<int> &cells) {
+    this->paged_in_cells.clear();
+    EventStack es;
+    this->for_each_particle_dat([&](auto &dat) {
+        std::vector<int> paged_in;
+        for (auto &cellx : cells) {
+            if (!dat->cell_dat.is_resident(cellx)) {
+                paged_in.push_back(cellx);
+            }
+        }
+        dat->cell_dat.page_in_cells_async(paged_in, es);
+        this->paged_in_cells.push_back(paged_in);
+    });
+    es.wait();
+}
+
+/*
+ * Page out the cells paged in by page_in_cells_temporary. The host copies
+ * are updated as the device may have modified the cells.
+ */
+inline void ParticleGroup::restore_paged_out_cells() {
+    int datx = 0;
+    this->for_each_particle_dat([&](auto &dat) {
+        auto &paged_in = this->paged_in_cells[datx++];
+        for (auto &cellx : paged_in) {
+            dat->cell_dat.mark_device_modified(cellx);
+        }
+        dat->cell_dat.page_out_cells(paged_in);
+    });
+    this->paged_in_cells.clear();
 }
 
 inline void ParticleGroup::add_particles(){};
-template <typename U>
-inline void ParticleGroup::add_particles(U particle_data){
 
-};
+/*
+ * Collective. Add particles to the group on each rank. If global ids are
+ * enabled each new particle is given an id that is unique over all ranks,
+ * ids are issued consecutively in rank order.
+ */
+inline void ParticleGroup::add_particles(ParticleSet &particle_data) {
+    if (this->global_id_dat != nullptr) {
+        const PPMD::INT first = this->issue_global_ids(particle_data.npart);
+        auto &ids = particle_data.get(*this->global_id_sym);
+        ids.resize(particle_data.npart);
+        std::iota(ids.begin(), ids.end(), first);
+    }
+    this->add_particles_local(particle_data);
+}
 
-inline void ParticleGroup::add_particles_local(ParticleSet &particle_data) {
-    // loop over the cells of the new particles and allocate more space in the
-    // dats
+/*
+ * Collective. Reserve npart global ids for this rank and return the first.
+ */
+inline PPMD::INT ParticleGroup::issue_global_ids(const PPMD::INT npart) {
+    MPI_Comm comm = this->sycl_target.comm;
+    int rank;
+    MPICHK(MPI_Comm_rank(comm, &rank))
+    PPMD::INT offset = 0;
+    PPMD::INT total = 0;
+    MPICHK(MPI_Exscan(&npart, &offset, 1, MPI_INT64_T, MPI_SUM, comm))
+    MPICHK(MPI_Allreduce(&npart, &total, 1, MPI_INT64_T, MPI_SUM, comm))
+    // The receive buffer of MPI_Exscan is undefined on rank 0.
+    const PPMD::INT first = this->global_id_next + ((rank == 0) ? 0 : offset);
+    this->global_id_next += total;
+    return first;
+}
+
+/*
+ * Collective. Add a dat holding a global id for each particle, ids are
+ * assigned to the existing particles and to particles added with
+ * add_particles. Particles added with add_particles_local must carry their
+ * ids, e.g. when particles move between ranks. An existing INT dat may be
+ * used to hold the ids.
+ */
+inline void ParticleGroup::enable_global_ids(const Sym<PPMD::INT> sym) {
+    PPMDASSERT(this->global_id_dat == nullptr,
+               "Global ids are already enabled");
+    if (this->particle_dats.get<PPMD::INT>().count(sym) == 0) {
+        auto dat = ParticleDat(this->sycl_target, sym, 1, this->ncell);
+        dat->set_npart_cells(this->npart_cell);
+        this->add_particle_dat(dat);
+    }
+    this->global_id_dat = (*this)[sym];
+    this->global_id_sym = std::make_shared<Sym<PPMD::INT>>(sym.name);
+    this->global_id_dat->cell_dat.push_host_cells();
+    this->global_id_dat->cell_dat.mark_device_modified();
+
+    // Number the existing particles in cell index order.
+    const PPMD::INT first = this->issue_global_ids(this->npart_local);
+    const int nrow_max = this->nrow_max;
+    if (nrow_max == 0) {
+        return;
+    }
+    auto d_ids = this->global_id_dat->cell_dat.device_accessor();
+    const int *d_cell_offsets = this->d_cell_offsets.ptr;
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(
+                sycl::range<2>(this->ncell, nrow_max), [=](sycl::id<2> idx) {
+                    const int cellx = idx[0];
+                    const int layerx = idx[1];
+                    const int offset = d_cell_offsets[cellx];
+                    if (layerx < d_cell_offsets[cellx + 1] - offset) {
+                        d_ids[cellx][0][layerx] = first + offset + layerx;
+                    }
+                });
+        })
+        .wait();
+}
+
+/*
+ * Create the device index from global id to particle location. The index is
+ * updated as particles are added, removed and reordered.
+ */
+inline void ParticleGroup::enable_global_id_index() {
+    PPMDASSERT(this->global_id_dat != nullptr, "Global ids are not enabled");
+    this->global_id_map =
+        std::make_unique<DeviceHashMap>(this->sycl_target, this->npart_local);
+    std::vector<int> layer_start(this->ncell, 0);
+    this->index_particles(layer_start, false);
+}
+
+/*
+ * Insert the particles at or above layer_start[cell] in each cell into the
+ * global id index, or if assign is true update the locations of particles
+ * already in the index. If the index would become too full it is rebuilt
+ * from all particles.
+ */
+inline void ParticleGroup::index_particles(std::vector<int> &layer_start,
+                                           const bool assign) {
+    auto &map = *this->global_id_map;
+    std::int64_t nnew = 0;
     for (int cellx = 0; cellx < this->ncell; cellx++) {
-        this->npart_cell_tmp[cellx] = this->npart_cell[cellx];
+        nnew += this->npart_cell[cellx] - layer_start[cellx];
+    }
+    if (!assign) {
+        if (!map.has_capacity(nnew)) {
+            map.reset(this->npart_local);
+            std::fill(layer_start.begin(), layer_start.end(), 0);
+            nnew = this->npart_local;
+        }
+        map.nused += nnew;
+    }
+    const int nrow_max = this->nrow_max;
+    if ((nnew == 0) || (nrow_max == 0)) {
+        return;
     }
+
+    this->d_index_layer_start.set(layer_start);
+    const int *d_layer_start = this->d_index_layer_start.ptr;
+    const int *d_cell_offsets = this->d_cell_offsets.ptr;
+    auto d_ids = this->global_id_dat->cell_dat.device_accessor();
+    const DeviceHashMapView d_map = map.get_device_view();
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(
+                sycl::range<2>(this->ncell, nrow_max), [=](sycl::id<2> idx) {
+                    const int cellx = idx[0];
+                    const int layerx = idx[1];
+                    const int nrow =
+                        d_cell_offsets[cellx + 1] - d_cell_offsets[cellx];
+                    if ((layerx >= d_layer_start[cellx]) && (layerx < nrow)) {
+                        const PPMD::INT id = d_ids[cellx][0][layerx];
+                        const PPMD::INT location =
+                            particle_location(cellx, layerx);
+                        if (assign) {
+                            d_map.assign(id, location);
+                        } else {
+                            d_map.insert(id, location);
+                        }
+                    }
+                });
+        })
+        .wait();
+}
+
+/*
+ * Find the cell and layer of particles on this rank from their global ids.
+ * The cell and layer of particles which are not held by this rank are -1.
+ */
+inline void
+ParticleGroup::get_particle_locations(const std::vector<PPMD::INT> &ids,
+                                      std::vector<int> &cells,
+                                      std::vector<int> &layers) {
+    PPMDASSERT(this->global_id_map != nullptr,
+               "The global id index is not enabled");
+    std::vector<PPMD::INT> locations;
+    this->global_id_map->find(ids, locations);
+    cells.resize(ids.size());
+    layers.resize(ids.size());
+    for (std::size_t px = 0; px < ids.size(); px++) {
+        const bool found = locations[px] >= 0;
+        cells[px] = found ? particle_location_cell(locations[px]) : -1;
+        layers[px] = found ? particle_location_layer(locations[px]) : -1;
+    }
+}
+
+/*
+ * Add particles to the group on this rank. Cells that are paged out, see
+ * ParticleResidency, are paged in for the duration of the call if they gain
+ * particles. If the global id index is enabled the global id dat must be
+ * resident.
+ */
+inline void ParticleGroup::add_particles_local(ParticleSet &particle_data) {
+    this->sycl_target.profiler.start_region(
+        "ParticleGroup::add_particles_local");
+    PPMDASSERT((this->global_id_map == nullptr) ||
+                   this->global_id_dat->cell_dat.all_resident(),
+               "The global id dat must be resident to update the index");
+    this->push_host_cells(false);
     const int npart = particle_data.npart;
     const int npart_new = this->npart_local + npart;
+    PPMDASSERT((this->global_id_dat == nullptr) ||
+                   particle_data.contains(*this->global_id_sym),
+               "Particles added locally must have global ids, see "
+               "add_particles");
+    std::vector<int> layer_start(this->npart_cell.begin(),
+                                 this->npart_cell.end());
     auto cellids = particle_data.get(*this->cell_id_sym);
-    for (int px = 0; px < npart_new; px++) {
-        auto cellindex = cellids[px];
-        PPMDASSERT((cellindex >= 0) && (cellindex < this->ncell),
-                   "Bad particle cellid)");
-        this->npart_cell_tmp[cellindex]++;
+
+    // The cell ids are validated and counted, and the layers of the new
+    // particles computed, on the device. The layers are used for every dat.
+    this->d_append_cells.set(cellids);
+    this->append_sort.compute(npart, this->d_append_cells.ptr, layer_start);
+    this->append_sort.assert_valid();
+    std::vector<int> cells_append;
+    for (int cellx = 0; cellx < this->ncell; cellx++) {
+        this->npart_cell_tmp[cellx] =
+            this->npart_cell[cellx] + this->append_sort.cell_counts[cellx];
+        if (this->append_sort.cell_counts[cellx] > 0) {
+            cells_append.push_back(cellx);
+        }
+    }
+    this->page_in_cells_temporary(cells_append);
+    this->for_each_particle_dat([&](auto &dat) {
+        dat->set_npart_cells(this->npart_cell_tmp);
+        dat->append_particle_data(npart, particle_data.contains(dat->sym),
+                                  this->d_append_cells.ptr,
+                                  this->append_sort.d_layers.ptr,
+                                  particle_data.get(dat->sym));
+    });
+
+    this->npart_local = npart_new;
+    for (int cellx = 0; cellx < this->ncell; cellx++) {
+        this->npart_cell[cellx] = this->npart_cell_tmp[cellx];
     }
+    this->update_cell_offsets();
 
-    for (auto &dat : this->particle_dats_real) {
-        dat.second->realloc(this->npart_cell_tmp);
+    // The append is async
+    this->sycl_target.queue.wait();
+    if (this->global_id_map != nullptr) {
+        this->index_particles(layer_start, false);
+    }
+    this->restore_paged_out_cells();
+    this->sycl_target.profiler.end_region();
+}
 
-        dat.second->append_particle_data(npart,
-                                         particle_data.contains(dat.first),
-                                         cellids, particle_data.get(dat.first));
+/*
+ * Copy the cells and layers of npart particles to remove to the device.
+ */
+inline void ParticleGroup::upload_removals(const int npart,
+                                           std::vector<PPMD::INT> &cells,
+                                           std::vector<PPMD::INT> &layers) {
+    PPMDASSERT(npart <= cells.size(), "incorrect number of cells");
+    PPMDASSERT(npart <= layers.size(), "incorrect number of layers");
+    this->d_remove_cells.realloc_no_copy(npart);
+    this->d_remove_layers.realloc_no_copy(npart);
+    EventStack es;
+    es.push(this->sycl_target.queue_h2d.memcpy(this->d_remove_cells.ptr,
+                                               cells.data(),
+                                               npart * sizeof(PPMD::INT)),
+            this->sycl_target.profiler, "ParticleGroup::remove_particles");
+    es.push(this->sycl_target.queue_h2d.memcpy(this->d_remove_layers.ptr,
+                                               layers.data(),
+                                               npart * sizeof(PPMD::INT)),
+            this->sycl_target.profiler, "ParticleGroup::remove_particles");
+    es.wait();
+}
+
+/*
+ * Validate the npart removals in d_remove_cells and d_remove_layers on the
+ * device. A removal is invalid if its cell is not in [0, ncell), its layer
+ * is not occupied or its (cell, layer) pair appears more than once, in which
+ * case every occurrence is invalid. Returns the number of invalid removals
+ * and sets first_invalid to the index of the first, or -1. The flags of the
+ * occupied layers are counted in d_remove_flags and the result is read with
+ * a single copy to the host.
+ */
+inline int ParticleGroup::count_invalid_removals(const int npart,
+                                                 int &first_invalid) {
+    first_invalid = -1;
+    if (npart == 0) {
+        return 0;
     }
+    this->d_remove_flags.realloc_no_copy(this->npart_local);
+    const int ncell = this->ncell;
+    const PPMD::INT *d_remove_cells = this->d_remove_cells.ptr;
+    const PPMD::INT *d_remove_layers = this->d_remove_layers.ptr;
+    int *d_remove_flags = this->d_remove_flags.ptr;
+    int *d_remove_errors = this->d_remove_errors.ptr;
+    const int *d_cell_offsets = this->d_cell_offsets.ptr;
+    auto lambda_valid = [=](const PPMD::INT cellx, const PPMD::INT layerx) {
+        return (cellx >= 0) && (cellx < ncell) && (layerx >= 0) &&
+               (layerx < d_cell_offsets[cellx + 1] - d_cell_offsets[cellx]);
+    };
 
-    for (auto &dat : this->particle_dats_int) {
-        dat.second->realloc(this->npart_cell_tmp);
+    auto &queue = this->sycl_target.queue;
+    const int errors_init[2] = {0, npart};
+    queue.fill(d_remove_flags, 0, this->npart_local);
+    queue.memcpy(d_remove_errors, errors_init, 2 * sizeof(int));
+    queue.wait();
+    queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(sycl::range<1>(npart), [=](sycl::id<1> idx) {
+                const PPMD::INT cellx = d_remove_cells[idx];
+                const PPMD::INT layerx = d_remove_layers[idx];
+                if (lambda_valid(cellx, layerx)) {
+                    atomic_fetch_add(
+                        &d_remove_flags[d_cell_offsets[cellx] + layerx], 1);
+                }
+            });
+        })
+        .wait();
+    queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(sycl::range<1>(npart), [=](sycl::id<1> idx) {
+                const int px = idx[0];
+                const PPMD::INT cellx = d_remove_cells[px];
+                const PPMD::INT layerx = d_remove_layers[px];
+                if (lambda_valid(cellx, layerx) &&
+                    (d_remove_flags[d_cell_offsets[cellx] + layerx] == 1)) {
+                    return;
+                }
+                atomic_fetch_add(&d_remove_errors[0], 1);
+                int first = d_remove_errors[1];
+                while ((px < first) &&
+                       !atomic_compare_exchange(&d_remove_errors[1], first,
+                                                px)) {
+                }
+            });
+        })
+        .wait();
+    int errors[2];
+    queue.memcpy(errors, d_remove_errors, 2 * sizeof(int)).wait();
+    first_invalid = (errors[0] > 0) ? errors[1] : -1;
+    return errors[0];
+}
 
-        dat.second->append_particle_data(npart,
-                                         particle_data.contains(dat.first),
-                                         cellids, particle_data.get(dat.first));
+/*
+ * Check npart particles to remove, described by their cell and layer as for
+ * remove_particles, without removing them. Returns the number of removals
+ * with a cell out of range, an unoccupied layer or a (cell, layer) pair that
+ * appears more than once, and sets first_invalid to the index of the first
+ * such removal, or -1.
+ */
+inline int ParticleGroup::check_remove_particles(
+    const int npart, std::vector<PPMD::INT> &cells,
+    std::vector<PPMD::INT> &layers, int &first_invalid) {
+    this->upload_removals(npart, cells, layers);
+    return this->count_invalid_removals(npart, first_invalid);
+}
+
+/*
+ * Remove particles from the group. The particles to remove are described by
+ * their cell and layer, each (cell, layer) pair must appear at most once and
+ * refer to an occupied layer. The pairs are validated on the device before
+ * any particle is moved, see check_remove_particles, and invalid pairs
+ * abort. Particles in the tail of each cell are moved into the holes left by
+ * removed particles in a single pass over all dats in the group. Cells that
+ * are paged out, see ParticleResidency, are paged in for the duration of the
+ * call if they lose particles.
+ */
+inline void ParticleGroup::remove_particles(const int npart,
+                                            std::vector<PPMD::INT> &cells,
+                                            std::vector<PPMD::INT> &layers) {
+    PPMDASSERT(npart <= this->npart_local,
+               "cannot remove more particles than exist");
+    if (npart == 0) {
+        return;
     }
 
-    this->npart_local = npart_new;
+    this->upload_removals(npart, cells, layers);
+    int first_invalid;
+    const int ninvalid = this->count_invalid_removals(npart, first_invalid);
+    if (ninvalid > 0) {
+        const std::string msg =
+            std::to_string(ninvalid) +
+            " removals have a cell or layer out of range or are repeated, "
+            "the first is removal " +
+            std::to_string(first_invalid) + ".";
+        PPMDASSERT(ninvalid == 0, msg.c_str());
+    }
 
-    // The append is async
+    std::vector<int> cells_remove(cells.begin(), cells.begin() + npart);
+    std::sort(cells_remove.begin(), cells_remove.end());
+    cells_remove.erase(std::unique(cells_remove.begin(), cells_remove.end()),
+                       cells_remove.end());
+    this->push_host_cells(false);
+    this->page_in_cells_temporary(cells_remove);
+    this->remove_particles_device(npart);
+    this->restore_paged_out_cells();
+}
+
+/*
+ * Remove all particles for which the first component of the passed INT dat,
+ * which must be a dat of this group, is non-zero. The selection is made on
+ * the device.
+ */
+inline void
+ParticleGroup::remove_particles(ParticleDatShPtr<PPMD::INT> mask_dat) {
+    auto &dats = this->particle_dats.get<PPMD::INT>();
+    PPMDASSERT((dats.count(mask_dat->sym) > 0) &&
+                   (dats.at(mask_dat->sym) == mask_dat),
+               "mask dat is not a dat of this ParticleGroup");
+
+    const int nrow_max = this->nrow_max;
+    if (nrow_max == 0) {
+        return;
+    }
+    this->push_host_cells();
+
+    this->d_remove_cells.realloc_no_copy(this->npart_local);
+    this->d_remove_layers.realloc_no_copy(this->npart_local);
+    this->s_remove_counts[0] = 0;
+
+    const int *d_cell_offsets = this->d_cell_offsets.ptr;
+    auto d_mask = mask_dat->cell_dat.device_accessor();
+    PPMD::INT *d_remove_cells = this->d_remove_cells.ptr;
+    PPMD::INT *d_remove_layers = this->d_remove_layers.ptr;
+    int *s_remove_count = this->s_remove_counts.ptr;
+
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(
+                sycl::range<2>(this->ncell, nrow_max), [=](sycl::id<2> idx) {
+                    const int cellx = idx[0];
+                    const int layerx = idx[1];
+                    if ((layerx < d_cell_offsets[cellx + 1] -
+                                      d_cell_offsets[cellx]) &&
+                        (d_mask[cellx][0][layerx] != 0)) {
+                        const int index = atomic_fetch_add(s_remove_count, 1);
+                        d_remove_cells[index] = cellx;
+                        d_remove_layers[index] = layerx;
+                    }
+                });
+        })
+        .wait();
+
+    this->remove_particles_device(this->s_remove_counts[0]);
+}
+
+/*
+ * Remove the npart particles described by d_remove_cells and d_remove_layers.
+ * Holes below the new occupancy of each cell are paired with the surviving
+ * particles above it and all dats are compressed by one kernel. The holes and
+ * the surviving particles are each taken in increasing layer order, hence the
+ * resulting layers depend only on the set of removed particles and not on
+ * the order of the removals or of the device execution.
+ */
+inline void ParticleGroup::remove_particles_device(const int npart) {
+    if (npart == 0) {
+        return;
+    }
+    this->sycl_target.profiler.start_region("ParticleGroup::remove_particles");
+
+    const int ncell = this->ncell;
+    this->d_remove_ranks.realloc_no_copy(npart);
+    this->d_remove_flags.realloc_no_copy(this->npart_local);
+    this->d_remove_holes.realloc_no_copy(npart);
+    this->d_remove_sources.realloc_no_copy(npart);
+    this->s_remove_counts.realloc_no_copy(3 * ncell);
+
+    const PPMD::INT *d_remove_cells = this->d_remove_cells.ptr;
+    const PPMD::INT *d_remove_layers = this->d_remove_layers.ptr;
+    int *d_remove_ranks = this->d_remove_ranks.ptr;
+    int *d_remove_flags = this->d_remove_flags.ptr;
+    int *d_remove_holes = this->d_remove_holes.ptr;
+    int *d_remove_sources = this->d_remove_sources.ptr;
+    const int *d_cell_offsets = this->d_cell_offsets.ptr;
+    // per cell: number of particles removed, holes found, sources found
+    int *s_remove_counts = this->s_remove_counts.ptr;
+    int *s_hole_counts = s_remove_counts + ncell;
+    int *s_source_counts = s_remove_counts + 2 * ncell;
+
+    this->sycl_target.queue.fill(s_remove_counts, 0, 3 * ncell);
+    this->sycl_target.queue.fill(d_remove_flags, 0, this->npart_local);
     this->sycl_target.queue.wait();
+
+    // Count the removals in each cell and flag the removed particles. The
+    // rank of a removal within its cell only selects which work item moves
+    // which hole and source pair in the compress kernel.
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(sycl::range<1>(npart), [=](sycl::id<1> idx) {
+                const int cellx = d_remove_cells[idx];
+                const int layerx = d_remove_layers[idx];
+                d_remove_ranks[idx] =
+                    atomic_fetch_add(&s_remove_counts[cellx], 1);
+                d_remove_flags[d_cell_offsets[cellx] + layerx] = 1;
+            });
+        })
+        .wait();
+
+    std::vector<int> remove_offsets(ncell);
+    std::vector<int> npart_cell_new(ncell);
+    int offset = 0;
+    for (int cellx = 0; cellx < ncell; cellx++) {
+        remove_offsets[cellx] = offset;
+        offset += s_remove_counts[cellx];
+        npart_cell_new[cellx] =
+            this->npart_cell[cellx] - s_remove_counts[cellx];
+    }
+    this->d_remove_offsets.set(remove_offsets);
+    this->d_npart_cell_new.set(npart_cell_new);
+    const int *d_remove_offsets = this->d_remove_offsets.ptr;
+    const int *d_npart_cell_new = this->d_npart_cell_new.ptr;
+
+    // Collect the holes below the new occupancy and the surviving particles
+    // in the tail of each cell, in increasing layer order. These two sets
+    // have the same size in each cell. The layers of each cell are split into
+    // blocks that count their holes and sources, the counts are scanned over
+    // the blocks of each cell, then each block writes its holes and sources.
+    const int block_size = 256;
+    const int nblock = (this->nrow_max + block_size - 1) / block_size;
+    this->d_remove_block_counts.realloc_no_copy(2 * ((size_t)ncell) * nblock);
+    int *d_block_counts = this->d_remove_block_counts.ptr;
+    auto lambda_block = [=](const int cellx, const int blockx, int *holes,
+                            int *sources, int &nhole, int &nsource) {
+        const int cell_offset = d_cell_offsets[cellx];
+        const int nrow = d_cell_offsets[cellx + 1] - cell_offset;
+        const int npart_new = d_npart_cell_new[cellx];
+        const int start = blockx * block_size;
+        const int end = (nrow - start < block_size) ? nrow : start + block_size;
+        for (int layerx = start; layerx < end; layerx++) {
+            const bool removed = d_remove_flags[cell_offset + layerx] != 0;
+            if ((layerx < npart_new) && removed) {
+                if (holes != nullptr) {
+                    holes[nhole] = layerx;
+                }
+                nhole++;
+            } else if ((layerx >= npart_new) && !removed) {
+                if (sources != nullptr) {
+                    sources[nsource] = layerx;
+                }
+                nsource++;
+            }
+        }
+    };
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(
+                sycl::range<2>(ncell, nblock), [=](sycl::id<2> idx) {
+                    const int cellx = idx[0];
+                    const int blockx = idx[1];
+                    int nhole = 0;
+                    int nsource = 0;
+                    lambda_block(cellx, blockx, nullptr, nullptr, nhole,
+                                 nsource);
+                    int *counts = d_block_counts + 2 * (cellx * nblock);
+                    counts[2 * blockx] = nhole;
+                    counts[2 * blockx + 1] = nsource;
+                });
+        })
+        .wait();
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(sycl::range<1>(ncell), [=](sycl::id<1> idx) {
+                const int cellx = idx[0];
+                int *counts = d_block_counts + 2 * (cellx * nblock);
+                int nhole = 0;
+                int nsource = 0;
+                for (int blockx = 0; blockx < nblock; blockx++) {
+                    const int nhole_block = counts[2 * blockx];
+                    const int nsource_block = counts[2 * blockx + 1];
+                    counts[2 * blockx] = nhole;
+                    counts[2 * blockx + 1] = nsource;
+                    nhole += nhole_block;
+                    nsource += nsource_block;
+                }
+                s_hole_counts[cellx] = nhole;
+                s_source_counts[cellx] = nsource;
+            });
+        })
+        .wait();
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(
+                sycl::range<2>(ncell, nblock), [=](sycl::id<2> idx) {
+                    const int cellx = idx[0];
+                    const int blockx = idx[1];
+                    const int *counts = d_block_counts + 2 * (cellx * nblock);
+                    const int offset = d_remove_offsets[cellx];
+                    int nhole = 0;
+                    int nsource = 0;
+                    lambda_block(
+                        cellx, blockx,
+                        d_remove_holes + offset + counts[2 * blockx],
+                        d_remove_sources + offset + counts[2 * blockx + 1],
+                        nhole, nsource);
+                });
+        })
+        .wait();
+
+    // Remove the particles from the global id index, the particles that move
+    // into the holes are updated by the compress kernel.
+    const bool index = (this->global_id_map != nullptr);
+    const DeviceHashMapView d_map =
+        index ? this->global_id_map->get_device_view() : DeviceHashMapView{};
+    const auto d_ids = index ? this->global_id_dat->cell_dat.device_accessor()
+                             : CellDatDeviceAccessor<PPMD::INT>(nullptr, 0, 0);
+    if (index) {
+        this->sycl_target.queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(sycl::range<1>(npart), [=](sycl::id<1> idx) {
+                    const int cellx = d_remove_cells[idx];
+                    const int layerx = d_remove_layers[idx];
+                    d_map.erase(d_ids[cellx][0][layerx]);
+                });
+            })
+            .wait();
+    }
+
+    // Move the surviving tail particles into the holes for all dats.
+    const int ndat = this->ndat;
+    char ****d_dat_ptrs = this->d_dat_ptrs.ptr;
+    const int *d_dat_ncomp = this->d_dat_ncomp.ptr;
+    const int *d_dat_elem_size = this->d_dat_elem_size.ptr;
+    const int *d_dat_tile_shift = this->d_dat_tile_shift.ptr;
+    const int *d_dat_tile_skip = this->d_dat_tile_skip.ptr;
+
+    sycl::queue &queue = this->sycl_target.queue;
+    auto event_compress = queue.submit([&](sycl::handler &cgh) {
+        cgh.parallel_for<>(sycl::range<1>(npart), [=](sycl::id<1> idx) {
+            const int cellx = d_remove_cells[idx];
+            const int rankx = d_remove_ranks[idx];
+            if (rankx < s_hole_counts[cellx]) {
+                const int offset = d_remove_offsets[cellx];
+                const int dst = d_remove_holes[offset + rankx];
+                const int src = d_remove_sources[offset + rankx];
+                for (int datx = 0; datx < ndat; datx++) {
+                    char **cell_ptr = d_dat_ptrs[datx][cellx];
+                    const int size = d_dat_elem_size[datx];
+                    const int shift = d_dat_tile_shift[datx];
+                    const int skip = d_dat_tile_skip[datx];
+                    const int dst_offset =
+                        tiled_row_index(dst, shift, skip) * size;
+                    const int src_offset =
+                        tiled_row_index(src, shift, skip) * size;
+                    for (int cx = 0; cx < d_dat_ncomp[datx]; cx++) {
+                        copy_element(cell_ptr[cx] + dst_offset,
+                                     cell_ptr[cx] + src_offset, size);
+                    }
+                }
+                if (index) {
+                    d_map.assign(d_ids[cellx][0][dst],
+                                 particle_location(cellx, dst));
+                }
+            }
+        });
+    });
+    this->sycl_target.profiler.add_device_event(
+        "ParticleGroup::remove_particles", event_compress);
+    event_compress.wait();
+
+    // Update the occupancies on the host and in the dats.
+    for (int cellx = 0; cellx < ncell; cellx++) {
+        this->npart_cell[cellx] = npart_cell_new[cellx];
+    }
+    this->for_each_particle_dat(
+        [&](auto &dat) { dat->set_npart_cells(this->npart_cell); });
+    this->npart_local -= npart;
+    this->update_cell_offsets();
+    this->sycl_target.profiler.end_region();
+}
+
+/*
+ * Reorder the particles within each cell. The new layer of the particle in
+ * cell c and layer l is d_layer_map[o_c + l] where o_c is the cell offset
+ * given by get_device_cell_offsets. The map must be a permutation of the
+ * layers within each cell. All dats are gathered into temporary space and
+ * scattered back with one kernel for each direction.
+ */
+inline void ParticleGroup::permute_layers(const int *d_layer_map) {
+    const int nrow_max = this->nrow_max;
+    const int npart_local = this->npart_local;
+    if (nrow_max == 0) {
+        return;
+    }
+    this->sycl_target.profiler.start_region("ParticleGroup::permute_layers");
+    this->push_host_cells();
+
+    // The temporary space holds each component of each dat as a column of
+    // npart_local elements. Columns start on 8 byte boundaries.
+    std::vector<std::size_t> permute_offsets;
+    std::size_t permute_size = 0;
+    this->for_each_particle_dat([&](auto &dat) {
+        permute_offsets.push_back(permute_size);
+        const std::size_t stride =
+            ((npart_local * dat->elem_size + 7) / 8) * 8;
+        permute_size += stride * dat->ncomp;
+    });
+    this->d_permute.realloc_no_copy(permute_size);
+    this->d_permute_offsets.set(permute_offsets);
+
+    const int ndat = this->ndat;
+    char ****d_dat_ptrs = this->d_dat_ptrs.ptr;
+    const int *d_dat_ncomp = this->d_dat_ncomp.ptr;
+    const int *d_dat_elem_size = this->d_dat_elem_size.ptr;
+    const int *d_dat_tile_shift = this->d_dat_tile_shift.ptr;
+    const int *d_dat_tile_skip = this->d_dat_tile_skip.ptr;
+    char *d_permute = this->d_permute.ptr;
+    const std::size_t *d_permute_offsets = this->d_permute_offsets.ptr;
+    const int *d_cell_offsets = this->d_cell_offsets.ptr;
+
+    // Copy between particle (cell, layer) and the particle at index in the
+    // temporary space for all dats.
+    auto lambda_copy = [=](const int cellx, const int layerx,
+                           const std::size_t index, const bool gather) {
+        for (int datx = 0; datx < ndat; datx++) {
+            char **cell_ptr = d_dat_ptrs[datx][cellx];
+            const std::size_t size = d_dat_elem_size[datx];
+            const std::size_t stride = ((npart_local * size + 7) / 8) * 8;
+            char *column = d_permute + d_permute_offsets[datx] + index * size;
+            const std::size_t offset =
+                tiled_row_index(layerx, d_dat_tile_shift[datx],
+                                d_dat_tile_skip[datx]) *
+                size;
+            for (int cx = 0; cx < d_dat_ncomp[datx]; cx++) {
+                char *element = cell_ptr[cx] + offset;
+                if (gather) {
+                    copy_element(column + cx * stride, element, size);
+                } else {
+                    copy_element(element, column + cx * stride, size);
+                }
+            }
+        }
+    };
+
+    // gather into the temporary space in the new order
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(
+                sycl::range<2>(this->ncell, nrow_max), [=](sycl::id<2> idx) {
+                    const int cellx = idx[0];
+                    const int layerx = idx[1];
+                    const int offset = d_cell_offsets[cellx];
+                    if (layerx < d_cell_offsets[cellx + 1] - offset) {
+                        lambda_copy(cellx, layerx,
+                                    offset + d_layer_map[offset + layerx],
+                                    true);
+                    }
+                });
+        })
+        .wait();
+
+    // scatter back into the dats
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(
+                sycl::range<2>(this->ncell, nrow_max), [=](sycl::id<2> idx) {
+                    const int cellx = idx[0];
+                    const int layerx = idx[1];
+                    const int offset = d_cell_offsets[cellx];
+                    if (layerx < d_cell_offsets[cellx + 1] - offset) {
+                        lambda_copy(cellx, layerx, offset + layerx, false);
+                    }
+                });
+        })
+        .wait();
+    this->for_each_particle_dat(
+        [&](auto &dat) { dat->cell_dat.mark_device_modified(); });
+    this->version++;
+    if (this->global_id_map != nullptr) {
+        std::vector<int> layer_start(this->ncell, 0);
+        this->index_particles(layer_start, true);
+    }
+    this->sycl_target.profiler.end_region();
 }
 
 } // namespace PPMD
@@ -0,0 +1,697 @@
+#ifndef _PPMD_PARTICLE_HALO
+#define _PPMD_PARTICLE_HALO
+
+#include <CL/sycl.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mpi.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "communication.hpp"
+#include "compute_target.hpp"
+#include "load_balance.hpp"
+#include "mesh_hierarchy.hpp"
+#include "particle_dat.hpp"
+#include "particle_group.hpp"
+#include "particle_species.hpp"
+#include "type_map.hpp"
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * Copies of the particles of neighbouring ranks that lie in the stencil of
+ * the cells owned by this rank. The halo holds a ParticleDat for each dat
+ * added with add_dat, the position dat is always held, with the same cells
+ * as the ParticleGroup, i.e. all the coarse cells of the MeshHierarchy in
+ * linear index order. Halo particles are stored in the cells they occupy on
+ * their owning rank. Cells owned by this rank are empty in the halo and
+ * cells owned by other ranks are empty in the ParticleGroup, hence a pair
+ * loop over the stencil of an owned cell may read the neighbour cells from
+ * both the ParticleGroup and the halo.
+ *
+ * exchange builds the exchange plan, the cells and particles sent to and
+ * received from each neighbouring rank, from the current ownership and
+ * occupancy and exchanges all the halo dats. exchange_positions reuses the
+ * plan and message sizes of the last exchange and only exchanges the
+ * positions. It is valid while the particles in the owned cells are not
+ * added, removed or reordered, e.g. between calls to
+ * LoadBalance::migrate and ParticleGroup::remove_particles. The halos of the
+ * species of a ParticleSpeciesGroup are exchanged together by
+ * ParticleSpeciesHalo.
+ */
+class ParticleHalo {
+  private:
+    static constexpr int tag_counts = 4201;
+    static constexpr int tag_data = 4202;
+
+    LoadBalance &load_balance;
+    ParticleGroup &particle_group;
+    const int ncell;
+
+    // The owners used to compute the cells exchanged with each rank.
+    std::vector<int> plan_cell_owners;
+    // The version of the ParticleGroup when the layers were planned.
+    std::int64_t plan_version;
+    // Neighbouring ranks and the cells sent to and received from each,
+    // indexed by position in neighbour_ranks.
+    std::vector<int> neighbour_ranks;
+    std::vector<std::vector<int>> send_cells;
+    std::vector<std::vector<int>> recv_cells;
+    // Particle counts of the cells sent by the last exchange, in send order,
+    // and the position of the counts of each neighbouring rank.
+    std::vector<int> send_cell_counts;
+    std::vector<int> recv_cell_counts;
+    std::vector<int> send_cell_displs;
+    std::vector<int> recv_cell_displs;
+    // Particles sent to and received from each neighbouring rank.
+    std::vector<int> send_counts;
+    std::vector<int> recv_counts;
+    int npart_send;
+    int npart_recv;
+    bool planned;
+
+    // Bytes of the halo dats of one particle and the offset of each dat in
+    // these bytes, in the order of for_each_dat.
+    int particle_bytes;
+    std::vector<int> dat_offsets;
+
+    // The source location of each sent particle and the halo location of
+    // each received particle, ordered by neighbouring rank.
+    BufferDevice<int> d_send_cells;
+    BufferDevice<int> d_send_layers;
+    BufferDevice<int> d_recv_cells;
+    BufferDevice<int> d_recv_layers;
+    BufferDevice<char> d_send_buffer;
+    BufferDevice<char> d_recv_buffer;
+    std::vector<char> h_send_buffer;
+    std::vector<char> h_recv_buffer;
+
+    std::vector<PPMD::INT> npart_cell;
+    std::vector<int> halo_cells;
+
+    inline void plan_cells();
+    inline void count_cells();
+    inline void plan_layers();
+    inline void check_plan();
+    template <typename T>
+    inline void pack_dat(ParticleDatShPtr<T> &dat, const int record_bytes,
+                         const int offset);
+    template <typename T>
+    inline void unpack_dat(ParticleDatShPtr<T> &dat, const int record_bytes,
+                           const int offset);
+
+    // The steps of an exchange are made for a set of halos that share a
+    // LoadBalance, the messages to each neighbouring rank hold the data of
+    // every halo in turn such that there is one communication round.
+    static inline void
+    plan_particles(const std::vector<ParticleHalo *> &halos);
+    static inline void
+    exchange_buffers(const std::vector<ParticleHalo *> &halos,
+                     const std::vector<int> &record_bytes);
+    static inline void exchange(const std::vector<ParticleHalo *> &halos);
+    static inline void
+    exchange_positions(const std::vector<ParticleHalo *> &halos);
+
+    friend class ParticleSpeciesHalo;
+
+  public:
+    SYCLTarget &sycl_target;
+    MPI_Comm comm;
+    // The halo dats for each element type in ParticleTypes.
+    TypeMap<ParticleDatMap, ParticleTypes> halo_dats;
+    ParticleDatShPtr<PPMD::REAL> position_dat;
+
+    ParticleHalo(LoadBalance &load_balance, ParticleGroup &particle_group)
+        : load_balance(load_balance), particle_group(particle_group),
+          ncell(particle_group.get_ncell()), plan_version(0), npart_send(0),
+          npart_recv(0), planned(false), particle_bytes(0),
+          d_send_cells(particle_group.sycl_target, 0),
+          d_send_layers(particle_group.sycl_target, 0),
+          d_recv_cells(particle_group.sycl_target, 0),
+          d_recv_layers(particle_group.sycl_target, 0),
+          d_send_buffer(particle_group.sycl_target, 0),
+          d_recv_buffer(particle_group.sycl_target, 0),
+          sycl_target(particle_group.sycl_target), comm(load_balance.comm) {
+        PPMDASSERT(this->ncell == load_balance.ncells,
+                   "ParticleGroup cells are not the coarse mesh cells");
+        PPMDASSERT(particle_group.position_dat != nullptr,
+                   "ParticleGroup has no position dat");
+        this->npart_cell = std::vector<PPMD::INT>(this->ncell);
+        this->add_dat(*particle_group.position_sym);
+        this->position_dat =
+            this->halo_dats.get<PPMD::REAL>().at(*particle_group.position_sym);
+    }
+
+    /*
+     * Hold halo copies of a dat of the ParticleGroup. Must be called with
+     * the same dats on all ranks. The halo is populated by the next call to
+     * exchange.
+     */
+    template <typename T> inline void add_dat(const Sym<T> sym) {
+        auto &dats = this->halo_dats.get<T>();
+        if (dats.count(sym) > 0) {
+            return;
+        }
+        auto &dat = this->particle_group[sym];
+        dats[sym] = ParticleDat(this->sycl_target, sym, dat->ncomp,
+                                this->ncell, dat->positions,
+                                dat->cell_dat.layout);
+        dats[sym]->set_npart_cells(this->npart_cell);
+        this->planned = false;
+    }
+
+    template <typename T>
+    inline ParticleDatShPtr<T> &operator[](PPMD::Sym<T> sym) {
+        return this->halo_dats.get<T>().at(sym);
+    };
+
+    /*
+     * Call f(dat) for every halo dat in the order of
+     * ParticleGroup::for_each_particle_dat.
+     */
+    template <typename F> inline void for_each_dat(F f) {
+        this->halo_dats.for_each([&](auto &dats) {
+            for (auto &dat : dats) {
+                f(dat.second);
+            }
+        });
+    }
+
+    /*
+     * Number of halo particles in each cell.
+     */
+    inline std::vector<PPMD::INT> &get_npart_cell() { return this->npart_cell; }
+    inline int get_npart_halo() { return this->npart_recv; }
+    /*
+     * Cells, owned by other ranks, which hold halo particles after an
+     * exchange, in increasing order.
+     */
+    inline std::vector<int> &get_halo_cells() { return this->halo_cells; }
+    /*
+     * Ranks that particles are exchanged with.
+     */
+    inline std::vector<int> &get_neighbour_ranks() {
+        return this->neighbour_ranks;
+    }
+
+    inline void exchange();
+    inline void exchange_positions();
+};
+
+/*
+ * Determine the cells sent to and received from each neighbouring rank.
+ */
+inline void ParticleHalo::plan_cells() {
+    HaloCells halo = this->load_balance.get_halo_cells();
+    this->neighbour_ranks = halo.ranks;
+    this->send_cells = halo.send_cells;
+    this->recv_cells = halo.recv_cells;
+
+    this->halo_cells.clear();
+    std::set<int> halo_set;
+    for (auto &cells : this->recv_cells) {
+        halo_set.insert(cells.begin(), cells.end());
+    }
+    this->halo_cells.assign(halo_set.begin(), halo_set.end());
+    this->plan_cell_owners = this->load_balance.cell_owners;
+}
+
+/*
+ * Collect the occupancies of the sent cells and size the space for the
+ * occupancies of the received cells.
+ */
+inline void ParticleHalo::count_cells() {
+    auto &npart_cell_group = this->particle_group.get_npart_cell();
+    const int nneighbours = this->neighbour_ranks.size();
+
+    this->send_cell_counts.clear();
+    this->send_cell_displs.resize(nneighbours);
+    this->recv_cell_displs.resize(nneighbours);
+    int nrecv_cells = 0;
+    for (int nx = 0; nx < nneighbours; nx++) {
+        this->send_cell_displs[nx] = this->send_cell_counts.size();
+        for (auto &cellx : this->send_cells[nx]) {
+            this->send_cell_counts.push_back(npart_cell_group[cellx]);
+        }
+        this->recv_cell_displs[nx] = nrecv_cells;
+        nrecv_cells += this->recv_cells[nx].size();
+    }
+    this->recv_cell_counts.resize(nrecv_cells);
+}
+
+/*
+ * Exchange the occupancies of the sent cells of a set of halos, then size
+ * the halo cells and build the per particle source and destination
+ * locations of each halo. The halos share a LoadBalance and have planned
+ * their cells, hence they exchange the same cells with the same ranks.
+ */
+inline void
+ParticleHalo::plan_particles(const std::vector<ParticleHalo *> &halos) {
+    auto &halo_first = *halos[0];
+    const int nneighbours = halo_first.neighbour_ranks.size();
+    for (auto &halo : halos) {
+        halo->count_cells();
+    }
+
+    std::vector<int> send_counts_all;
+    std::vector<int> send_displs_all(nneighbours);
+    std::vector<int> recv_displs_all(nneighbours);
+    int nrecv_all = 0;
+    for (int nx = 0; nx < nneighbours; nx++) {
+        send_displs_all[nx] = send_counts_all.size();
+        for (auto &halo : halos) {
+            auto start = halo->send_cell_counts.begin() +
+                         halo->send_cell_displs[nx];
+            send_counts_all.insert(send_counts_all.end(), start,
+                                   start + halo->send_cells[nx].size());
+        }
+        recv_displs_all[nx] = nrecv_all;
+        nrecv_all += halos.size() * halo_first.recv_cells[nx].size();
+    }
+    std::vector<int> recv_counts_all(nrecv_all);
+
+    std::vector<MPI_Request> requests(2 * nneighbours);
+    for (int nx = 0; nx < nneighbours; nx++) {
+        MPICHK(MPI_Irecv(recv_counts_all.data() + recv_displs_all[nx],
+                         halos.size() * halo_first.recv_cells[nx].size(),
+                         MPI_INT, halo_first.neighbour_ranks[nx], tag_counts,
+                         halo_first.comm, &requests[nx]))
+    }
+    for (int nx = 0; nx < nneighbours; nx++) {
+        MPICHK(MPI_Isend(send_counts_all.data() + send_displs_all[nx],
+                         halos.size() * halo_first.send_cells[nx].size(),
+                         MPI_INT, halo_first.neighbour_ranks[nx], tag_counts,
+                         halo_first.comm, &requests[nneighbours + nx]))
+    }
+    MPICHK(MPI_Waitall(2 * nneighbours, requests.data(), MPI_STATUSES_IGNORE))
+
+    for (int nx = 0; nx < nneighbours; nx++) {
+        int index = recv_displs_all[nx];
+        for (auto &halo : halos) {
+            const int ncells = halo->recv_cells[nx].size();
+            std::copy(recv_counts_all.begin() + index,
+                      recv_counts_all.begin() + index + ncells,
+                      halo->recv_cell_counts.begin() +
+                          halo->recv_cell_displs[nx]);
+            index += ncells;
+        }
+    }
+    for (auto &halo : halos) {
+        halo->plan_layers();
+    }
+}
+
+/*
+ * Size the halo cells from the received occupancies and build the per
+ * particle source and destination locations.
+ */
+inline void ParticleHalo::plan_layers() {
+    const int nneighbours = this->neighbour_ranks.size();
+    std::vector<int> send_cells_flat;
+    std::vector<int> send_layers_flat;
+    std::vector<int> recv_cells_flat;
+    std::vector<int> recv_layers_flat;
+    std::fill(this->npart_cell.begin(), this->npart_cell.end(), 0);
+    this->plan_version = this->particle_group.get_version();
+    this->send_counts.assign(nneighbours, 0);
+    this->recv_counts.assign(nneighbours, 0);
+    for (int nx = 0; nx < nneighbours; nx++) {
+        int index = this->send_cell_displs[nx];
+        for (auto &cellx : this->send_cells[nx]) {
+            const int nrow = this->send_cell_counts[index++];
+            for (int layerx = 0; layerx < nrow; layerx++) {
+                send_cells_flat.push_back(cellx);
+                send_layers_flat.push_back(layerx);
+            }
+            this->send_counts[nx] += nrow;
+        }
+        index = this->recv_cell_displs[nx];
+        for (auto &cellx : this->recv_cells[nx]) {
+            // A cell may be received from only one rank, its owner.
+            const int nrow = this->recv_cell_counts[index++];
+            for (int layerx = 0; layerx < nrow; layerx++) {
+                recv_cells_flat.push_back(cellx);
+                recv_layers_flat.push_back(layerx);
+            }
+            this->npart_cell[cellx] = nrow;
+            this->recv_counts[nx] += nrow;
+        }
+    }
+    this->npart_send = send_cells_flat.size();
+    this->npart_recv = recv_cells_flat.size();
+    this->d_send_cells.set(send_cells_flat);
+    this->d_send_layers.set(send_layers_flat);
+    this->d_recv_cells.set(recv_cells_flat);
+    this->d_recv_layers.set(recv_layers_flat);
+
+    this->for_each_dat(
+        [&](auto &dat) { dat->set_npart_cells(this->npart_cell); });
+
+    // Dats are packed per particle with each dat aligned to its element size
+    // and each particle aligned to 8 bytes.
+    this->dat_offsets.clear();
+    int offset = 0;
+    this->for_each_dat([&](auto &dat) {
+        offset = ((offset + dat->elem_size - 1) / dat->elem_size) *
+                 dat->elem_size;
+        this->dat_offsets.push_back(offset);
+        offset += dat->ncomp * dat->elem_size;
+    });
+    this->particle_bytes = ((offset + 7) / 8) * 8;
+    this->planned = true;
+}
+
+/*
+ * Gather the particles of a dat that are sent into the device send buffer.
+ */
+template <typename T>
+inline void ParticleHalo::pack_dat(ParticleDatShPtr<T> &dat,
+                                   const int record_bytes, const int offset) {
+    if (this->npart_send == 0) {
+        return;
+    }
+    auto &source_dat = this->particle_group[dat->sym];
+    PPMDASSERT(source_dat->cell_dat.all_resident(),
+               "All cells must be resident on the device, see "
+               "ParticleResidency::page_in_all");
+    source_dat->cell_dat.push_host_cells();
+    const auto k_source = source_dat->cell_dat.device_accessor();
+    const int k_ncomp = dat->ncomp;
+    const int *k_cells = this->d_send_cells.ptr;
+    const int *k_layers = this->d_send_layers.ptr;
+    char *k_buffer = this->d_send_buffer.ptr;
+    // The dat may be written by loops submitted without waiting.
+    const std::vector<sycl::event> deps =
+        this->sycl_target.get_compute_events();
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.depends_on(deps);
+            cgh.parallel_for<>(
+                sycl::range<1>(this->npart_send), [=](sycl::id<1> idx) {
+                    const int cellx = k_cells[idx];
+                    const int layerx = k_layers[idx];
+                    T *record = reinterpret_cast<T *>(
+                        k_buffer + idx[0] * record_bytes + offset);
+                    for (int cx = 0; cx < k_ncomp; cx++) {
+                        record[cx] = k_source[cellx][cx][layerx];
+                    }
+                });
+        })
+        .wait();
+}
+
+/*
+ * Scatter the received particles of a dat from the device receive buffer
+ * into the halo cells.
+ */
+template <typename T>
+inline void ParticleHalo::unpack_dat(ParticleDatShPtr<T> &dat,
+                                     const int record_bytes, const int offset) {
+    dat->cell_dat.mark_device_modified();
+    if (this->npart_recv == 0) {
+        return;
+    }
+    const auto k_halo = dat->cell_dat.device_accessor();
+    const int k_ncomp = dat->ncomp;
+    const int *k_cells = this->d_recv_cells.ptr;
+    const int *k_layers = this->d_recv_layers.ptr;
+    const char *k_buffer = this->d_recv_buffer.ptr;
+    const std::vector<sycl::event> deps =
+        this->sycl_target.get_compute_events();
+    this->sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.depends_on(deps);
+            cgh.parallel_for<>(
+                sycl::range<1>(this->npart_recv), [=](sycl::id<1> idx) {
+                    const int cellx = k_cells[idx];
+                    const int layerx = k_layers[idx];
+                    const T *record = reinterpret_cast<const T *>(
+                        k_buffer + idx[0] * record_bytes + offset);
+                    for (int cx = 0; cx < k_ncomp; cx++) {
+                        k_halo[cellx][cx][layerx] = record[cx];
+                    }
+                });
+        })
+        .wait();
+}
+
+/*
+ * Send the packed particles in the device send buffers of a set of halos to
+ * the neighbouring ranks and copy the received particles into the device
+ * receive buffers. The message to each rank holds the particles of each halo
+ * in turn, record_bytes holds the bytes of one particle of each halo.
+ */
+inline void
+ParticleHalo::exchange_buffers(const std::vector<ParticleHalo *> &halos,
+                               const std::vector<int> &record_bytes) {
+    auto &halo_first = *halos[0];
+    auto &sycl_target = halo_first.sycl_target;
+    const int nhalo = halos.size();
+    const int nneighbours = halo_first.neighbour_ranks.size();
+    std::vector<size_t> send_bytes(nneighbours + 1, 0);
+    std::vector<size_t> recv_bytes(nneighbours + 1, 0);
+    for (int nx = 0; nx < nneighbours; nx++) {
+        send_bytes[nx + 1] = send_bytes[nx];
+        recv_bytes[nx + 1] = recv_bytes[nx];
+        for (int hx = 0; hx < nhalo; hx++) {
+            send_bytes[nx + 1] +=
+                ((size_t)halos[hx]->send_counts[nx]) * record_bytes[hx];
+            recv_bytes[nx + 1] +=
+                ((size_t)halos[hx]->recv_counts[nx]) * record_bytes[hx];
+        }
+    }
+    auto &h_send_buffer = halo_first.h_send_buffer;
+    auto &h_recv_buffer = halo_first.h_recv_buffer;
+    h_send_buffer.resize(send_bytes[nneighbours]);
+    h_recv_buffer.resize(recv_bytes[nneighbours]);
+
+    // The device buffer of each halo holds its particles ordered by
+    // neighbouring rank.
+    EventStack es;
+    std::vector<size_t> device_offsets(nhalo, 0);
+    for (int nx = 0; nx < nneighbours; nx++) {
+        size_t host_offset = send_bytes[nx];
+        for (int hx = 0; hx < nhalo; hx++) {
+            const size_t nbytes =
+                ((size_t)halos[hx]->send_counts[nx]) * record_bytes[hx];
+            if (nbytes > 0) {
+                es.push(sycl_target.queue_d2h.memcpy(
+                            h_send_buffer.data() + host_offset,
+                            halos[hx]->d_send_buffer.ptr + device_offsets[hx],
+                            nbytes),
+                        sycl_target.profiler, "ParticleHalo::exchange");
+            }
+            host_offset += nbytes;
+            device_offsets[hx] += nbytes;
+        }
+    }
+    es.wait();
+
+    std::vector<MPI_Request> requests(2 * nneighbours);
+    for (int nx = 0; nx < nneighbours; nx++) {
+        MPICHK(MPI_Irecv(h_recv_buffer.data() + recv_bytes[nx],
+                         recv_bytes[nx + 1] - recv_bytes[nx], MPI_BYTE,
+                         halo_first.neighbour_ranks[nx], tag_data,
+                         halo_first.comm, &requests[nx]))
+    }
+    for (int nx = 0; nx < nneighbours; nx++) {
+        MPICHK(MPI_Isend(h_send_buffer.data() + send_bytes[nx],
+                         send_bytes[nx + 1] - send_bytes[nx], MPI_BYTE,
+                         halo_first.neighbour_ranks[nx], tag_data,
+                         halo_first.comm, &requests[nneighbours + nx]))
+    }
+    MPICHK(MPI_Waitall(2 * nneighbours, requests.data(), MPI_STATUSES_IGNORE))
+
+    std::fill(device_offsets.begin(), device_offsets.end(), 0);
+    for (int nx = 0; nx < nneighbours; nx++) {
+        size_t host_offset = recv_bytes[nx];
+        for (int hx = 0; hx < nhalo; hx++) {
+            const size_t nbytes =
+                ((size_t)halos[hx]->recv_counts[nx]) * record_bytes[hx];
+            if (nbytes > 0) {
+                es.push(sycl_target.queue_h2d.memcpy(
+                            halos[hx]->d_recv_buffer.ptr + device_offsets[hx],
+                            h_recv_buffer.data() + host_offset, nbytes),
+                        sycl_target.profiler, "ParticleHalo::exchange");
+            }
+            host_offset += nbytes;
+            device_offsets[hx] += nbytes;
+        }
+    }
+    es.wait();
+    sycl_target.profiler.add_bytes("mpi_send", send_bytes[nneighbours]);
+}
+
+/*
+ * Collective. Rebuild the exchange plans of a set of halos that share a
+ * LoadBalance and exchange all their halo dats in one communication round.
+ */
+inline void ParticleHalo::exchange(const std::vector<ParticleHalo *> &halos) {
+    if (halos.size() == 0) {
+        return;
+    }
+    auto &profiler = halos[0]->sycl_target.profiler;
+    profiler.start_region("ParticleHalo::exchange");
+    for (auto &halo : halos) {
+        PPMDASSERT(&halo->load_balance == &halos[0]->load_balance,
+                   "Halos exchanged together must share a LoadBalance");
+        if (halo->plan_cell_owners != halo->load_balance.cell_owners) {
+            halo->plan_cells();
+        }
+    }
+    ParticleHalo::plan_particles(halos);
+
+    std::vector<int> record_bytes;
+    for (auto &halo : halos) {
+        const int nbytes = halo->particle_bytes;
+        record_bytes.push_back(nbytes);
+        halo->d_send_buffer.realloc_no_copy(halo->npart_send * nbytes);
+        halo->d_recv_buffer.realloc_no_copy(halo->npart_recv * nbytes);
+        int datx = 0;
+        halo->for_each_dat([&](auto &dat) {
+            halo->pack_dat(dat, nbytes, halo->dat_offsets[datx++]);
+        });
+    }
+    ParticleHalo::exchange_buffers(halos, record_bytes);
+    for (auto &halo : halos) {
+        int datx = 0;
+        halo->for_each_dat([&](auto &dat) {
+            halo->unpack_dat(dat, halo->particle_bytes,
+                             halo->dat_offsets[datx++]);
+        });
+    }
+    profiler.end_region();
+}
+
+/*
+ * Collective. Rebuild the exchange plan from the current cell ownership and
+ * occupancy and exchange all the halo dats.
+ */
+inline void ParticleHalo::exchange() { ParticleHalo::exchange({this}); }
+
+/*
+ * Check that the plan of the last exchange is still valid.
+ */
+inline void ParticleHalo::check_plan() {
+    PPMDASSERT(this->planned, "exchange must be called before "
+                              "exchange_positions");
+    PPMDASSERT(this->plan_cell_owners == this->load_balance.cell_owners,
+               "Cell owners changed since the last exchange");
+    // Equal occupancies do not imply the same particle in each layer, e.g.
+    // after a sort or a removal followed by an addition.
+    PPMDASSERT(this->plan_version == this->particle_group.get_version(),
+               "Particles were added, removed or reordered since the last "
+               "exchange");
+    auto &npart_cell_group = this->particle_group.get_npart_cell();
+    int index = 0;
+    for (auto &cells : this->send_cells) {
+        for (auto &cellx : cells) {
+            PPMDASSERT(npart_cell_group[cellx] ==
+                           this->send_cell_counts[index++],
+                       "Occupancy of a sent cell changed since the last "
+                       "exchange");
+        }
+    }
+}
+
+/*
+ * Collective. Exchange the positions of the halo particles of a set of halos
+ * in one communication round using the plans of the last exchange.
+ */
+inline void
+ParticleHalo::exchange_positions(const std::vector<ParticleHalo *> &halos) {
+    if (halos.size() == 0) {
+        return;
+    }
+    for (auto &halo : halos) {
+        halo->check_plan();
+    }
+    auto &profiler = halos[0]->sycl_target.profiler;
+    profiler.start_region("ParticleHalo::exchange_positions");
+    std::vector<int> record_bytes;
+    for (auto &halo : halos) {
+        const int nbytes =
+            ((halo->position_dat->ncomp * sizeof(PPMD::REAL) + 7) / 8) * 8;
+        record_bytes.push_back(nbytes);
+        halo->pack_dat(halo->position_dat, nbytes, 0);
+    }
+    ParticleHalo::exchange_buffers(halos, record_bytes);
+    int hx = 0;
+    for (auto &halo : halos) {
+        halo->unpack_dat(halo->position_dat, record_bytes[hx++], 0);
+    }
+    profiler.end_region();
+}
+
+/*
+ * Collective. Exchange the positions of the halo particles using the plan of
+ * the last call to exchange. The ownership must not have changed and the
+ * particles must not have been added, removed or reordered since that call.
+ */
+inline void ParticleHalo::exchange_positions() {
+    ParticleHalo::exchange_positions({this});
+}
+
+/*
+ * A ParticleHalo for each species of a ParticleSpeciesGroup. exchange and
+ * exchange_positions exchange the halos of all species in one communication
+ * round, as LoadBalance::migrate does for the particles, hence the number of
+ * messages per step does not grow with the number of species.
+ */
+class ParticleSpeciesHalo {
+  private:
+    ParticleSpeciesGroup &species_group;
+    std::vector<std::unique_ptr<ParticleHalo>> halos;
+    std::vector<ParticleHalo *> halo_ptrs;
+
+  public:
+    ParticleSpeciesHalo(LoadBalance &load_balance,
+                        ParticleSpeciesGroup &species_group)
+        : species_group(species_group) {
+        for (int sx = 0; sx < species_group.get_nspecies(); sx++) {
+            this->halos.push_back(std::make_unique<ParticleHalo>(
+                load_balance, species_group.get_species(sx)));
+            this->halo_ptrs.push_back(this->halos.back().get());
+        }
+    }
+
+    inline int get_nspecies() { return this->halos.size(); }
+    inline ParticleHalo &get_halo(const int index) {
+        PPMDASSERT((index >= 0) && (index < this->halos.size()),
+                   "Bad species index");
+        return *this->halos[index];
+    }
+    /*
+     * The halo of a species, e.g. to add dats with ParticleHalo::add_dat.
+     */
+    inline ParticleHalo &operator[](const std::string name) {
+        auto &names = this->species_group.get_names();
+        const int index =
+            std::find(names.begin(), names.end(), name) - names.begin();
+        PPMDASSERT(index < names.size(), "Unknown species");
+        return *this->halos[index];
+    }
+
+    /*
+     * Collective. Rebuild the plans and exchange the halo dats of all
+     * species, see ParticleHalo::exchange.
+     */
+    inline void exchange() { ParticleHalo::exchange(this->halo_ptrs); }
+    /*
+     * Collective. Exchange the positions of all species, see
+     * ParticleHalo::exchange_positions.
+     */
+    inline void exchange_positions() {
+        ParticleHalo::exchange_positions(this->halo_ptrs);
+    }
+};
+
+} // namespace PPMD
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef _PPMD_PARTICLE_HISTOGRAM
+#define _PPMD_PARTICLE_HISTOGRAM
+
+#include <CL/sycl.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <mpi.h>
+#include <type_traits>
+#include <vector>
+
+#include "access.hpp"
+#include "compute_target.hpp"
+#include "particle_dat.hpp"
+#include "particle_group.hpp"
+#include "particle_loop.hpp"
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * An axis of a ParticleHistogram, a component of a ParticleDat binned into
+ * nbin bins of equal width over [lower, upper).
+ */
+template <typename T> struct HistogramAxis {
+    ParticleDatShPtr<T> dat;
+    int component;
+    int nbin;
+    T lower;
+    T upper;
+};
+
+/*
+ * Device copy of a HistogramAxis, or of the weight component of a
+ * ParticleHistogram, read through the pointers of the CellDat.
+ */
+template <typename T> struct HistogramAxisDevice {
+    T ***d_ptr;
+    int tile_shift;
+    int tile_skip;
+    int component;
+    int nbin;
+    T lower;
+    T upper;
+    T inv_width;
+};
+
+/*
+ * Bins the particles of a ParticleGroup over one or more ParticleDat
+ * components, e.g. the velocity components for f(v) or a position and a
+ * velocity component for f(x, v), and optionally weights each particle by a
+ * ParticleDat component. The bins are held in row major order, i.e. the bin
+ * of the last axis varies fastest, and particles outside the range of any
+ * axis are not binned.
+ *
+ * The histogram is accumulated on the device. If the bins fit in work-group
+ * local memory each work-group accumulates a private sub-histogram which is
+ * added to the device histogram once, otherwise particles are added to the
+ * device histogram directly. Only the bins are copied to the host and the
+ * histograms of all ranks are summed with a single MPI_Allreduce.
+ */
+template <typename T> class ParticleHistogram {
+    static_assert(std::is_floating_point<T>::value,
+                  "ParticleHistogram requires floating point dats");
+
+  private:
+    std::vector<HistogramAxis<T>> axes;
+    std::vector<ParticleDatAccess> accesses;
+    bool weighted;
+    HistogramAxisDevice<T> weight;
+    BufferDevice<HistogramAxisDevice<T>> d_axes;
+    BufferDevice<PPMD::REAL> d_bins;
+    std::vector<PPMD::REAL> bins;
+    int nbin_total;
+    int local_size;
+    int ngroup_max;
+    bool use_local_memory;
+
+    inline HistogramAxisDevice<T> device_axis(ParticleDatShPtr<T> dat,
+                                              const int component,
+                                              const int nbin, const T lower,
+                                              const T upper) {
+        PPMDASSERT((component >= 0) && (component < dat->ncomp),
+                   "Bad histogram component");
+        return {dat->cell_dat.device_ptr(),
+                dat->cell_dat.get_tile_shift(),
+                dat->cell_dat.get_tile_skip(),
+                component,
+                nbin,
+                lower,
+                upper,
+                (upper > lower) ? ((T)nbin) / (upper - lower) : (T)0};
+    }
+
+    inline void setup();
+    inline sycl::event submit_local(const std::vector<sycl::event> &deps);
+    inline sycl::event submit_global(const std::vector<sycl::event> &deps);
+
+  public:
+    ParticleGroup &particle_group;
+
+    /*
+     * Histogram counting the particles.
+     */
+    ParticleHistogram(ParticleGroup &particle_group,
+                      std::vector<HistogramAxis<T>> axes)
+        : axes(axes), weighted(false), weight(),
+          d_axes(particle_group.sycl_target, 0),
+          d_bins(particle_group.sycl_target, 0),
+          particle_group(particle_group) {
+        this->setup();
+    };
+
+    /*
+     * Histogram summing a component of a ParticleDat over the particles of
+     * each bin.
+     */
+    ParticleHistogram(ParticleGroup &particle_group,
+                      std::vector<HistogramAxis<T>> axes,
+                      ParticleDatShPtr<T> weight_dat,
+                      const int weight_component = 0)
+        : axes(axes), weighted(true), d_axes(particle_group.sycl_target, 0),
+          d_bins(particle_group.sycl_target, 0),
+          particle_group(particle_group) {
+        this->weight =
+            this->device_axis(weight_dat, weight_component, 1, 0, 0);
+        this->accesses.push_back(dat_access<READ>(weight_dat));
+        this->setup();
+    };
+
+    /*
+     * Number of bins along each axis and in total.
+     */
+    inline std::vector<int> get_shape() {
+        std::vector<int> shape;
+        for (auto &axis : this->axes) {
+            shape.push_back(axis.nbin);
+        }
+        return shape;
+    }
+    inline int get_nbin() { return this->nbin_total; }
+
+    /*
+     * Collective on the communicator of the SYCLTarget. Bin the particles of
+     * all ranks and return the bins.
+     */
+    inline std::vector<PPMD::REAL> &compute();
+};
+
+template <typename T> inline void ParticleHistogram<T>::setup() {
+    PPMDASSERT(this->axes.size() > 0, "A histogram needs at least one axis");
+    std::vector<HistogramAxisDevice<T>> h_axes;
+    std::int64_t nbin_total = 1;
+    for (auto &axis : this->axes) {
+        PPMDASSERT(axis.nbin > 0, "Histogram axes need at least one bin");
+        PPMDASSERT(axis.upper > axis.lower, "Bad histogram axis range");
+        h_axes.push_back(this->device_axis(axis.dat, axis.component, axis.nbin,
+                                           axis.lower, axis.upper));
+        this->accesses.push_back(dat_access<READ>(axis.dat));
+        nbin_total *= axis.nbin;
+    }
+    PPMDASSERT(nbin_total <= INT32_MAX, "Too many histogram bins");
+    this->nbin_total = nbin_total;
+    this->d_axes.set(h_axes);
+    this->d_bins.realloc_no_copy(this->nbin_total);
+    this->bins.assign(this->nbin_total, 0);
+
+    auto &device = this->particle_group.sycl_target.device;
+    const std::size_t local_mem_size =
+        device.get_info<sycl::info::device::local_mem_size>();
+    const std::size_t max_local_size =
+        device.get_info<sycl::info::device::max_work_group_size>();
+    this->local_size = std::min<std::size_t>(max_local_size, 128);
+    this->ngroup_max =
+        4 * device.get_info<sycl::info::device::max_compute_units>();
+    this->use_local_memory =
+        this->nbin_total * sizeof(PPMD::REAL) <= local_mem_size;
+}
+
+/*
+ * Each work-group strides over the particles and accumulates into a
+ * sub-histogram in local memory, which is then added to the device
+ * histogram with one atomic per non-empty bin.
+ */
+template <typename T>
+inline sycl::event
+ParticleHistogram<T>::submit_local(const std::vector<sycl::event> &deps) {
+    auto &sycl_target = this->particle_group.sycl_target;
+    const int npart = this->particle_group.get_npart_local();
+    const int ncell = this->particle_group.get_ncell();
+    const int *k_cell_order = this->particle_group.get_device_cell_order();
+    const int *k_order_offsets =
+        this->particle_group.get_device_order_offsets();
+    const HistogramAxisDevice<T> *k_axes = this->d_axes.ptr;
+    const int k_ndim = this->axes.size();
+    const bool k_weighted = this->weighted;
+    const HistogramAxisDevice<T> k_weight = this->weight;
+    PPMD::REAL *k_bins = this->d_bins.ptr;
+    const int k_nbin = this->nbin_total;
+
+    const int local_size = this->local_size;
+    const int ngroup = std::max(
+        std::min((npart + local_size - 1) / local_size, this->ngroup_max), 1);
+    const int global_size = ngroup * local_size;
+
+    return sycl_target.queue.submit([&](sycl::handler &cgh) {
+        cgh.depends_on(deps);
+        sycl::local_accessor<PPMD::REAL, 1> local_bins(
+            sycl::range<1>(k_nbin), cgh);
+        cgh.parallel_for<>(
+            sycl::nd_range<1>(sycl::range<1>(global_size),
+                              sycl::range<1>(local_size)),
+            [=](sycl::nd_item<1> idx) {
+                const int local_id = idx.get_local_id(0);
+                for (int binx = local_id; binx < k_nbin; binx += local_size) {
+                    local_bins[binx] = 0;
+                }
+                sycl::group_barrier(idx.get_group());
+
+                for (int index = idx.get_global_id(0); index < npart;
+                     index += global_size) {
+                    const int orderx =
+                        flat_index_search(k_order_offsets, ncell, index);
+                    const int cellx = k_cell_order[orderx];
+                    const int layerx = index - k_order_offsets[orderx];
+                    int binx = 0;
+                    bool inside = true;
+                    for (int dimx = 0; dimx < k_ndim; dimx++) {
+                        const HistogramAxisDevice<T> axis = k_axes[dimx];
+                        const T value =
+                            axis.d_ptr[cellx][axis.component][tiled_row_index(
+                                layerx, axis.tile_shift, axis.tile_skip)];
+                        // Written such that NaN is outside the axis.
+                        if (!((value >= axis.lower) && (value < axis.upper))) {
+                            inside = false;
+                            break;
+                        }
+                        int axis_bin = (value - axis.lower) * axis.inv_width;
+                        axis_bin = (axis_bin < axis.nbin) ? axis_bin
+                                                          : axis.nbin - 1;
+                        binx = binx * axis.nbin + axis_bin;
+                    }
+                    if (inside) {
+                        const PPMD::REAL value =
+                            k_weighted
+                                ? k_weight.d_ptr[cellx][k_weight.component]
+                                                [tiled_row_index(
+                                                    layerx,
+                                                    k_weight.tile_shift,
+                                                    k_weight.tile_skip)]
+                                : 1;
+                        atomic_fetch_add_local(&local_bins[binx], value);
+                    }
+                }
+
+                sycl::group_barrier(idx.get_group());
+                for (int binx = local_id; binx < k_nbin; binx += local_size) {
+                    const PPMD::REAL value = local_bins[binx];
+                    if (value != 0) {
+                        atomic_fetch_add(&k_bins[binx], value);
+                    }
+                }
+            });
+    });
+}
+
+/*
+ * Fallback for histograms that do not fit in local memory, each particle is
+ * added to the device histogram directly.
+ */
+template <typename T>
+inline sycl::event
+ParticleHistogram<T>::submit_global(const std::vector<sycl::event> &deps) {
+    auto &sycl_target = this->particle_group.sycl_target;
+    const int npart = this->particle_group.get_npart_local();
+    const int ncell = this->particle_group.get_ncell();
+    const int *k_cell_order = this->particle_group.get_device_cell_order();
+    const int *k_order_offsets =
+        this->particle_group.get_device_order_offsets();
+    const HistogramAxisDevice<T> *k_axes = this->d_axes.ptr;
+    const int k_ndim = this->axes.size();
+    const bool k_weighted = this->weighted;
+    const HistogramAxisDevice<T> k_weight = this->weight;
+    PPMD::REAL *k_bins = this->d_bins.ptr;
+
+    return sycl_target.queue.submit([&](sycl::handler &cgh) {
+        cgh.depends_on(deps);
+        cgh.parallel_for<>(sycl::range<1>(npart), [=](sycl::id<1> idx) {
+            const int index = idx[0];
+            const int orderx = flat_index_search(k_order_offsets, ncell, index);
+            const int cellx = k_cell_order[orderx];
+            const int layerx = index - k_order_offsets[orderx];
+            int binx = 0;
+            for (int dimx = 0; dimx < k_ndim; dimx++) {
+                const HistogramAxisDevice<T> axis = k_axes[dimx];
+                const T value =
+                    axis.d_ptr[cellx][axis.component][tiled_row_index(
+                        layerx, axis.tile_shift, axis.tile_skip)];
+                // Written such that NaN is outside the axis.
+                if (!((value >= axis.lower) && (value < axis.upper))) {
+                    return;
+                }
+                int axis_bin = (value - axis.lower) * axis.inv_width;
+                axis_bin = (axis_bin < axis.nbin) ? axis_bin : axis.nbin - 1;
+                binx = binx * axis.nbin + axis_bin;
+            }
+            const PPMD::REAL value =
+                k_weighted
+                    ? k_weight.d_ptr[cellx][k_weight.component]
+                                    [tiled_row_index(layerx,
+                                                     k_weight.tile_shift,
+                                                     k_weight.tile_skip)]
+                    : 1;
+            atomic_fetch_add(&k_bins[binx], value);
+        });
+    });
+}
+
+template <typename T>
+inline std::vector<PPMD::REAL> &ParticleHistogram<T>::compute() {
+    auto &sycl_target = this->particle_group.sycl_target;
+    sync_particle_loop_dats(this->particle_group, this->accesses, true);
+    sycl_target.profiler.start_region("ParticleHistogram");
+
+    const int npart = this->particle_group.get_npart_local();
+    // The binned dats may be written by loops submitted without waiting.
+    std::vector<sycl::event> deps = sycl_target.get_compute_events();
+    deps.push_back(sycl_target.queue.fill(this->d_bins.ptr, (PPMD::REAL)0,
+                                          this->nbin_total, deps));
+    if (npart > 0) {
+        sycl::event event = this->use_local_memory
+                                ? this->submit_local(deps)
+                                : this->submit_global(deps);
+        sycl_target.profiler.add_device_event("ParticleHistogram", event);
+        event.wait();
+    }
+    EventStack es;
+    es.push(sycl_target.queue_d2h.memcpy(this->bins.data(), this->d_bins.ptr,
+                                         this->nbin_total * sizeof(PPMD::REAL),
+                                         deps),
+            sycl_target.profiler, "ParticleHistogram");
+    es.wait();
+    sycl_target.profiler.add_bytes("device_to_host",
+                                   this->nbin_total * sizeof(PPMD::REAL));
+    MPICHK(MPI_Allreduce(MPI_IN_PLACE, this->bins.data(), this->nbin_total,
+                         MPI_DOUBLE, MPI_SUM, sycl_target.comm))
+    sycl_target.profiler.end_region();
+    return this->bins;
+}
+
+} // namespace PPMD
+
+#endif
@@ -0,0 +1,635 @@
+#ifndef _PPMD_PARTICLE_LOOP
+#define _PPMD_PARTICLE_LOOP
+
+#include <CL/sycl.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "access.hpp"
+#include "autotune.hpp"
+#include "compute_target.hpp"
+#include "particle_dat.hpp"
+#include "particle_group.hpp"
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * How the iteration space of a ParticleLoop is mapped onto work items.
+ *
+ * cell_blocked: A 2D range of ncell X nrow_max work items where work items
+ * beyond the occupancy of a cell exit immediately. Cheap when the cell
+ * occupancies are close to uniform.
+ *
+ * flat: A 1D range of npart_local work items where each work item finds its
+ * cell with a binary search of the exclusive prefix sum of the occupancies.
+ * No work items are idle when the occupancies are non-uniform.
+ *
+ * simd: A 2D range of ncell X ceil(nrow_max / PPMD_TILE_WIDTH) work items
+ * where each work item calls the kernel for a batch of PPMD_TILE_WIDTH
+ * consecutive layers of a cell in a loop marked for vectorisation. The last
+ * batch of a cell is a shorter loop over the remaining layers. Batches
+ * coincide with the tiles of dats with the aosoa layout. Intended for CPU
+ * devices, e.g. the hipSYCL OpenMP backend, where each work item runs on one
+ * core and the batch loop is compiled to SIMD instructions.
+ *
+ * automatic: Select one of the above from the occupancy distribution and the
+ * device type at the time the loop is executed.
+ */
+enum class ParticleLoopSchedule { automatic, cell_blocked, flat, simd };
+
+/*
+ * Select a schedule for a loop over npart particles held in ncell cells where
+ * the maximum cell occupancy is nrow_max. The flat schedule is chosen when
+ * the fraction of work items of the cell blocked schedule that would hold a
+ * particle is below fill_threshold. Otherwise the simd schedule is chosen if
+ * simd is true, e.g. for CPU devices, and the cell blocked schedule if not.
+ */
+inline ParticleLoopSchedule
+select_particle_loop_schedule(const int npart, const int ncell,
+                              const int nrow_max,
+                              const double fill_threshold = 0.5,
+                              const bool simd = false) {
+    if ((npart == 0) || (nrow_max == 0)) {
+        return ParticleLoopSchedule::cell_blocked;
+    }
+    const double fill = ((double)npart) / (((double)ncell) * nrow_max);
+    if (fill < fill_threshold) {
+        return ParticleLoopSchedule::flat;
+    }
+    return simd ? ParticleLoopSchedule::simd
+                : ParticleLoopSchedule::cell_blocked;
+}
+
+/*
+ * Find the position p in a non-decreasing array offsets of n + 1 entries such
+ * that offsets[p] <= index < offsets[p + 1]. Requires
+ * offsets[0] <= index < offsets[n]. Callable on the device.
+ */
+inline int flat_index_search(const int *offsets, const int n,
+                             const int index) {
+    int lower = 0;
+    int upper = n;
+    while (upper - lower > 1) {
+        const int mid = (lower + upper) / 2;
+        if (offsets[mid] <= index) {
+            lower = mid;
+        } else {
+            upper = mid;
+        }
+    }
+    return lower;
+}
+
+/*
+ * Declares that a loop accesses a ParticleDat with a given AccessMode. An
+ * access is particle local if the kernel call for a particle only accesses
+ * the data of that particle in the dat. Used to determine whether loops can
+ * be fused, see can_fuse_particle_loops.
+ */
+struct ParticleDatAccess {
+    const void *dat;
+    std::string name;
+    bool write;
+    bool particle_local;
+    // Push host mirror modifications of the dat to the device and mark the
+    // host mirror of the dat as out of date, see CellDat::enable_host_mirror.
+    std::function<void()> push_host_cells;
+    std::function<void()> mark_device_modified;
+    // The modification counter of the dat, see CellDat::get_version.
+    std::function<std::int64_t()> get_version;
+    // True if every cell of the dat is resident on the device, see
+    // CellDat::page_out_cells.
+    std::function<bool()> all_resident;
+};
+
+/*
+ * Create a ParticleDatAccess for a dat, e.g. dat_access<READ>(V).
+ */
+template <typename MODE, typename T>
+inline ParticleDatAccess dat_access(ParticleDatShPtr<T> dat,
+                                    const bool particle_local = true) {
+    CellDat<T> *cell_dat = &dat->cell_dat;
+    return {dat.get(),
+            dat->name,
+            MODE::write,
+            particle_local,
+            [=]() { cell_dat->push_host_cells(); },
+            [=]() { cell_dat->mark_device_modified(); },
+            [=]() { return cell_dat->get_version(); },
+            [=]() { return cell_dat->all_resident(); }};
+}
+
+/*
+ * Assert that every cell of the dats accessed by a kernel is resident on the
+ * device, as kernels over the whole group would dereference the NULL column
+ * pointers of paged out cells, see CellDat::page_out_cells. If the accesses
+ * are not declared every dat in the group is checked.
+ */
+inline void assert_particle_loop_dats_resident(
+    ParticleGroup &particle_group,
+    const std::vector<ParticleDatAccess> &accesses,
+    const bool accesses_declared) {
+    const char *message = "All cells of the dats accessed on the device must "
+                          "be resident, see ParticleResidency::page_in_all";
+    if (!accesses_declared) {
+        particle_group.for_each_particle_dat([&](auto &dat) {
+            PPMDASSERT(dat->cell_dat.all_resident(), message);
+        });
+        return;
+    }
+    for (auto &access : accesses) {
+        PPMDASSERT(access.all_resident(), message);
+    }
+}
+
+/*
+ * Bring the host mirrors of the dats accessed by a loop up to date before the
+ * loop is submitted. Host modifications of the accessed dats are pushed to
+ * the device and the host mirrors of written dats are marked as out of date.
+ * If the accesses are not declared every dat in the group is treated as
+ * written. The accessed dats must be resident on the device unless
+ * require_resident is false, e.g. for ParticleResidency which pages in the
+ * cells itself.
+ */
+inline void
+sync_particle_loop_dats(ParticleGroup &particle_group,
+                        const std::vector<ParticleDatAccess> &accesses,
+                        const bool accesses_declared,
+                        const bool require_resident = true) {
+    if (require_resident) {
+        assert_particle_loop_dats_resident(particle_group, accesses,
+                                           accesses_declared);
+    }
+    if (!accesses_declared) {
+        particle_group.for_each_particle_dat([&](auto &dat) {
+            dat->cell_dat.push_host_cells();
+            dat->cell_dat.mark_device_modified();
+        });
+        return;
+    }
+    for (auto &access : accesses) {
+        access.push_host_cells();
+    }
+    for (auto &access : accesses) {
+        if (access.write) {
+            access.mark_device_modified();
+        }
+    }
+}
+
+/*
+ * Returns true if a loop with the accesses b may be fused with an earlier
+ * loop with the accesses a. In a fused kernel the work item of a particle
+ * calls the kernel of the first loop then the kernel of the second, hence
+ * dependencies through particle local accesses are preserved. A dat that is
+ * written by either loop must not be accessed by either loop other than
+ * through particle local accesses.
+ */
+inline bool can_fuse_particle_loops(const std::vector<ParticleDatAccess> &a,
+                                    const std::vector<ParticleDatAccess> &b) {
+    for (auto &access_a : a) {
+        for (auto &access_b : b) {
+            if ((access_a.dat == access_b.dat) &&
+                (access_a.write || access_b.write) &&
+                !(access_a.particle_local && access_b.particle_local)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Key identifying a loop and the current problem size to the autotuner.
+ */
+inline std::string particle_loop_tuning_key(const std::string name,
+                                            ParticleGroup &particle_group,
+                                            ParticleLoopSchedule schedule) {
+    const std::int64_t npart = particle_group.get_npart_local();
+    const std::int64_t nitem_cell_blocked =
+        ((std::int64_t)particle_group.get_ncell()) *
+        particle_group.get_nrow_max();
+    return "ParticleLoop:" + name + ":" + std::to_string((int)schedule) + ":" +
+           std::to_string(Autotuner::size_bucket(npart)) + ":" +
+           std::to_string(Autotuner::size_bucket(nitem_cell_blocked / npart));
+}
+
+/*
+ * Resolve the automatic schedule using the current cell occupancies and the
+ * device type.
+ */
+inline ParticleLoopSchedule
+resolve_particle_loop_schedule(ParticleGroup &particle_group,
+                               ParticleLoopSchedule schedule) {
+    if (schedule != ParticleLoopSchedule::automatic) {
+        return schedule;
+    }
+    return select_particle_loop_schedule(
+        particle_group.get_npart_local(), particle_group.get_ncell(),
+        particle_group.get_nrow_max(), 0.5,
+        particle_group.sycl_target.device.is_cpu());
+}
+
+/*
+ * Candidate launch configurations for a loop, the first is the configuration
+ * used without tuning.
+ */
+inline std::vector<KernelConfig>
+particle_loop_tuning_candidates(ParticleGroup &particle_group,
+                                ParticleLoopSchedule schedule) {
+    std::vector<ParticleLoopSchedule> schedules;
+    if (schedule == ParticleLoopSchedule::automatic) {
+        schedules = {ParticleLoopSchedule::cell_blocked,
+                     ParticleLoopSchedule::flat};
+        if (particle_group.sycl_target.device.is_cpu()) {
+            schedules.push_back(ParticleLoopSchedule::simd);
+        }
+    } else {
+        schedules = {schedule};
+    }
+    const ParticleLoopSchedule schedule_default =
+        resolve_particle_loop_schedule(particle_group, schedule);
+    std::vector<KernelConfig> candidates = {{(int)schedule_default, 0}};
+    for (auto local_size : Autotuner::candidate_local_sizes(
+             particle_group.sycl_target.device)) {
+        for (auto schedulex : schedules) {
+            if ((local_size > 0) || (schedulex != schedule_default)) {
+                candidates.push_back({(int)schedulex, local_size});
+            }
+        }
+    }
+    return candidates;
+}
+
+/*
+ * Submit kernel(cell, layer) for every particle in the group with a given
+ * schedule (the config variant) and work-group size.
+ */
+template <typename KERNEL>
+inline sycl::event submit_particle_loop_config(ParticleGroup &particle_group,
+                                               const KernelConfig config,
+                                               const KERNEL kernel) {
+    auto &sycl_target = particle_group.sycl_target;
+    const int ncell = particle_group.get_ncell();
+    const int npart = particle_group.get_npart_local();
+    const int nrow_max = particle_group.get_nrow_max();
+    const int *d_cell_order = particle_group.get_device_cell_order();
+    const int local_size = config.local_size;
+    // The out-of-order compute queue does not order the kernel after loops
+    // that were submitted and not waited on.
+    const std::vector<sycl::event> deps = sycl_target.get_compute_events();
+
+    if (config.variant == (int)ParticleLoopSchedule::flat) {
+        const int *d_order_offsets = particle_group.get_device_order_offsets();
+        auto lambda_particle = [=](const int index) {
+            const int orderx = flat_index_search(d_order_offsets, ncell, index);
+            const int cellx = d_cell_order[orderx];
+            const int layerx = index - d_order_offsets[orderx];
+            kernel(cellx, layerx);
+        };
+        if (local_size == 0) {
+            return sycl_target.queue.submit([&](sycl::handler &cgh) {
+                cgh.depends_on(deps);
+                cgh.parallel_for<>(
+                    sycl::range<1>(npart),
+                    [=](sycl::id<1> idx) { lambda_particle(idx[0]); });
+            });
+        }
+        const size_t global_size =
+            ((npart + local_size - 1) / local_size) * local_size;
+        return sycl_target.queue.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(deps);
+            cgh.parallel_for<>(
+                sycl::nd_range<1>(sycl::range<1>(global_size),
+                                  sycl::range<1>(local_size)),
+                [=](sycl::nd_item<1> idx) {
+                    const int index = idx.get_global_id(0);
+                    if (index < npart) {
+                        lambda_particle(index);
+                    }
+                });
+        });
+    }
+
+    const int *d_cell_offsets = particle_group.get_device_cell_offsets();
+    if (config.variant == (int)ParticleLoopSchedule::simd) {
+        const int nbatch_max =
+            (nrow_max + PPMD_TILE_WIDTH - 1) / PPMD_TILE_WIDTH;
+        auto lambda_batch = [=](const int orderx, const int batchx) {
+            const int cellx = d_cell_order[orderx];
+            const int layer_start = batchx * PPMD_TILE_WIDTH;
+            const int nlane = d_cell_offsets[cellx + 1] -
+                              d_cell_offsets[cellx] - layer_start;
+            if (nlane >= PPMD_TILE_WIDTH) {
+                PPMD_SIMD_LOOP
+                for (int lanex = 0; lanex < PPMD_TILE_WIDTH; lanex++) {
+                    kernel(cellx, layer_start + lanex);
+                }
+            } else {
+                PPMD_SIMD_LOOP
+                for (int lanex = 0; lanex < nlane; lanex++) {
+                    kernel(cellx, layer_start + lanex);
+                }
+            }
+        };
+        if (local_size == 0) {
+            return sycl_target.queue.submit([&](sycl::handler &cgh) {
+                cgh.depends_on(deps);
+                cgh.parallel_for<>(
+                    sycl::range<2>(ncell, nbatch_max),
+                    [=](sycl::id<2> idx) { lambda_batch(idx[0], idx[1]); });
+            });
+        }
+        const size_t global_size =
+            ((nbatch_max + local_size - 1) / local_size) * local_size;
+        return sycl_target.queue.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(deps);
+            cgh.parallel_for<>(
+                sycl::nd_range<2>(sycl::range<2>(ncell, global_size),
+                                  sycl::range<2>(1, local_size)),
+                [=](sycl::nd_item<2> idx) {
+                    lambda_batch(idx.get_global_id(0), idx.get_global_id(1));
+                });
+        });
+    }
+
+    auto lambda_particle = [=](const int orderx, const int layerx) {
+        const int cellx = d_cell_order[orderx];
+        if (layerx < d_cell_offsets[cellx + 1] - d_cell_offsets[cellx]) {
+            kernel(cellx, layerx);
+        }
+    };
+    if (local_size == 0) {
+        return sycl_target.queue.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(deps);
+            cgh.parallel_for<>(
+                sycl::range<2>(ncell, nrow_max),
+                [=](sycl::id<2> idx) { lambda_particle(idx[0], idx[1]); });
+        });
+    }
+    const size_t global_size =
+        ((nrow_max + local_size - 1) / local_size) * local_size;
+    return sycl_target.queue.submit([&](sycl::handler &cgh) {
+        cgh.depends_on(deps);
+        cgh.parallel_for<>(
+            sycl::nd_range<2>(sycl::range<2>(ncell, global_size),
+                              sycl::range<2>(1, local_size)),
+            [=](sycl::nd_item<2> idx) {
+                lambda_particle(idx.get_global_id(0), idx.get_global_id(1));
+            });
+    });
+}
+
+/*
+ * Submit kernel(cell, layer) for every particle in the group to the compute
+ * queue using the launch configuration from the autotuner and return the
+ * event of the kernel, which is recorded with SYCLTarget::add_compute_event.
+ * If the launch is an autotuning trial this blocks until the kernel is
+ * complete.
+ */
+template <typename KERNEL>
+inline sycl::event submit_particle_loop(const std::string name,
+                                        ParticleGroup &particle_group,
+                                        ParticleLoopSchedule schedule,
+                                        const KERNEL kernel) {
+    auto &sycl_target = particle_group.sycl_target;
+    if (particle_group.get_npart_local() == 0) {
+        return sycl::event();
+    }
+
+    sycl_target.profiler.start_region(name.c_str());
+    const std::string key =
+        particle_loop_tuning_key(name, particle_group, schedule);
+    KernelConfig config;
+    const bool trial = sycl_target.autotuner.get_config(
+        key, particle_loop_tuning_candidates(particle_group, schedule),
+        config);
+
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    sycl::event event =
+        submit_particle_loop_config(particle_group, config, kernel);
+    if (trial) {
+        event.wait();
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        sycl_target.autotuner.record(
+            key, std::chrono::duration<double>(t1 - t0).count());
+    }
+    sycl_target.profiler.add_device_event(name.c_str(), event);
+    sycl_target.add_compute_event(event);
+    sycl_target.profiler.end_region();
+    return event;
+}
+
+/*
+ * Executes a kernel once for every particle in a ParticleGroup. The kernel is
+ * called on the device as kernel(cell, layer) and should access particle data
+ * through device accessors captured by value, e.g. from
+ * ParticleDatT::cell_dat.device_accessor(), or device pointers from
+ * ParticleDatT::cell_dat.device_ptr() for dats with the soa layout. Cells
+ * are traversed in the cell order of the ParticleGroup. The accesses the
+ * kernel makes to ParticleDats may be declared with dat_access, loops without
+ * declared accesses are never fused.
+ *
+ * The schedule, if automatic, and the work-group size are taken from the
+ * autotuner of the SYCLTarget. The loop is tuned per name, requested
+ * schedule, particle count bucket and occupancy fill bucket.
+ */
+template <typename KERNEL> class ParticleLoopT {
+  private:
+  public:
+    ParticleGroup &particle_group;
+    const KERNEL kernel;
+    const std::string name;
+    const std::vector<ParticleDatAccess> accesses;
+    const bool accesses_declared;
+    ParticleLoopSchedule schedule;
+
+    ParticleLoopT(const std::string name, ParticleGroup &particle_group,
+                  KERNEL kernel,
+                  const ParticleLoopSchedule schedule =
+                      ParticleLoopSchedule::automatic)
+        : particle_group(particle_group), kernel(kernel), name(name),
+          accesses_declared(false), schedule(schedule){};
+
+    ParticleLoopT(const std::string name, ParticleGroup &particle_group,
+                  KERNEL kernel, std::vector<ParticleDatAccess> accesses,
+                  const ParticleLoopSchedule schedule =
+                      ParticleLoopSchedule::automatic)
+        : particle_group(particle_group), kernel(kernel), name(name),
+          accesses(accesses), accesses_declared(true), schedule(schedule){};
+
+    /*
+     * The schedule that will be used if the loop is executed with the current
+     * cell occupancies.
+     */
+    inline ParticleLoopSchedule get_schedule() {
+        return resolve_particle_loop_schedule(this->particle_group,
+                                              this->schedule);
+    }
+
+    /*
+     * Submit the loop to the compute queue and return the event of the
+     * kernel.
+     */
+    inline sycl::event submit() {
+        sync_particle_loop_dats(this->particle_group, this->accesses,
+                                this->accesses_declared);
+        return submit_particle_loop(this->name, this->particle_group,
+                                    this->schedule, this->kernel);
+    }
+
+    /*
+     * Execute the loop and block until it is complete.
+     */
+    inline void execute() { this->submit().wait(); }
+};
+
+template <typename KERNEL>
+using ParticleLoopShPtr = std::shared_ptr<ParticleLoopT<KERNEL>>;
+
+template <typename KERNEL>
+inline ParticleLoopShPtr<KERNEL>
+ParticleLoop(const std::string name, ParticleGroup &particle_group,
+             KERNEL kernel,
+             const ParticleLoopSchedule schedule =
+                 ParticleLoopSchedule::automatic) {
+    return std::make_shared<ParticleLoopT<KERNEL>>(name, particle_group,
+                                                   kernel, schedule);
+}
+template <typename KERNEL>
+inline ParticleLoopShPtr<KERNEL>
+ParticleLoop(const std::string name, ParticleGroup &particle_group,
+             KERNEL kernel, std::vector<ParticleDatAccess> accesses,
+             const ParticleLoopSchedule schedule =
+                 ParticleLoopSchedule::automatic) {
+    return std::make_shared<ParticleLoopT<KERNEL>>(name, particle_group,
+                                                   kernel, accesses, schedule);
+}
+
+/*
+ * Call the kernels of a tuple of kernels whose bit is set in mask.
+ */
+template <typename TUPLE, std::size_t... INDEX>
+inline void call_fused_kernels(const TUPLE &kernels, const unsigned mask,
+                               const int cellx, const int layerx,
+                               std::index_sequence<INDEX...>) {
+    ((((mask >> INDEX) & 1u) ? std::get<INDEX>(kernels)(cellx, layerx)
+                              : void()),
+     ...);
+}
+
+/*
+ * A sequence of ParticleLoops that is executed in order. Consecutive loops
+ * over the same ParticleGroup whose declared accesses allow fusion, see
+ * can_fuse_particle_loops, are executed as a single kernel such that the
+ * particle data is streamed from memory once for the fused loops rather than
+ * once per loop. The schedule of a fused kernel is the schedule of the first
+ * loop it contains.
+ */
+template <typename... KERNELS> class ParticleLoopSequenceT {
+  private:
+    std::tuple<ParticleLoopShPtr<KERNELS>...> loops;
+    std::vector<ParticleGroup *> groups;
+    std::vector<const std::vector<ParticleDatAccess> *> accesses;
+    std::vector<bool> accesses_declared;
+    std::vector<std::string> names;
+    std::vector<ParticleLoopSchedule> schedules;
+
+  public:
+    const std::string name;
+    // Fuse loops where legal, if false each loop is executed separately.
+    bool fusion_enabled;
+
+    ParticleLoopSequenceT(const std::string name,
+                          ParticleLoopShPtr<KERNELS>... loops)
+        : loops(loops...), name(name), fusion_enabled(true) {
+        static_assert(sizeof...(KERNELS) <= 32, "Too many loops to fuse");
+        (this->groups.push_back(&loops->particle_group), ...);
+        (this->accesses.push_back(&loops->accesses), ...);
+        (this->accesses_declared.push_back(loops->accesses_declared), ...);
+        (this->names.push_back(loops->name), ...);
+        (this->schedules.push_back(loops->schedule), ...);
+    }
+
+    /*
+     * The loops grouped into kernels. Each entry is the half open range of
+     * loop indices [start, end) executed by one kernel.
+     */
+    inline std::vector<std::pair<int, int>> get_segments() {
+        const int nloop = sizeof...(KERNELS);
+        std::vector<std::pair<int, int>> segments;
+        int start = 0;
+        while (start < nloop) {
+            int end = start + 1;
+            while (this->fusion_enabled && (end < nloop) &&
+                   this->accesses_declared[start] &&
+                   this->accesses_declared[end] &&
+                   (this->groups[end] == this->groups[start])) {
+                bool legal = true;
+                for (int lx = start; lx < end; lx++) {
+                    legal = legal && can_fuse_particle_loops(
+                                         *this->accesses[lx],
+                                         *this->accesses[end]);
+                }
+                if (!legal) {
+                    break;
+                }
+                end++;
+            }
+            segments.push_back({start, end});
+            start = end;
+        }
+        return segments;
+    }
+
+    /*
+     * Execute the loops and block until they are complete.
+     */
+    inline void execute() {
+        const auto kernels = std::apply(
+            [](auto &...loopx) { return std::make_tuple(loopx->kernel...); },
+            this->loops);
+        for (auto &segment : this->get_segments()) {
+            unsigned mask = 0;
+            std::string segment_name = this->name;
+            for (int lx = segment.first; lx < segment.second; lx++) {
+                mask |= 1u << lx;
+                segment_name += ":" + this->names[lx];
+                sync_particle_loop_dats(*this->groups[lx], *this->accesses[lx],
+                                        this->accesses_declared[lx]);
+            }
+            auto lambda_fused = [=](const int cellx, const int layerx) {
+                call_fused_kernels(kernels, mask, cellx, layerx,
+                                   std::index_sequence_for<KERNELS...>{});
+            };
+            submit_particle_loop(segment_name, *this->groups[segment.first],
+                                 this->schedules[segment.first], lambda_fused)
+                .wait();
+        }
+    }
+};
+
+template <typename... KERNELS>
+using ParticleLoopSequenceShPtr =
+    std::shared_ptr<ParticleLoopSequenceT<KERNELS...>>;
+
+template <typename... KERNELS>
+inline ParticleLoopSequenceShPtr<KERNELS...>
+ParticleLoopSequence(const std::string name,
+                     ParticleLoopShPtr<KERNELS>... loops) {
+    return std::make_shared<ParticleLoopSequenceT<KERNELS...>>(name,
+                                                              loops...);
+}
+
+} // namespace PPMD
+
+#endif
@@ -0,0 +1,314 @@
+#ifndef _PPMD_PARTICLE_RESIDENCY
+#define _PPMD_PARTICLE_RESIDENCY
+
+#include <CL/sycl.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "compute_target.hpp"
+#include "particle_group.hpp"
+#include "particle_loop.hpp"
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * Streams loops over a ParticleGroup through a limited amount of device
+ * memory. The cells of the group are split, in the cell order of the group,
+ * into batches whose data in all the dats of the group fits in half of the
+ * device budget. Cells outside the working set are paged out to host memory,
+ * see CellDat::page_out_cells. execute runs a kernel over one batch at a
+ * time while the next batch is paged in on the host to device copy queue,
+ * hence at most two batches are resident at once. A cell larger than half
+ * the budget forms a batch on its own and may exceed the budget.
+ *
+ * After a call to execute the cells of the last batch remain resident and
+ * the other cells are paged out, hence a group that fits in a single batch
+ * stays resident between calls. Cells that are paged out may be read and
+ * written with CellDat::get_cell and set_cell. ParticleGroup::add_particles
+ * and remove_particles with a list of particles page in only the cells that
+ * gain or lose particles, for the duration of the call, hence the group may
+ * grow beyond the budget while paged out. Operations that access every cell
+ * on the device, e.g. a ParticleLoop over the whole group, ParticleSort,
+ * halo exchanges, migration and removal with a mask dat, assert that the
+ * cells are resident and require page_in_all to be called first, which
+ * requires the whole group to fit in device memory.
+ */
+class ParticleResidency {
+  private:
+    std::int64_t plan_version;
+    // The cells in the cell order of the group, the exclusive prefix sum of
+    // their occupancies and the position of the first cell of each batch.
+    std::vector<int> cells;
+    std::vector<int> offsets;
+    std::vector<int> batch_starts;
+    BufferDevice<int> d_cells;
+    BufferDevice<int> d_offsets;
+    std::size_t peak_resident_bytes;
+
+    inline std::vector<int> get_batch_cells(const int batch) {
+        return std::vector<int>(this->cells.begin() + this->batch_starts[batch],
+                                this->cells.begin() +
+                                    this->batch_starts[batch + 1]);
+    }
+
+    inline void page_out(const std::vector<int> &cells) {
+        this->particle_group.for_each_particle_dat(
+            [&](auto &dat) { dat->cell_dat.page_out_cells(cells); });
+    }
+
+    // The device allocations are made before page_in_cells_async returns,
+    // hence the peak is sampled after each page in.
+    inline void page_in_async(const std::vector<int> &cells, EventStack &es) {
+        this->particle_group.for_each_particle_dat(
+            [&](auto &dat) { dat->cell_dat.page_in_cells_async(cells, es); });
+        this->peak_resident_bytes =
+            std::max(this->peak_resident_bytes, this->get_resident_bytes());
+    }
+
+    inline void plan();
+
+  public:
+    ParticleGroup &particle_group;
+    // Bytes of device memory that may be used by the particle data.
+    std::size_t device_budget;
+
+    ParticleResidency(ParticleGroup &particle_group,
+                      const std::size_t device_budget)
+        : plan_version(-1), d_cells(particle_group.sycl_target, 0),
+          d_offsets(particle_group.sycl_target, 0),
+          peak_resident_bytes(0), particle_group(particle_group),
+          device_budget(device_budget) {
+        PPMDASSERT(device_budget > 0, "Device budget must be positive");
+    };
+
+    /*
+     * Returns true if a cell is resident in all the dats of the group.
+     */
+    inline bool is_resident(const int cell) {
+        bool resident = true;
+        this->particle_group.for_each_particle_dat([&](auto &dat) {
+            resident = resident && dat->cell_dat.is_resident(cell);
+        });
+        return resident;
+    }
+
+    /*
+     * Number of batches of the current plan, the plan is rebuilt when the
+     * particles of the group are added, removed or reordered.
+     */
+    inline int get_nbatch() {
+        this->plan();
+        return this->batch_starts.size() - 1;
+    }
+
+    /*
+     * Bytes of device memory allocated for the data of all the dats of the
+     * group, see CellDat::get_device_bytes, and the maximum reached while
+     * paging in cells since the last call to reset_peak_resident_bytes.
+     */
+    inline std::size_t get_resident_bytes() {
+        std::size_t nbytes = 0;
+        this->particle_group.for_each_particle_dat(
+            [&](auto &dat) { nbytes += dat->cell_dat.get_device_bytes(); });
+        return nbytes;
+    }
+    inline std::size_t get_peak_resident_bytes() {
+        return this->peak_resident_bytes;
+    }
+    inline void reset_peak_resident_bytes() {
+        this->peak_resident_bytes = this->get_resident_bytes();
+    }
+
+    /*
+     * Page out every cell of the group.
+     */
+    inline void page_out_all() {
+        std::vector<int> all_cells(this->particle_group.get_ncell());
+        for (int cellx = 0; cellx < all_cells.size(); cellx++) {
+            all_cells[cellx] = cellx;
+        }
+        this->page_out(all_cells);
+    }
+
+    /*
+     * Page in every cell of the group, e.g. before operations that access
+     * every cell on the device.
+     */
+    inline void page_in_all() {
+        std::vector<int> all_cells(this->particle_group.get_ncell());
+        for (int cellx = 0; cellx < all_cells.size(); cellx++) {
+            all_cells[cellx] = cellx;
+        }
+        EventStack es;
+        this->page_in_async(all_cells, es);
+        es.wait();
+    }
+
+    /*
+     * Execute kernel(cell, layer) for every particle in the group, one batch
+     * of cells at a time. The accesses of the kernel may be declared as for
+     * a ParticleLoop, only the dats written by the kernel are copied back to
+     * the host when a batch is paged out. Otherwise every dat is treated as
+     * written.
+     */
+    template <typename KERNEL>
+    inline void execute(const std::string name, const KERNEL kernel) {
+        this->execute(name, kernel, {}, false);
+    }
+    template <typename KERNEL>
+    inline void execute(const std::string name, const KERNEL kernel,
+                        std::vector<ParticleDatAccess> accesses) {
+        this->execute(name, kernel, accesses, true);
+    }
+    template <typename KERNEL>
+    inline void execute(const std::string name, const KERNEL kernel,
+                        const std::vector<ParticleDatAccess> &accesses,
+                        const bool accesses_declared);
+};
+
+/*
+ * Split the cells into batches of at most half the device budget.
+ */
+inline void ParticleResidency::plan() {
+    if (this->plan_version == this->particle_group.get_version()) {
+        return;
+    }
+    auto &cell_order = this->particle_group.get_cell_order();
+    auto &npart_cell = this->particle_group.get_npart_cell();
+    const int ncell = cell_order.size();
+    const std::size_t batch_budget = this->device_budget / 2;
+
+    this->cells = cell_order;
+    this->offsets.assign(ncell + 1, 0);
+    this->batch_starts.clear();
+    this->batch_starts.push_back(0);
+    std::size_t batch_bytes = 0;
+    for (int orderx = 0; orderx < ncell; orderx++) {
+        const int cellx = cell_order[orderx];
+        this->offsets[orderx + 1] = this->offsets[orderx] + npart_cell[cellx];
+        // The size once paged in, which excludes any spare rows.
+        std::size_t cell_bytes = 0;
+        this->particle_group.for_each_particle_dat([&](auto &dat) {
+            cell_bytes += dat->cell_dat.get_data_bytes(cellx);
+        });
+        if ((batch_bytes > 0) && (batch_bytes + cell_bytes > batch_budget)) {
+            this->batch_starts.push_back(orderx);
+            batch_bytes = 0;
+        }
+        batch_bytes += cell_bytes;
+    }
+    this->batch_starts.push_back(ncell);
+    this->d_cells.set(this->cells);
+    this->d_offsets.set(this->offsets);
+    this->plan_version = this->particle_group.get_version();
+}
+
+template <typename KERNEL>
+inline void
+ParticleResidency::execute(const std::string name, const KERNEL kernel,
+                           const std::vector<ParticleDatAccess> &accesses,
+                           const bool accesses_declared) {
+    auto &sycl_target = this->particle_group.sycl_target;
+    // The dats are not required to be resident as the cells are paged in
+    // below.
+    sync_particle_loop_dats(this->particle_group, accesses, accesses_declared,
+                            false);
+    this->plan();
+    const int nbatch = this->batch_starts.size() - 1;
+
+    // Only the first batch may be resident at the start such that at most
+    // two batches are resident at once. Its resident cells are kept unless
+    // their spare rows take it over the batch budget, in which case they are
+    // paged in again with no spare rows. Cells that are not modified are not
+    // copied.
+    auto first_cells = this->get_batch_cells(0);
+    std::size_t first_bytes = 0;
+    std::size_t first_data_bytes = 0;
+    for (auto &cellx : first_cells) {
+        this->particle_group.for_each_particle_dat([&](auto &dat) {
+            first_bytes += dat->cell_dat.get_cell_bytes(cellx);
+            first_data_bytes += dat->cell_dat.get_data_bytes(cellx);
+        });
+    }
+    const bool keep_first =
+        first_bytes <= std::max(this->device_budget / 2, first_data_bytes);
+    std::vector<char> keep(this->particle_group.get_ncell(), 0);
+    if (keep_first) {
+        for (auto &cellx : first_cells) {
+            keep[cellx] = 1;
+        }
+    }
+    std::vector<int> out_cells;
+    for (int cellx = 0; cellx < keep.size(); cellx++) {
+        if (!keep[cellx] && this->is_resident(cellx)) {
+            out_cells.push_back(cellx);
+        }
+    }
+    this->page_out(out_cells);
+    EventStack es;
+    this->page_in_async(first_cells, es);
+    es.wait();
+
+    sycl_target.profiler.start_region(name.c_str());
+    const int *k_cells = this->d_cells.ptr;
+    const int *k_offsets = this->d_offsets.ptr;
+    for (int batchx = 0; batchx < nbatch; batchx++) {
+        const int start = this->batch_starts[batchx];
+        const int end = this->batch_starts[batchx + 1];
+        const int npart = this->offsets[end] - this->offsets[start];
+        const int offset = this->offsets[start];
+        const int ncell_batch = end - start;
+
+        sycl::event event;
+        if (npart > 0) {
+            // The batch may be written by loops submitted without waiting.
+            const std::vector<sycl::event> deps =
+                sycl_target.get_compute_events();
+            event = sycl_target.queue.submit([&](sycl::handler &cgh) {
+                cgh.depends_on(deps);
+                cgh.parallel_for<>(sycl::range<1>(npart), [=](sycl::id<1> idx) {
+                    const int index = offset + idx[0];
+                    const int orderx =
+                        start + flat_index_search(k_offsets + start,
+                                                  ncell_batch, index);
+                    kernel(k_cells[orderx], index - k_offsets[orderx]);
+                });
+            });
+            sycl_target.profiler.add_device_event(name.c_str(), event);
+        }
+        // Prefetch the next batch while the kernel runs.
+        EventStack es_next;
+        if (batchx + 1 < nbatch) {
+            this->page_in_async(this->get_batch_cells(batchx + 1), es_next);
+        }
+        event.wait();
+
+        auto batch_cells = this->get_batch_cells(batchx);
+        this->particle_group.for_each_particle_dat([&](auto &dat) {
+            bool write = !accesses_declared;
+            for (auto &access : accesses) {
+                write = write || (access.write && (access.dat == dat.get()));
+            }
+            if (write) {
+                for (auto &cellx : batch_cells) {
+                    dat->cell_dat.mark_device_modified(cellx);
+                }
+            }
+        });
+        es_next.wait();
+        if (batchx + 1 < nbatch) {
+            this->page_out(batch_cells);
+        }
+    }
+    sycl_target.profiler.end_region();
+}
+
+} // namespace PPMD
+
+#endif
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <map>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "access.hpp"
@@ -13,51 +14,45 @@
 
 namespace PPMD {
 
+template <typename T> using SymVectorMap = std::map<Sym<T>, std::vector<T>>;
+
+/*
+ * Holds the properties of a set of particles on the host, e.g. to add to a
+ * ParticleGroup. Values are stored column wise, i.e. by component then
+ * particle.
+ */
 class ParticleSet {
 
   private:
-    std::map<Sym<PPMD::REAL>, std::vector<PPMD::REAL>> values_real;
-    std::map<Sym<PPMD::INT>, std::vector<PPMD::INT>> values_int;
+    TypeMap<SymVectorMap, ParticleTypes> values;
 
   public:
     const int npart;
 
     ParticleSet(const int npart, ParticleSpec particle_spec) : npart(npart) {
-
-        for (auto const &spec : particle_spec.properties_real) {
-            values_real[spec.sym] = std::vector<PPMD::REAL>(npart * spec.ncomp);
-            std::fill(values_real[spec.sym].begin(),
-                      values_real[spec.sym].end(), 0.0);
-        }
-        for (auto const &spec : particle_spec.properties_int) {
-            values_int[spec.sym] = std::vector<PPMD::INT>(npart * spec.ncomp);
-            std::fill(values_int[spec.sym].begin(), values_int[spec.sym].end(),
-                      0);
-        }
+        particle_spec.properties.for_each([&](auto &properties) {
+            for (auto const &spec : properties) {
+                using T = typename std::decay<
+                    decltype(spec.sym)>::type::value_type;
+                auto &values = this->values.get<T>();
+                values[spec.sym] = std::vector<T>(npart * spec.ncomp);
+                std::fill(values[spec.sym].begin(), values[spec.sym].end(),
+                          ((T)0));
+            }
+        });
     };
 
-    inline ColumnMajorRowAccessor<std::vector, PPMD::REAL>
-    operator[](Sym<PPMD::REAL> sym) {
-        return ColumnMajorRowAccessor<std::vector, PPMD::REAL>{values_real[sym],
-                                                               this->npart};
-    };
-    inline ColumnMajorRowAccessor<std::vector, PPMD::INT>
-    operator[](Sym<PPMD::INT> sym) {
-        return ColumnMajorRowAccessor<std::vector, PPMD::INT>{values_int[sym],
-                                                              this->npart};
+    template <typename T>
+    inline ColumnMajorRowAccessor<std::vector, T> operator[](Sym<T> sym) {
+        return ColumnMajorRowAccessor<std::vector, T>{
+            this->values.get<T>()[sym], this->npart};
     };
 
-    inline std::vector<PPMD::REAL> &get(Sym<PPMD::REAL> const &sym) {
-        return values_real[sym];
+    template <typename T> inline std::vector<T> &get(Sym<T> const &sym) {
+        return this->values.get<T>()[sym];
     };
-    inline std::vector<PPMD::INT> &get(Sym<PPMD::INT> const &sym) {
-        return values_int[sym];
-    };
-    inline bool contains(Sym<PPMD::REAL> const &sym) {
-        return (this->values_real.count(sym) > 0);
-    }
-    inline bool contains(Sym<PPMD::INT> const &sym) {
-        return (this->values_int.count(sym) > 0);
+    template <typename T> inline bool contains(Sym<T> const &sym) {
+        return (this->values.get<T>().count(sym) > 0);
     }
 };
 
@@ -0,0 +1,335 @@
+#ifndef _PPMD_PARTICLE_SORT
+#define _PPMD_PARTICLE_SORT
+
+#include <CL/sycl.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "compute_target.hpp"
+#include "mesh_hierarchy.hpp"
+#include "particle_group.hpp"
+#include "space_filling_curve.hpp"
+#include "typedefs.hpp"
+
+namespace PPMD {
+
+/*
+ * Reorders a ParticleGroup for spatial locality. Particles within each cell
+ * are sorted by the Morton key of the fine MeshHierarchy cell that contains
+ * them and the cell traversal order of the ParticleGroup is set to the Morton
+ * order of the coarse cells. The cells of the ParticleGroup must be the coarse
+ * cells of the MeshHierarchy in linear index order, with the first dimension
+ * the fastest running index.
+ */
+class ParticleSort {
+  private:
+    int step_count;
+    BufferDevice<std::uint64_t> d_keys;
+    BufferDevice<int> d_layer_map;
+    // Orders of the particles of each cell before and after a pass of the
+    // radix sort, the first block of each cell, the cell of each block, the
+    // bucket counts of each block and the first position of each bucket of
+    // each cell.
+    BufferDevice<int> d_order;
+    BufferDevice<int> d_block_offsets;
+    BufferDevice<int> d_block_cells;
+    BufferDevice<int> d_block_counts;
+    BufferDevice<int> d_bucket_offsets;
+    // Number of key bits sorted by each pass of the radix sort.
+    static constexpr int radix_bits = 8;
+    // Number of consecutive particles of a cell processed by one work item
+    // in each pass of the radix sort.
+    static constexpr int block_size = 256;
+
+  public:
+    ParticleGroup &particle_group;
+    MeshHierarchy &mesh_hierarchy;
+    // Number of calls to step between sorts, 0 disables sorting in step.
+    const int sort_frequency;
+
+    ParticleSort(ParticleGroup &particle_group, MeshHierarchy &mesh_hierarchy,
+                 const int sort_frequency = 1)
+        : particle_group(particle_group), mesh_hierarchy(mesh_hierarchy),
+          sort_frequency(sort_frequency), step_count(0),
+          d_keys(particle_group.sycl_target, 0),
+          d_layer_map(particle_group.sycl_target, 0),
+          d_order(particle_group.sycl_target, 0),
+          d_block_offsets(particle_group.sycl_target, 0),
+          d_block_cells(particle_group.sycl_target, 0),
+          d_block_counts(particle_group.sycl_target, 0),
+          d_bucket_offsets(particle_group.sycl_target, 0) {
+        PPMDASSERT(mesh_hierarchy.ncells_coarse ==
+                       particle_group.domain.mesh.get_cell_count(),
+                   "ParticleGroup cells are not the coarse mesh cells");
+        PPMDASSERT(mesh_hierarchy.ndim <= 3, "ndim must be <= 3");
+        PPMDASSERT(mesh_hierarchy.subdivision_order * mesh_hierarchy.ndim <= 64,
+                   "Too many fine cells for a 64 bit key");
+        PPMDASSERT(sort_frequency >= 0, "Negative sort frequency passed");
+        auto cell_order =
+            morton_cell_order(mesh_hierarchy.ndim, mesh_hierarchy.dims);
+        particle_group.set_cell_order(cell_order);
+    };
+
+    inline void sort();
+    template <int NDIM> inline void compute_keys();
+
+    /*
+     * Advance the step counter and sort if sort_frequency steps have passed
+     * since the last sort. Returns true if a sort was performed.
+     */
+    inline bool step() {
+        if (this->sort_frequency == 0) {
+            return false;
+        }
+        this->step_count++;
+        if (this->step_count >= this->sort_frequency) {
+            this->step_count = 0;
+            this->sort();
+            return true;
+        }
+        return false;
+    }
+};
+
+/*
+ * Compute the Morton key of the fine cell containing each particle.
+ */
+template <int NDIM> inline void ParticleSort::compute_keys() {
+    const int nrow_max = this->particle_group.get_nrow_max();
+    const int ncell = this->particle_group.domain.mesh.get_cell_count();
+    const auto mesh_hierarchy_device =
+        this->mesh_hierarchy.get_device_view<NDIM>();
+    const int *d_cell_offsets = this->particle_group.get_device_cell_offsets();
+    auto d_positions =
+        this->particle_group.position_dat->cell_dat.device_accessor();
+    std::uint64_t *d_keys = this->d_keys.ptr;
+    // The positions may be written by loops submitted without waiting.
+    const std::vector<sycl::event> deps =
+        this->particle_group.sycl_target.get_compute_events();
+
+    this->particle_group.sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.depends_on(deps);
+            cgh.parallel_for<>(
+                sycl::range<2>(ncell, nrow_max), [=](sycl::id<2> idx) {
+                    const int cellx = idx[0];
+                    const int layerx = idx[1];
+                    const int offset = d_cell_offsets[cellx];
+                    if (layerx < d_cell_offsets[cellx + 1] - offset) {
+                        double position[NDIM];
+                        for (int dimx = 0; dimx < NDIM; dimx++) {
+                            position[dimx] = d_positions[cellx][dimx][layerx];
+                        }
+                        int index_coarse[NDIM];
+                        int index_fine[NDIM];
+                        mesh_hierarchy_device.position_to_tuple(
+                            position, index_coarse, index_fine);
+                        d_keys[offset + layerx] = morton_encode(
+                            NDIM, index_fine,
+                            mesh_hierarchy_device.subdivision_order);
+                    }
+                });
+        })
+        .wait();
+}
+
+/*
+ * Sort the particles within each cell by the Morton key of their fine cell.
+ * The sort is a stable least significant digit radix sort where each pass is
+ * a counting sort of radix_bits bits of the key within each cell, hence the
+ * cost is linear in the occupancy of each cell. The particles of each cell
+ * are split into blocks of block_size particles such that densely occupied
+ * cells are sorted by many work items. The blocks are numbered consecutively
+ * over the cells, hence the number of blocks is set by the occupancy of each
+ * cell rather than by the most occupied cell. Each block counts its particles
+ * in each bucket, the counts are scanned over the blocks of each bucket of
+ * each cell and then over the buckets of each cell, then each block places
+ * its particles.
+ */
+inline void ParticleSort::sort() {
+    const int nrow_max = this->particle_group.get_nrow_max();
+    const int npart_local = this->particle_group.get_npart_local();
+    const int key_bits =
+        this->mesh_hierarchy.subdivision_order * this->mesh_hierarchy.ndim;
+    if ((nrow_max == 0) || (key_bits == 0)) {
+        return;
+    }
+    auto &profiler = this->particle_group.sycl_target.profiler;
+    profiler.start_region("ParticleSort::sort");
+    const int ncell = this->particle_group.domain.mesh.get_cell_count();
+    const int digit_bits = std::min(key_bits, ParticleSort::radix_bits);
+    const int nbucket = 1 << digit_bits;
+    const int npass = (key_bits + digit_bits - 1) / digit_bits;
+    this->d_keys.realloc_no_copy(npart_local);
+    this->d_layer_map.realloc_no_copy(npart_local);
+    this->d_order.realloc_no_copy(2 * npart_local);
+
+    // number the blocks of each cell from the first block of the cell
+    const int block_size = ParticleSort::block_size;
+    auto &npart_cell = this->particle_group.get_npart_cell();
+    std::vector<int> block_offsets(ncell + 1);
+    int nblock = 0;
+    for (int cellx = 0; cellx < ncell; cellx++) {
+        block_offsets[cellx] = nblock;
+        nblock += (npart_cell[cellx] + block_size - 1) / block_size;
+    }
+    block_offsets[ncell] = nblock;
+    std::vector<int> block_cells(nblock);
+    for (int cellx = 0; cellx < ncell; cellx++) {
+        for (int blockx = block_offsets[cellx];
+             blockx < block_offsets[cellx + 1]; blockx++) {
+            block_cells[blockx] = cellx;
+        }
+    }
+    this->d_block_offsets.set(block_offsets);
+    this->d_block_cells.set(block_cells);
+    this->d_block_counts.realloc_no_copy(((size_t)nbucket) * nblock);
+    this->d_bucket_offsets.realloc_no_copy(ncell * nbucket);
+
+    const int *d_cell_offsets = this->particle_group.get_device_cell_offsets();
+    const std::uint64_t *d_keys = this->d_keys.ptr;
+    int *d_layer_map = this->d_layer_map.ptr;
+    const int *d_block_offsets = this->d_block_offsets.ptr;
+    const int *d_block_cells = this->d_block_cells.ptr;
+    // Indexed by bucket then block.
+    int *d_block_counts = this->d_block_counts.ptr;
+    int *d_bucket_offsets = this->d_bucket_offsets.ptr;
+    auto &queue = this->particle_group.sycl_target.queue;
+
+    switch (this->mesh_hierarchy.ndim) {
+    case 1:
+        this->compute_keys<1>();
+        break;
+    case 2:
+        this->compute_keys<2>();
+        break;
+    default:
+        this->compute_keys<3>();
+    }
+
+    // Each pass reads the order of the previous pass, the first pass starts
+    // from the current layers, and writes the order stably sorted by one
+    // digit.
+    for (int passx = 0; passx < npass; passx++) {
+        const int *d_order_in = this->d_order.ptr + (passx % 2) * npart_local;
+        int *d_order_out = this->d_order.ptr + ((passx + 1) % 2) * npart_local;
+        const int shift = passx * digit_bits;
+        const std::uint64_t mask = nbucket - 1;
+        const bool first_pass = (passx == 0);
+        // The layer and the bucket of row rowx of a cell in this pass and the
+        // rows of a block of a cell.
+        auto lambda_layer = [=](const int offset, const int rowx) {
+            return first_pass ? rowx : d_order_in[offset + rowx];
+        };
+        auto lambda_bucket = [=](const int offset, const int layerx) {
+            return (int)((d_keys[offset + layerx] >> shift) & mask);
+        };
+        auto lambda_rows = [=](const int cellx, const int blockx, int &start,
+                               int &end) {
+            const int nrow = d_cell_offsets[cellx + 1] - d_cell_offsets[cellx];
+            start = (blockx - d_block_offsets[cellx]) * block_size;
+            end = (nrow - start < block_size) ? nrow : start + block_size;
+        };
+
+        queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(
+                    sycl::range<1>(nblock), [=](sycl::id<1> idx) {
+                        const int blockx = idx[0];
+                        const int cellx = d_block_cells[blockx];
+                        int *counts = d_block_counts + blockx;
+                        for (int bucketx = 0; bucketx < nbucket; bucketx++) {
+                            counts[((size_t)bucketx) * nblock] = 0;
+                        }
+                        const int offset = d_cell_offsets[cellx];
+                        int start, end;
+                        lambda_rows(cellx, blockx, start, end);
+                        for (int rowx = start; rowx < end; rowx++) {
+                            const int bucketx = lambda_bucket(
+                                offset, lambda_layer(offset, rowx));
+                            counts[((size_t)bucketx) * nblock]++;
+                        }
+                    });
+            })
+            .wait();
+        queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(
+                    sycl::range<2>(ncell, nbucket), [=](sycl::id<2> idx) {
+                        const int cellx = idx[0];
+                        const int bucketx = idx[1];
+                        int *counts =
+                            d_block_counts + ((size_t)bucketx) * nblock;
+                        int count = 0;
+                        for (int blockx = d_block_offsets[cellx];
+                             blockx < d_block_offsets[cellx + 1]; blockx++) {
+                            const int count_block = counts[blockx];
+                            counts[blockx] = count;
+                            count += count_block;
+                        }
+                        d_bucket_offsets[cellx * nbucket + bucketx] = count;
+                    });
+            })
+            .wait();
+        queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(sycl::range<1>(ncell), [=](sycl::id<1> idx) {
+                    const int cellx = idx[0];
+                    int *offsets = d_bucket_offsets + cellx * nbucket;
+                    int count = 0;
+                    for (int bucketx = 0; bucketx < nbucket; bucketx++) {
+                        const int count_bucket = offsets[bucketx];
+                        offsets[bucketx] = count;
+                        count += count_bucket;
+                    }
+                });
+            })
+            .wait();
+        queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(
+                    sycl::range<1>(nblock), [=](sycl::id<1> idx) {
+                        const int blockx = idx[0];
+                        const int cellx = d_block_cells[blockx];
+                        int *counts = d_block_counts + blockx;
+                        const int *offsets = d_bucket_offsets + cellx * nbucket;
+                        const int offset = d_cell_offsets[cellx];
+                        int start, end;
+                        lambda_rows(cellx, blockx, start, end);
+                        for (int rowx = start; rowx < end; rowx++) {
+                            const int layerx = lambda_layer(offset, rowx);
+                            const int bucketx = lambda_bucket(offset, layerx);
+                            const int position =
+                                offsets[bucketx] +
+                                counts[((size_t)bucketx) * nblock]++;
+                            d_order_out[offset + position] = layerx;
+                        }
+                    });
+            })
+            .wait();
+    }
+
+    // invert the sorted order to give the new layer of each particle
+    const int *d_order = this->d_order.ptr + (npass % 2) * npart_local;
+    queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(
+                sycl::range<2>(ncell, nrow_max), [=](sycl::id<2> idx) {
+                    const int cellx = idx[0];
+                    const int rowx = idx[1];
+                    const int offset = d_cell_offsets[cellx];
+                    if (rowx < d_cell_offsets[cellx + 1] - offset) {
+                        d_layer_map[offset + d_order[offset + rowx]] = rowx;
+                    }
+                });
+        })
+        .wait();
+
+    this->particle_group.permute_layers(d_layer_map);
+    profiler.end_region();
+}
+
+} // namespace PPMD
+
+#endif
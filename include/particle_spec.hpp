@@ -7,6 +7,8 @@
 #include <string>
 #include <vector>
 
+#include "access.hpp"
+#include "type_map.hpp"
 #include "typedefs.hpp"
 
 namespace PPMD {
@@ -14,6 +16,7 @@ namespace PPMD {
 template <typename U> class Sym {
   private:
   public:
+    typedef U value_type;
     const std::string name;
     Sym(const std::string name) : name(name) {}
 
@@ -28,35 +31,51 @@ template <typename T> class ParticleProp {
     const std::string name;
     const int ncomp;
     const bool positions;
-    ParticleProp(const Sym<T> sym, int ncomp, bool positions = false)
-        : sym(sym), name(sym.name), ncomp(ncomp), positions(positions) {}
+    // Device layout of the ParticleDat created for this property.
+    const CellDatLayout layout;
+    ParticleProp(const Sym<T> sym, int ncomp, bool positions = false,
+                 CellDatLayout layout = CellDatLayout::soa)
+        : sym(sym), name(sym.name), ncomp(ncomp), positions(positions),
+          layout(layout) {}
 };
 
+template <typename T> using ParticlePropVector = std::vector<ParticleProp<T>>;
+
+/*
+ * Describes the properties of a particle. Properties may have any of the
+ * element types in ParticleTypes.
+ */
 class ParticleSpec {
   private:
-    template <typename... T> void push(T... args) { this->push(args...); }
-    void push(ParticleProp<PPMD::REAL> pp) {
-        this->properties_real.push_back(pp);
-    }
-    void push(ParticleProp<PPMD::INT> pp) {
-        this->properties_int.push_back(pp);
-    }
-    template <typename... T> void push(ParticleProp<PPMD::REAL> pp, T... args) {
-        this->properties_real.push_back(pp);
-        this->push(args...);
-    }
-    template <typename... T> void push(ParticleProp<PPMD::INT> pp, T... args) {
-        this->properties_int.push_back(pp);
+    void push(){};
+    template <typename T, typename... U>
+    void push(ParticleProp<T> pp, U... args) {
+        this->properties.template get<T>().push_back(pp);
         this->push(args...);
     }
 
   public:
-    std::vector<ParticleProp<PPMD::REAL>> properties_real;
-    std::vector<ParticleProp<PPMD::INT>> properties_int;
+    TypeMap<ParticlePropVector, ParticleTypes> properties;
 
+    ParticleSpec(){};
     template <typename... T> ParticleSpec(T... args) { this->push(args...); };
 
     ~ParticleSpec(){};
+
+    /*
+     * Add a property to the specification.
+     */
+    template <typename T> inline void add_property(ParticleProp<T> pp) {
+        this->push(pp);
+    }
+
+    /*
+     * Get the properties with element type T.
+     */
+    template <typename T>
+    inline std::vector<ParticleProp<T>> &get_properties() {
+        return this->properties.template get<T>();
+    }
 };
 
 } // namespace PPMD
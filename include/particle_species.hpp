@@ -0,0 +1,117 @@
+#ifndef _PPMD_PARTICLE_SPECIES
+#define _PPMD_PARTICLE_SPECIES
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compute_target.hpp"
+#include "domain.hpp"
+#include "particle_group.hpp"
+#include "particle_spec.hpp"
+#include "typedefs.hpp"
+
+namespace PPMD {
+
+/*
+ * A set of particle species, e.g. electrons and ions, that share a Domain,
+ * and hence a cell structure and decomposition, and a SYCLTarget. Each
+ * species is a ParticleGroup with its own ParticleSpec. Operations that take
+ * a ParticleSpeciesGroup, e.g. LoadBalance::migrate and the exchanges of
+ * ParticleSpeciesHalo, process all species in one pass and batch the
+ * messages of all species into one communication round.
+ */
+class ParticleSpeciesGroup {
+  private:
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<ParticleGroup>> species;
+    std::map<std::string, int> species_index;
+    std::vector<PPMD::INT> npart_cell;
+
+  public:
+    Domain domain;
+    SYCLTarget &sycl_target;
+
+    ParticleSpeciesGroup(Domain domain, SYCLTarget &sycl_target)
+        : domain(domain), sycl_target(sycl_target){};
+
+    /*
+     * Add a species with a name that is not already in use and return its
+     * ParticleGroup.
+     */
+    inline ParticleGroup &add_species(const std::string name,
+                                      ParticleSpec &particle_spec) {
+        PPMDASSERT(this->species_index.count(name) == 0,
+                   "Species name already in use");
+        this->species_index[name] = this->species.size();
+        this->names.push_back(name);
+        this->species.push_back(std::make_shared<ParticleGroup>(
+            this->domain, particle_spec, this->sycl_target));
+        return *this->species.back();
+    }
+
+    inline int get_nspecies() { return this->species.size(); }
+    inline const std::vector<std::string> &get_names() { return this->names; }
+    inline ParticleGroup &get_species(const int index) {
+        PPMDASSERT((index >= 0) && (index < this->species.size()),
+                   "Bad species index");
+        return *this->species[index];
+    }
+    inline ParticleGroup &operator[](const std::string name) {
+        PPMDASSERT(this->species_index.count(name) > 0, "Unknown species");
+        return *this->species[this->species_index.at(name)];
+    }
+
+    /*
+     * Call func(name, particle_group) for each species in the order the
+     * species were added.
+     */
+    template <typename FUNC> inline void for_each_species(FUNC func) {
+        for (std::size_t sx = 0; sx < this->species.size(); sx++) {
+            func(this->names[sx], *this->species[sx]);
+        }
+    }
+
+    /*
+     * Get pointers to the ParticleGroups of the species in the order the
+     * species were added.
+     */
+    inline std::vector<ParticleGroup *> get_particle_groups() {
+        std::vector<ParticleGroup *> groups;
+        for (auto &group : this->species) {
+            groups.push_back(group.get());
+        }
+        return groups;
+    }
+
+    /*
+     * Number of particles of all species on this rank.
+     */
+    inline int get_npart_local() {
+        int npart = 0;
+        for (auto &group : this->species) {
+            npart += group->get_npart_local();
+        }
+        return npart;
+    }
+
+    /*
+     * Number of particles of all species in each cell.
+     */
+    inline std::vector<PPMD::INT> &get_npart_cell() {
+        this->npart_cell.assign(this->domain.mesh.get_cell_count(), 0);
+        for (auto &group : this->species) {
+            auto &npart_cell_species = group->get_npart_cell();
+            for (std::size_t cellx = 0; cellx < this->npart_cell.size();
+                 cellx++) {
+                this->npart_cell[cellx] += npart_cell_species[cellx];
+            }
+        }
+        return this->npart_cell;
+    }
+};
+
+} // namespace PPMD
+
+#endif
@@ -0,0 +1,439 @@
+#ifndef _PPMD_PARTICLE_SUB_GROUP
+#define _PPMD_PARTICLE_SUB_GROUP
+
+#include <CL/sycl.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compute_target.hpp"
+#include "particle_group.hpp"
+#include "particle_loop.hpp"
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * The particles of a ParticleGroup for which a predicate holds. The predicate
+ * is called on the device as predicate(cell, layer) and returns true for the
+ * selected particles, it should access particle data in the same way as the
+ * kernel of a ParticleLoop. The selection is stored as a compacted list of
+ * the cells and layers of the selected particles, grouped by cell in
+ * increasing cell order then in increasing layer order, such that loops and
+ * reductions over the selection cost work proportional to its size.
+ *
+ * The selection is computed when first required and reused until particles
+ * are added to, removed from or reordered in the ParticleGroup, or one of the
+ * dats read by the predicate is modified, see CellDat::get_version. The dats
+ * read by the predicate may be declared with dat_access, otherwise a
+ * modification of any dat in the group invalidates the selection. Device
+ * writes that are not made through a ParticleLoop, or followed by
+ * CellDat::mark_device_modified, are not detected and require a call to
+ * invalidate.
+ */
+template <typename PREDICATE> class ParticleSubGroupT {
+  private:
+    BufferDevice<int> d_flags;
+    BufferDevice<int> d_counts;
+    BufferDevice<int> d_cell_offsets;
+    BufferDevice<int> d_cells;
+    BufferDevice<int> d_layers;
+    std::vector<int> npart_cell;
+    std::vector<int> cell_offsets;
+    int npart_local;
+
+    bool valid;
+    std::int64_t group_version;
+    std::int64_t dat_version;
+
+    /*
+     * Sum of the versions of the dats read by the predicate. Versions only
+     * increase hence the sum changes if and only if one of them changes.
+     */
+    inline std::int64_t get_dat_version() {
+        std::int64_t version = 0;
+        if (this->accesses_declared) {
+            for (auto &access : this->accesses) {
+                version += access.get_version();
+            }
+        } else {
+            this->particle_group.for_each_particle_dat(
+                [&](auto &dat) { version += dat->cell_dat.get_version(); });
+        }
+        return version;
+    }
+
+    inline void select();
+
+  public:
+    ParticleGroup &particle_group;
+    const PREDICATE predicate;
+    const std::vector<ParticleDatAccess> accesses;
+    const bool accesses_declared;
+
+    ParticleSubGroupT(ParticleGroup &particle_group, PREDICATE predicate)
+        : d_flags(particle_group.sycl_target, 0),
+          d_counts(particle_group.sycl_target, 0),
+          d_cell_offsets(particle_group.sycl_target, 0),
+          d_cells(particle_group.sycl_target, 0),
+          d_layers(particle_group.sycl_target, 0), npart_local(0),
+          valid(false), group_version(0), dat_version(0),
+          particle_group(particle_group), predicate(predicate),
+          accesses_declared(false){};
+
+    ParticleSubGroupT(ParticleGroup &particle_group, PREDICATE predicate,
+                      std::vector<ParticleDatAccess> accesses)
+        : d_flags(particle_group.sycl_target, 0),
+          d_counts(particle_group.sycl_target, 0),
+          d_cell_offsets(particle_group.sycl_target, 0),
+          d_cells(particle_group.sycl_target, 0),
+          d_layers(particle_group.sycl_target, 0), npart_local(0),
+          valid(false), group_version(0), dat_version(0),
+          particle_group(particle_group), predicate(predicate),
+          accesses(accesses), accesses_declared(true){};
+
+    /*
+     * Returns true if the stored selection is up to date.
+     */
+    inline bool is_valid() {
+        return this->valid &&
+               (this->group_version == this->particle_group.get_version()) &&
+               (this->dat_version == this->get_dat_version());
+    }
+
+    /*
+     * Discard the stored selection such that it is recomputed when next
+     * required.
+     */
+    inline void invalidate() { this->valid = false; }
+
+    /*
+     * Recompute the selection if it is out of date.
+     */
+    inline void update() {
+        if (!this->is_valid()) {
+            this->select();
+        }
+    }
+
+    inline int get_npart_local() {
+        this->update();
+        return this->npart_local;
+    }
+    /*
+     * Number of selected particles in each cell.
+     */
+    inline std::vector<int> &get_npart_cell() {
+        this->update();
+        return this->npart_cell;
+    }
+    /*
+     * Exclusive prefix sum of the number of selected particles in each cell
+     * (ncell + 1 entries), the selected particles of a cell are held in this
+     * range of the cell and layer lists.
+     */
+    inline std::vector<int> &get_cell_offsets() {
+        this->update();
+        return this->cell_offsets;
+    }
+    inline const int *get_device_cell_offsets() {
+        this->update();
+        return this->d_cell_offsets.ptr;
+    }
+    /*
+     * Device pointers to the cells and layers of the selected particles
+     * (get_npart_local entries).
+     */
+    inline const int *get_device_cells() {
+        this->update();
+        return this->d_cells.ptr;
+    }
+    inline const int *get_device_layers() {
+        this->update();
+        return this->d_layers.ptr;
+    }
+
+    /*
+     * Sum kernel(cell, layer), which returns a T, over the selected particles
+     * on the device. The sum is computed in a fixed order hence the result is
+     * reproducible.
+     */
+    template <typename T, typename KERNEL> inline T reduce_sum(KERNEL kernel);
+};
+
+/*
+ * Evaluate the predicate for every particle, count the selected particles in
+ * each cell, then write the cells and layers of the selected particles of
+ * each cell from the scanned counts.
+ */
+template <typename PREDICATE>
+inline void ParticleSubGroupT<PREDICATE>::select() {
+    auto &sycl_target = this->particle_group.sycl_target;
+    const int ncell = this->particle_group.get_ncell();
+    const int nrow_max = this->particle_group.get_nrow_max();
+    const int npart_group = this->particle_group.get_npart_local();
+
+    // The predicate only reads, the versions of the dats are not changed.
+    assert_particle_loop_dats_resident(this->particle_group, this->accesses,
+                                       this->accesses_declared);
+    if (this->accesses_declared) {
+        for (auto &access : this->accesses) {
+            access.push_host_cells();
+        }
+    } else {
+        this->particle_group.for_each_particle_dat(
+            [&](auto &dat) { dat->cell_dat.push_host_cells(); });
+    }
+
+    sycl_target.profiler.start_region("ParticleSubGroup::select");
+    this->npart_cell.assign(ncell, 0);
+    this->cell_offsets.assign(ncell + 1, 0);
+    this->d_flags.realloc_no_copy(npart_group);
+    this->d_counts.realloc_no_copy(ncell);
+
+    // The predicate reads dats that loops submitted without waiting may
+    // write.
+    const std::vector<sycl::event> deps = sycl_target.get_compute_events();
+    if (npart_group > 0) {
+        const PREDICATE k_predicate = this->predicate;
+        const int *k_group_offsets =
+            this->particle_group.get_device_cell_offsets();
+        int *k_flags = this->d_flags.ptr;
+        int *k_counts = this->d_counts.ptr;
+
+        sycl_target.queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.depends_on(deps);
+                cgh.parallel_for<>(
+                    sycl::range<2>(ncell, nrow_max), [=](sycl::id<2> idx) {
+                        const int cellx = idx[0];
+                        const int layerx = idx[1];
+                        const int offset = k_group_offsets[cellx];
+                        if (layerx < k_group_offsets[cellx + 1] - offset) {
+                            k_flags[offset + layerx] =
+                                k_predicate(cellx, layerx) ? 1 : 0;
+                        }
+                    });
+            })
+            .wait();
+        sycl_target.queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(
+                    sycl::range<1>(ncell), [=](sycl::id<1> idx) {
+                        const int cellx = idx[0];
+                        int count = 0;
+                        for (int px = k_group_offsets[cellx];
+                             px < k_group_offsets[cellx + 1]; px++) {
+                            count += k_flags[px];
+                        }
+                        k_counts[cellx] = count;
+                    });
+            })
+            .wait();
+        sycl_target.queue
+            .memcpy(this->npart_cell.data(), k_counts, ncell * sizeof(int))
+            .wait();
+    }
+
+    for (int cellx = 0; cellx < ncell; cellx++) {
+        this->cell_offsets[cellx + 1] =
+            this->cell_offsets[cellx] + this->npart_cell[cellx];
+    }
+    this->npart_local = this->cell_offsets[ncell];
+    this->d_cell_offsets.set(this->cell_offsets);
+    this->d_cells.realloc_no_copy(this->npart_local);
+    this->d_layers.realloc_no_copy(this->npart_local);
+
+    if (this->npart_local > 0) {
+        const int *k_group_offsets =
+            this->particle_group.get_device_cell_offsets();
+        const int *k_flags = this->d_flags.ptr;
+        const int *k_cell_offsets = this->d_cell_offsets.ptr;
+        int *k_cells = this->d_cells.ptr;
+        int *k_layers = this->d_layers.ptr;
+        sycl_target.queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(
+                    sycl::range<1>(ncell), [=](sycl::id<1> idx) {
+                        const int cellx = idx[0];
+                        const int offset = k_group_offsets[cellx];
+                        const int nrow = k_group_offsets[cellx + 1] - offset;
+                        int index = k_cell_offsets[cellx];
+                        for (int layerx = 0; layerx < nrow; layerx++) {
+                            if (k_flags[offset + layerx]) {
+                                k_cells[index] = cellx;
+                                k_layers[index] = layerx;
+                                index++;
+                            }
+                        }
+                    });
+            })
+            .wait();
+    }
+    sycl_target.profiler.end_region();
+
+    this->valid = true;
+    this->group_version = this->particle_group.get_version();
+    this->dat_version = this->get_dat_version();
+}
+
+template <typename PREDICATE>
+template <typename T, typename KERNEL>
+inline T ParticleSubGroupT<PREDICATE>::reduce_sum(KERNEL kernel) {
+    this->update();
+    T sum = 0;
+    const int npart = this->npart_local;
+    if (npart == 0) {
+        return sum;
+    }
+    PPMDASSERT(this->particle_group.all_resident(),
+               "All cells must be resident on the device, see "
+               "ParticleResidency::page_in_all");
+    this->particle_group.for_each_particle_dat(
+        [&](auto &dat) { dat->cell_dat.push_host_cells(); });
+
+    auto &sycl_target = this->particle_group.sycl_target;
+    const int block_size = 256;
+    const int nblock = (npart + block_size - 1) / block_size;
+    BufferDevice<T> d_partial(sycl_target, nblock);
+    const int *k_cells = this->d_cells.ptr;
+    const int *k_layers = this->d_layers.ptr;
+    T *k_partial = d_partial.ptr;
+    const std::vector<sycl::event> deps = sycl_target.get_compute_events();
+    sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.depends_on(deps);
+            cgh.parallel_for<>(sycl::range<1>(nblock), [=](sycl::id<1> idx) {
+                const int start = idx[0] * block_size;
+                const int end =
+                    (npart - start < block_size) ? npart : start + block_size;
+                T partial = 0;
+                for (int px = start; px < end; px++) {
+                    partial += kernel(k_cells[px], k_layers[px]);
+                }
+                k_partial[idx] = partial;
+            });
+        })
+        .wait();
+    std::vector<T> partial(nblock);
+    sycl_target.queue.memcpy(partial.data(), k_partial, nblock * sizeof(T))
+        .wait();
+    for (int blockx = 0; blockx < nblock; blockx++) {
+        sum += partial[blockx];
+    }
+    return sum;
+}
+
+template <typename PREDICATE>
+using ParticleSubGroupShPtr = std::shared_ptr<ParticleSubGroupT<PREDICATE>>;
+
+template <typename PREDICATE>
+inline ParticleSubGroupShPtr<PREDICATE>
+ParticleSubGroup(ParticleGroup &particle_group, PREDICATE predicate) {
+    return std::make_shared<ParticleSubGroupT<PREDICATE>>(particle_group,
+                                                          predicate);
+}
+template <typename PREDICATE>
+inline ParticleSubGroupShPtr<PREDICATE>
+ParticleSubGroup(ParticleGroup &particle_group, PREDICATE predicate,
+                 std::vector<ParticleDatAccess> accesses) {
+    return std::make_shared<ParticleSubGroupT<PREDICATE>>(
+        particle_group, predicate, accesses);
+}
+
+/*
+ * Executes a kernel once for every particle in a ParticleSubGroup. The kernel
+ * is called on the device as kernel(cell, layer) as for a ParticleLoop and
+ * the accesses of the kernel may be declared in the same way. The selection
+ * is brought up to date before the loop is submitted.
+ */
+template <typename PREDICATE, typename KERNEL>
+class ParticleSubGroupLoopT {
+  private:
+  public:
+    ParticleSubGroupShPtr<PREDICATE> sub_group;
+    const KERNEL kernel;
+    const std::string name;
+    const std::vector<ParticleDatAccess> accesses;
+    const bool accesses_declared;
+
+    ParticleSubGroupLoopT(const std::string name,
+                          ParticleSubGroupShPtr<PREDICATE> sub_group,
+                          KERNEL kernel)
+        : sub_group(sub_group), kernel(kernel), name(name),
+          accesses_declared(false){};
+
+    ParticleSubGroupLoopT(const std::string name,
+                          ParticleSubGroupShPtr<PREDICATE> sub_group,
+                          KERNEL kernel,
+                          std::vector<ParticleDatAccess> accesses)
+        : sub_group(sub_group), kernel(kernel), name(name),
+          accesses(accesses), accesses_declared(true){};
+
+    /*
+     * Submit the loop to the compute queue and return the event of the
+     * kernel.
+     */
+    inline sycl::event submit() {
+        auto &particle_group = this->sub_group->particle_group;
+        auto &sycl_target = particle_group.sycl_target;
+        // The selection is taken before the sync marks the written dats as
+        // modified, such that it is made at most once here and is made again
+        // when next required if the loop wrote a dat read by the predicate.
+        this->sub_group->update();
+        const int npart = this->sub_group->get_npart_local();
+        const int *k_cells = this->sub_group->get_device_cells();
+        const int *k_layers = this->sub_group->get_device_layers();
+        sync_particle_loop_dats(particle_group, this->accesses,
+                                this->accesses_declared);
+        if (npart == 0) {
+            return sycl::event();
+        }
+
+        sycl_target.profiler.start_region(this->name.c_str());
+        const KERNEL k_kernel = this->kernel;
+        const std::vector<sycl::event> deps = sycl_target.get_compute_events();
+        sycl::event event = sycl_target.queue.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(deps);
+            cgh.parallel_for<>(sycl::range<1>(npart), [=](sycl::id<1> idx) {
+                k_kernel(k_cells[idx], k_layers[idx]);
+            });
+        });
+        sycl_target.profiler.add_device_event(this->name.c_str(), event);
+        sycl_target.add_compute_event(event);
+        sycl_target.profiler.end_region();
+        return event;
+    }
+
+    /*
+     * Execute the loop and block until it is complete.
+     */
+    inline void execute() { this->submit().wait(); }
+};
+
+template <typename PREDICATE, typename KERNEL>
+using ParticleSubGroupLoopShPtr =
+    std::shared_ptr<ParticleSubGroupLoopT<PREDICATE, KERNEL>>;
+
+template <typename PREDICATE, typename KERNEL>
+inline ParticleSubGroupLoopShPtr<PREDICATE, KERNEL>
+ParticleLoop(const std::string name,
+             ParticleSubGroupShPtr<PREDICATE> sub_group, KERNEL kernel) {
+    return std::make_shared<ParticleSubGroupLoopT<PREDICATE, KERNEL>>(
+        name, sub_group, kernel);
+}
+template <typename PREDICATE, typename KERNEL>
+inline ParticleSubGroupLoopShPtr<PREDICATE, KERNEL>
+ParticleLoop(const std::string name,
+             ParticleSubGroupShPtr<PREDICATE> sub_group, KERNEL kernel,
+             std::vector<ParticleDatAccess> accesses) {
+    return std::make_shared<ParticleSubGroupLoopT<PREDICATE, KERNEL>>(
+        name, sub_group, kernel, accesses);
+}
+
+} // namespace PPMD
+
+#endif
@@ -2,14 +2,31 @@
 #define _PPMD
 
 #include "access.hpp"
+#include "affinity.hpp"
+#include "autotune.hpp"
+#include "boris_pusher.hpp"
+#include "cell_counting_sort.hpp"
 #include "cell_dat.hpp"
+#include "cell_dat_halo.hpp"
 #include "compute_target.hpp"
+#include "device_hash_map.hpp"
 #include "domain.hpp"
+#include "load_balance.hpp"
 #include "mesh_hierarchy.hpp"
 #include "particle_dat.hpp"
 #include "particle_group.hpp"
+#include "particle_halo.hpp"
+#include "particle_histogram.hpp"
+#include "particle_loop.hpp"
+#include "particle_residency.hpp"
 #include "particle_set.hpp"
+#include "particle_sort.hpp"
 #include "particle_spec.hpp"
+#include "particle_species.hpp"
+#include "particle_sub_group.hpp"
+#include "profiling.hpp"
+#include "space_filling_curve.hpp"
+#include "type_map.hpp"
 #include "typedefs.hpp"
 
 #endif
@@ -0,0 +1,302 @@
+#ifndef _PPMD_PROFILING
+#define _PPMD_PROFILING
+
+#include <CL/sycl.hpp>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mpi.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "communication.hpp"
+#include "typedefs.hpp"
+
+using namespace cl;
+
+namespace PPMD {
+
+/*
+ * Records named nested host regions, the execution time of device events and
+ * byte counts. Recording is switched on and off at runtime with enable and
+ * disable, when disabled each recording call returns after a single branch.
+ * Device timings require the queue to be created with the enable_profiling
+ * property, see device_profiling.
+ */
+class Profiler {
+  private:
+    struct Region {
+        std::string name;
+        double start;
+        double end;
+        int depth;
+    };
+    struct DeviceEvent {
+        std::string name;
+        double host_time;
+        sycl::event event;
+    };
+
+    std::chrono::high_resolution_clock::time_point time_origin;
+    std::vector<std::pair<std::string, double>> stack;
+    std::vector<Region> regions;
+    std::vector<DeviceEvent> device_events_pending;
+    std::vector<Region> device_regions;
+    std::map<std::string, std::int64_t> bytes;
+
+    /*
+     * Time in microseconds since the profiler was created.
+     */
+    inline double now() {
+        return std::chrono::duration<double, std::micro>(
+                   std::chrono::high_resolution_clock::now() -
+                   this->time_origin)
+            .count();
+    }
+
+    /*
+     * Read the profiling information of recorded device events. Blocks until
+     * the events are complete. Events without profiling information, e.g.
+     * from a queue created without the enable_profiling property, are
+     * discarded.
+     */
+    inline void resolve_device_events() {
+        for (auto &device_event : this->device_events_pending) {
+            auto &event = device_event.event;
+            event.wait();
+            std::uint64_t t_submit, t_start, t_end;
+            try {
+                t_submit = event.template get_profiling_info<
+                    sycl::info::event_profiling::command_submit>();
+                t_start = event.template get_profiling_info<
+                    sycl::info::event_profiling::command_start>();
+                t_end = event.template get_profiling_info<
+                    sycl::info::event_profiling::command_end>();
+            } catch (sycl::exception const &e) {
+                continue;
+            }
+            // Device timestamps are placed relative to the host time at which
+            // the event was recorded.
+            const double start = device_event.host_time +
+                                 ((double)(t_start - t_submit)) * 1.0e-3;
+            const double end = start + ((double)(t_end - t_start)) * 1.0e-3;
+            this->device_regions.push_back({device_event.name, start, end, 0});
+        }
+        this->device_events_pending.clear();
+    }
+
+  public:
+    bool enabled;
+    // Set if the queue was created with the enable_profiling property.
+    bool device_profiling;
+
+    Profiler()
+        : time_origin(std::chrono::high_resolution_clock::now()),
+          enabled(false), device_profiling(false){};
+
+    inline void enable() { this->enabled = true; }
+    inline void disable() { this->enabled = false; }
+
+    /*
+     * Start a named host region, regions may be nested.
+     */
+    inline void start_region(const char *name) {
+        if (!this->enabled) {
+            return;
+        }
+        this->stack.push_back({name, this->now()});
+    }
+
+    /*
+     * End the most recently started host region.
+     */
+    inline void end_region() {
+        if ((!this->enabled) || (this->stack.size() == 0)) {
+            return;
+        }
+        const double end = this->now();
+        auto &top = this->stack.back();
+        this->regions.push_back(
+            {top.first, top.second, end, (int)this->stack.size() - 1});
+        this->stack.pop_back();
+    }
+
+    /*
+     * Record the execution time of a device kernel or memcpy.
+     */
+    inline void add_device_event(const char *name, sycl::event event) {
+        if ((!this->enabled) || (!this->device_profiling)) {
+            return;
+        }
+        this->device_events_pending.push_back({name, this->now(), event});
+    }
+
+    /*
+     * Add to a named byte counter, e.g. for host to device transfers or MPI
+     * messages.
+     */
+    inline void add_bytes(const char *name, const std::int64_t nbytes) {
+        if (!this->enabled) {
+            return;
+        }
+        this->bytes[name] += nbytes;
+    }
+
+    /*
+     * Discard all recorded information.
+     */
+    inline void reset() {
+        this->stack.clear();
+        this->regions.clear();
+        this->device_events_pending.clear();
+        this->device_regions.clear();
+        this->bytes.clear();
+    }
+
+    /*
+     * Total time in seconds spent in each named region. Device events are
+     * reported with the prefix "device:".
+     */
+    inline std::map<std::string, double> get_region_totals() {
+        this->resolve_device_events();
+        std::map<std::string, double> totals;
+        for (auto &region : this->regions) {
+            totals[region.name] += (region.end - region.start) * 1.0e-6;
+        }
+        for (auto &region : this->device_regions) {
+            totals["device:" + region.name] +=
+                (region.end - region.start) * 1.0e-6;
+        }
+        return totals;
+    }
+
+    /*
+     * Get the byte counters.
+     */
+    inline std::map<std::string, std::int64_t> get_bytes() {
+        return this->bytes;
+    }
+
+    inline void write_chrome_trace(const std::string filename,
+                                   const int rank = 0);
+    inline void print_summary(MPI_Comm comm);
+};
+
+/*
+ * Write the recorded regions in the Chrome trace event format. Host regions
+ * are written to thread 0 and device events to thread 1 of process rank.
+ */
+inline void Profiler::write_chrome_trace(const std::string filename,
+                                         const int rank) {
+    this->resolve_device_events();
+    std::ofstream out(filename);
+    out << "{\"traceEvents\":[\n";
+    out << std::fixed << std::setprecision(3);
+    bool first = true;
+    auto lambda_write = [&](Region &region, const int tid,
+                            const char *category) {
+        out << (first ? "" : ",\n") << "{\"name\":\"" << region.name
+            << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"ts\":"
+            << region.start << ",\"dur\":" << (region.end - region.start)
+            << ",\"pid\":" << rank << ",\"tid\":" << tid << "}";
+        first = false;
+    };
+    for (auto &region : this->regions) {
+        lambda_write(region, 0, "host");
+    }
+    for (auto &region : this->device_regions) {
+        lambda_write(region, 1, "device");
+    }
+    out << "\n],\"otherData\":{";
+    first = true;
+    for (auto &counter : this->bytes) {
+        out << (first ? "" : ",") << "\"bytes:" << counter.first
+            << "\":" << counter.second;
+        first = false;
+    }
+    out << "}}\n";
+}
+
+/*
+ * Collective on comm. Print, on rank 0, the minimum, mean and maximum over
+ * all ranks of the time in each region and of each byte counter.
+ */
+inline void Profiler::print_summary(MPI_Comm comm) {
+    int rank, size;
+    MPICHK(MPI_Comm_rank(comm, &rank))
+    MPICHK(MPI_Comm_size(comm, &size))
+
+    std::map<std::string, double> values = this->get_region_totals();
+    for (auto &counter : this->bytes) {
+        values["bytes:" + counter.first] = (double)counter.second;
+    }
+
+    // Form the union of the names on all ranks.
+    std::string names_local;
+    for (auto &value : values) {
+        names_local += value.first + "\n";
+    }
+    int length_local = names_local.size();
+    std::vector<int> lengths(size);
+    MPICHK(MPI_Allgather(&length_local, 1, MPI_INT, lengths.data(), 1,
+                         MPI_INT, comm))
+    std::vector<int> displs(size);
+    int length_total = 0;
+    for (int rankx = 0; rankx < size; rankx++) {
+        displs[rankx] = length_total;
+        length_total += lengths[rankx];
+    }
+    std::vector<char> names_all(length_total + 1);
+    MPICHK(MPI_Allgatherv(names_local.data(), length_local, MPI_CHAR,
+                          names_all.data(), lengths.data(), displs.data(),
+                          MPI_CHAR, comm))
+    std::set<std::string> names;
+    std::string name;
+    for (int cx = 0; cx < length_total; cx++) {
+        if (names_all[cx] == '\n') {
+            names.insert(name);
+            name.clear();
+        } else {
+            name += names_all[cx];
+        }
+    }
+
+    const int nvalues = names.size();
+    std::vector<double> local(nvalues);
+    int index = 0;
+    for (auto &namex : names) {
+        local[index++] = (values.count(namex) > 0) ? values[namex] : 0.0;
+    }
+    std::vector<double> value_min(nvalues);
+    std::vector<double> value_max(nvalues);
+    std::vector<double> value_sum(nvalues);
+    MPICHK(MPI_Reduce(local.data(), value_min.data(), nvalues, MPI_DOUBLE,
+                      MPI_MIN, 0, comm))
+    MPICHK(MPI_Reduce(local.data(), value_max.data(), nvalues, MPI_DOUBLE,
+                      MPI_MAX, 0, comm))
+    MPICHK(MPI_Reduce(local.data(), value_sum.data(), nvalues, MPI_DOUBLE,
+                      MPI_SUM, 0, comm))
+
+    if (rank == 0) {
+        std::cout << std::left << std::setw(48) << "name" << std::right
+                  << std::setw(14) << "min" << std::setw(14) << "mean"
+                  << std::setw(14) << "max" << std::endl;
+        index = 0;
+        for (auto &namex : names) {
+            std::cout << std::left << std::setw(48) << namex << std::right
+                      << std::scientific << std::setprecision(4)
+                      << std::setw(14) << value_min[index] << std::setw(14)
+                      << value_sum[index] / size << std::setw(14)
+                      << value_max[index] << std::endl;
+            index++;
+        }
+    }
+}
+
+} // namespace PPMD
+
+#endif
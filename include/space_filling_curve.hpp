@@ -0,0 +1,76 @@
+#ifndef _PPMD_SPACE_FILLING_CURVE
+#define _PPMD_SPACE_FILLING_CURVE
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "typedefs.hpp"
+
+namespace PPMD {
+
+/*
+ * Interleave the lowest nbits bits of ndim non-negative indices to form a
+ * Morton (Z-order) key. Bit b of index d is placed at bit b * ndim + d of the
+ * key. Callable on the host and the device.
+ */
+inline std::uint64_t morton_encode(const int ndim, const int *index,
+                                   const int nbits) {
+    std::uint64_t key = 0;
+    for (int bitx = 0; bitx < nbits; bitx++) {
+        for (int dimx = 0; dimx < ndim; dimx++) {
+            const std::uint64_t bit = (index[dimx] >> bitx) & 1;
+            key |= bit << (bitx * ndim + dimx);
+        }
+    }
+    return key;
+}
+
+/*
+ * Number of bits required to represent every index in [0, n).
+ */
+inline int morton_nbits(const int n) {
+    int nbits = 0;
+    while ((1 << nbits) < n) {
+        nbits++;
+    }
+    return nbits;
+}
+
+/*
+ * Return the linear indices of the cells of a Cartesian grid, where the first
+ * dimension is the fastest running index, ordered along a Morton curve.
+ */
+inline std::vector<int> morton_cell_order(const int ndim,
+                                          const std::vector<int> &dims) {
+    PPMDASSERT(dims.size() >= ndim, "vector of dims too small");
+    PPMDASSERT(ndim <= 3, "ndim must be <= 3");
+    int ncells = 1;
+    int nbits = 0;
+    for (int dimx = 0; dimx < ndim; dimx++) {
+        ncells *= dims[dimx];
+        nbits = std::max(nbits, morton_nbits(dims[dimx]));
+    }
+
+    std::vector<std::uint64_t> keys(ncells);
+    for (int cellx = 0; cellx < ncells; cellx++) {
+        int index[3];
+        int linear = cellx;
+        for (int dimx = 0; dimx < ndim; dimx++) {
+            index[dimx] = linear % dims[dimx];
+            linear /= dims[dimx];
+        }
+        keys[cellx] = morton_encode(ndim, index, nbits);
+    }
+
+    std::vector<int> order(ncells);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&](const int a, const int b) { return keys[a] < keys[b]; });
+    return order;
+}
+
+} // namespace PPMD
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef _PPMD_TYPE_MAP
+#define _PPMD_TYPE_MAP
+
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+#include "typedefs.hpp"
+
+namespace PPMD {
+
+/*
+ * A list of types.
+ */
+template <typename... T> struct TypeList {};
+
+/*
+ * Additional element types for ParticleDats may be added by defining
+ * PPMD_EXTRA_PARTICLE_TYPES, including a leading comma, before including
+ * this header, e.g.
+ *      #define PPMD_EXTRA_PARTICLE_TYPES , int16_t, uint32_t
+ */
+#ifndef PPMD_EXTRA_PARTICLE_TYPES
+#define PPMD_EXTRA_PARTICLE_TYPES
+#endif
+
+/*
+ * The element types a ParticleDat, ParticleProp or ParticleSet may hold.
+ */
+typedef TypeList<PPMD::REAL, PPMD::INT, float, int32_t,
+                 uint8_t PPMD_EXTRA_PARTICLE_TYPES>
+    ParticleTypes;
+
+template <typename T> struct TypeNotFound : std::false_type {};
+
+/*
+ * The position of the type T in the types U.
+ */
+template <typename T, typename... U> struct TypeIndex {
+    static_assert(TypeNotFound<T>::value,
+                  "Type is not in the type list, see ParticleTypes.");
+};
+template <typename T, typename... U> struct TypeIndex<T, T, U...> {
+    static constexpr int value = 0;
+};
+template <typename T, typename V, typename... U>
+struct TypeIndex<T, V, U...> {
+    static constexpr int value = 1 + TypeIndex<T, U...>::value;
+};
+
+/*
+ * Holds one instance of C<T> for each type T in a TypeList, e.g. a map from
+ * Sym<T> to ParticleDatShPtr<T> for each element type.
+ */
+template <template <typename> class C, typename LIST> class TypeMap;
+
+template <template <typename> class C, typename... T>
+class TypeMap<C, TypeList<T...>> {
+  private:
+    std::tuple<C<T>...> values;
+
+  public:
+    /*
+     * Get the instance for the type U.
+     */
+    template <typename U> inline C<U> &get() {
+        static_assert(std::is_trivially_copyable<U>::value,
+                      "Element types must be trivially copyable.");
+        return std::get<TypeIndex<U, T...>::value>(this->values);
+    }
+
+    /*
+     * Call f on the instance for each type in the order of the type list.
+     */
+    template <typename F> inline void for_each(F f) {
+        std::apply([&](auto &...value) { (f(value), ...); }, this->values);
+    }
+};
+
+} // namespace PPMD
+
+#endif
@@ -6,6 +6,16 @@
 
 #define RESTRICT __restrict
 
+/*
+ * Requests vectorisation of the following loop when compiled with OpenMP,
+ * e.g. by the hipSYCL OpenMP CPU backend.
+ */
+#if defined(_OPENMP)
+#define PPMD_SIMD_LOOP _Pragma("omp simd")
+#else
+#define PPMD_SIMD_LOOP
+#endif
+
 namespace PPMD {
 
 #define PPMDASSERT(expr, msg)                                                  \
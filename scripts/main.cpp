@@ -21,6 +21,7 @@ int main(int argc, char **argv) {
                                };
 
     ParticleGroup A(domain, particle_spec, sycl_target);
+    A.enable_global_ids();
 
 
     A.add_particle_dat(ParticleDat(sycl_target, ParticleProp(Sym<PPMD::REAL>("FOO"), 3), cell_count));
@@ -46,7 +47,7 @@ int main(int argc, char **argv) {
 
     std::cout << "---------------" << std::endl;
 
-    A.add_particles_local(initial_distribution);
+    A.add_particles(initial_distribution);
 
     return 0;
     // ParticleLoop(
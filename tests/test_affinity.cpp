@@ -0,0 +1,44 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <ppmd.hpp>
+using namespace PPMD;
+
+TEST_CASE("test_partition_node_cpus") {
+    REQUIRE(parse_cpu_list("0-3,8,10-11\n") ==
+            std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    REQUIRE(parse_cpu_list("").size() == 0);
+
+    // two NUMA nodes of four CPUs and an empty node
+    std::vector<std::vector<int>> numa_cpus = {{0, 1, 2, 3}, {}, {4, 5, 6, 7}};
+
+    // one rank uses all the CPUs
+    REQUIRE(partition_node_cpus(numa_cpus, 1, 0) ==
+            std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7}));
+    // one NUMA node per rank
+    REQUIRE(partition_node_cpus(numa_cpus, 2, 0) ==
+            std::vector<int>({0, 1, 2, 3}));
+    REQUIRE(partition_node_cpus(numa_cpus, 2, 1) ==
+            std::vector<int>({4, 5, 6, 7}));
+    // ranks do not span NUMA nodes
+    REQUIRE(partition_node_cpus(numa_cpus, 3, 0) ==
+            std::vector<int>({0, 1, 2, 3}));
+    REQUIRE(partition_node_cpus(numa_cpus, 3, 1) == std::vector<int>({4, 5}));
+    REQUIRE(partition_node_cpus(numa_cpus, 3, 2) == std::vector<int>({6, 7}));
+    // more ranks than CPUs share CPUs
+    for (int rankx = 0; rankx < 16; rankx++) {
+        auto cpus = partition_node_cpus(numa_cpus, 16, rankx);
+        REQUIRE(cpus.size() == 1);
+        REQUIRE(cpus[0] == (rankx / 8) * 4 + (rankx % 8) % 4);
+    }
+
+    // the SYCLTarget holds the intra-node communicator of its communicator
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    int size_intra;
+    MPI_Comm_size(sycl_target.comm_pair.comm_intra, &size_intra);
+    REQUIRE(sycl_target.comm_pair.size_intra == size_intra);
+    REQUIRE(sycl_target.comm_pair.comm_parent == MPI_COMM_WORLD);
+    sycl_target.free();
+    REQUIRE(sycl_target.comm_pair.comm_intra == MPI_COMM_NULL);
+    // further calls, e.g. by the destructor, have no effect
+    sycl_target.free();
+}
@@ -0,0 +1,124 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <ppmd.hpp>
+using namespace PPMD;
+
+TEST_CASE("test_autotune_cache") {
+
+    const std::string filename = "test_autotune_cache.txt";
+    std::remove(filename.c_str());
+
+    Autotuner autotuner;
+    autotuner.enabled = true;
+    autotuner.nrepeat = 2;
+    autotuner.filename = filename;
+    autotuner.write_cache = true;
+
+    REQUIRE(Autotuner::size_bucket(0) == 0);
+    REQUIRE(Autotuner::size_bucket(1) == 1);
+    REQUIRE(Autotuner::size_bucket(5) == 3);
+    REQUIRE(Autotuner::size_bucket(7) == 3);
+
+    const std::string key = "test kernel:3";
+    std::vector<KernelConfig> candidates = {{0, 0}, {1, 64}, {0, 128}};
+    std::vector<double> times = {2.0, 1.0, 3.0};
+    KernelConfig config;
+    for (int cx = 0; cx < 3; cx++) {
+        for (int rx = 0; rx < 2; rx++) {
+            REQUIRE(autotuner.get_config(key, candidates, config));
+            REQUIRE(config.variant == candidates[cx].variant);
+            REQUIRE(config.local_size == candidates[cx].local_size);
+            REQUIRE(!autotuner.has_config(key));
+            autotuner.record(key, times[cx] + rx);
+        }
+    }
+
+    // tuning is complete and the fastest candidate is used
+    REQUIRE(autotuner.has_config(key));
+    REQUIRE(!autotuner.get_config(key, candidates, config));
+    REQUIRE(config.variant == 1);
+    REQUIRE(config.local_size == 64);
+
+    // a later run reads the configuration from the cache without tuning
+    Autotuner autotuner_cached;
+    autotuner_cached.enabled = true;
+    autotuner_cached.filename = filename;
+    REQUIRE(autotuner_cached.load());
+    REQUIRE(!autotuner_cached.get_config(key, candidates, config));
+    REQUIRE(config.variant == 1);
+    REQUIRE(config.local_size == 64);
+
+    // without tuning or a stored configuration the default is used
+    Autotuner autotuner_disabled;
+    REQUIRE(!autotuner_disabled.get_config(key, candidates, config));
+    REQUIRE(config.variant == 0);
+    REQUIRE(config.local_size == 0);
+
+    // malformed lines are skipped and the other lines are read
+    {
+        std::ofstream out(filename);
+        out << "bad variant\tx\t64\t1.0\n";
+        out << "bad local size\t1\t99999999999999999999\t1.0\n";
+        out << "bad time\t1\t64\t\n";
+        out << "no tabs\n";
+        out << key << "\t1\t32\t1.0\n";
+    }
+    Autotuner autotuner_malformed;
+    autotuner_malformed.filename = filename;
+    REQUIRE(autotuner_malformed.load());
+    REQUIRE(!autotuner_malformed.has_config("bad variant"));
+    REQUIRE(!autotuner_malformed.has_config("bad local size"));
+    REQUIRE(!autotuner_malformed.has_config("bad time"));
+    REQUIRE(!autotuner_malformed.get_config(key, candidates, config));
+    REQUIRE(config.variant == 1);
+    REQUIRE(config.local_size == 32);
+
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("test_autotune_particle_loop") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    sycl_target.autotuner.reset();
+    sycl_target.autotuner.enabled = true;
+    sycl_target.autotuner.nrepeat = 1;
+    sycl_target.autotuner.write_cache = false;
+
+    const int cell_count = 8;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("COUNT"), 1)};
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    const int N = 100;
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] =
+            (px * 7) % cell_count;
+    }
+    A.add_particles_local(initial_distribution);
+
+    auto k_COUNT = A[Sym<PPMD::INT>("COUNT")]->cell_dat.device_ptr();
+    auto loop = ParticleLoop("test_autotune_particle_loop", A,
+                             [=](const int cellx, const int layerx) {
+                                 k_COUNT[cellx][0][layerx] += 1;
+                             });
+
+    // Every launch while tuning must still visit each particle once.
+    const int nlaunch = 24;
+    for (int lx = 0; lx < nlaunch; lx++) {
+        loop->execute();
+    }
+    auto COUNT = A[Sym<PPMD::INT>("COUNT")];
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto COUNT_data = COUNT->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < COUNT_data->nrow; rowx++) {
+            REQUIRE((*COUNT_data)[0][rowx] == nlaunch);
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <cmath>
+#include <ppmd.hpp>
+using namespace PPMD;
+
+/*
+ * Push particles of element type T in a uniform magnetic field along z, or a
+ * uniform electric field along x, and compare with the analytic motion.
+ */
+template <typename T>
+static void boris_gyration_test(const double tol_velocity,
+                                const double tol_position) {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 4;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("POS"), 3, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1),
+                               ParticleProp(Sym<T>("P"), 3),
+                               ParticleProp(Sym<T>("V"), 3),
+                               ParticleProp(Sym<T>("E"), 3),
+                               ParticleProp(Sym<T>("B"), 3)};
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    // Even particles gyrate in the magnetic field, odd particles are
+    // accelerated by the electric field.
+    const int N = 40;
+    const double v0 = 1.5;
+    const double b0 = 2.0;
+    const double e0 = 0.25;
+    const double q_over_m = -0.5;
+    const double dt = 0.01;
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] =
+            px % cell_count;
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = px;
+        initial_distribution[Sym<T>("P")][px][0] = px;
+        initial_distribution[Sym<T>("P")][px][2] = -px;
+        initial_distribution[Sym<T>("V")][px][0] = v0;
+        initial_distribution[Sym<T>("V")][px][2] = 0.5;
+        if (px % 2 == 0) {
+            initial_distribution[Sym<T>("B")][px][2] = b0;
+        } else {
+            initial_distribution[Sym<T>("E")][px][0] = e0;
+        }
+    }
+    A.add_particles_local(initial_distribution);
+
+    BorisPusher<T> pusher(A, Sym<T>("P"), Sym<T>("V"), Sym<T>("E"),
+                          Sym<T>("B"), dt, q_over_m);
+
+    // one gyration period
+    const double omega = q_over_m * b0;
+    const int nstep = std::round(2.0 * M_PI / std::abs(omega * dt));
+    for (int stepx = 0; stepx < nstep; stepx++) {
+        pusher.execute();
+    }
+
+    // The Boris rotation is exact up to a phase error, the rotation angle of
+    // each step is 2 atan(omega dt / 2).
+    const double theta = 2.0 * std::atan(omega * dt / 2.0);
+    const double t = nstep * dt;
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto P = A[Sym<T>("P")];
+    auto V = A[Sym<T>("V")];
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        auto P_data = P->cell_dat.get_cell(cellx);
+        auto V_data = V->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+            const int px = (*ID_data)[0][rowx];
+            double v_correct[3];
+            double p_correct[3];
+            if (px % 2 == 0) {
+                // dv/dt = (q/m) v x B
+                v_correct[0] = v0 * std::cos(nstep * theta);
+                v_correct[1] = -v0 * std::sin(nstep * theta);
+                p_correct[0] = px + v0 * std::sin(omega * t) / omega;
+                p_correct[1] = v0 * (std::cos(omega * t) - 1.0) / omega;
+            } else {
+                v_correct[0] = v0 + q_over_m * e0 * t;
+                v_correct[1] = 0.0;
+                // the velocity is staggered by half a step
+                p_correct[0] = px + v0 * t +
+                               0.5 * q_over_m * e0 * t * t +
+                               0.5 * q_over_m * e0 * t * dt;
+                p_correct[1] = 0.0;
+            }
+            v_correct[2] = 0.5;
+            p_correct[2] = -px + 0.5 * t;
+            for (int dimx = 0; dimx < 3; dimx++) {
+                REQUIRE(std::abs((*V_data)[dimx][rowx] - v_correct[dimx]) <
+                        tol_velocity);
+                REQUIRE(std::abs((*P_data)[dimx][rowx] - p_correct[dimx]) <
+                        tol_position);
+            }
+        }
+    }
+}
+
+TEST_CASE("test_boris_pusher_gyration") {
+    boris_gyration_test<PPMD::REAL>(1.0e-10, 1.0e-3);
+    boris_gyration_test<float>(1.0e-4, 1.0e-3);
+}
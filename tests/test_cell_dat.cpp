@@ -200,3 +200,123 @@ TEST_CASE("test_cell_dat_INT_1") {
         }
     }
 }
+
+TEST_CASE("test_cell_dat_async") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 4;
+    const int ncol = 3;
+    CellDat<PPMD::REAL> cd(sycl_target, cell_count, ncol);
+
+    // start the uploads of all cells before waiting on any of them
+    std::vector<CellData<PPMD::REAL>> cells_in;
+    EventStack es;
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        const int nrow = cellx + 1;
+        cd.set_nrow(cellx, nrow);
+        auto cell_data =
+            std::make_shared<CellDataT<PPMD::REAL>>(sycl_target, nrow, ncol);
+        for (int colx = 0; colx < ncol; colx++) {
+            for (int rowx = 0; rowx < nrow; rowx++) {
+                cell_data->data[colx][rowx] = cellx * 100 + colx * 10 + rowx;
+            }
+        }
+        cd.set_cell_async(cellx, *cell_data, es);
+        cells_in.push_back(cell_data);
+    }
+    es.wait();
+    REQUIRE(es.events.size() == 0);
+
+    std::vector<CellData<PPMD::REAL>> cells_out;
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto cell_data = std::make_shared<CellDataT<PPMD::REAL>>(
+            sycl_target, cd.nrow[cellx], ncol);
+        cd.get_cell_async(cellx, *cell_data, es);
+        cells_out.push_back(cell_data);
+    }
+    es.wait();
+
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        for (int colx = 0; colx < ncol; colx++) {
+            REQUIRE(cells_out[cellx]->data[colx] ==
+                    cells_in[cellx]->data[colx]);
+        }
+    }
+}
+
+TEST_CASE("test_cell_dat_aosoa") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 3;
+    const int ncol = 3;
+    CellDat<PPMD::INT> cd(sycl_target, cell_count, ncol, CellDatLayout::aosoa);
+    REQUIRE(cd.tile_width == PPMD_TILE_WIDTH);
+    REQUIRE(cd.get_tile_skip() == (ncol - 1) * PPMD_TILE_WIDTH);
+
+    // write the cells on the device through the accessor
+    auto lambda_write = [&](const int cellx, const int nrow) {
+        auto d = cd.device_accessor();
+        sycl_target.queue
+            .submit([&](sycl::handler &cgh) {
+                cgh.parallel_for<>(sycl::range<1>(nrow), [=](sycl::id<1> idx) {
+                    const int rowx = idx[0];
+                    for (int colx = 0; colx < ncol; colx++) {
+                        d[cellx][colx][rowx] = cellx * 1000 + colx * 100 + rowx;
+                    }
+                });
+            })
+            .wait();
+    };
+    auto lambda_check = [&](const int cellx, const int nrow) {
+        auto cell_data = cd.get_cell(cellx);
+        REQUIRE(cell_data->nrow == nrow);
+        for (int colx = 0; colx < ncol; colx++) {
+            for (int rowx = 0; rowx < nrow; rowx++) {
+                REQUIRE((*cell_data)[colx][rowx] ==
+                        cellx * 1000 + colx * 100 + rowx);
+            }
+        }
+    };
+
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        const int nrow = 5 + cellx * 6;
+        cd.set_nrow(cellx, nrow);
+        lambda_write(cellx, nrow);
+        lambda_check(cellx, nrow);
+    }
+
+    // growing a cell keeps the existing rows
+    cd.set_nrow(1, 40);
+    auto cell_data = cd.get_cell(1);
+    for (int colx = 0; colx < ncol; colx++) {
+        for (int rowx = 0; rowx < 11; rowx++) {
+            REQUIRE((*cell_data)[colx][rowx] == 1000 + colx * 100 + rowx);
+        }
+    }
+
+    // set_cell packs into tiles that the accessor reads
+    for (int colx = 0; colx < ncol; colx++) {
+        for (int rowx = 0; rowx < 40; rowx++) {
+            (*cell_data)[colx][rowx] = -(colx * 100 + rowx);
+        }
+    }
+    cd.set_cell(1, cell_data);
+    PPMD::INT *d_sum = sycl::malloc_device<PPMD::INT>(1, sycl_target.queue);
+    sycl_target.queue.fill(d_sum, (PPMD::INT)0, 1).wait();
+    auto d = cd.device_accessor();
+    sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.single_task<>([=]() {
+                for (int rowx = 0; rowx < 40; rowx++) {
+                    d_sum[0] += d[1][2][rowx];
+                }
+            });
+        })
+        .wait();
+    PPMD::INT h_sum;
+    sycl_target.queue.memcpy(&h_sum, d_sum, sizeof(PPMD::INT)).wait();
+    sycl::free(d_sum, sycl_target.queue);
+    REQUIRE(h_sum == -(200 * 40 + (39 * 40) / 2));
+}
@@ -0,0 +1,218 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <map>
+#include <ppmd.hpp>
+#include <random>
+#include <set>
+using namespace PPMD;
+
+TEST_CASE("test_device_hash_map") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int N = 100;
+    DeviceHashMap map(sycl_target, N);
+    REQUIRE(map.get_capacity() >= 4 * N);
+    REQUIRE(map.has_capacity(N));
+
+    auto d_map = map.get_device_view();
+    sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(sycl::range<1>(N), [=](sycl::id<1> idx) {
+                d_map.insert(idx[0] * 7, idx[0]);
+            });
+        })
+        .wait();
+    map.nused += N;
+
+    // erase the even keys and update the odd keys
+    sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(sycl::range<1>(N), [=](sycl::id<1> idx) {
+                const PPMD::INT key = idx[0] * 7;
+                if (idx[0] % 2 == 0) {
+                    d_map.erase(key);
+                } else {
+                    d_map.assign(key, -((PPMD::INT)idx[0]));
+                }
+            });
+        })
+        .wait();
+
+    std::vector<PPMD::INT> keys;
+    for (int kx = 0; kx < N; kx++) {
+        keys.push_back(kx * 7);
+    }
+    keys.push_back(3);
+    std::vector<PPMD::INT> values;
+    map.find(keys, values);
+    for (int kx = 0; kx < N; kx++) {
+        REQUIRE(values[kx] == ((kx % 2 == 0) ? -1 : -kx));
+    }
+    REQUIRE(values[N] == -1);
+
+    map.reset(10);
+    map.find(keys, values);
+    for (auto &value : values) {
+        REQUIRE(value == -1);
+    }
+}
+
+/*
+ * Check the global id index against the ids held in each cell and return the
+ * ids held on this rank.
+ */
+static inline std::set<PPMD::INT> check_index(ParticleGroup &A,
+                                              const int cell_count) {
+    std::vector<PPMD::INT> ids;
+    std::vector<int> cells;
+    std::vector<int> layers;
+    auto GID = A[Sym<PPMD::INT>("GLOBAL_ID")];
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto GID_data = GID->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < GID_data->nrow; rowx++) {
+            ids.push_back((*GID_data)[0][rowx]);
+            cells.push_back(cellx);
+            layers.push_back(rowx);
+        }
+    }
+    std::vector<int> cells_found;
+    std::vector<int> layers_found;
+    A.get_particle_locations(ids, cells_found, layers_found);
+    REQUIRE(cells_found == cells);
+    REQUIRE(layers_found == layers);
+    std::set<PPMD::INT> id_set(ids.begin(), ids.end());
+    REQUIRE(id_set.size() == ids.size());
+    return id_set;
+}
+
+TEST_CASE("test_particle_group_global_ids") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    const int cell_count = 6;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("MASK"), 1)};
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    std::mt19937 rng(1234 + rank);
+    std::uniform_int_distribution<int> cell_rng(0, cell_count - 1);
+    auto lambda_add = [&](const int N) {
+        ParticleSet particles(N, particle_spec);
+        for (int px = 0; px < N; px++) {
+            particles[Sym<PPMD::INT>("CELL_ID")][px][0] = cell_rng(rng);
+        }
+        A.add_particles(particles);
+    };
+
+    // particles added before the ids are enabled are numbered in cell order
+    const int N0 = 20 + rank;
+    lambda_add(N0);
+    A.enable_global_ids();
+    A.enable_global_id_index();
+    auto ids = check_index(A, cell_count);
+    const int npart_first = size * 20 + (size * (size - 1)) / 2;
+    const int offset = rank * 20 + (rank * (rank - 1)) / 2;
+    REQUIRE(*ids.begin() == offset);
+    REQUIRE(*ids.rbegin() == offset + N0 - 1);
+
+    // ids are unique over all ranks
+    const int N1 = 37;
+    lambda_add(N1);
+    ids = check_index(A, cell_count);
+    REQUIRE(ids.size() == N0 + N1);
+    std::vector<PPMD::INT> ids_local(ids.begin(), ids.end());
+    std::vector<PPMD::INT> ids_global(size * (N0 + N1 + size));
+    std::vector<int> counts(size);
+    std::vector<int> displs(size);
+    const int nlocal = ids_local.size();
+    MPI_Allgather(&nlocal, 1, MPI_INT, counts.data(), 1, MPI_INT,
+                  MPI_COMM_WORLD);
+    int ntotal = 0;
+    for (int rankx = 0; rankx < size; rankx++) {
+        displs[rankx] = ntotal;
+        ntotal += counts[rankx];
+    }
+    MPI_Allgatherv(ids_local.data(), nlocal, MPI_INT64_T, ids_global.data(),
+                   counts.data(), displs.data(), MPI_INT64_T, MPI_COMM_WORLD);
+    ids_global.resize(ntotal);
+    std::set<PPMD::INT> ids_global_set(ids_global.begin(), ids_global.end());
+    REQUIRE(ntotal == npart_first + size * N1);
+    REQUIRE(ids_global_set.size() == ntotal);
+    REQUIRE(*ids_global_set.rbegin() == ntotal - 1);
+
+    // removed particles leave the index and moved particles are updated
+    auto MASK = A[Sym<PPMD::INT>("MASK")];
+    auto GID = A[Sym<PPMD::INT>("GLOBAL_ID")];
+    std::set<PPMD::INT> ids_removed;
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto GID_data = GID->cell_dat.get_cell(cellx);
+        auto MASK_data = MASK->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < GID_data->nrow; rowx++) {
+            const PPMD::INT id = (*GID_data)[0][rowx];
+            (*MASK_data)[0][rowx] = (id % 3 == 0);
+            if (id % 3 == 0) {
+                ids_removed.insert(id);
+            }
+        }
+        MASK->cell_dat.set_cell(cellx, MASK_data);
+    }
+    A.remove_particles(MASK);
+    ids = check_index(A, cell_count);
+    REQUIRE(ids.size() + ids_removed.size() == N0 + N1);
+    std::vector<PPMD::INT> ids_lookup(ids_removed.begin(), ids_removed.end());
+    std::vector<int> cells_found;
+    std::vector<int> layers_found;
+    A.get_particle_locations(ids_lookup, cells_found, layers_found);
+    for (std::size_t px = 0; px < ids_lookup.size(); px++) {
+        REQUIRE(cells_found[px] == -1);
+        REQUIRE(layers_found[px] == -1);
+    }
+
+    // reverse the particles in each cell
+    std::vector<int> layer_map;
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        const int nrow = A.get_npart_cell()[cellx];
+        for (int rowx = 0; rowx < nrow; rowx++) {
+            layer_map.push_back(nrow - 1 - rowx);
+        }
+    }
+    BufferDevice<int> d_layer_map(sycl_target, 0);
+    d_layer_map.set(layer_map);
+    A.permute_layers(d_layer_map.ptr);
+    check_index(A, cell_count);
+
+    // enough new particles to force the index to be rebuilt
+    lambda_add(500);
+    ids = check_index(A, cell_count);
+    REQUIRE(ids.size() + ids_removed.size() == N0 + N1 + 500);
+
+    // the index is usable on the device
+    auto d_map = A.get_global_id_map();
+    auto d_gid = GID->cell_dat.device_accessor();
+    int *s_found = sycl::malloc_shared<int>(1, sycl_target.queue);
+    s_found[0] = 0;
+    const int nrow0 = A.get_npart_cell()[0];
+    sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(sycl::range<1>(nrow0), [=](sycl::id<1> idx) {
+                PPMD::INT location;
+                const int layerx = idx[0];
+                if (d_map.find(d_gid[0][0][layerx], location) &&
+                    (particle_location_cell(location) == 0) &&
+                    (particle_location_layer(location) == layerx)) {
+                    atomic_fetch_add(s_found, 1);
+                }
+            });
+        })
+        .wait();
+    REQUIRE(s_found[0] == nrow0);
+    sycl::free(s_found, sycl_target.queue);
+}
@@ -0,0 +1,346 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <mpi.h>
+#include <ppmd.hpp>
+#include <random>
+using namespace PPMD;
+
+TEST_CASE("test_partition_cells") {
+    std::vector<int> cell_order = {3, 0, 2, 1, 4, 5};
+    // cell 2 is as expensive as all the others combined, the split should
+    // give costs of 7 and 3 rather than 2 and 8
+    std::vector<double> cell_costs = {1.0, 1.0, 5.0, 1.0, 1.0, 1.0};
+
+    auto parts = partition_cells(cell_order, cell_costs, 2);
+    REQUIRE(parts[3] == 0);
+    REQUIRE(parts[0] == 0);
+    REQUIRE(parts[2] == 0);
+    REQUIRE(parts[1] == 1);
+    REQUIRE(parts[4] == 1);
+    REQUIRE(parts[5] == 1);
+
+    // parts should be contiguous along the order and never decrease
+    std::fill(cell_costs.begin(), cell_costs.end(), 1.0);
+    parts = partition_cells(cell_order, cell_costs, 3);
+    for (int ix = 0; ix < 6; ix++) {
+        REQUIRE(parts[cell_order[ix]] == ix / 2);
+    }
+}
+
+TEST_CASE("test_mpi_byte_layout") {
+    std::vector<size_t> bytes = {16, 0, 40};
+    std::vector<int> counts;
+    std::vector<int> displs;
+    REQUIRE(mpi_byte_layout(bytes, counts, displs) == 56);
+    REQUIRE(counts == std::vector<int>({16, 0, 40}));
+    REQUIRE(displs == std::vector<int>({0, 16, 16}));
+}
+
+TEST_CASE("test_load_balance_migrate") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::vector<int> dims = {4, 4};
+    const double extent = 1.0;
+    MeshHierarchy mh(sycl_target, 2, dims, extent, 1);
+    const int cell_count = mh.ncells_coarse;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1),
+                               ParticleProp(Sym<uint8_t>("F"), 2)};
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    LoadBalance load_balance(mh);
+    auto owned_cells = load_balance.get_owned_cells();
+    int nowned_total = owned_cells.size();
+    MPI_Allreduce(MPI_IN_PLACE, &nowned_total, 1, MPI_INT, MPI_SUM,
+                  MPI_COMM_WORLD);
+    REQUIRE(nowned_total == cell_count);
+
+    // place all the particles in the first two owned cells to create an
+    // imbalance
+    const int N = 100;
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        const int cell = owned_cells[px % std::min(2, (int)owned_cells.size())];
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cell;
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = rank * N + px;
+        initial_distribution[Sym<PPMD::REAL>("P")][px][0] = 0.0;
+        initial_distribution[Sym<PPMD::REAL>("P")][px][1] = -(rank * N + px);
+        initial_distribution[Sym<uint8_t>("F")][px][0] = (rank * N + px) % 256;
+        initial_distribution[Sym<uint8_t>("F")][px][1] = rank;
+    }
+    A.add_particles_local(initial_distribution);
+
+    CellDatConst<PPMD::INT> cdc(sycl_target, cell_count, 2, 1);
+    for (auto &cellx : owned_cells) {
+        auto cell_data = cdc.get_cell(cellx);
+        cell_data->data[0][0] = cellx;
+        cell_data->data[0][1] = -cellx;
+        cdc.set_cell(cellx, cell_data);
+    }
+
+    load_balance.particle_weight = 100.0;
+    load_balance.add_particle_counts(A);
+    // the ranks own equal numbers of cells and particles if the cells divide
+    // evenly, hence rank 0 carries an extra cost
+    if (rank == 0) {
+        load_balance.add_cost(owned_cells[0], 100.0 * N);
+    }
+    if (size > 1) {
+        REQUIRE(load_balance.get_imbalance() > 1.0);
+    }
+    load_balance.repartition(true);
+    // the first component of the positions is set by a loop that is not
+    // waited on before the migration
+    auto P = A[Sym<PPMD::REAL>("P")];
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto k_P = P->cell_dat.device_accessor();
+    auto k_ID = ID->cell_dat.device_accessor();
+    auto loop = ParticleLoop(
+        "set_position", A,
+        [=](const int cellx, const int layerx) {
+            k_P[cellx][0][layerx] = k_ID[cellx][0][layerx];
+        },
+        {dat_access<WRITE>(P), dat_access<READ>(ID)});
+    loop->submit();
+    load_balance.migrate(A);
+    load_balance.migrate(cdc);
+
+    // all particles should be in owned cells and none should be lost
+    owned_cells = load_balance.get_owned_cells();
+    int npart_total = A.get_npart_local();
+    MPI_Allreduce(MPI_IN_PLACE, &npart_total, 1, MPI_INT, MPI_SUM,
+                  MPI_COMM_WORLD);
+    REQUIRE(npart_total == N * size);
+
+    auto F = A[Sym<uint8_t>("F")];
+    auto &npart_cell = A.get_npart_cell();
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        if (load_balance.cell_owners[cellx] != rank) {
+            REQUIRE(npart_cell[cellx] == 0);
+        }
+        auto P_data = P->cell_dat.get_cell(cellx);
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        auto F_data = F->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+            const PPMD::INT id = (*ID_data)[0][rowx];
+            REQUIRE((*P_data)[0][rowx] == id);
+            REQUIRE((*P_data)[1][rowx] == -id);
+            REQUIRE((*F_data)[0][rowx] == id % 256);
+            REQUIRE((*F_data)[1][rowx] == id / N);
+        }
+    }
+    for (auto &cellx : owned_cells) {
+        auto cell_data = cdc.get_cell(cellx);
+        REQUIRE(cell_data->data[0][0] == cellx);
+        REQUIRE(cell_data->data[0][1] == -cellx);
+    }
+}
+
+TEST_CASE("test_load_balance_migrate_species") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::vector<int> dims = {4, 4};
+    MeshHierarchy mh(sycl_target, 2, dims, 1.0, 1);
+    const int cell_count = mh.ncells_coarse;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec electron_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1)};
+    ParticleSpec ion_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                          ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                          ParticleProp(Sym<PPMD::INT>("ID"), 1),
+                          ParticleProp(Sym<PPMD::REAL>("Q"), 1),
+                          ParticleProp(Sym<uint8_t>("Z"), 1)};
+
+    ParticleSpeciesGroup species(domain, sycl_target);
+    auto &electrons = species.add_species("electrons", electron_spec);
+    auto &ions = species.add_species("ions", ion_spec);
+    REQUIRE(species.get_nspecies() == 2);
+    REQUIRE(&species["ions"] == &ions);
+    REQUIRE(species.get_names()[0] == "electrons");
+
+    LoadBalance load_balance(mh);
+    auto owned_cells = load_balance.get_owned_cells();
+    const int nowned = std::min(2, (int)owned_cells.size());
+
+    const int N_electrons = 60;
+    const int N_ions = 25;
+    ParticleSet electron_distribution(N_electrons, electron_spec);
+    for (int px = 0; px < N_electrons; px++) {
+        const PPMD::INT id = rank * N_electrons + px;
+        electron_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] =
+            owned_cells[px % nowned];
+        electron_distribution[Sym<PPMD::INT>("ID")][px][0] = id;
+        electron_distribution[Sym<PPMD::REAL>("P")][px][0] = id;
+        electron_distribution[Sym<PPMD::REAL>("P")][px][1] = -id;
+    }
+    electrons.add_particles_local(electron_distribution);
+    ParticleSet ion_distribution(N_ions, ion_spec);
+    for (int px = 0; px < N_ions; px++) {
+        const PPMD::INT id = rank * N_ions + px;
+        ion_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] =
+            owned_cells[px % nowned];
+        ion_distribution[Sym<PPMD::INT>("ID")][px][0] = id;
+        ion_distribution[Sym<PPMD::REAL>("P")][px][0] = id;
+        ion_distribution[Sym<PPMD::REAL>("Q")][px][0] = 0.5 * id;
+        ion_distribution[Sym<uint8_t>("Z")][px][0] = id % 7;
+    }
+    ions.add_particles_local(ion_distribution);
+
+    REQUIRE(species.get_npart_local() == N_electrons + N_ions);
+    auto &npart_cell = species.get_npart_cell();
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        REQUIRE(npart_cell[cellx] == electrons.get_npart_cell()[cellx] +
+                                         ions.get_npart_cell()[cellx]);
+    }
+
+    load_balance.particle_weight = 100.0;
+    load_balance.add_particle_counts(species);
+    load_balance.repartition(true);
+    load_balance.migrate(species);
+
+    int npart_electrons = electrons.get_npart_local();
+    int npart_ions = ions.get_npart_local();
+    MPI_Allreduce(MPI_IN_PLACE, &npart_electrons, 1, MPI_INT, MPI_SUM,
+                  MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &npart_ions, 1, MPI_INT, MPI_SUM,
+                  MPI_COMM_WORLD);
+    REQUIRE(npart_electrons == N_electrons * size);
+    REQUIRE(npart_ions == N_ions * size);
+
+    auto P_e = electrons[Sym<PPMD::REAL>("P")];
+    auto ID_e = electrons[Sym<PPMD::INT>("ID")];
+    auto P_i = ions[Sym<PPMD::REAL>("P")];
+    auto ID_i = ions[Sym<PPMD::INT>("ID")];
+    auto Q_i = ions[Sym<PPMD::REAL>("Q")];
+    auto Z_i = ions[Sym<uint8_t>("Z")];
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        if (load_balance.cell_owners[cellx] != rank) {
+            REQUIRE(electrons.get_npart_cell()[cellx] == 0);
+            REQUIRE(ions.get_npart_cell()[cellx] == 0);
+        }
+        auto P_data = P_e->cell_dat.get_cell(cellx);
+        auto ID_data = ID_e->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+            const PPMD::INT id = (*ID_data)[0][rowx];
+            REQUIRE((*P_data)[0][rowx] == id);
+            REQUIRE((*P_data)[1][rowx] == -id);
+        }
+        P_data = P_i->cell_dat.get_cell(cellx);
+        ID_data = ID_i->cell_dat.get_cell(cellx);
+        auto Q_data = Q_i->cell_dat.get_cell(cellx);
+        auto Z_data = Z_i->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+            const PPMD::INT id = (*ID_data)[0][rowx];
+            REQUIRE((*P_data)[0][rowx] == id);
+            REQUIRE((*Q_data)[0][rowx] == 0.5 * id);
+            REQUIRE((*Z_data)[0][rowx] == id % 7);
+        }
+    }
+}
+
+TEST_CASE("test_load_balance_migrate_ownership") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::vector<int> dims = {4, 4};
+    MeshHierarchy mh(sycl_target, 2, dims, 1.0, 1);
+    const int cell_count = mh.ncells_coarse;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 3, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1),
+                               ParticleProp(Sym<uint8_t>("F"), 3)};
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    // the same number of particles in every owned cell, the id encodes the
+    // cell
+    LoadBalance load_balance(mh);
+    auto owned_cells = load_balance.get_owned_cells();
+    const int ppc = 3;
+    const int N = ppc * owned_cells.size();
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        const int cell = owned_cells[px / ppc];
+        const PPMD::INT id = cell * ppc + px % ppc;
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cell;
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = id;
+        for (int dimx = 0; dimx < 3; dimx++) {
+            initial_distribution[Sym<PPMD::REAL>("P")][px][dimx] =
+                id + 0.25 * dimx;
+            initial_distribution[Sym<uint8_t>("F")][px][dimx] =
+                (id + dimx) % 256;
+        }
+    }
+    A.add_particles_local(initial_distribution);
+
+    // the cells of rank 0 are expensive, hence they are spread over all the
+    // ranks and the cells of the other ranks move to the last rank
+    for (auto &cellx : owned_cells) {
+        load_balance.add_cost(cellx, (rank == 0) ? 100.0 : 1.0);
+    }
+    const bool changed = load_balance.repartition();
+    if (size > 1) {
+        REQUIRE(changed);
+        int nmoved = 0;
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            if (load_balance.cell_owners[cellx] !=
+                load_balance.cell_owners_previous[cellx]) {
+                nmoved++;
+            }
+        }
+        REQUIRE(nmoved > 0);
+    }
+    load_balance.migrate(A);
+
+    owned_cells = load_balance.get_owned_cells();
+    int npart_total = A.get_npart_local();
+    MPI_Allreduce(MPI_IN_PLACE, &npart_total, 1, MPI_INT, MPI_SUM,
+                  MPI_COMM_WORLD);
+    REQUIRE(npart_total == ppc * cell_count);
+    REQUIRE(A.get_npart_local() == ppc * (int)owned_cells.size());
+
+    auto P = A[Sym<PPMD::REAL>("P")];
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto F = A[Sym<uint8_t>("F")];
+    auto &npart_cell = A.get_npart_cell();
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        const bool owned = load_balance.cell_owners[cellx] == rank;
+        REQUIRE(npart_cell[cellx] == (owned ? ppc : 0));
+        auto P_data = P->cell_dat.get_cell(cellx);
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        auto F_data = F->cell_dat.get_cell(cellx);
+        std::vector<int> found(ppc, 0);
+        for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+            const PPMD::INT id = (*ID_data)[0][rowx];
+            REQUIRE(id / ppc == cellx);
+            found[id % ppc]++;
+            for (int dimx = 0; dimx < 3; dimx++) {
+                REQUIRE((*P_data)[dimx][rowx] == id + 0.25 * dimx);
+                REQUIRE((*F_data)[dimx][rowx] == (id + dimx) % 256);
+            }
+        }
+        if (owned) {
+            REQUIRE(found == std::vector<int>(ppc, 1));
+        }
+    }
+}
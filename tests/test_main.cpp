@@ -1,12 +1,15 @@
 #define CATCH_CONFIG_RUNNER
 #include <catch2/catch.hpp>
+#include <mpi.h>
 
 int main(int argc, char *argv[]) {
     // global setup
+    MPI_Init(&argc, &argv);
 
     int result = Catch::Session().run(argc, argv);
 
     // global cleanup
+    MPI_Finalize();
 
     return result;
 }
@@ -22,3 +22,109 @@ TEST_CASE("test_mesh_hierarchy_1") {
     REQUIRE(mh.ncells_coarse == 8);
     REQUIRE(mh.ncells_fine == 16);
 }
+
+/*
+ * Round trip a fine cell through its tuple, used to evaluate the index
+ * helpers of MeshHierarchyDevice at compile time.
+ */
+static constexpr int round_trip_fine(const MeshHierarchyDevice<2> &mhd,
+                                     const int linear) {
+    int index[2] = {};
+    mhd.linear_to_tuple_fine(linear, index);
+    return mhd.tuple_to_linear_fine(index);
+}
+
+TEST_CASE("test_mesh_hierarchy_device_constexpr") {
+    // a 4 x 3 coarse mesh with 2 x 2 fine cells in each coarse cell
+    constexpr MeshHierarchyDevice<2> mhd{
+        {4, 3}, 1, 2, 12, 4, 1.0, 0.5, 1.0, 2.0};
+    static_assert(mhd.stencil_size() == 9, "bad stencil size");
+    static_assert(round_trip_fine(mhd, 3) == 3, "bad fine round trip");
+    static_assert(mhd.stencil_neighbour_coarse(0, 4) == 0,
+                  "bad stencil centre");
+    static_assert(mhd.stencil_neighbour_coarse(0, 0) == 3 + 4 * 2,
+                  "bad periodic neighbour");
+    REQUIRE(mhd.stencil_neighbour_coarse(5, 8) == 10);
+}
+
+TEST_CASE("test_mesh_hierarchy_device_view") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    std::vector<int> dims = {3, 4, 5};
+    MeshHierarchy mh(sycl_target, 3, dims, 2.0, 2);
+    auto mhd = mh.get_device_view<3>();
+
+    REQUIRE(mhd.dims[0] == 3);
+    REQUIRE(mhd.dims[2] == 5);
+    REQUIRE(mhd.ncells_dim_fine == 4);
+    REQUIRE(mhd.ncells_coarse == 60);
+    REQUIRE(mhd.ncells_fine == 64);
+    REQUIRE(mhd.stencil_size() == 27);
+
+    // round trip the linear indices
+    for (int cellx = 0; cellx < mhd.ncells_coarse; cellx++) {
+        int index[3];
+        mhd.linear_to_tuple_coarse(cellx, index);
+        REQUIRE(index[0] + 3 * (index[1] + 4 * index[2]) == cellx);
+        REQUIRE(mhd.tuple_to_linear_coarse(index) == cellx);
+    }
+    for (int cellx = 0; cellx < mhd.ncells_fine; cellx++) {
+        int index[3];
+        mhd.linear_to_tuple_fine(cellx, index);
+        REQUIRE(mhd.tuple_to_linear_fine(index) == cellx);
+    }
+
+    // evaluate positions and neighbours on the device
+    const int npos = 4;
+    std::vector<double> positions = {0.1, 0.1, 0.1, 2.6, 4.1, 9.9,
+                                     5.99, 7.99, 0.0, 3.0, 0.49, 8.51};
+    std::vector<int> correct_coarse = {0, 0, 0, 1, 2, 4, 2, 3, 0, 1, 0, 4};
+    std::vector<int> correct_fine = {0, 0, 0, 1, 0, 3, 3, 3, 0, 2, 0, 1};
+
+    double *d_positions = sycl::malloc_shared<double>(npos * 3,
+                                                      sycl_target.queue);
+    int *d_coarse = sycl::malloc_shared<int>(npos * 3, sycl_target.queue);
+    int *d_fine = sycl::malloc_shared<int>(npos * 3, sycl_target.queue);
+    int *d_neighbours = sycl::malloc_shared<int>(27, sycl_target.queue);
+    for (int ix = 0; ix < npos * 3; ix++) {
+        d_positions[ix] = positions[ix];
+    }
+
+    sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(sycl::range<1>(npos), [=](sycl::id<1> idx) {
+                mhd.position_to_tuple(&d_positions[idx * 3],
+                                      &d_coarse[idx * 3], &d_fine[idx * 3]);
+            });
+        })
+        .wait();
+    sycl_target.queue
+        .submit([&](sycl::handler &cgh) {
+            cgh.parallel_for<>(sycl::range<1>(27), [=](sycl::id<1> idx) {
+                d_neighbours[idx] = mhd.stencil_neighbour_coarse(0, idx);
+            });
+        })
+        .wait();
+
+    for (int ix = 0; ix < npos * 3; ix++) {
+        REQUIRE(d_coarse[ix] == correct_coarse[ix]);
+        REQUIRE(d_fine[ix] == correct_fine[ix]);
+    }
+
+    // the centre of the stencil is the cell itself and the neighbours of the
+    // cell at the origin wrap around the periodic boundaries
+    REQUIRE(d_neighbours[13] == 0);
+    int offset[3];
+    mhd.stencil_offset(0, offset);
+    REQUIRE(offset[0] == -1);
+    REQUIRE(offset[1] == -1);
+    REQUIRE(offset[2] == -1);
+    REQUIRE(d_neighbours[0] == 2 + 3 * (3 + 4 * 4));
+    REQUIRE(d_neighbours[14] == 1);
+
+    sycl::free(d_positions, sycl_target.queue);
+    sycl::free(d_coarse, sycl_target.queue);
+    sycl::free(d_fine, sycl_target.queue);
+    sycl::free(d_neighbours, sycl_target.queue);
+}
@@ -78,6 +78,112 @@ TEST_CASE("test_particle_dat_append_1") {
         // zero
         auto cell_data = A->cell_dat.get_cell(cellx);
 
-        // TODO need to verify the rows are copied into the correct cells
+        // the new particles follow the existing particles in the order they
+        // were given
+        int rowx = counts[cellx] / 2;
+        for (int px = 0; px < N; px++) {
+            if (cells0[px] == cellx) {
+                for (int cx = 0; cx < ncomp; cx++) {
+                    REQUIRE((*cell_data)[cx][rowx] == data0[cx * N + px]);
+                }
+                rowx++;
+            }
+        }
+        REQUIRE(rowx == counts[cellx]);
+    }
+}
+
+TEST_CASE("test_cell_counting_sort") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 7;
+    const int N = 1000;
+    std::mt19937 rng(12);
+    std::uniform_int_distribution<int> cell_rng(0, cell_count - 1);
+    std::vector<PPMD::INT> cells(N);
+    for (int px = 0; px < N; px++) {
+        // most of the items are in one cell
+        cells[px] = (px % 4 == 0) ? cell_rng(rng) : 3;
+    }
+    std::vector<int> layer_start(cell_count);
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        layer_start[cellx] = cellx * 2;
+    }
+    std::vector<int> layers_correct(N);
+    std::vector<int> counts_correct(cell_count);
+    std::vector<int> next_layer = layer_start;
+    for (int px = 0; px < N; px++) {
+        layers_correct[px] = next_layer[cells[px]]++;
+        counts_correct[cells[px]]++;
     }
+
+    BufferDevice<PPMD::INT> d_cells(sycl_target, 0);
+    d_cells.set(cells);
+    CellCountingSort counting_sort(sycl_target, cell_count, 16);
+    std::vector<int> layers(N);
+    auto lambda_check = [&]() {
+        REQUIRE(counting_sort.compute(N, d_cells.ptr, layer_start) == 0);
+        sycl_target.queue
+            .memcpy(layers.data(), counting_sort.d_layers.ptr,
+                    N * sizeof(int))
+            .wait();
+        REQUIRE(layers == layers_correct);
+        REQUIRE(counting_sort.cell_counts == counts_correct);
+        REQUIRE(counting_sort.first_error == -1);
+    };
+    lambda_check();
+    // a single block
+    counting_sort.block_size = 5000;
+    lambda_check();
+
+    // invalid cells are reported and are not counted
+    counting_sort.block_size = 16;
+    cells[501] = cell_count;
+    cells[37] = -1;
+    cells[901] = 100;
+    counts_correct[3] -= 3;
+    d_cells.set(cells);
+    REQUIRE(counting_sort.compute(N, d_cells.ptr, layer_start) == 3);
+    REQUIRE(counting_sort.nerrors == 3);
+    REQUIRE(counting_sort.first_error == 37);
+    REQUIRE(counting_sort.cell_counts == counts_correct);
+}
+
+TEST_CASE("test_cell_counting_sort_many_cells") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    // the cell indices are sorted in several passes and there are more
+    // cells than items
+    const int cell_count = 100000;
+    const int N = 5000;
+    std::mt19937 rng(34);
+    std::uniform_int_distribution<int> cell_rng(0, cell_count - 1);
+    std::vector<PPMD::INT> cells(N);
+    for (int px = 0; px < N; px++) {
+        cells[px] = (px % 3 == 0) ? 12345 : cell_rng(rng);
+    }
+    std::vector<int> layer_start(cell_count);
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        layer_start[cellx] = cellx % 5;
+    }
+    std::vector<int> layers_correct(N);
+    std::vector<int> counts_correct(cell_count);
+    std::vector<int> next_layer = layer_start;
+    for (int px = 0; px < N; px++) {
+        layers_correct[px] = next_layer[cells[px]]++;
+        counts_correct[cells[px]]++;
+    }
+
+    BufferDevice<PPMD::INT> d_cells(sycl_target, 0);
+    d_cells.set(cells);
+    CellCountingSort counting_sort(sycl_target, cell_count, 64);
+    REQUIRE(counting_sort.compute(N, d_cells.ptr, layer_start) == 0);
+    std::vector<int> layers(N);
+    sycl_target.queue
+        .memcpy(layers.data(), counting_sort.d_layers.ptr, N * sizeof(int))
+        .wait();
+    REQUIRE(layers == layers_correct);
+    REQUIRE(counting_sort.cell_counts == counts_correct);
 }
@@ -0,0 +1,445 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <ppmd.hpp>
+#include <random>
+#include <set>
+using namespace PPMD;
+
+/*
+ * Create a ParticleGroup with N particles randomly distributed over cells
+ * where each particle has a unique ID and position components derived from
+ * that ID.
+ */
+static inline void create_particles(ParticleGroup &A, ParticleSpec &spec,
+                                    const int N, const int cell_count) {
+    std::mt19937 rng(91824);
+    std::uniform_int_distribution<int> cell_rng(0, cell_count - 1);
+
+    ParticleSet initial_distribution(N, spec);
+    for (int px = 0; px < N; px++) {
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cell_rng(rng);
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = px;
+        for (int dimx = 0; dimx < 2; dimx++) {
+            initial_distribution[Sym<PPMD::REAL>("P")][px][dimx] =
+                (double)(px * 2 + dimx);
+        }
+    }
+    A.add_particles_local(initial_distribution);
+}
+
+/*
+ * Check the occupancies of the dats are consistent and that the data of each
+ * particle is consistent with its ID. Returns the set of IDs found.
+ */
+static inline std::set<PPMD::INT> check_particles(ParticleGroup &A,
+                                                  const int cell_count) {
+    std::set<PPMD::INT> ids;
+    auto P = A[Sym<PPMD::REAL>("P")];
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto CELL_ID = A[Sym<PPMD::INT>("CELL_ID")];
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        const int nrow = ID->s_npart_cell[cellx];
+        REQUIRE(P->s_npart_cell[cellx] == nrow);
+        REQUIRE(CELL_ID->s_npart_cell[cellx] == nrow);
+        REQUIRE(ID->cell_dat.nrow[cellx] == nrow);
+
+        auto P_data = P->cell_dat.get_cell(cellx);
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        auto CELL_ID_data = CELL_ID->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < nrow; rowx++) {
+            const PPMD::INT id = (*ID_data)[0][rowx];
+            REQUIRE((*CELL_ID_data)[0][rowx] == cellx);
+            REQUIRE((*P_data)[0][rowx] == (double)(id * 2));
+            REQUIRE((*P_data)[1][rowx] == (double)(id * 2 + 1));
+            REQUIRE(ids.count(id) == 0);
+            ids.insert(id);
+        }
+    }
+    return ids;
+}
+
+TEST_CASE("test_particle_group_remove_particles_list") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 5;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1)};
+
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    const int N = 200;
+    create_particles(A, particle_spec, N, cell_count);
+    REQUIRE(A.get_npart_local() == N);
+    auto ids_all = check_particles(A, cell_count);
+    REQUIRE(ids_all.size() == N);
+
+    // remove every third particle in each cell and the last particle in each
+    // cell
+    std::vector<PPMD::INT> cells;
+    std::vector<PPMD::INT> layers;
+    std::set<PPMD::INT> ids_removed;
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        const int nrow = ID->s_npart_cell[cellx];
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < nrow; rowx++) {
+            if ((rowx % 3 == 0) || (rowx == nrow - 1)) {
+                cells.push_back(cellx);
+                layers.push_back(rowx);
+                ids_removed.insert((*ID_data)[0][rowx]);
+            }
+        }
+    }
+
+    const int nremove = cells.size();
+    int first_invalid;
+    REQUIRE(A.check_remove_particles(nremove, cells, layers, first_invalid) ==
+            0);
+    REQUIRE(first_invalid == -1);
+
+    // removals with a cell or layer out of range and repeated removals are
+    // found on the device, every occurrence of a repeat is counted
+    const int nrow_0 = ID->s_npart_cell[0];
+    std::vector<PPMD::INT> cells_invalid = {0, 1, -1, cell_count, 0, 2, 0};
+    std::vector<PPMD::INT> layers_invalid = {0, 1, 0, 0, nrow_0, -1, 0};
+    REQUIRE(A.check_remove_particles(7, cells_invalid, layers_invalid,
+                                     first_invalid) == 6);
+    REQUIRE(first_invalid == 0);
+    REQUIRE(A.check_remove_particles(4, cells_invalid, layers_invalid,
+                                     first_invalid) == 2);
+    REQUIRE(first_invalid == 2);
+    REQUIRE(A.check_remove_particles(2, cells_invalid, layers_invalid,
+                                     first_invalid) == 0);
+    REQUIRE(first_invalid == -1);
+    REQUIRE(A.get_npart_local() == N);
+
+    A.remove_particles(nremove, cells, layers);
+    REQUIRE(A.get_npart_local() == N - nremove);
+
+    auto ids_remaining = check_particles(A, cell_count);
+    REQUIRE(ids_remaining.size() == N - nremove);
+    for (auto id : ids_all) {
+        REQUIRE((ids_remaining.count(id) + ids_removed.count(id)) == 1);
+    }
+
+    // the layers after a removal depend only on the set of removed particles
+    // and not on the order in which they are listed
+    ParticleGroup B(domain, particle_spec, sycl_target);
+    create_particles(B, particle_spec, N, cell_count);
+    std::vector<PPMD::INT> cells_reversed(cells.rbegin(), cells.rend());
+    std::vector<PPMD::INT> layers_reversed(layers.rbegin(), layers.rend());
+    B.remove_particles(nremove, cells_reversed, layers_reversed);
+    auto ID_B = B[Sym<PPMD::INT>("ID")];
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        auto ID_B_data = ID_B->cell_dat.get_cell(cellx);
+        REQUIRE(ID_B_data->nrow == ID_data->nrow);
+        for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+            REQUIRE((*ID_B_data)[0][rowx] == (*ID_data)[0][rowx]);
+        }
+    }
+}
+
+TEST_CASE("test_particle_group_remove_particles_mask") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 4;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1),
+                               ParticleProp(Sym<PPMD::INT>("MASK"), 1)};
+
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    const int N = 123;
+    create_particles(A, particle_spec, N, cell_count);
+
+    // mark the particles with odd IDs for removal
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto MASK = A[Sym<PPMD::INT>("MASK")];
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        auto MASK_data = MASK->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+            (*MASK_data)[0][rowx] = (*ID_data)[0][rowx] % 2;
+        }
+        MASK->cell_dat.set_cell(cellx, MASK_data);
+    }
+
+    A.remove_particles(MASK);
+    REQUIRE(A.get_npart_local() == (N + 1) / 2);
+
+    auto ids_remaining = check_particles(A, cell_count);
+    REQUIRE(ids_remaining.size() == (N + 1) / 2);
+    for (auto id : ids_remaining) {
+        REQUIRE(id % 2 == 0);
+    }
+
+    // removing with an all zero mask is a no-op
+    A.remove_particles(MASK);
+    REQUIRE(A.get_npart_local() == (N + 1) / 2);
+}
+
+TEST_CASE("test_particle_group_element_types") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 4;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1),
+                               ParticleProp(Sym<PPMD::INT>("MASK"), 1),
+                               ParticleProp(Sym<float>("W"), 2),
+                               ParticleProp(Sym<int32_t>("S"), 1),
+                               ParticleProp(Sym<uint8_t>("F"), 3)};
+    REQUIRE(particle_spec.get_properties<float>().size() == 1);
+    REQUIRE(particle_spec.get_properties<uint8_t>()[0].ncomp == 3);
+
+    ParticleGroup A(domain, particle_spec, sycl_target);
+    REQUIRE(A.get_particle_dats<PPMD::REAL>().size() == 1);
+    REQUIRE(A.get_particle_dats<int32_t>().size() == 1);
+    int ndat = 0;
+    A.for_each_particle_dat([&](auto &dat) { ndat++; });
+    REQUIRE(ndat == 7);
+
+    const int N = 151;
+    std::mt19937 rng(52134);
+    std::uniform_int_distribution<int> cell_rng(0, cell_count - 1);
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cell_rng(rng);
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = px;
+        initial_distribution[Sym<PPMD::INT>("MASK")][px][0] = (px % 3 == 0);
+        initial_distribution[Sym<float>("W")][px][0] = 0.5f * px;
+        initial_distribution[Sym<float>("W")][px][1] = -0.5f * px;
+        initial_distribution[Sym<int32_t>("S")][px][0] = -px;
+        for (int cx = 0; cx < 3; cx++) {
+            initial_distribution[Sym<uint8_t>("F")][px][cx] = (px + cx) % 256;
+        }
+    }
+    A.add_particles_local(initial_distribution);
+
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto W = A[Sym<float>("W")];
+    auto S = A[Sym<int32_t>("S")];
+    auto F = A[Sym<uint8_t>("F")];
+    auto lambda_check = [&]() {
+        std::set<PPMD::INT> ids;
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            const int nrow = ID->s_npart_cell[cellx];
+            REQUIRE(W->s_npart_cell[cellx] == nrow);
+            REQUIRE(F->s_npart_cell[cellx] == nrow);
+            auto ID_data = ID->cell_dat.get_cell(cellx);
+            auto W_data = W->cell_dat.get_cell(cellx);
+            auto S_data = S->cell_dat.get_cell(cellx);
+            auto F_data = F->cell_dat.get_cell(cellx);
+            for (int rowx = 0; rowx < nrow; rowx++) {
+                const PPMD::INT id = (*ID_data)[0][rowx];
+                REQUIRE((*W_data)[0][rowx] == 0.5f * id);
+                REQUIRE((*W_data)[1][rowx] == -0.5f * id);
+                REQUIRE((*S_data)[0][rowx] == -id);
+                for (int cx = 0; cx < 3; cx++) {
+                    REQUIRE((*F_data)[cx][rowx] == (id + cx) % 256);
+                }
+                ids.insert(id);
+            }
+        }
+        return ids;
+    };
+    REQUIRE(lambda_check().size() == N);
+
+    A.remove_particles(A[Sym<PPMD::INT>("MASK")]);
+    REQUIRE(A.get_npart_local() == N - (N + 2) / 3);
+    auto ids = lambda_check();
+    REQUIRE(ids.size() == N - (N + 2) / 3);
+    for (auto id : ids) {
+        REQUIRE(id % 3 != 0);
+    }
+
+    // reverse the order of the particles in each cell
+    std::vector<PPMD::INT> ids_before;
+    std::vector<int> layer_map;
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        const int nrow = ID->s_npart_cell[cellx];
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < nrow; rowx++) {
+            layer_map.push_back(nrow - 1 - rowx);
+            ids_before.push_back((*ID_data)[0][rowx]);
+        }
+    }
+    BufferDevice<int> d_layer_map(sycl_target, 0);
+    d_layer_map.set(layer_map);
+    A.permute_layers(d_layer_map.ptr);
+    lambda_check();
+    int index = 0;
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        const int nrow = ID->s_npart_cell[cellx];
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < nrow; rowx++) {
+            REQUIRE((*ID_data)[0][rowx] == ids_before[index + nrow - 1 - rowx]);
+        }
+        index += nrow;
+    }
+}
+
+TEST_CASE("test_particle_group_aosoa") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 5;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{
+        ParticleProp(Sym<PPMD::REAL>("P"), 2, true, CellDatLayout::aosoa),
+        ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+        ParticleProp(Sym<PPMD::INT>("ID"), 1, false, CellDatLayout::aosoa),
+        ParticleProp(Sym<PPMD::INT>("MASK"), 1),
+        ParticleProp(Sym<float>("V"), 3, false, CellDatLayout::aosoa)};
+
+    ParticleGroup A(domain, particle_spec, sycl_target);
+    REQUIRE(A[Sym<PPMD::REAL>("P")]->cell_dat.layout == CellDatLayout::aosoa);
+
+    const int N = 203;
+    create_particles(A, particle_spec, N, cell_count);
+    REQUIRE(check_particles(A, cell_count).size() == N);
+
+    // set V and MASK from the ID on the device through accessors
+    auto k_ID = A[Sym<PPMD::INT>("ID")]->cell_dat.device_accessor();
+    auto k_V = A[Sym<float>("V")]->cell_dat.device_accessor();
+    auto k_MASK = A[Sym<PPMD::INT>("MASK")]->cell_dat.device_accessor();
+    auto loop = ParticleLoop(
+        "test_particle_group_aosoa", A, [=](const int cellx, const int layerx) {
+            const PPMD::INT id = k_ID[cellx][0][layerx];
+            for (int cx = 0; cx < 3; cx++) {
+                k_V[cellx][cx][layerx] = id * 3 + cx;
+            }
+            k_MASK[cellx][0][layerx] = (id % 4 == 1);
+        });
+    loop->execute();
+
+    A.remove_particles(A[Sym<PPMD::INT>("MASK")]);
+    const int nremaining = N - (N + 2) / 4;
+    REQUIRE(A.get_npart_local() == nremaining);
+    auto ids = check_particles(A, cell_count);
+    REQUIRE(ids.size() == nremaining);
+
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto V = A[Sym<float>("V")];
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        auto V_data = V->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+            const PPMD::INT id = (*ID_data)[0][rowx];
+            REQUIRE(id % 4 != 1);
+            for (int cx = 0; cx < 3; cx++) {
+                REQUIRE((*V_data)[cx][rowx] == id * 3 + cx);
+            }
+        }
+    }
+}
+
+TEST_CASE("test_particle_group_host_mirror") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    auto &profiler = sycl_target.profiler;
+
+    const int cell_count = 4;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1),
+                               ParticleProp(Sym<PPMD::REAL>("V"), 1),
+                               ParticleProp(Sym<PPMD::REAL>("Q"), 1)};
+    ParticleGroup A(domain, particle_spec, sycl_target);
+    const int N = 40;
+    create_particles(A, particle_spec, N, cell_count);
+
+    auto V = A[Sym<PPMD::REAL>("V")];
+    auto Q = A[Sym<PPMD::REAL>("Q")];
+    V->cell_dat.enable_host_mirror();
+    auto &npart_cell = A.get_npart_cell();
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        REQUIRE(npart_cell[cellx] > 0);
+    }
+
+    profiler.enable();
+    profiler.reset();
+    auto lambda_bytes = [&](const char *name) {
+        auto bytes = profiler.get_bytes();
+        return (bytes.count(name) > 0) ? bytes.at(name) : 0;
+    };
+
+    // only the first read copies the cell
+    V->cell_dat.get_host_cell(0);
+    V->cell_dat.get_host_cell(0);
+    REQUIRE(lambda_bytes("device_to_host") == npart_cell[0] * 8);
+
+    // host modifications are pushed before the next loop that uses the dat
+    auto &V1 = V->cell_dat.get_host_cell(1, true);
+    for (int rowx = 0; rowx < V1.nrow; rowx++) {
+        V1[0][rowx] = rowx + 0.5;
+    }
+    REQUIRE(lambda_bytes("host_to_device") == 0);
+    auto k_V = V->cell_dat.device_accessor();
+    auto k_Q = Q->cell_dat.device_accessor();
+    ParticleLoop(
+        "copy", A,
+        [=](const int cellx, const int layerx) {
+            k_Q[cellx][0][layerx] = k_V[cellx][0][layerx];
+        },
+        {dat_access<READ>(V), dat_access<WRITE>(Q)})
+        ->execute();
+    REQUIRE(lambda_bytes("host_to_device") == npart_cell[1] * 8);
+    auto Q1 = Q->cell_dat.get_cell(1);
+    for (int rowx = 0; rowx < Q1->nrow; rowx++) {
+        REQUIRE((*Q1)[0][rowx] == rowx + 0.5);
+    }
+
+    // a loop that only reads the dat leaves the host copies valid
+    const auto d2h_before = lambda_bytes("device_to_host");
+    V->cell_dat.get_host_cell(0);
+    V->cell_dat.get_host_cell(1);
+    REQUIRE(lambda_bytes("device_to_host") == d2h_before);
+
+    // a loop that writes the dat makes the host copies stale
+    ParticleLoop(
+        "increment", A,
+        [=](const int cellx, const int layerx) {
+            k_V[cellx][0][layerx] += 1.0;
+        },
+        {dat_access<WRITE>(V)})
+        ->execute();
+    auto &V1_new = V->cell_dat.get_host_cell(1);
+    for (int rowx = 0; rowx < V1_new.nrow; rowx++) {
+        REQUIRE(V1_new[0][rowx] == rowx + 1.5);
+    }
+
+    // removing particles from cell 2 only makes cell 2 stale
+    V->cell_dat.get_host_cell(0);
+    V->cell_dat.get_host_cell(2);
+    std::vector<PPMD::INT> cells = {2};
+    std::vector<PPMD::INT> layers = {0};
+    A.remove_particles(1, cells, layers);
+    const auto d2h_remove = lambda_bytes("device_to_host");
+    V->cell_dat.get_host_cell(0);
+    REQUIRE(lambda_bytes("device_to_host") == d2h_remove);
+    REQUIRE(V->cell_dat.get_host_cell(2).nrow == npart_cell[2]);
+    REQUIRE(lambda_bytes("device_to_host") ==
+            d2h_remove + npart_cell[2] * 8);
+    profiler.disable();
+    profiler.reset();
+}
@@ -0,0 +1,446 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <mpi.h>
+#include <ppmd.hpp>
+#include <set>
+using namespace PPMD;
+
+TEST_CASE("test_mesh_hierarchy_neighbours") {
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    std::vector<int> dims = {4, 3};
+    MeshHierarchy mh(sycl_target, 2, dims, 1.0, 1);
+
+    // cell (0, 0) wraps in both dimensions
+    std::vector<int> correct = {1, 3, 4, 5, 7, 8, 9, 11};
+    REQUIRE(mh.get_neighbours_coarse(0) == correct);
+
+    // with two cells in a dimension both offsets wrap onto the same cell
+    std::vector<int> dims_narrow = {2, 1};
+    MeshHierarchy mh_narrow(sycl_target, 2, dims_narrow, 1.0, 1);
+    REQUIRE(mh_narrow.get_neighbours_coarse(0) == std::vector<int>{1});
+}
+
+TEST_CASE("test_particle_halo") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::vector<int> dims = {6, 4};
+    MeshHierarchy mh(sycl_target, 2, dims, 1.0, 1);
+    const int cell_count = mh.ncells_coarse;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1),
+                               ParticleProp(Sym<float>("Q"), 1),
+                               ParticleProp(Sym<PPMD::REAL>("V"), 3)};
+    ParticleGroup A(domain, particle_spec, sycl_target);
+    LoadBalance load_balance(mh);
+
+    // The number of particles in each cell and their data is a function of
+    // the cell such that the receiving rank can check the halo.
+    auto lambda_npart = [](const int cell) { return (cell * 5) % 4; };
+    auto lambda_id = [](const int cell, const int layer) {
+        return cell * 100 + layer;
+    };
+    auto owned_cells = load_balance.get_owned_cells();
+    int N = 0;
+    for (auto &cellx : owned_cells) {
+        N += lambda_npart(cellx);
+    }
+    ParticleSet initial_distribution(N, particle_spec);
+    int px = 0;
+    for (auto &cellx : owned_cells) {
+        for (int layerx = 0; layerx < lambda_npart(cellx); layerx++) {
+            const int id = lambda_id(cellx, layerx);
+            initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cellx;
+            initial_distribution[Sym<PPMD::INT>("ID")][px][0] = id;
+            initial_distribution[Sym<PPMD::REAL>("P")][px][0] = id;
+            initial_distribution[Sym<PPMD::REAL>("P")][px][1] = -id;
+            initial_distribution[Sym<float>("Q")][px][0] = 0.5f * id;
+            px++;
+        }
+    }
+    A.add_particles_local(initial_distribution);
+
+    ParticleHalo halo(load_balance, A);
+    halo.add_dat(Sym<PPMD::INT>("ID"));
+    halo.add_dat(Sym<float>("Q"));
+    halo.exchange();
+
+    // the halo cells are the cells of other ranks in the stencil of the owned
+    // cells
+    std::set<int> halo_cells_correct;
+    for (auto &cellx : owned_cells) {
+        for (auto &neighbour : mh.get_neighbours_coarse(cellx)) {
+            if (load_balance.cell_owners[neighbour] != rank) {
+                halo_cells_correct.insert(neighbour);
+            }
+        }
+    }
+    REQUIRE(halo.get_halo_cells() ==
+            std::vector<int>(halo_cells_correct.begin(),
+                             halo_cells_correct.end()));
+    REQUIRE(halo.get_neighbour_ranks().size() <= size - 1);
+
+    auto lambda_check = [&](const double shift) {
+        auto &npart_cell = halo.get_npart_cell();
+        int npart_halo = 0;
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            const int npart_correct =
+                halo_cells_correct.count(cellx) ? lambda_npart(cellx) : 0;
+            REQUIRE(npart_cell[cellx] == npart_correct);
+            auto ID_data = halo[Sym<PPMD::INT>("ID")]->cell_dat.get_cell(cellx);
+            auto Q_data = halo[Sym<float>("Q")]->cell_dat.get_cell(cellx);
+            auto P_data = halo[Sym<PPMD::REAL>("P")]->cell_dat.get_cell(cellx);
+            REQUIRE(ID_data->nrow == npart_correct);
+            for (int layerx = 0; layerx < npart_correct; layerx++) {
+                const int id = lambda_id(cellx, layerx);
+                REQUIRE((*ID_data)[0][layerx] == id);
+                REQUIRE((*Q_data)[0][layerx] == 0.5f * id);
+                REQUIRE((*P_data)[0][layerx] == id + shift);
+                REQUIRE((*P_data)[1][layerx] == -id);
+            }
+            npart_halo += npart_correct;
+        }
+        REQUIRE(halo.get_npart_halo() == npart_halo);
+    };
+    lambda_check(0.0);
+
+    // move the particles without changing the occupancy and refresh only the
+    // positions
+    auto k_P = A[Sym<PPMD::REAL>("P")]->cell_dat.device_accessor();
+    auto k_ID = A[Sym<PPMD::INT>("ID")]->cell_dat.device_accessor();
+    for (int stepx = 1; stepx < 3; stepx++) {
+        ParticleLoop("shift", A, [=](const int cellx, const int layerx) {
+            k_P[cellx][0][layerx] += 1.0;
+            k_ID[cellx][0][layerx] = -1;
+        })->execute();
+        halo.exchange_positions();
+        lambda_check((double)stepx);
+    }
+
+    // a full exchange sends the other dats again
+    halo.exchange();
+    auto ID_halo = halo[Sym<PPMD::INT>("ID")];
+    for (auto &cellx : halo.get_halo_cells()) {
+        auto ID_data = ID_halo->cell_dat.get_cell(cellx);
+        for (int layerx = 0; layerx < ID_data->nrow; layerx++) {
+            REQUIRE((*ID_data)[0][layerx] == -1);
+        }
+    }
+}
+
+TEST_CASE("test_particle_halo_plan_reuse") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    auto &profiler = sycl_target.profiler;
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::vector<int> dims = {4, 4};
+    MeshHierarchy mh(sycl_target, 2, dims, 1.0, 1);
+    const int cell_count = mh.ncells_coarse;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1)};
+    ParticleGroup A(domain, particle_spec, sycl_target);
+    LoadBalance load_balance(mh);
+
+    // two particles in every owned cell
+    const int ppc = 2;
+    auto owned_cells = load_balance.get_owned_cells();
+    const int N = ppc * owned_cells.size();
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        const int cellx = owned_cells[px / ppc];
+        const int id = cellx * ppc + px % ppc;
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cellx;
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = id;
+        initial_distribution[Sym<PPMD::REAL>("P")][px][0] = id;
+        initial_distribution[Sym<PPMD::REAL>("P")][px][1] = -id;
+    }
+    A.add_particles_local(initial_distribution);
+
+    // the particles sent, each owned cell is sent once to every other rank
+    // that owns a cell in its stencil
+    int npart_send = 0;
+    int npart_recv = 0;
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        std::set<int> ranks;
+        for (auto &neighbour : mh.get_neighbours_coarse(cellx)) {
+            ranks.insert(load_balance.cell_owners[neighbour]);
+        }
+        if (load_balance.cell_owners[cellx] == rank) {
+            npart_send += ppc * (ranks.size() - ranks.count(rank));
+        } else if (ranks.count(rank)) {
+            npart_recv += ppc;
+        }
+    }
+    // the halo is only empty on a single rank, run the tests with more ranks
+    // to exchange particles
+    if (size > 1) {
+        REQUIRE(npart_send > 0);
+        REQUIRE(npart_recv > 0);
+    }
+
+    ParticleHalo halo(load_balance, A);
+    halo.add_dat(Sym<PPMD::INT>("ID"));
+    profiler.enable();
+    profiler.reset();
+    halo.exchange();
+    REQUIRE(halo.get_npart_halo() == npart_recv);
+    // a full exchange sends the position and the id of each particle
+    const std::int64_t bytes_full = profiler.get_bytes()["mpi_send"];
+    REQUIRE(bytes_full >= npart_send * (2 * sizeof(PPMD::REAL) +
+                                        sizeof(PPMD::INT)));
+
+    // the ids of the owned particles change but only the positions are sent
+    // by exchange_positions, with the plan of the exchange, the loop is not
+    // waited on before the exchange
+    auto P = A[Sym<PPMD::REAL>("P")];
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto k_P = P->cell_dat.device_accessor();
+    auto k_ID = ID->cell_dat.device_accessor();
+    auto loop = ParticleLoop(
+        "shift", A,
+        [=](const int cellx, const int layerx) {
+            k_P[cellx][1][layerx] -= 0.5;
+            k_ID[cellx][0][layerx] = -1;
+        },
+        {dat_access<WRITE>(P), dat_access<WRITE>(ID)});
+    for (int stepx = 1; stepx < 3; stepx++) {
+        loop->submit();
+        profiler.reset();
+        halo.exchange_positions();
+        REQUIRE(profiler.get_bytes()["mpi_send"] ==
+                npart_send * 2 * sizeof(PPMD::REAL));
+        REQUIRE(halo.get_npart_halo() == npart_recv);
+        int npart_halo = 0;
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            auto P_data = halo[Sym<PPMD::REAL>("P")]->cell_dat.get_cell(cellx);
+            auto ID_data = halo[Sym<PPMD::INT>("ID")]->cell_dat.get_cell(cellx);
+            for (int layerx = 0; layerx < ID_data->nrow; layerx++) {
+                const int id = (*ID_data)[0][layerx];
+                REQUIRE(id / ppc == cellx);
+                REQUIRE((*P_data)[0][layerx] == id);
+                REQUIRE((*P_data)[1][layerx] == -id - 0.5 * stepx);
+            }
+            npart_halo += ID_data->nrow;
+        }
+        REQUIRE(npart_halo == npart_recv);
+    }
+    profiler.disable();
+}
+
+TEST_CASE("test_particle_species_halo") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    std::vector<int> dims = {5, 4};
+    MeshHierarchy mh(sycl_target, 2, dims, 1.0, 1);
+    const int cell_count = mh.ncells_coarse;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+    LoadBalance load_balance(mh);
+
+    ParticleSpec spec_electrons{
+        ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+        ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+        ParticleProp(Sym<PPMD::INT>("ID"), 1)};
+    ParticleSpec spec_ions{ParticleProp(Sym<PPMD::REAL>("X"), 2, true),
+                           ParticleProp(Sym<PPMD::INT>("CELL"), 1, true),
+                           ParticleProp(Sym<float>("M"), 1)};
+    ParticleSpeciesGroup species(domain, sycl_target);
+    auto &electrons = species.add_species("electrons", spec_electrons);
+    auto &ions = species.add_species("ions", spec_ions);
+
+    // The occupancy and data of each cell are functions of the cell and the
+    // species such that the receiving rank can check the halos.
+    auto lambda_npart = [](const int species, const int cell) {
+        return (cell * (3 + species)) % (3 + 2 * species);
+    };
+    auto lambda_id = [](const int species, const int cell, const int layer) {
+        return species * 10000 + cell * 100 + layer;
+    };
+    auto owned_cells = load_balance.get_owned_cells();
+    std::vector<int> npart(2, 0);
+    for (int sx = 0; sx < 2; sx++) {
+        for (auto &cellx : owned_cells) {
+            npart[sx] += lambda_npart(sx, cellx);
+        }
+    }
+    ParticleSet electrons_distribution(npart[0], spec_electrons);
+    ParticleSet ions_distribution(npart[1], spec_ions);
+    std::vector<int> px(2, 0);
+    for (auto &cellx : owned_cells) {
+        for (int layerx = 0; layerx < lambda_npart(0, cellx); layerx++) {
+            const int id = lambda_id(0, cellx, layerx);
+            electrons_distribution[Sym<PPMD::INT>("CELL_ID")][px[0]][0] = cellx;
+            electrons_distribution[Sym<PPMD::INT>("ID")][px[0]][0] = id;
+            electrons_distribution[Sym<PPMD::REAL>("P")][px[0]][0] = id;
+            electrons_distribution[Sym<PPMD::REAL>("P")][px[0]][1] = -id;
+            px[0]++;
+        }
+        for (int layerx = 0; layerx < lambda_npart(1, cellx); layerx++) {
+            const int id = lambda_id(1, cellx, layerx);
+            ions_distribution[Sym<PPMD::INT>("CELL")][px[1]][0] = cellx;
+            ions_distribution[Sym<float>("M")][px[1]][0] = 0.25f * id;
+            ions_distribution[Sym<PPMD::REAL>("X")][px[1]][0] = id;
+            ions_distribution[Sym<PPMD::REAL>("X")][px[1]][1] = -id;
+            px[1]++;
+        }
+    }
+    electrons.add_particles_local(electrons_distribution);
+    ions.add_particles_local(ions_distribution);
+
+    ParticleSpeciesHalo halo(load_balance, species);
+    REQUIRE(halo.get_nspecies() == 2);
+    halo["electrons"].add_dat(Sym<PPMD::INT>("ID"));
+    halo["ions"].add_dat(Sym<float>("M"));
+    halo.exchange();
+
+    std::set<int> halo_cells_correct;
+    for (auto &cellx : owned_cells) {
+        for (auto &neighbour : mh.get_neighbours_coarse(cellx)) {
+            if (load_balance.cell_owners[neighbour] != rank) {
+                halo_cells_correct.insert(neighbour);
+            }
+        }
+    }
+    auto lambda_check = [&](const double shift) {
+        for (int sx = 0; sx < 2; sx++) {
+            auto &species_halo = halo.get_halo(sx);
+            REQUIRE(species_halo.get_halo_cells() ==
+                    std::vector<int>(halo_cells_correct.begin(),
+                                     halo_cells_correct.end()));
+            auto position_halo = species_halo.position_dat;
+            for (int cellx = 0; cellx < cell_count; cellx++) {
+                const int npart_correct = halo_cells_correct.count(cellx)
+                                              ? lambda_npart(sx, cellx)
+                                              : 0;
+                REQUIRE(species_halo.get_npart_cell()[cellx] == npart_correct);
+                auto P_data = position_halo->cell_dat.get_cell(cellx);
+                for (int layerx = 0; layerx < npart_correct; layerx++) {
+                    const int id = lambda_id(sx, cellx, layerx);
+                    REQUIRE((*P_data)[0][layerx] == id + shift);
+                    REQUIRE((*P_data)[1][layerx] == -id);
+                }
+            }
+        }
+        auto &ID_halo = halo["electrons"][Sym<PPMD::INT>("ID")];
+        auto &M_halo = halo["ions"][Sym<float>("M")];
+        for (auto &cellx : halo_cells_correct) {
+            auto ID_data = ID_halo->cell_dat.get_cell(cellx);
+            auto M_data = M_halo->cell_dat.get_cell(cellx);
+            for (int layerx = 0; layerx < ID_data->nrow; layerx++) {
+                REQUIRE((*ID_data)[0][layerx] == lambda_id(0, cellx, layerx));
+            }
+            for (int layerx = 0; layerx < M_data->nrow; layerx++) {
+                REQUIRE((*M_data)[0][layerx] ==
+                        0.25f * lambda_id(1, cellx, layerx));
+            }
+        }
+    };
+    lambda_check(0.0);
+
+    // the positions of all species are refreshed together
+    auto k_P = electrons[Sym<PPMD::REAL>("P")]->cell_dat.device_accessor();
+    auto k_X = ions[Sym<PPMD::REAL>("X")]->cell_dat.device_accessor();
+    ParticleLoop("shift_electrons", electrons,
+                 [=](const int cellx, const int layerx) {
+                     k_P[cellx][0][layerx] += 1.0;
+                 })
+        ->execute();
+    ParticleLoop("shift_ions", ions, [=](const int cellx, const int layerx) {
+        k_X[cellx][0][layerx] += 1.0;
+    })->execute();
+    halo.exchange_positions();
+    lambda_check(1.0);
+}
+
+TEST_CASE("test_cell_dat_const_halo") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::vector<int> dims = {5, 4};
+    MeshHierarchy mh(sycl_target, 2, dims, 1.0, 1);
+    const int cell_count = mh.ncells_coarse;
+    LoadBalance load_balance(mh);
+
+    CellDatConst<PPMD::REAL> cdc(sycl_target, cell_count, 2, 3);
+    CellDatConstHalo<PPMD::REAL> halo(load_balance, cdc);
+
+    auto lambda_value = [](const int step, const int cell, const int row,
+                           const int col) {
+        return step * 1000 + cell * 10 + row * 3 + col;
+    };
+    // Write the owned cells, mark the other cells and check the ghost layer
+    // holds the values of the owners after the exchange.
+    auto lambda_step = [&](const int step) {
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            const bool owned = load_balance.cell_owners[cellx] == rank;
+            auto cell_data = cdc.get_cell(cellx);
+            for (int rowx = 0; rowx < 2; rowx++) {
+                for (int colx = 0; colx < 3; colx++) {
+                    (*cell_data)[colx][rowx] =
+                        owned ? lambda_value(step, cellx, rowx, colx) : -1.0;
+                }
+            }
+            cdc.set_cell(cellx, cell_data);
+        }
+
+        halo.exchange();
+
+        std::set<int> halo_cells;
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            if (load_balance.cell_owners[cellx] != rank) {
+                continue;
+            }
+            for (auto &neighbour : mh.get_neighbours_coarse(cellx)) {
+                if (load_balance.cell_owners[neighbour] != rank) {
+                    halo_cells.insert(neighbour);
+                }
+            }
+        }
+        REQUIRE(halo.get_halo_cells() ==
+                std::vector<int>(halo_cells.begin(), halo_cells.end()));
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            const bool valid = (load_balance.cell_owners[cellx] == rank) ||
+                               (halo_cells.count(cellx) > 0);
+            auto cell_data = cdc.get_cell(cellx);
+            for (int rowx = 0; rowx < 2; rowx++) {
+                for (int colx = 0; colx < 3; colx++) {
+                    REQUIRE((*cell_data)[colx][rowx] ==
+                            (valid ? lambda_value(step, cellx, rowx, colx)
+                                   : -1.0));
+                }
+            }
+        }
+    };
+
+    // the persistent requests are reused
+    lambda_step(0);
+    lambda_step(1);
+
+    // a change of ownership recreates the plan
+    if (rank == 0) {
+        load_balance.add_cost(0, 1000.0);
+    }
+    load_balance.repartition(true);
+    lambda_step(2);
+    lambda_step(3);
+}
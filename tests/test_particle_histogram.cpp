@@ -0,0 +1,173 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <cmath>
+#include <ppmd.hpp>
+#include <random>
+using namespace PPMD;
+
+/*
+ * Bin of a value on the host with the same arithmetic as ParticleHistogram,
+ * -1 if the value is outside the axis.
+ */
+template <typename T>
+static int host_bin(const T value, const int nbin, const T lower,
+                    const T upper) {
+    if (!((value >= lower) && (value < upper))) {
+        return -1;
+    }
+    const T inv_width = ((T)nbin) / (upper - lower);
+    const int binx = (value - lower) * inv_width;
+    return (binx < nbin) ? binx : nbin - 1;
+}
+
+TEST_CASE("test_particle_histogram") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    int size;
+    MPICHK(MPI_Comm_size(sycl_target.comm, &size));
+
+    const int cell_count = 8;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{
+        ParticleProp(Sym<PPMD::REAL>("P"), 1, true),
+        ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+        ParticleProp(Sym<PPMD::REAL>("V"), 3, false, CellDatLayout::aosoa),
+        ParticleProp(Sym<PPMD::REAL>("W"), 2),
+        ParticleProp(Sym<float>("U"), 1)};
+
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    const int N = 1000;
+    std::mt19937 rng(1357);
+    std::uniform_int_distribution<int> cell_rng(0, cell_count - 1);
+    std::uniform_real_distribution<double> position_rng(0.0, 1.0);
+    std::normal_distribution<double> velocity_rng(0.0, 1.0);
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cell_rng(rng);
+        initial_distribution[Sym<PPMD::REAL>("P")][px][0] = position_rng(rng);
+        for (int dimx = 0; dimx < 3; dimx++) {
+            initial_distribution[Sym<PPMD::REAL>("V")][px][dimx] =
+                velocity_rng(rng);
+        }
+        initial_distribution[Sym<PPMD::REAL>("W")][px][1] = 0.25 * (px % 4);
+        initial_distribution[Sym<float>("U")][px][0] = velocity_rng(rng);
+    }
+    A.add_particles_local(initial_distribution);
+
+    auto P = A[Sym<PPMD::REAL>("P")];
+    auto V = A[Sym<PPMD::REAL>("V")];
+    auto W = A[Sym<PPMD::REAL>("W")];
+    auto U = A[Sym<float>("U")];
+
+    // f(v) over two velocity components, particles outside are not binned
+    const int nbin_v = 12;
+    ParticleHistogram<PPMD::REAL> f_v(A, {{V, 0, nbin_v, -2.0, 2.0},
+                                          {V, 2, nbin_v, -2.0, 2.0}});
+    REQUIRE(f_v.get_nbin() == nbin_v * nbin_v);
+    REQUIRE(f_v.get_shape() == std::vector<int>{nbin_v, nbin_v});
+    std::vector<PPMD::REAL> correct(nbin_v * nbin_v, 0);
+    for (int px = 0; px < N; px++) {
+        const int b0 = host_bin<PPMD::REAL>(
+            initial_distribution[Sym<PPMD::REAL>("V")][px][0], nbin_v, -2.0,
+            2.0);
+        const int b2 = host_bin<PPMD::REAL>(
+            initial_distribution[Sym<PPMD::REAL>("V")][px][2], nbin_v, -2.0,
+            2.0);
+        if ((b0 >= 0) && (b2 >= 0)) {
+            correct[b0 * nbin_v + b2] += size;
+        }
+    }
+    auto &bins_v = f_v.compute();
+    REQUIRE(bins_v == correct);
+    // a second call gives the same bins
+    REQUIRE(f_v.compute() == correct);
+
+    // weighted f(x, v)
+    const int nbin_x = 5;
+    ParticleHistogram<PPMD::REAL> f_xv(
+        A, {{P, 0, nbin_x, 0.0, 1.0}, {V, 1, nbin_v, -3.0, 3.0}}, W, 1);
+    correct.assign(nbin_x * nbin_v, 0);
+    for (int px = 0; px < N; px++) {
+        const int bx = host_bin<PPMD::REAL>(
+            initial_distribution[Sym<PPMD::REAL>("P")][px][0], nbin_x, 0.0,
+            1.0);
+        const int bv = host_bin<PPMD::REAL>(
+            initial_distribution[Sym<PPMD::REAL>("V")][px][1], nbin_v, -3.0,
+            3.0);
+        if ((bx >= 0) && (bv >= 0)) {
+            correct[bx * nbin_v + bv] +=
+                size * initial_distribution[Sym<PPMD::REAL>("W")][px][1];
+        }
+    }
+    auto &bins_xv = f_xv.compute();
+    for (int binx = 0; binx < nbin_x * nbin_v; binx++) {
+        REQUIRE(std::abs(bins_xv[binx] - correct[binx]) < 1.0e-10);
+    }
+
+    // too many bins for local memory
+    const int nbin_large = 20000;
+    ParticleHistogram<PPMD::REAL> f_large(A,
+                                          {{V, 1, nbin_large, -4.0, 4.0}});
+    correct.assign(nbin_large, 0);
+    for (int px = 0; px < N; px++) {
+        const int bv = host_bin<PPMD::REAL>(
+            initial_distribution[Sym<PPMD::REAL>("V")][px][1], nbin_large,
+            -4.0, 4.0);
+        if (bv >= 0) {
+            correct[bv] += size;
+        }
+    }
+    REQUIRE(f_large.compute() == correct);
+
+    // single precision dats
+    const int nbin_u = 7;
+    ParticleHistogram<float> f_u(A, {{U, 0, nbin_u, -1.5f, 1.5f}});
+    correct.assign(nbin_u, 0);
+    for (int px = 0; px < N; px++) {
+        const int bu = host_bin<float>(
+            initial_distribution[Sym<float>("U")][px][0], nbin_u, -1.5f,
+            1.5f);
+        if (bu >= 0) {
+            correct[bu] += size;
+        }
+    }
+    REQUIRE(f_u.compute() == correct);
+
+    // modifications of the binned dats are seen by the next call, also when
+    // the loop making them was submitted and not waited on
+    auto k_V = V->cell_dat.device_accessor();
+    auto loop = ParticleLoop(
+        "shift", A,
+        [=](const int cellx, const int layerx) {
+            k_V[cellx][0][layerx] = 10.0;
+        },
+        {dat_access<WRITE>(V)});
+    loop->submit();
+    for (auto &value : f_v.compute()) {
+        REQUIRE(value == 0);
+    }
+
+    // NaN is outside every axis, in local and in global memory
+    auto loop_nan = ParticleLoop(
+        "nan", A,
+        [=](const int cellx, const int layerx) {
+            k_V[cellx][0][layerx] = (layerx % 2 == 0) ? NAN : 0.0;
+            k_V[cellx][1][layerx] = NAN;
+            k_V[cellx][2][layerx] = 0.0;
+        },
+        {dat_access<WRITE>(V)});
+    loop_nan->execute();
+    int npart_odd = 0;
+    for (auto &npart_cell : A.get_npart_cell()) {
+        npart_odd += npart_cell / 2;
+    }
+    correct.assign(nbin_v * nbin_v, 0);
+    correct[(nbin_v / 2) * nbin_v + nbin_v / 2] = size * npart_odd;
+    REQUIRE(f_v.compute() == correct);
+    for (auto &value : f_large.compute()) {
+        REQUIRE(value == 0);
+    }
+}
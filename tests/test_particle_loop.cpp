@@ -0,0 +1,268 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <cmath>
+#include <map>
+#include <ppmd.hpp>
+#include <random>
+using namespace PPMD;
+
+TEST_CASE("test_particle_loop_flat_index_search") {
+    // cells 1 and 3 are empty
+    std::vector<int> offsets = {0, 2, 2, 5, 5, 6};
+    const int n = offsets.size() - 1;
+    std::vector<int> expected = {0, 0, 2, 2, 2, 4};
+    for (int index = 0; index < 6; index++) {
+        REQUIRE(flat_index_search(offsets.data(), n, index) == expected[index]);
+    }
+
+    REQUIRE(select_particle_loop_schedule(0, 10, 0) ==
+            ParticleLoopSchedule::cell_blocked);
+    REQUIRE(select_particle_loop_schedule(100, 10, 10) ==
+            ParticleLoopSchedule::cell_blocked);
+    REQUIRE(select_particle_loop_schedule(100, 10, 91) ==
+            ParticleLoopSchedule::flat);
+    REQUIRE(select_particle_loop_schedule(100, 10, 10, 0.5, true) ==
+            ParticleLoopSchedule::simd);
+    REQUIRE(select_particle_loop_schedule(100, 10, 91, 0.5, true) ==
+            ParticleLoopSchedule::flat);
+}
+
+TEST_CASE("test_particle_loop_schedules") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 16;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1),
+                               ParticleProp(Sym<PPMD::INT>("COUNT"), 1)};
+
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    // Place most particles in one cell such that the occupancy is skewed and
+    // leave some cells empty.
+    const int N = 300;
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> cell_rng(0, cell_count / 2 - 1);
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] =
+            (px % 3 == 0) ? 2 * cell_rng(rng) : 5;
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = px;
+    }
+    A.add_particles_local(initial_distribution);
+
+    // Traverse the cells in reverse order.
+    std::vector<int> cell_order(cell_count);
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        cell_order[cellx] = cell_count - 1 - cellx;
+    }
+    A.set_cell_order(cell_order);
+
+    auto k_ID = A[Sym<PPMD::INT>("ID")]->cell_dat.device_ptr();
+    auto k_COUNT = A[Sym<PPMD::INT>("COUNT")]->cell_dat.device_ptr();
+    auto k_P = A[Sym<PPMD::REAL>("P")]->cell_dat.device_ptr();
+
+    auto loop = ParticleLoop(
+        "test_particle_loop", A, [=](const int cellx, const int layerx) {
+            k_COUNT[cellx][0][layerx] += 1;
+            k_P[cellx][0][layerx] = k_ID[cellx][0][layerx] * 2;
+            k_P[cellx][1][layerx] = cellx;
+        });
+    // The occupancy is skewed hence the flat schedule should be selected.
+    REQUIRE(loop->get_schedule() == ParticleLoopSchedule::flat);
+
+    auto lambda_check = [&](const int count) {
+        auto ID = A[Sym<PPMD::INT>("ID")];
+        auto COUNT = A[Sym<PPMD::INT>("COUNT")];
+        auto P = A[Sym<PPMD::REAL>("P")];
+        int npart_found = 0;
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            auto ID_data = ID->cell_dat.get_cell(cellx);
+            auto COUNT_data = COUNT->cell_dat.get_cell(cellx);
+            auto P_data = P->cell_dat.get_cell(cellx);
+            for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+                REQUIRE((*COUNT_data)[0][rowx] == count);
+                REQUIRE((*P_data)[0][rowx] == (*ID_data)[0][rowx] * 2);
+                REQUIRE((*P_data)[1][rowx] == cellx);
+                npart_found++;
+            }
+        }
+        REQUIRE(npart_found == N);
+    };
+
+    loop->execute();
+    lambda_check(1);
+    loop->schedule = ParticleLoopSchedule::cell_blocked;
+    loop->execute();
+    lambda_check(2);
+    loop->schedule = ParticleLoopSchedule::flat;
+    loop->execute();
+    lambda_check(3);
+    // the occupancies are not multiples of the batch width
+    loop->schedule = ParticleLoopSchedule::simd;
+    loop->execute();
+    lambda_check(4);
+    // copies from the device are ordered after a submitted loop without
+    // waiting on it, also through the host mirror
+    auto COUNT = A[Sym<PPMD::INT>("COUNT")];
+    COUNT->cell_dat.enable_host_mirror();
+    COUNT->cell_dat.get_host_cell(5);
+    loop->schedule = ParticleLoopSchedule::automatic;
+    loop->submit();
+    lambda_check(5);
+    loop->submit();
+    auto &COUNT_host = COUNT->cell_dat.get_host_cell(5);
+    for (int rowx = 0; rowx < COUNT_host.nrow; rowx++) {
+        REQUIRE(COUNT_host[0][rowx] == 6);
+    }
+    sycl_target.wait_all();
+
+    // a loop submitted without waiting on an earlier loop that writes the
+    // data it reads is ordered after that loop
+    auto loop_write = ParticleLoop(
+        "test_particle_loop_write", A, [=](const int cellx, const int layerx) {
+            k_COUNT[cellx][0][layerx] = k_ID[cellx][0][layerx];
+        });
+    auto loop_read = ParticleLoop(
+        "test_particle_loop_read", A, [=](const int cellx, const int layerx) {
+            k_P[cellx][0][layerx] = 2 * k_COUNT[cellx][0][layerx];
+            k_P[cellx][1][layerx] = cellx;
+        });
+    for (int repx = 0; repx < 4; repx++) {
+        loop_write->submit();
+        loop_read->submit();
+        sycl_target.wait_all();
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            auto ID_data = A[Sym<PPMD::INT>("ID")]->cell_dat.get_cell(cellx);
+            auto P_data = A[Sym<PPMD::REAL>("P")]->cell_dat.get_cell(cellx);
+            for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+                REQUIRE((*P_data)[0][rowx] == (*ID_data)[0][rowx] * 2);
+            }
+        }
+        ParticleLoop("test_particle_loop_clear", A,
+                     [=](const int cellx, const int layerx) {
+                         k_COUNT[cellx][0][layerx] = 0;
+                     })
+            ->execute();
+    }
+}
+
+TEST_CASE("test_particle_loop_fusion") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 6;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 1, true),
+                               ParticleProp(Sym<PPMD::REAL>("V"), 1),
+                               ParticleProp(Sym<PPMD::REAL>("Q"), 1),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1)};
+
+    ParticleGroup A(domain, particle_spec, sycl_target);
+    const int N = 120;
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] =
+            px % cell_count;
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = px;
+        initial_distribution[Sym<PPMD::REAL>("P")][px][0] = 0.1 * px;
+        initial_distribution[Sym<PPMD::REAL>("V")][px][0] = 0.3;
+    }
+    A.add_particles_local(initial_distribution);
+
+    auto P = A[Sym<PPMD::REAL>("P")];
+    auto V = A[Sym<PPMD::REAL>("V")];
+    auto Q = A[Sym<PPMD::REAL>("Q")];
+    auto k_P = P->cell_dat.device_ptr();
+    auto k_V = V->cell_dat.device_ptr();
+    auto k_Q = Q->cell_dat.device_ptr();
+
+    auto loop_push = ParticleLoop(
+        "push", A,
+        [=](const int cellx, const int layerx) {
+            k_P[cellx][0][layerx] += k_V[cellx][0][layerx];
+        },
+        {dat_access<READ>(V), dat_access<WRITE>(P)});
+    auto loop_boundary = ParticleLoop(
+        "boundary", A,
+        [=](const int cellx, const int layerx) {
+            if (k_P[cellx][0][layerx] > 10.0) {
+                k_P[cellx][0][layerx] -= 10.0;
+            }
+        },
+        {dat_access<WRITE>(P)});
+    // reads the position of another particle in the cell
+    auto loop_neighbour = ParticleLoop(
+        "neighbour", A,
+        [=](const int cellx, const int layerx) {
+            k_Q[cellx][0][layerx] = k_P[cellx][0][0] + k_P[cellx][0][layerx];
+        },
+        {dat_access<READ>(P, false), dat_access<WRITE>(Q)});
+
+    REQUIRE(can_fuse_particle_loops(loop_push->accesses,
+                                    loop_boundary->accesses));
+    REQUIRE(!can_fuse_particle_loops(loop_boundary->accesses,
+                                     loop_neighbour->accesses));
+
+    auto sequence = ParticleLoopSequence("step", loop_push, loop_boundary,
+                                         loop_neighbour);
+    auto segments = sequence->get_segments();
+    REQUIRE(segments.size() == 2);
+    REQUIRE(segments[0] == std::pair<int, int>(0, 2));
+    REQUIRE(segments[1] == std::pair<int, int>(2, 3));
+
+    // compute the expected values on the host
+    std::map<PPMD::INT, double> p_correct;
+    for (int px = 0; px < N; px++) {
+        double p = 0.1 * px;
+        for (int stepx = 0; stepx < 3; stepx++) {
+            p += 0.3;
+            p = (p > 10.0) ? p - 10.0 : p;
+        }
+        p_correct[px] = p;
+    }
+
+    auto lambda_check = [&]() {
+        auto ID = A[Sym<PPMD::INT>("ID")];
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            auto ID_data = ID->cell_dat.get_cell(cellx);
+            auto P_data = P->cell_dat.get_cell(cellx);
+            auto Q_data = Q->cell_dat.get_cell(cellx);
+            for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+                const double p = p_correct[(*ID_data)[0][rowx]];
+                REQUIRE(std::abs((*P_data)[0][rowx] - p) < 1.0e-10);
+                REQUIRE(std::abs((*Q_data)[0][rowx] -
+                                 ((*P_data)[0][0] + (*P_data)[0][rowx])) <
+                        1.0e-10);
+            }
+        }
+    };
+
+    for (int stepx = 0; stepx < 3; stepx++) {
+        sequence->execute();
+    }
+    lambda_check();
+
+    // the unfused execution gives the same result
+    sequence->fusion_enabled = false;
+    REQUIRE(sequence->get_segments().size() == 3);
+    for (int px = 0; px < N; px++) {
+        double p = p_correct[px];
+        for (int stepx = 0; stepx < 3; stepx++) {
+            p += 0.3;
+            p = (p > 10.0) ? p - 10.0 : p;
+        }
+        p_correct[px] = p;
+    }
+    for (int stepx = 0; stepx < 3; stepx++) {
+        sequence->execute();
+    }
+    lambda_check();
+}
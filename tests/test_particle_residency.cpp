@@ -0,0 +1,189 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <ppmd.hpp>
+#include <random>
+using namespace PPMD;
+
+TEST_CASE("test_particle_residency") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    auto &profiler = sycl_target.profiler;
+
+    const int cell_count = 16;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{
+        ParticleProp(Sym<PPMD::REAL>("P"), 2, true),
+        ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+        ParticleProp(Sym<PPMD::INT>("ID"), 1),
+        ParticleProp(Sym<PPMD::INT>("COUNT"), 1),
+        ParticleProp(Sym<PPMD::REAL>("V"), 2, false, CellDatLayout::aosoa)};
+
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    const int N = 400;
+    std::mt19937 rng(9876);
+    std::uniform_int_distribution<int> cell_rng(0, cell_count - 1);
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cell_rng(rng);
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = px;
+        initial_distribution[Sym<PPMD::REAL>("P")][px][0] = px;
+        initial_distribution[Sym<PPMD::REAL>("P")][px][1] = -px;
+        initial_distribution[Sym<PPMD::REAL>("V")][px][0] = 0.5;
+        initial_distribution[Sym<PPMD::REAL>("V")][px][1] = px % 3;
+    }
+    A.add_particles_local(initial_distribution);
+
+    auto P = A[Sym<PPMD::REAL>("P")];
+    auto V = A[Sym<PPMD::REAL>("V")];
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto COUNT = A[Sym<PPMD::INT>("COUNT")];
+    auto k_P = P->cell_dat.device_accessor();
+    auto k_V = V->cell_dat.device_accessor();
+    auto k_COUNT = COUNT->cell_dat.device_accessor();
+
+    std::size_t total_bytes = 0;
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        A.for_each_particle_dat([&](auto &dat) {
+            total_bytes += dat->cell_dat.get_data_bytes(cellx);
+        });
+    }
+    const std::size_t budget = total_bytes / 4;
+    ParticleResidency residency(A, budget);
+    REQUIRE(residency.get_nbatch() > 2);
+
+    auto lambda_check = [&](const int nstep) {
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            auto ID_data = ID->cell_dat.get_cell(cellx);
+            auto P_data = P->cell_dat.get_cell(cellx);
+            auto V_data = V->cell_dat.get_cell(cellx);
+            auto COUNT_data = COUNT->cell_dat.get_cell(cellx);
+            for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+                const int px = (*ID_data)[0][rowx];
+                REQUIRE((*V_data)[0][rowx] == 0.5);
+                REQUIRE((*V_data)[1][rowx] == px % 3);
+                REQUIRE((*P_data)[0][rowx] == px + nstep * 0.5);
+                REQUIRE((*P_data)[1][rowx] == -px + nstep * (px % 3));
+                REQUIRE((*COUNT_data)[0][rowx] == nstep);
+            }
+        }
+    };
+
+    auto lambda_push = [=](const int cellx, const int layerx) {
+        for (int dimx = 0; dimx < 2; dimx++) {
+            k_P[cellx][dimx][layerx] += k_V[cellx][dimx][layerx];
+        }
+        k_COUNT[cellx][0][layerx] += 1;
+    };
+
+    // undeclared accesses treat every dat as written
+    residency.execute("push", lambda_push);
+    REQUIRE(!P->cell_dat.all_resident());
+    REQUIRE(residency.get_peak_resident_bytes() <= budget);
+    lambda_check(1);
+
+    // only the written dats are copied back when a batch is paged out
+    residency.page_out_all();
+    REQUIRE(residency.get_resident_bytes() == 0);
+    profiler.enable();
+    profiler.reset();
+    residency.reset_peak_resident_bytes();
+    residency.execute("push", lambda_push,
+                      {dat_access<READ>(V), dat_access<WRITE>(P),
+                       dat_access<WRITE>(COUNT)});
+    REQUIRE(residency.get_peak_resident_bytes() <= budget);
+    auto bytes = profiler.get_bytes();
+    std::size_t written_bytes = 0;
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        if (!residency.is_resident(cellx)) {
+            written_bytes += P->cell_dat.get_data_bytes(cellx) +
+                             COUNT->cell_dat.get_data_bytes(cellx);
+        }
+    }
+    REQUIRE(bytes["page_out"] == written_bytes);
+    profiler.disable();
+    lambda_check(2);
+
+    // host writes to a paged out cell are seen by the device
+    int cell_out = 0;
+    while (residency.is_resident(cell_out)) {
+        cell_out++;
+    }
+    auto COUNT_data = COUNT->cell_dat.get_cell(cell_out);
+    REQUIRE(COUNT_data->nrow > 0);
+    for (int rowx = 0; rowx < COUNT_data->nrow; rowx++) {
+        (*COUNT_data)[0][rowx] = -1;
+    }
+    COUNT->cell_dat.set_cell(cell_out, COUNT_data);
+    residency.execute(
+        "restore",
+        [=](const int cellx, const int layerx) {
+            if (k_COUNT[cellx][0][layerx] < 0) {
+                k_COUNT[cellx][0][layerx] = 2;
+            }
+        },
+        {dat_access<WRITE>(COUNT)});
+    lambda_check(2);
+
+    // particles are added to and removed from paged out cells
+    residency.page_out_all();
+    REQUIRE(residency.get_resident_bytes() == 0);
+    const int N_add = 50;
+    ParticleSet add_distribution(N_add, particle_spec);
+    for (int px = 0; px < N_add; px++) {
+        add_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cell_rng(rng);
+        add_distribution[Sym<PPMD::INT>("ID")][px][0] = N + px;
+        add_distribution[Sym<PPMD::INT>("COUNT")][px][0] = 2;
+        add_distribution[Sym<PPMD::REAL>("P")][px][0] = N + px + 1.0;
+        add_distribution[Sym<PPMD::REAL>("P")][px][1] =
+            -(N + px) + 2 * ((N + px) % 3);
+        add_distribution[Sym<PPMD::REAL>("V")][px][0] = 0.5;
+        add_distribution[Sym<PPMD::REAL>("V")][px][1] = (N + px) % 3;
+    }
+    A.add_particles_local(add_distribution);
+    REQUIRE(residency.get_resident_bytes() == 0);
+    REQUIRE(A.get_npart_local() == N + N_add);
+    lambda_check(2);
+
+    std::vector<PPMD::INT> remove_cells;
+    std::vector<PPMD::INT> remove_layers;
+    for (int cellx = 0; cellx < cell_count; cellx += 3) {
+        if (A.get_npart_cell()[cellx] > 1) {
+            remove_cells.push_back(cellx);
+            remove_layers.push_back(0);
+            remove_cells.push_back(cellx);
+            remove_layers.push_back(A.get_npart_cell()[cellx] - 1);
+        }
+    }
+    const int npart_remove = remove_cells.size();
+    A.remove_particles(npart_remove, remove_cells, remove_layers);
+    REQUIRE(residency.get_resident_bytes() == 0);
+    REQUIRE(A.get_npart_local() == N + N_add - npart_remove);
+    lambda_check(2);
+
+    // whole group operations after paging in every cell
+    residency.page_in_all();
+    A.for_each_particle_dat(
+        [&](auto &dat) { REQUIRE(dat->cell_dat.all_resident()); });
+    REQUIRE(residency.get_resident_bytes() >= total_bytes);
+    auto loop = ParticleLoop(
+        "push", A, lambda_push,
+        {dat_access<READ>(V), dat_access<WRITE>(P), dat_access<WRITE>(COUNT)});
+    loop->execute();
+    lambda_check(3);
+
+    // a group that fits in one batch stays resident between calls
+    ParticleResidency residency_all(A, 4 * residency.get_resident_bytes());
+    REQUIRE(residency_all.get_nbatch() == 1);
+    residency_all.execute("push", lambda_push);
+    profiler.enable();
+    profiler.reset();
+    residency_all.execute("push", lambda_push);
+    bytes = profiler.get_bytes();
+    REQUIRE(bytes["page_in"] == 0);
+    REQUIRE(bytes["page_out"] == 0);
+    profiler.disable();
+    lambda_check(5);
+}
@@ -0,0 +1,136 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <ppmd.hpp>
+#include <random>
+using namespace PPMD;
+
+TEST_CASE("test_morton_cell_order") {
+    std::vector<int> dims = {4, 2};
+    auto order = morton_cell_order(2, dims);
+    std::vector<int> correct = {0, 1, 4, 5, 2, 3, 6, 7};
+    REQUIRE(order == correct);
+}
+
+/*
+ * Sort particles placed uniformly in the coarse cells, or with every other
+ * particle in the first cell if skewed, and check that the particles of each
+ * cell are in Morton key order, and that particles with equal keys keep their
+ * order.
+ */
+static void particle_sort_test(const int ndim, std::vector<int> dims,
+                               const int subdivision_order,
+                               const int N = 400, const bool skewed = false) {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const double extent = 2.0;
+    MeshHierarchy mh(sycl_target, ndim, dims, extent, subdivision_order);
+
+    const int cell_count = mh.ncells_coarse;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{
+        ParticleProp(Sym<PPMD::REAL>("P"), ndim, true),
+        ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+        ParticleProp(Sym<PPMD::INT>("ID"), 1)};
+
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> cell_rng(0, cell_count - 1);
+    std::uniform_real_distribution<double> pos_rng(0.0, 1.0);
+
+    ParticleSet initial_distribution(N, particle_spec);
+    std::vector<double> px_pos(N * ndim);
+    for (int px = 0; px < N; px++) {
+        const int cell = (skewed && (px % 2 == 0)) ? 0 : cell_rng(rng);
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cell;
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = px;
+        int cell_remainder = cell;
+        for (int dimx = 0; dimx < ndim; dimx++) {
+            const int cell_index = cell_remainder % dims[dimx];
+            cell_remainder /= dims[dimx];
+            const double pos = (cell_index + pos_rng(rng)) * extent;
+            initial_distribution[Sym<PPMD::REAL>("P")][px][dimx] = pos;
+            px_pos[px * ndim + dimx] = pos;
+        }
+    }
+    A.add_particles_local(initial_distribution);
+
+    auto P = A[Sym<PPMD::REAL>("P")];
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto CELL_ID = A[Sym<PPMD::INT>("CELL_ID")];
+
+    // the layer of each particle before sorting
+    std::vector<int> layer_before(N);
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < ID_data->nrow; rowx++) {
+            layer_before[(*ID_data)[0][rowx]] = rowx;
+        }
+    }
+
+    ParticleSort particle_sort(A, mh, 2);
+    auto cell_order = A.get_cell_order();
+    REQUIRE(cell_order == morton_cell_order(ndim, dims));
+
+    // sort frequency is 2 so the first step should not sort
+    REQUIRE(!particle_sort.step());
+    REQUIRE(particle_sort.step());
+
+    const int nfine = 1 << subdivision_order;
+    int npart_found = 0;
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto P_data = P->cell_dat.get_cell(cellx);
+        auto ID_data = ID->cell_dat.get_cell(cellx);
+        auto CELL_ID_data = CELL_ID->cell_dat.get_cell(cellx);
+        const int nrow = ID_data->nrow;
+        std::uint64_t key_previous = 0;
+        int layer_previous = -1;
+        for (int rowx = 0; rowx < nrow; rowx++) {
+            const PPMD::INT id = (*ID_data)[0][rowx];
+            REQUIRE((*CELL_ID_data)[0][rowx] == cellx);
+            int index[3];
+            for (int dimx = 0; dimx < ndim; dimx++) {
+                const double pos = (*P_data)[dimx][rowx];
+                REQUIRE(pos == px_pos[id * ndim + dimx]);
+                index[dimx] =
+                    ((int)std::floor(pos * mh.inverse_cell_width_fine)) % nfine;
+            }
+            const std::uint64_t key =
+                morton_encode(ndim, index, subdivision_order);
+            REQUIRE(key >= key_previous);
+            if ((rowx > 0) && (key == key_previous)) {
+                REQUIRE(layer_before[id] > layer_previous);
+            }
+            key_previous = key;
+            layer_previous = layer_before[id];
+            npart_found++;
+        }
+    }
+    REQUIRE(npart_found == N);
+}
+
+TEST_CASE("test_particle_sort_1") {
+    std::vector<int> correct_order = {0, 1, 4, 5, 2, 3, 6, 7};
+    REQUIRE(morton_cell_order(2, {4, 2}) == correct_order);
+    particle_sort_test(2, {4, 2}, 2);
+}
+
+TEST_CASE("test_particle_sort_multi_pass") {
+    // 12 bit keys are sorted in two passes
+    particle_sort_test(3, {2, 2, 1}, 4);
+}
+
+TEST_CASE("test_particle_sort_dense_cells") {
+    // the cells hold more particles than a block of the radix sort hence
+    // each cell is sorted by several work items
+    particle_sort_test(1, {2}, 4, 1500);
+}
+
+TEST_CASE("test_particle_sort_skewed_cells") {
+    // the first cell holds several blocks of the radix sort and the other
+    // cells less than one block
+    particle_sort_test(2, {4, 4}, 3, 1500, true);
+}
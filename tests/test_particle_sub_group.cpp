@@ -0,0 +1,208 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <ppmd.hpp>
+#include <random>
+using namespace PPMD;
+
+TEST_CASE("test_particle_sub_group") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+
+    const int cell_count = 8;
+    Mesh mesh(cell_count);
+    Domain domain(mesh);
+
+    ParticleSpec particle_spec{ParticleProp(Sym<PPMD::REAL>("P"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("CELL_ID"), 1, true),
+                               ParticleProp(Sym<PPMD::INT>("ID"), 1),
+                               ParticleProp(Sym<PPMD::INT>("FLAG"), 1),
+                               ParticleProp(Sym<PPMD::INT>("COUNT"), 1)};
+
+    ParticleGroup A(domain, particle_spec, sycl_target);
+
+    const int N = 200;
+    std::mt19937 rng(4321);
+    std::uniform_int_distribution<int> cell_rng(0, cell_count - 1);
+    ParticleSet initial_distribution(N, particle_spec);
+    for (int px = 0; px < N; px++) {
+        initial_distribution[Sym<PPMD::INT>("CELL_ID")][px][0] = cell_rng(rng);
+        initial_distribution[Sym<PPMD::INT>("ID")][px][0] = px;
+        initial_distribution[Sym<PPMD::INT>("FLAG")][px][0] = (px % 7 == 0);
+    }
+    A.add_particles_local(initial_distribution);
+
+    auto ID = A[Sym<PPMD::INT>("ID")];
+    auto FLAG = A[Sym<PPMD::INT>("FLAG")];
+    auto COUNT = A[Sym<PPMD::INT>("COUNT")];
+    auto k_ID = ID->cell_dat.device_ptr();
+    auto k_FLAG = FLAG->cell_dat.device_ptr();
+    auto k_COUNT = COUNT->cell_dat.device_ptr();
+
+    auto sub_group = ParticleSubGroup(
+        A,
+        [=](const int cellx, const int layerx) {
+            return k_FLAG[cellx][0][layerx] > 0;
+        },
+        {dat_access<READ>(FLAG)});
+
+    // check the selection against the host copy of the dats
+    auto lambda_check = [&]() {
+        std::vector<int> &npart_cell = sub_group->get_npart_cell();
+        std::vector<int> &cell_offsets = sub_group->get_cell_offsets();
+        const int npart = sub_group->get_npart_local();
+        std::vector<int> cells(npart);
+        std::vector<int> layers(npart);
+        if (npart > 0) {
+            sycl_target.queue
+                .memcpy(cells.data(), sub_group->get_device_cells(),
+                        npart * sizeof(int))
+                .wait();
+            sycl_target.queue
+                .memcpy(layers.data(), sub_group->get_device_layers(),
+                        npart * sizeof(int))
+                .wait();
+        }
+        int npart_found = 0;
+        for (int cellx = 0; cellx < cell_count; cellx++) {
+            REQUIRE(cell_offsets[cellx] == npart_found);
+            auto FLAG_data = FLAG->cell_dat.get_cell(cellx);
+            int count = 0;
+            for (int rowx = 0; rowx < FLAG_data->nrow; rowx++) {
+                if ((*FLAG_data)[0][rowx] > 0) {
+                    REQUIRE(cells[npart_found] == cellx);
+                    REQUIRE(layers[npart_found] == rowx);
+                    npart_found++;
+                    count++;
+                }
+            }
+            REQUIRE(npart_cell[cellx] == count);
+        }
+        REQUIRE(npart == npart_found);
+        return npart_found;
+    };
+
+    REQUIRE(!sub_group->is_valid());
+    REQUIRE(lambda_check() == (N + 6) / 7);
+    REQUIRE(sub_group->is_valid());
+
+    // a loop over the selection only visits the selected particles
+    auto loop_count = ParticleLoop(
+        "count", sub_group,
+        [=](const int cellx, const int layerx) {
+            k_COUNT[cellx][0][layerx] += 1;
+        },
+        {dat_access<WRITE>(COUNT)});
+    loop_count->execute();
+    loop_count->execute();
+    // the predicate does not read COUNT hence the selection is reused
+    REQUIRE(sub_group->is_valid());
+    for (int cellx = 0; cellx < cell_count; cellx++) {
+        auto FLAG_data = FLAG->cell_dat.get_cell(cellx);
+        auto COUNT_data = COUNT->cell_dat.get_cell(cellx);
+        for (int rowx = 0; rowx < FLAG_data->nrow; rowx++) {
+            REQUIRE((*COUNT_data)[0][rowx] == 2 * (*FLAG_data)[0][rowx]);
+        }
+    }
+
+    // the selection is made at most once per execution of a loop, the
+    // predicate counts the particles it is evaluated for
+    BufferDevice<int> d_nevaluated(sycl_target, 1);
+    int *k_nevaluated = d_nevaluated.ptr;
+    auto lambda_nevaluated = [&]() {
+        int nevaluated;
+        sycl_target.queue.memcpy(&nevaluated, k_nevaluated, sizeof(int))
+            .wait();
+        return nevaluated;
+    };
+    auto lambda_predicate = [=](const int cellx, const int layerx) {
+        atomic_fetch_add(k_nevaluated, 1);
+        return k_FLAG[cellx][0][layerx] > 0;
+    };
+    auto lambda_increment = [=](const int cellx, const int layerx) {
+        k_COUNT[cellx][0][layerx] += 1;
+    };
+    const int nloop = 3;
+    auto counted_groups = {
+        ParticleSubGroup(A, lambda_predicate),
+        ParticleSubGroup(A, lambda_predicate, {dat_access<READ>(FLAG)})};
+    // the loop writes a dat read by the undeclared predicate, hence the
+    // selection is made once per execution, otherwise only once
+    int nselect_expected = nloop;
+    for (auto counted_group : counted_groups) {
+        sycl_target.queue.fill(k_nevaluated, 0, 1).wait();
+        auto loop_counted =
+            ParticleLoop("counted", counted_group, lambda_increment,
+                         {dat_access<WRITE>(COUNT)});
+        for (int loopx = 0; loopx < nloop; loopx++) {
+            loop_counted->execute();
+        }
+        REQUIRE(lambda_nevaluated() == nselect_expected * N);
+        nselect_expected = 1;
+    }
+
+    // reductions over the selection
+    PPMD::INT id_sum = 0;
+    for (int px = 0; px < N; px += 7) {
+        id_sum += px;
+    }
+    auto lambda_id = [=](const int cellx, const int layerx) {
+        return k_ID[cellx][0][layerx];
+    };
+    REQUIRE(sub_group->reduce_sum<PPMD::INT>(lambda_id) == id_sum);
+
+    // writing the predicate dat invalidates the selection
+    auto loop_flag = ParticleLoop(
+        "flag", A,
+        [=](const int cellx, const int layerx) {
+            k_FLAG[cellx][0][layerx] = (k_ID[cellx][0][layerx] % 5 == 0);
+        },
+        {dat_access<READ>(ID), dat_access<WRITE>(FLAG)});
+    loop_flag->execute();
+    REQUIRE(!sub_group->is_valid());
+    REQUIRE(lambda_check() == (N + 4) / 5);
+
+    // the selection made after a loop that was submitted and not waited on
+    // sees the values written by the loop
+    auto loop_flag_3 = ParticleLoop(
+        "flag_3", A,
+        [=](const int cellx, const int layerx) {
+            k_FLAG[cellx][0][layerx] = (k_ID[cellx][0][layerx] % 3 == 0);
+        },
+        {dat_access<READ>(ID), dat_access<WRITE>(FLAG)});
+    loop_flag_3->submit();
+    REQUIRE(sub_group->get_npart_local() == (N + 2) / 3);
+    REQUIRE(lambda_check() == (N + 2) / 3);
+    loop_flag->submit();
+    REQUIRE(sub_group->get_npart_local() == (N + 4) / 5);
+    REQUIRE(lambda_check() == (N + 4) / 5);
+
+    // adding particles invalidates the selection
+    const int N2 = 30;
+    ParticleSet new_particles(N2, particle_spec);
+    for (int px = 0; px < N2; px++) {
+        new_particles[Sym<PPMD::INT>("CELL_ID")][px][0] = cell_rng(rng);
+        new_particles[Sym<PPMD::INT>("ID")][px][0] = N + px;
+        new_particles[Sym<PPMD::INT>("FLAG")][px][0] = 1;
+    }
+    A.add_particles_local(new_particles);
+    REQUIRE(!sub_group->is_valid());
+    REQUIRE(lambda_check() == (N + 4) / 5 + N2);
+
+    // a loop over the selection that clears the flag empties the selection
+    auto loop_clear = ParticleLoop(
+        "clear", sub_group,
+        [=](const int cellx, const int layerx) {
+            k_FLAG[cellx][0][layerx] = 0;
+        },
+        {dat_access<WRITE>(FLAG)});
+    loop_clear->execute();
+    REQUIRE(!sub_group->is_valid());
+    REQUIRE(sub_group->get_npart_local() == 0);
+    REQUIRE(lambda_check() == 0);
+
+    // an empty selection
+    auto empty_group = ParticleSubGroup(
+        A, [=](const int cellx, const int layerx) { return false; });
+    REQUIRE(empty_group->get_npart_local() == 0);
+    REQUIRE(empty_group->reduce_sum<PPMD::INT>(lambda_id) == 0);
+}
@@ -0,0 +1,109 @@
+#include <CL/sycl.hpp>
+#include <catch2/catch.hpp>
+#include <fstream>
+#include <ppmd.hpp>
+#include <sstream>
+using namespace PPMD;
+
+TEST_CASE("test_profiler_regions") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    auto &profiler = sycl_target.profiler;
+    profiler.disable();
+    profiler.reset();
+
+    // nothing should be recorded when disabled
+    profiler.start_region("disabled");
+    profiler.add_bytes("disabled", 10);
+    profiler.end_region();
+    REQUIRE(profiler.get_region_totals().size() == 0);
+    REQUIRE(profiler.get_bytes().size() == 0);
+
+    profiler.enable();
+    profiler.start_region("outer");
+    profiler.start_region("inner");
+    profiler.add_bytes("host_to_device", 100);
+    profiler.end_region();
+    profiler.add_bytes("host_to_device", 28);
+    profiler.end_region();
+
+    // operations in the library record regions and transfers
+    CellDat<PPMD::REAL> cell_dat(sycl_target, 2, 3);
+    cell_dat.set_nrow(0, 4);
+    auto cell_data = cell_dat.get_cell(0);
+    cell_dat.set_cell(0, cell_data);
+
+    auto totals = profiler.get_region_totals();
+    REQUIRE(totals.count("outer") == 1);
+    REQUIRE(totals.count("inner") == 1);
+    REQUIRE(totals.count("CellDat::get_cell") == 1);
+    REQUIRE(totals.count("CellDat::set_cell") == 1);
+    REQUIRE(totals["outer"] >= totals["inner"]);
+    auto bytes = profiler.get_bytes();
+    REQUIRE(bytes["host_to_device"] == 128 + 4 * 3 * sizeof(PPMD::REAL));
+    REQUIRE(bytes["device_to_host"] == 4 * 3 * sizeof(PPMD::REAL));
+
+    const std::string filename = "test_profiler_regions_trace.json";
+    profiler.write_chrome_trace(filename);
+    std::ifstream trace(filename);
+    std::stringstream contents;
+    contents << trace.rdbuf();
+    REQUIRE(contents.str().find("\"traceEvents\"") != std::string::npos);
+    REQUIRE(contents.str().find("\"name\":\"inner\"") != std::string::npos);
+    std::remove(filename.c_str());
+
+    profiler.print_summary(MPI_COMM_WORLD);
+    profiler.disable();
+    profiler.reset();
+}
+
+TEST_CASE("test_profiler_copy_events") {
+
+    // device timings require queues created with profiling enabled
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD, true};
+    auto &profiler = sycl_target.profiler;
+    REQUIRE(profiler.device_profiling);
+    profiler.enable();
+    profiler.reset();
+
+    // copies on the copy queues are recorded as device events
+    CellDat<PPMD::REAL> cell_dat(sycl_target, 2, 3);
+    cell_dat.set_nrow(0, 4);
+    auto cell_data = cell_dat.get_cell(0);
+    cell_dat.set_cell(0, cell_data);
+    cell_dat.page_out_cells({0});
+    EventStack es;
+    cell_dat.page_in_cells_async({0}, es);
+    es.wait();
+
+    auto totals = profiler.get_region_totals();
+    REQUIRE(totals.count("device:CellDat::get_cell") == 1);
+    REQUIRE(totals.count("device:CellDat::set_cell") == 1);
+    REQUIRE(totals.count("device:CellDat::page_out") == 1);
+    REQUIRE(totals.count("device:CellDat::page_in") == 1);
+
+    profiler.disable();
+    profiler.reset();
+}
+
+TEST_CASE("test_profiler_device_events_without_profiling") {
+
+    SYCLTarget sycl_target{GPU_SELECTOR, MPI_COMM_WORLD};
+    auto &profiler = sycl_target.profiler;
+    const bool device_profiling = profiler.device_profiling;
+    profiler.enable();
+    profiler.reset();
+
+    // events from a queue without profiling enabled are discarded rather
+    // than read
+    sycl::queue queue(sycl_target.context, sycl_target.device);
+    BufferDevice<int> d_value(sycl_target, 1);
+    profiler.device_profiling = true;
+    profiler.add_device_event("unprofiled", queue.fill(d_value.ptr, 1, 1));
+    auto totals = profiler.get_region_totals();
+    REQUIRE(totals.count("device:unprofiled") == 0);
+
+    profiler.device_profiling = device_profiling;
+    profiler.disable();
+    profiler.reset();
+}